@@ -0,0 +1,46 @@
+#ifndef CRC_DEFINED_H_
+#define CRC_DEFINED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Slices of lookup table per algorithm: 8 (slicing-by-8, 8 KB for each
+ * 32-bit CRC), 4 or 1 (byte at a time, 1 KB).
+ */
+#ifndef CRC_SLICES
+#define CRC_SLICES 8
+#endif
+
+/*
+ * The tables are const and stay in flash on microcontrollers. Define
+ * PICORB_CRC_TABLES_IN_RAM to have them copied to RAM at startup
+ * instead, where reads do not wait on the flash cache.
+ */
+
+/*
+ * Each function continues from the value it returned for the data
+ * before, so a checksum may be computed a chunk at a time. The initial
+ * value is 0, except 0xFFFF for CRC-16 and 1 for Adler-32.
+ */
+
+/* CRC-32 (ISO-HDLC, as zlib) */
+uint32_t CRC_crc32(const uint8_t *data, size_t len, uint32_t crc);
+/* CRC-32C (Castagnoli, as iSCSI and ext4) */
+uint32_t CRC_crc32c(const uint8_t *data, size_t len, uint32_t crc);
+/* CRC-16/CCITT-FALSE: polynomial 0x1021, not reflected */
+uint16_t CRC_crc16(const uint8_t *data, size_t len, uint16_t crc);
+/* CRC-8/SMBUS: polynomial 0x07, not reflected */
+uint8_t CRC_crc8(const uint8_t *data, size_t len, uint8_t crc);
+/* Adler-32 (RFC 1950) */
+uint32_t CRC_adler32(const uint8_t *data, size_t len, uint32_t adler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC_DEFINED_H_ */
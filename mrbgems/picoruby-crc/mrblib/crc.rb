@@ -0,0 +1,62 @@
+module CRC
+  # Streaming checksum over data that arrives in pieces:
+  #
+  #   digest = CRC::Digest.new(:crc32c)
+  #   digest.update(block1).update(block2)
+  #   digest.finish  #=> Integer
+  class Digest
+    ALGORITHMS = [:crc32, :crc32c, :crc16, :crc8, :adler32]
+
+    attr_reader :algorithm
+
+    def initialize(algorithm = :crc32)
+      unless ALGORITHMS.include?(algorithm)
+        raise ArgumentError.new("Unknown algorithm: #{algorithm}")
+      end
+      @algorithm = algorithm
+      reset
+    end
+
+    def update(data)
+      @value = case @algorithm
+      when :crc32
+        CRC.crc32(data, @value)
+      when :crc32c
+        CRC.crc32c(data, @value)
+      when :crc16
+        CRC.crc16(data, @value)
+      when :crc8
+        CRC.crc8(data, @value)
+      else
+        CRC.adler32(data, @value)
+      end
+      self
+    end
+
+    def <<(data)
+      update(data)
+    end
+
+    # The checksum of everything given to update since the last reset.
+    # The digest may be updated further afterwards.
+    def finish
+      @value
+    end
+
+    def reset
+      @value = case @algorithm
+      when :crc32
+        CRC.crc32
+      when :crc32c
+        CRC.crc32c
+      when :crc16
+        CRC.crc16
+      when :crc8
+        CRC.crc8
+      else
+        CRC.adler32
+      end
+      self
+    end
+  end
+end
@@ -1,37 +1,205 @@
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include "../include/crc.h"
 
+#if CRC_SLICES != 1 && CRC_SLICES != 4 && CRC_SLICES != 8
+#error "CRC_SLICES must be 1, 4 or 8"
+#endif
+
+#ifdef PICORB_CRC_TABLES_IN_RAM
+#define CRC_TABLE_CONST
+#else
+#define CRC_TABLE_CONST const
+#endif
+
+#include "crc_tables.h"
+
+/*
+ * CRC instructions
+ *
+ * SSE4.2 has CRC-32C only and is looked up at run time, so that a
+ * generic x86 build still uses it. ARMv8 has both polynomials and is
+ * used when the compiler targets it.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CRC_HW_CRC32C
+#include <nmmintrin.h>
+
+static bool
+crc_hw_available(void)
+{
+  static int available = -1;
+  if (available < 0) available = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+  return available;
+}
+
+__attribute__((target("sse4.2")))
 static uint32_t
-generate_crc32(uint8_t *str, size_t len, uint32_t crc)
-{
-  uint32_t crc_value = ~crc;
-  for (size_t i = 0; i < len; i++) {
-    crc_value ^= str[i];
-    for (int j = 0; j < 8; j++) {
-      if (crc_value & 1) {
-        crc_value = (crc_value >> 1) ^ 0xEDB88320;
-      } else {
-        crc_value >>= 1;
-      }
-    }
+crc_hw_crc32c(const uint8_t *p, size_t len, uint32_t crc)
+{
+  for (; len && ((uintptr_t)p & 7); len--) crc = _mm_crc32_u8(crc, *p++);
+#if defined(__x86_64__)
+  for (; 8 <= len; len -= 8, p += 8) {
+    uint64_t word;
+    __builtin_memcpy(&word, p, 8);
+    crc = (uint32_t)_mm_crc32_u64(crc, word);
   }
-  return ~crc_value;
+#else
+  for (; 4 <= len; len -= 4, p += 4) {
+    uint32_t word;
+    __builtin_memcpy(&word, p, 4);
+    crc = _mm_crc32_u32(crc, word);
+  }
+#endif
+  for (; len; len--) crc = _mm_crc32_u8(crc, *p++);
+  return crc;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC_HW_CRC32
+#define CRC_HW_CRC32C
+#include <string.h>
+#include <arm_acle.h>
+
+#define crc_hw_available() true
+
+#define CRC_HW_LOOP(byte_op, word_op) \
+  for (; len && ((uintptr_t)p & 7); len--) crc = byte_op(crc, *p++); \
+  for (; 8 <= len; len -= 8, p += 8) { \
+    uint64_t word; \
+    memcpy(&word, p, 8); \
+    crc = word_op(crc, word); \
+  } \
+  for (; len; len--) crc = byte_op(crc, *p++); \
+  return crc
+
+static uint32_t
+crc_hw_crc32(const uint8_t *p, size_t len, uint32_t crc)
+{
+  CRC_HW_LOOP(__crc32b, __crc32d);
 }
 
-static uint16_t
-generate_crc16(uint8_t *str, size_t len, uint16_t crc)
+static uint32_t
+crc_hw_crc32c(const uint8_t *p, size_t len, uint32_t crc)
 {
-  for (size_t i = 0; i < len; i++) {
-    crc ^= (uint16_t)str[i] << 8;
-    for (int j = 0; j < 8; j++) {
-      if (crc & 0x8000) {
-        crc = (crc << 1) ^ 0x1021;
-      } else {
-        crc <<= 1;
-      }
+  CRC_HW_LOOP(__crc32cb, __crc32cd);
+}
+
+#endif
+
+/*
+ * Tables
+ *
+ * Slice k holds the CRC of a byte followed by k zero bytes, so that
+ * CRC_SLICES bytes are folded in with one lookup each and no shifting
+ * between them.
+ */
+
+static inline uint32_t
+crc_le32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* The register of a reflected 32-bit CRC, not inverted */
+static uint32_t
+crc_reflected32(CRC_TABLE_CONST uint32_t table[][256], const uint8_t *p, size_t len, uint32_t crc)
+{
+#if CRC_SLICES == 8
+  for (; 8 <= len; len -= 8, p += 8) {
+    uint32_t one = crc_le32(p) ^ crc;
+    uint32_t two = crc_le32(p + 4);
+    crc = table[7][one & 0xff] ^ table[6][(one >> 8) & 0xff] ^
+          table[5][(one >> 16) & 0xff] ^ table[4][one >> 24] ^
+          table[3][two & 0xff] ^ table[2][(two >> 8) & 0xff] ^
+          table[1][(two >> 16) & 0xff] ^ table[0][two >> 24];
+  }
+#elif CRC_SLICES == 4
+  for (; 4 <= len; len -= 4, p += 4) {
+    crc ^= crc_le32(p);
+    crc = table[3][crc & 0xff] ^ table[2][(crc >> 8) & 0xff] ^
+          table[1][(crc >> 16) & 0xff] ^ table[0][crc >> 24];
+  }
+#endif
+  for (; len; len--) crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+uint32_t
+CRC_crc32(const uint8_t *data, size_t len, uint32_t crc)
+{
+#ifdef CRC_HW_CRC32
+  if (crc_hw_available()) return ~crc_hw_crc32(data, len, ~crc);
+#endif
+  return ~crc_reflected32(crc32_table, data, len, ~crc);
+}
+
+uint32_t
+CRC_crc32c(const uint8_t *data, size_t len, uint32_t crc)
+{
+#ifdef CRC_HW_CRC32C
+  if (crc_hw_available()) return ~crc_hw_crc32c(data, len, ~crc);
+#endif
+  return ~crc_reflected32(crc32c_table, data, len, ~crc);
+}
+
+uint16_t
+CRC_crc16(const uint8_t *p, size_t len, uint16_t crc)
+{
+#if CRC_SLICES == 8
+  for (; 8 <= len; len -= 8, p += 8) {
+    crc = crc16_table[7][p[0] ^ (crc >> 8)] ^ crc16_table[6][p[1] ^ (crc & 0xff)] ^
+          crc16_table[5][p[2]] ^ crc16_table[4][p[3]] ^
+          crc16_table[3][p[4]] ^ crc16_table[2][p[5]] ^
+          crc16_table[1][p[6]] ^ crc16_table[0][p[7]];
+  }
+#elif CRC_SLICES == 4
+  for (; 4 <= len; len -= 4, p += 4) {
+    crc = crc16_table[3][p[0] ^ (crc >> 8)] ^ crc16_table[2][p[1] ^ (crc & 0xff)] ^
+          crc16_table[1][p[2]] ^ crc16_table[0][p[3]];
+  }
+#endif
+  for (; len; len--) crc = (uint16_t)(crc << 8) ^ crc16_table[0][(crc >> 8) ^ *p++];
+  return crc;
+}
+
+uint8_t
+CRC_crc8(const uint8_t *p, size_t len, uint8_t crc)
+{
+  for (; len; len--) crc = crc8_table[0][crc ^ *p++];
+  return crc;
+}
+
+/* Largest prime below 65536, and the most bytes before the sums can
+ * overflow 32 bits */
+#define CRC_ADLER_BASE 65521
+#define CRC_ADLER_NMAX 5552
+
+uint32_t
+CRC_adler32(const uint8_t *p, size_t len, uint32_t adler)
+{
+  uint32_t a = adler & 0xffff;
+  uint32_t b = adler >> 16;
+
+  while (len) {
+    size_t n = len < CRC_ADLER_NMAX ? len : CRC_ADLER_NMAX;
+    len -= n;
+    for (; 4 <= n; n -= 4, p += 4) {
+      a += p[0]; b += a;
+      a += p[1]; b += a;
+      a += p[2]; b += a;
+      a += p[3]; b += a;
+    }
+    for (; n; n--) {
+      a += *p++;
+      b += a;
     }
+    a %= CRC_ADLER_BASE;
+    b %= CRC_ADLER_BASE;
   }
-  return crc & 0xFFFF;
+  return b << 16 | a;
 }
 
 #if defined(PICORB_VM_MRUBY)
@@ -43,4 +211,3 @@ generate_crc16(uint8_t *str, size_t len, uint16_t crc)
 #include "mrubyc/crc.c"
 
 #endif
-
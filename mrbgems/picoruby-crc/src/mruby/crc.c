@@ -16,7 +16,7 @@ mrb_crc_s_crc32(mrb_state *mrb, mrb_value klass)
   if (mrb_nil_p(string)) {
     return mrb_fixnum_value(0);
   }
-  uint32_t crc_value = generate_crc32((uint8_t *)RSTRING_PTR(string), (size_t)RSTRING_LEN(string), (uint32_t)crc);
+  uint32_t crc_value = CRC_crc32((uint8_t *)RSTRING_PTR(string), (size_t)RSTRING_LEN(string), (uint32_t)crc);
   return mrb_int_value(mrb, crc_value);
 }
 
@@ -33,7 +33,7 @@ mrb_crc_s_crc32_from_address(mrb_state *mrb, mrb_value klass)
   if (address == 0) {
     mrb_raise(mrb, E_ARGUMENT_ERROR, "Address must not be NULL");
   }
-  uint32_t crc_value = generate_crc32((uint8_t *)((uintptr_t)address), (size_t)length, (uint32_t)crc);
+  uint32_t crc_value = CRC_crc32((uint8_t *)((uintptr_t)address), (size_t)length, (uint32_t)crc);
   return mrb_int_value(mrb, crc_value);
 }
 
@@ -52,7 +52,7 @@ mrb_crc_s_crc16(mrb_state *mrb, mrb_value klass)
   if (mrb_nil_p(string)) {
     return mrb_fixnum_value(0xFFFF);
   }
-  uint16_t crc_value = generate_crc16((uint8_t *)RSTRING_PTR(string), (size_t)RSTRING_LEN(string), (uint16_t)crc);
+  uint16_t crc_value = CRC_crc16((uint8_t *)RSTRING_PTR(string), (size_t)RSTRING_LEN(string), (uint16_t)crc);
   return mrb_fixnum_value(crc_value);
 }
 
@@ -69,10 +69,63 @@ mrb_crc_s_crc16_from_address(mrb_state *mrb, mrb_value klass)
   if (address == 0) {
     mrb_raise(mrb, E_ARGUMENT_ERROR, "Address must not be NULL");
   }
-  uint16_t crc_value = generate_crc16((uint8_t *)((uintptr_t)address), (size_t)length, (uint16_t)crc);
+  uint16_t crc_value = CRC_crc16((uint8_t *)((uintptr_t)address), (size_t)length, (uint16_t)crc);
   return mrb_fixnum_value(crc_value);
 }
 
+/*
+ * CRC.crc32c(string = nil, crc = 0) -> Integer
+ * CRC-32C (Castagnoli)
+ * when string is nil, returns the initial checksum value
+ */
+static mrb_value
+mrb_crc_s_crc32c(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value string = mrb_nil_value();
+  mrb_int crc = 0;
+  mrb_get_args(mrb, "|Si", &string, &crc);
+  if (mrb_nil_p(string)) {
+    return mrb_fixnum_value(0);
+  }
+  uint32_t crc_value = CRC_crc32c((uint8_t *)RSTRING_PTR(string), (size_t)RSTRING_LEN(string), (uint32_t)crc);
+  return mrb_int_value(mrb, crc_value);
+}
+
+/*
+ * CRC.crc8(string = nil, crc = 0) -> Integer
+ * CRC-8/SMBUS (polynomial 0x07, initial value 0)
+ * when string is nil, returns the initial checksum value
+ */
+static mrb_value
+mrb_crc_s_crc8(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value string = mrb_nil_value();
+  mrb_int crc = 0;
+  mrb_get_args(mrb, "|Si", &string, &crc);
+  if (mrb_nil_p(string)) {
+    return mrb_fixnum_value(0);
+  }
+  uint8_t crc_value = CRC_crc8((uint8_t *)RSTRING_PTR(string), (size_t)RSTRING_LEN(string), (uint8_t)crc);
+  return mrb_fixnum_value(crc_value);
+}
+
+/*
+ * CRC.adler32(string = nil, adler = 1) -> Integer
+ * when string is nil, returns the initial checksum value
+ */
+static mrb_value
+mrb_crc_s_adler32(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value string = mrb_nil_value();
+  mrb_int adler = 1;
+  mrb_get_args(mrb, "|Si", &string, &adler);
+  if (mrb_nil_p(string)) {
+    return mrb_fixnum_value(1);
+  }
+  uint32_t adler_value = CRC_adler32((uint8_t *)RSTRING_PTR(string), (size_t)RSTRING_LEN(string), (uint32_t)adler);
+  return mrb_int_value(mrb, adler_value);
+}
+
 void
 mrb_picoruby_crc_gem_init(mrb_state* mrb)
 {
@@ -82,6 +135,9 @@ mrb_picoruby_crc_gem_init(mrb_state* mrb)
   mrb_define_class_method_id(mrb, module_CRC, MRB_SYM(crc32_from_address), mrb_crc_s_crc32_from_address, MRB_ARGS_ARG(2,1));
   mrb_define_class_method_id(mrb, module_CRC, MRB_SYM(crc16), mrb_crc_s_crc16, MRB_ARGS_OPT(2));
   mrb_define_class_method_id(mrb, module_CRC, MRB_SYM(crc16_from_address), mrb_crc_s_crc16_from_address, MRB_ARGS_ARG(2,1));
+  mrb_define_class_method_id(mrb, module_CRC, MRB_SYM(crc32c), mrb_crc_s_crc32c, MRB_ARGS_OPT(2));
+  mrb_define_class_method_id(mrb, module_CRC, MRB_SYM(crc8), mrb_crc_s_crc8, MRB_ARGS_OPT(2));
+  mrb_define_class_method_id(mrb, module_CRC, MRB_SYM(adler32), mrb_crc_s_adler32, MRB_ARGS_OPT(2));
 }
 
 void
@@ -21,7 +21,7 @@ c_crc_crc32(mrbc_vm *vm, mrbc_value v[], int argc)
     mrbc_raise(vm, MRBC_CLASS(TypeError), "Expected a String type for the first argument");
     return;
   }
-  uint32_t crc_value = generate_crc32((uint8_t *)string.string->data, (size_t)string.string->size, (uint32_t)crc);
+  uint32_t crc_value = CRC_crc32((uint8_t *)string.string->data, (size_t)string.string->size, (uint32_t)crc);
   SET_INT_RETURN(crc_value);
 }
 
@@ -43,7 +43,7 @@ c_crc_crc32_from_address(mrbc_vm *vm, mrbc_value v[], int argc)
   } else {
     crc = GET_INT_ARG(3);
   }
-  uint32_t crc_value = generate_crc32((uint8_t *)address, (size_t)length, (uint32_t)crc);
+  uint32_t crc_value = CRC_crc32((uint8_t *)address, (size_t)length, (uint32_t)crc);
   SET_INT_RETURN(crc_value);
 }
 
@@ -69,7 +69,7 @@ c_crc_crc16(mrbc_vm *vm, mrbc_value v[], int argc)
     mrbc_raise(vm, MRBC_CLASS(TypeError), "Expected a String type for the first argument");
     return;
   }
-  uint16_t crc_value = generate_crc16((uint8_t *)string.string->data, (size_t)string.string->size, (uint16_t)crc);
+  uint16_t crc_value = CRC_crc16((uint8_t *)string.string->data, (size_t)string.string->size, (uint16_t)crc);
   SET_INT_RETURN(crc_value);
 }
 
@@ -91,10 +91,87 @@ c_crc_crc16_from_address(mrbc_vm *vm, mrbc_value v[], int argc)
   } else {
     crc = GET_INT_ARG(3);
   }
-  uint16_t crc_value = generate_crc16((uint8_t *)address, (size_t)length, (uint16_t)crc);
+  uint16_t crc_value = CRC_crc16((uint8_t *)address, (size_t)length, (uint16_t)crc);
   SET_INT_RETURN(crc_value);
 }
 
+/*
+ * CRC.crc32c(string = nil, crc = 0) -> Integer
+ * CRC-32C (Castagnoli)
+ * when string is nil, returns the initial checksum value
+ */
+static void
+c_crc_crc32c(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_value string = GET_ARG(1);
+  mrbc_int_t crc;
+  if (argc < 2) {
+    crc = 0;
+  } else {
+    crc = GET_INT_ARG(2);
+  }
+  if (string.tt == MRBC_TT_NIL) {
+    SET_INT_RETURN(0);
+    return;
+  } else if (string.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "Expected a String type for the first argument");
+    return;
+  }
+  uint32_t crc_value = CRC_crc32c((uint8_t *)string.string->data, (size_t)string.string->size, (uint32_t)crc);
+  SET_INT_RETURN(crc_value);
+}
+
+/*
+ * CRC.crc8(string = nil, crc = 0) -> Integer
+ * CRC-8/SMBUS (polynomial 0x07, initial value 0)
+ * when string is nil, returns the initial checksum value
+ */
+static void
+c_crc_crc8(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_value string = GET_ARG(1);
+  mrbc_int_t crc;
+  if (argc < 2) {
+    crc = 0;
+  } else {
+    crc = GET_INT_ARG(2);
+  }
+  if (string.tt == MRBC_TT_NIL) {
+    SET_INT_RETURN(0);
+    return;
+  } else if (string.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "Expected a String type for the first argument");
+    return;
+  }
+  uint8_t crc_value = CRC_crc8((uint8_t *)string.string->data, (size_t)string.string->size, (uint8_t)crc);
+  SET_INT_RETURN(crc_value);
+}
+
+/*
+ * CRC.adler32(string = nil, adler = 1) -> Integer
+ * when string is nil, returns the initial checksum value
+ */
+static void
+c_crc_adler32(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  mrbc_value string = GET_ARG(1);
+  mrbc_int_t adler;
+  if (argc < 2) {
+    adler = 1;
+  } else {
+    adler = GET_INT_ARG(2);
+  }
+  if (string.tt == MRBC_TT_NIL) {
+    SET_INT_RETURN(1);
+    return;
+  } else if (string.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "Expected a String type for the first argument");
+    return;
+  }
+  uint32_t adler_value = CRC_adler32((uint8_t *)string.string->data, (size_t)string.string->size, (uint32_t)adler);
+  SET_INT_RETURN(adler_value);
+}
+
 void
 mrbc_crc_init(mrbc_vm *vm)
 {
@@ -104,4 +181,7 @@ mrbc_crc_init(mrbc_vm *vm)
   mrbc_define_method(vm, module_CRC, "crc32_from_address", c_crc_crc32_from_address);
   mrbc_define_method(vm, module_CRC, "crc16", c_crc_crc16);
   mrbc_define_method(vm, module_CRC, "crc16_from_address", c_crc_crc16_from_address);
+  mrbc_define_method(vm, module_CRC, "crc32c", c_crc_crc32c);
+  mrbc_define_method(vm, module_CRC, "crc8", c_crc_crc8);
+  mrbc_define_method(vm, module_CRC, "adler32", c_crc_adler32);
 }
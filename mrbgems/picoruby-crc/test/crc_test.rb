@@ -0,0 +1,46 @@
+class CRCTest < Picotest::Test
+  CHECK = "123456789"
+
+  def test_check_values
+    assert_equal(0xcbf43926, CRC.crc32(CHECK))
+    assert_equal(0xe3069283, CRC.crc32c(CHECK))
+    assert_equal(0x29b1, CRC.crc16(CHECK))
+    assert_equal(0xf4, CRC.crc8(CHECK))
+    assert_equal(0x091e01de, CRC.adler32(CHECK))
+  end
+
+  def test_initial_values
+    assert_equal(0, CRC.crc32)
+    assert_equal(0, CRC.crc32c)
+    assert_equal(0xFFFF, CRC.crc16)
+    assert_equal(0, CRC.crc8)
+    assert_equal(1, CRC.adler32)
+  end
+
+  def test_chaining
+    data = "The quick brown fox jumps over the lazy dog"
+    head = data.byteslice(0, 13) || ""
+    tail = data.byteslice(13, 30) || ""
+    assert_equal(CRC.crc32(data), CRC.crc32(tail, CRC.crc32(head)))
+    assert_equal(CRC.crc32c(data), CRC.crc32c(tail, CRC.crc32c(head)))
+    assert_equal(CRC.crc16(data), CRC.crc16(tail, CRC.crc16(head)))
+    assert_equal(CRC.crc8(data), CRC.crc8(tail, CRC.crc8(head)))
+    assert_equal(CRC.adler32(data), CRC.adler32(tail, CRC.adler32(head)))
+  end
+
+  def test_digest
+    digest = CRC::Digest.new(:crc32c)
+    digest.update("1234").update("5") << "6789"
+    assert_equal(0xe3069283, digest.finish)
+    digest.reset
+    assert_equal(0, digest.finish)
+    assert_equal(0x29b1, CRC::Digest.new(:crc16).update(CHECK).finish)
+    assert_equal(0xcbf43926, CRC::Digest.new.update(CHECK).finish)
+  end
+
+  def test_digest_unknown_algorithm
+    assert_raise(ArgumentError) do
+      CRC::Digest.new(:md5)
+    end
+  end
+end
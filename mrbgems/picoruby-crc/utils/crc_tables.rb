@@ -0,0 +1,61 @@
+#!/usr/bin/env ruby
+
+# ------------------------------------------------------------
+# Generates src/crc_tables.h, the lookup tables of src/crc.c
+#   - CRC-32 and CRC-32C : reflected, 8 slices of 256 entries
+#   - CRC-16/CCITT       : MSB first, 8 slices of 256 entries
+#   - CRC-8              : MSB first, one slice
+# Slice k holds the CRC of a byte followed by k zero bytes. Slices
+# beyond CRC_SLICES are left out by the preprocessor.
+#
+#   ruby utils/crc_tables.rb > src/crc_tables.h
+# ------------------------------------------------------------
+
+def reflected_table(poly)
+  t0 = (0..255).map do |i|
+    c = i
+    8.times { c = c & 1 == 1 ? (c >> 1) ^ poly : c >> 1 }
+    c
+  end
+  slices = [t0]
+  7.times { slices << slices.last.map { |c| (c >> 8) ^ t0[c & 0xff] } }
+  slices
+end
+
+def msb_table(poly, width, count)
+  top = 1 << (width - 1)
+  mask = (1 << width) - 1
+  t0 = (0..255).map do |i|
+    c = i << (width - 8)
+    8.times { c = c & top != 0 ? ((c << 1) ^ poly) & mask : (c << 1) & mask }
+    c
+  end
+  slices = [t0]
+  (count - 1).times do
+    slices << slices.last.map { |c| ((c << 8) & mask) ^ t0[c >> (width - 8)] }
+  end
+  slices
+end
+
+def emit(name, type, slices, digits)
+  puts
+  puts "static CRC_TABLE_CONST #{type} #{name}[#{slices.size == 1 ? '1' : 'CRC_SLICES'}][256] = {"
+  slices.each_with_index do |slice, k|
+    puts "#if 4 <= CRC_SLICES" if k == 1
+    puts "#if 8 <= CRC_SLICES" if k == 4
+    puts "  {"
+    slice.each_slice(8) do |row|
+      puts "    " + row.map { |c| "0x%0#{digits}x" % c }.join(", ") + ","
+    end
+    puts "  },"
+    puts "#endif" if k == 7
+    puts "#endif" if k == 3
+  end
+  puts "};"
+end
+
+puts "/* Generated by utils/crc_tables.rb. Do not edit. */"
+emit("crc32_table", "uint32_t", reflected_table(0xEDB88320), 8)
+emit("crc32c_table", "uint32_t", reflected_table(0x82F63B78), 8)
+emit("crc16_table", "uint16_t", msb_table(0x1021, 16, 8), 4)
+emit("crc8_table", "uint8_t", msb_table(0x07, 8, 1), 2)
@@ -134,6 +134,16 @@ irq_lowest_bit(uint32_t v)
  * happened: an interrupted drain retries that source at the next
  * scheduler entry instead of leaving it claimed forever.
  */
+/* Ready predicate: lets the dispatcher skip the drain while no source
+   is ready. */
+static bool
+irq_pending(mrb_state *mrb, void *ud)
+{
+  (void)mrb;
+  (void)ud;
+  return IRQ_peek_ready() != 0;
+}
+
 static void
 irq_drain(mrb_state *mrb, void *ud)
 {
@@ -394,7 +404,10 @@ irq_bridge_init(mrb_state *mrb, struct RClass *module_IRQ)
      platform's own servicing (cyw43_arch poll on pico_w/pico2_w), and
      setting it directly would silently disable whichever registered
      first. See include/hal.h in picoruby-machine. */
-  picorb_scheduler_service_add(mrb, irq_drain, NULL);
+  {
+    static const picorb_scheduler_service_opts_t opts = { "irq", 0, 0, irq_pending };
+    picorb_scheduler_service_add_opts(mrb, irq_drain, NULL, &opts);
+  }
 
   /* Claim ownership only once nothing above can still raise. Otherwise
      a failed init would leave the bridge owned by a VM that does not
@@ -145,6 +145,13 @@ irq_unbind_source(int id)
  * the token is recorded only once the push happened, so an allocation
  * failure inside the push cannot leave a source claimed forever.
  */
+static bool
+irq_pending(void *ud)
+{
+  (void)ud;
+  return IRQ_peek_ready() != 0;
+}
+
 static void
 irq_drain(void *ud)
 {
@@ -311,7 +318,10 @@ irq_bridge_init(mrbc_vm *vm, mrbc_class *module_IRQ)
 
   /* Not mrbc_task_set_scheduler_hook: the hook slot is shared with the
      platform's own servicing. See include/hal.h in picoruby-machine. */
-  picorb_scheduler_service_add(irq_drain, NULL);
+  {
+    static const picorb_scheduler_service_opts_t opts = { "irq", 0, 0, irq_pending };
+    picorb_scheduler_service_add_opts(irq_drain, NULL, &opts);
+  }
 }
 
 #endif /* PICORB_IRQ_EVENT_BRIDGE */
@@ -0,0 +1,135 @@
+#ifndef JSON_DEFINED_H_
+#define JSON_DEFINED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Deepest nesting of arrays and objects accepted by JSON.parse and
+ * JSON.generate. Both recurse on the C stack, which is small on
+ * microcontrollers. */
+#ifndef JSON_MAX_NESTING
+#define JSON_MAX_NESTING 64
+#endif
+
+/* Longest number literal; longer ones are rejected */
+#define JSON_NUMBER_MAX_LEN 64
+
+/*
+ * Scanner over a JSON text. The VM glue drives it token by token and
+ * builds Hash/Array values directly, so nothing but the final values is
+ * allocated. On failure, error holds a static message and pos the byte
+ * offset where it was found.
+ */
+typedef struct {
+  const uint8_t *src;
+  size_t len;
+  size_t pos;
+  const char *error;
+} json_scanner_t;
+
+typedef enum {
+  JSON_NUMBER_ERROR = 0,
+  JSON_NUMBER_INTEGER,
+  JSON_NUMBER_FLOAT,
+} json_number_t;
+
+void JSON_scanner_init(json_scanner_t *s, const uint8_t *src, size_t len);
+/* Skip whitespace; returns the next byte, or -1 at the end */
+int JSON_peek(json_scanner_t *s);
+/* Consume c after whitespace, or fail with "Expected ..." */
+bool JSON_expect(json_scanner_t *s, uint8_t c);
+/* Consume "true", "false" or "null" */
+bool JSON_scan_literal(json_scanner_t *s, const char *word);
+/* Find the string at pos (on its opening quote). body/len cover the raw
+ * contents between the quotes; escaped tells whether JSON_unescape is
+ * needed. */
+bool JSON_scan_string(json_scanner_t *s, const uint8_t **body, size_t *len, bool *escaped);
+/* Decode the escapes of a raw string body into dst, which may be the
+ * same buffer as src and needs at most len bytes. \u escapes become
+ * UTF-8. Returns the decoded length, or -1 with *error set. */
+int32_t JSON_unescape(const uint8_t *src, size_t len, uint8_t *dst, const char **error);
+/* Scan a number. An integer that does not fit in int64_t is reported as
+ * a float. */
+json_number_t JSON_scan_number(json_scanner_t *s, int64_t *ival, double *fval);
+
+/*
+ * Escaping for the generator. out receives runs of the quoted string;
+ * bytes that need no escape are passed on in one call per run.
+ */
+typedef void (*json_out_func)(void *ctx, const char *buf, size_t len);
+void JSON_escape_string(const uint8_t *src, size_t len, json_out_func out, void *ctx);
+
+/* Size of the pieces JSON.dump hands to io.write. The buffer lives on
+ * the C stack while JSON.dump runs. */
+#ifndef JSON_DUMP_BUFFER_SIZE
+#define JSON_DUMP_BUFFER_SIZE 256
+#endif
+
+/*
+ * Incremental parser behind JSON::StreamParser
+ *
+ * Input arrives in pieces. JSON_stream_feed() reports every complete
+ * token as an event and returns how many bytes it consumed; the caller
+ * keeps the rest (an unfinished token, at most JSON_STREAM_MAX_TOKEN
+ * bytes) and prepends it to the next piece. Nothing but the grammar
+ * state and the container stack lives here, so memory does not depend
+ * on the size of the document. Top-level values may follow one another,
+ * as in JSON Lines.
+ */
+#ifndef JSON_STREAM_MAX_TOKEN
+#define JSON_STREAM_MAX_TOKEN 4096
+#endif
+
+typedef enum {
+  JSON_EVENT_START_OBJECT,
+  JSON_EVENT_END_OBJECT,
+  JSON_EVENT_START_ARRAY,
+  JSON_EVENT_END_ARRAY,
+  JSON_EVENT_KEY,      /* str/len/escaped */
+  JSON_EVENT_STRING,   /* str/len/escaped */
+  JSON_EVENT_INTEGER,  /* ival */
+  JSON_EVENT_FLOAT,    /* fval */
+  JSON_EVENT_TRUE,
+  JSON_EVENT_FALSE,
+  JSON_EVENT_NULL,
+} json_event_type_t;
+
+typedef struct {
+  json_event_type_t type;
+  const uint8_t *str;
+  size_t len;
+  bool escaped;
+  int64_t ival;
+  double fval;
+} json_event_t;
+
+/* Returns false to stop the feed, with the error left to the caller */
+typedef bool (*json_event_func)(void *ctx, const json_event_t *event);
+
+typedef struct {
+  uint64_t objects;     /* one bit per open container: 1 = object */
+  int depth;
+  uint8_t state;
+  size_t scanned;       /* bytes of an unfinished string already looked at */
+  bool scanned_escaped;
+  size_t offset;        /* bytes consumed by earlier feeds */
+  const char *error;
+} json_stream_t;
+
+void JSON_stream_init(json_stream_t *st);
+/* final tells that no more input follows, so a number or literal at the
+ * end is complete and an unfinished document is an error. Returns the
+ * bytes consumed; check st->error. */
+size_t JSON_stream_feed(json_stream_t *st, const uint8_t *buf, size_t len, bool final,
+                        json_event_func fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_DEFINED_H_ */
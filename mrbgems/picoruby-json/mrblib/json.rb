@@ -1,7 +1,10 @@
 #
 # JSON library for PicoRuby
-# This is a simple JSON parser and generator for PicoRuby.
-# It is designed to be small and simple, not to be fast or complete.
+#
+# JSON.parse and JSON.generate are implemented in C (src/json.c).
+# JSON::Parser and JSON::Generator below are the original pure Ruby
+# implementation, designed to be small and simple, not to be fast or
+# complete.
 #
 # Author: Hitoshi HASUMI
 # License: MIT
@@ -87,14 +90,6 @@ module JSON
     end
   end
 
-  def self.parse(json)
-    JSON::Parser.new(json).parse
-  end
-
-  def self.generate(obj)
-    JSON::Generator.new(obj).generate
-  end
-
   # Digger class is to dig into the JSON object especially dedicated
   # to the small memory environment.
   # It does not parse the whole JSON object but it scans the JSON string
@@ -319,6 +314,320 @@ module JSON
     end
   end
 
+  # StreamParser takes a JSON text in pieces, so that a document larger
+  # than RAM can be read from a socket, a File or an HTTP body. Only the
+  # unfinished token at the end of a piece (at most MAX_TOKEN bytes) and
+  # the values picked by the selector are kept.
+  #
+  # Usage:
+  #   parser = JSON::StreamParser.new
+  #   parser.feed('{"a":[1,') { |event, value| p [event, value] }
+  #   # => [:start_object, nil] [:key, "a"] [:start_array, nil] [:value, 1]
+  #   parser.feed('2]}') { |event, value| p [event, value] }
+  #   # => [:value, 2] [:end_array, nil] [:end_object, nil]
+  #   parser.finish
+  #
+  #   # With a selector, the block receives each matching value instead
+  #   parser = JSON::StreamParser.new("$.items[*].name")
+  #   parser.read(socket) { |name| puts name }
+  #
+  # Selectors are a subset of JSONPath: $ followed by .key, ['key'],
+  # [index], .* and [*]. A bare "$" picks each top-level value, which
+  # suits JSON Lines.
+  #
+  class StreamParser
+    MAX_TOKEN = 4096
+
+    def self.new(selector = nil)
+      parser = _new
+      parser._setup(selector)
+      parser
+    end
+
+    def self.compile_selector(selector)
+      path = []
+      i = 0
+      i += 1 if selector[0] == "$"
+      while i < selector.size
+        c = selector[i]
+        if c == "."
+          j = i + 1
+          while j < selector.size && selector[j] != "." && selector[j] != "["
+            j += 1
+          end
+          name = selector[i + 1, j - i - 1].to_s
+          raise ArgumentError.new("Empty key in selector: #{selector}") if name.empty?
+          path << (name == "*" ? :any : name)
+        elsif c == "["
+          j = i + 1
+          j += 1 while j < selector.size && selector[j] != "]"
+          raise ArgumentError.new("Unterminated [ in selector: #{selector}") if selector.size <= j
+          inner = selector[i + 1, j - i - 1].to_s
+          if inner == "*"
+            path << :any
+          elsif inner[0] == "'" || inner[0] == '"'
+            path << inner[1, inner.size - 2].to_s
+          elsif !inner.empty? && inner.to_i.to_s == inner
+            path << inner.to_i
+          else
+            raise ArgumentError.new("Invalid index in selector: #{selector}")
+          end
+          j += 1
+        else
+          raise ArgumentError.new("Unexpected '#{c}' in selector: #{selector}")
+        end
+        i = j
+      end
+      path
+    end
+
+    def _setup(selector)
+      @tail = ""
+      @events = []
+      @selector = selector ? StreamParser.compile_selector(selector) : nil
+      # One entry per open container: the current key of an object, or
+      # the current index of an array
+      @path = []
+      # Containers of the value being picked, innermost last
+      @building = nil
+    end
+
+    # Feed the next piece of the text. Events (or selected values) of the
+    # tokens completed by this piece go to the block.
+    def feed(chunk, &block)
+      data = @tail.empty? ? chunk : @tail + chunk
+      @events.clear
+      consumed = _feed(data, false, @events)
+      @tail = data.byteslice(consumed, data.bytesize - consumed) || ""
+      if MAX_TOKEN < @tail.bytesize
+        raise JSON::ParserError.new("Token longer than #{MAX_TOKEN} bytes")
+      end
+      dispatch(block)
+    end
+
+    # Tell that the text is over. Raises ParserError if it ended halfway.
+    def finish(&block)
+      data = @tail
+      @tail = ""
+      @events.clear
+      _feed(data, true, @events)
+      dispatch(block)
+    end
+
+    # Feed everything io.read returns, then finish
+    def read(io, chunk_size = 512, &block)
+      while chunk = io.read(chunk_size)
+        break if chunk.empty?
+        feed(chunk, &block)
+      end
+      finish(&block)
+    end
+
+    private
+
+    def dispatch(block)
+      events = @events
+      i = 0
+      while i < events.size
+        if @selector
+          select_event(events[i], events[i + 1], block)
+        elsif block
+          block.call(events[i], events[i + 1])
+        end
+        i += 2
+      end
+      events.clear
+      nil
+    end
+
+    def select_event(event, value, block)
+      case event
+      when :key
+        @path[-1] = value
+        return
+      when :end_object, :end_array
+        @path.pop
+        if @building
+          picked = @building.pop
+          if @building.empty?
+            @building = nil
+            block.call(picked) if block
+          end
+        end
+        return
+      end
+      # A value starts here
+      @path[-1] += 1 if @path[-1].is_a?(Integer)
+      if @building
+        build(event, value)
+      elsif selected?
+        if event == :value
+          block.call(value) if block
+        else
+          @building = []
+          build(event, value)
+        end
+      end
+      if event == :start_object
+        @path << nil
+      elsif event == :start_array
+        @path << -1
+      end
+    end
+
+    def build(event, value)
+      item = if event == :start_object
+        {}
+      elsif event == :start_array
+        []
+      else
+        value
+      end
+      parent = @building.last
+      if parent.is_a?(Hash)
+        parent[@path[-1]] = item
+      elsif parent
+        parent << item
+      end
+      @building << item unless event == :value
+    end
+
+    def selected?
+      selector = @selector
+      return false if selector.size != @path.size
+      i = 0
+      while i < selector.size
+        s = selector[i]
+        return false if s != :any && s != @path[i]
+        i += 1
+      end
+      true
+    end
+  end
+
+  # StreamGenerator writes JSON to an IO (anything with #write) piece by
+  # piece, so a large document is never held in memory as a whole.
+  # Output is buffered up to buffer_size bytes. Hash and Array values go
+  # through JSON.dump, which writes them in fixed-size pieces as well.
+  #
+  # Usage:
+  #   gen = JSON::StreamGenerator.new(socket)
+  #   gen.start_object
+  #   gen.add("device", "pico")
+  #   gen.start_array("samples")
+  #   readings.each { |r| gen.add({"t" => r.time, "v" => r.value}) }
+  #   gen.end_array
+  #   gen.end_object
+  #   gen.finish
+  #
+  # Values added at the top level are separated by newlines (JSON Lines).
+  #
+  class StreamGenerator
+    BUFFER_SIZE = 256
+
+    def initialize(io, buffer_size = BUFFER_SIZE)
+      @io = io
+      @buffer_size = buffer_size
+      @buffer = ""
+      @stack = []
+      @first = true
+    end
+
+    def start_array(key = nil)
+      separator(key)
+      write("[")
+      @stack << :array
+      @first = true
+      self
+    end
+
+    def end_array
+      close_container(:array, "]")
+    end
+
+    def start_object(key = nil)
+      separator(key)
+      write("{")
+      @stack << :object
+      @first = true
+      self
+    end
+
+    def end_object
+      close_container(:object, "}")
+    end
+
+    # add(value) in an array or at the top level, add(key, value) in an object
+    def add(*args)
+      if @stack.last == :object
+        raise ArgumentError.new("add takes a key and a value in an object") if args.size != 2
+        key = args[0]
+        value = args[1]
+      else
+        raise ArgumentError.new("add takes a value outside an object") if args.size != 1
+        key = nil
+        value = args[0]
+      end
+      separator(key)
+      if value.is_a?(Hash) || value.is_a?(Array)
+        flush
+        JSON.dump(value, @io)
+      else
+        write(JSON.generate(value))
+      end
+      self
+    end
+
+    def flush
+      unless @buffer.empty?
+        @io.write(@buffer)
+        @buffer = ""
+      end
+      self
+    end
+
+    # Flush the rest. Raises GeneratorError if a container is still open.
+    def finish
+      unless @stack.empty?
+        raise JSON::GeneratorError.new("#{@stack.size} unclosed #{@stack.last}")
+      end
+      flush
+    end
+
+    private
+
+    def separator(key)
+      if @stack.last == :object
+        raise ArgumentError.new("Key is required in an object") if key.nil?
+      elsif key
+        raise ArgumentError.new("Key is only allowed in an object")
+      end
+      unless @first
+        write(@stack.empty? ? "\n" : ",")
+      end
+      @first = false
+      if key
+        write(JSON.generate(key.is_a?(Symbol) ? key : key.to_s))
+        write(":")
+      end
+    end
+
+    def close_container(type, char)
+      if @stack.last != type
+        raise JSON::GeneratorError.new("No #{type} to close")
+      end
+      @stack.pop
+      @first = false
+      write(char)
+      self
+    end
+
+    def write(str)
+      @buffer << str
+      flush if @buffer_size <= @buffer.bytesize
+    end
+  end
+
   class Generator
     include JSON::Common
 
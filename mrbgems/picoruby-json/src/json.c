@@ -0,0 +1,594 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/json.h"
+
+/*
+ * Scanner
+ */
+
+void
+JSON_scanner_init(json_scanner_t *s, const uint8_t *src, size_t len)
+{
+  s->src = src;
+  s->len = len;
+  s->pos = 0;
+  s->error = NULL;
+}
+
+int
+JSON_peek(json_scanner_t *s)
+{
+  while (s->pos < s->len) {
+    uint8_t c = s->src[s->pos];
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+      return c;
+    }
+    s->pos++;
+  }
+  return -1;
+}
+
+bool
+JSON_expect(json_scanner_t *s, uint8_t c)
+{
+  if (JSON_peek(s) == c) {
+    s->pos++;
+    return true;
+  }
+  switch (c) {
+    case ',': s->error = "Expected ','"; break;
+    case ':': s->error = "Expected ':'"; break;
+    case '"': s->error = "Expected '\"'"; break;
+    default:  s->error = "Unexpected character"; break;
+  }
+  return false;
+}
+
+bool
+JSON_scan_literal(json_scanner_t *s, const char *word)
+{
+  size_t n = strlen(word);
+  if (s->len - s->pos < n || memcmp(s->src + s->pos, word, n) != 0) {
+    s->error = "Unexpected character";
+    return false;
+  }
+  s->pos += n;
+  return true;
+}
+
+bool
+JSON_scan_string(json_scanner_t *s, const uint8_t **body, size_t *len, bool *escaped)
+{
+  const uint8_t *p, *end;
+
+  if (!JSON_expect(s, '"')) return false;
+  p = s->src + s->pos;
+  end = s->src + s->len;
+  *body = p;
+  *escaped = false;
+  while (p < end) {
+    uint8_t c = *p;
+    if (c == '"') {
+      *len = (size_t)(p - *body);
+      s->pos = (size_t)(p + 1 - s->src);
+      return true;
+    }
+    if (c == '\\') {
+      *escaped = true;
+      p += 2;
+      continue;
+    }
+    if (c < 0x20) {
+      /* RFC 8259 requires control characters to be escaped */
+      s->pos = (size_t)(p - s->src);
+      s->error = "Control character in string";
+      return false;
+    }
+    p++;
+  }
+  s->error = "Unterminated string";
+  return false;
+}
+
+static int
+hex_value(uint8_t c)
+{
+  if ('0' <= c && c <= '9') return c - '0';
+  if ('a' <= c && c <= 'f') return c - 'a' + 10;
+  if ('A' <= c && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static int32_t
+read_hex4(const uint8_t *p)
+{
+  int32_t code = 0;
+  for (int i = 0; i < 4; i++) {
+    int h = hex_value(p[i]);
+    if (h < 0) return -1;
+    code = (code << 4) | h;
+  }
+  return code;
+}
+
+static size_t
+put_utf8(uint8_t *dst, uint32_t code)
+{
+  if (code < 0x80) {
+    dst[0] = (uint8_t)code;
+    return 1;
+  } else if (code < 0x800) {
+    dst[0] = (uint8_t)(0xC0 | (code >> 6));
+    dst[1] = (uint8_t)(0x80 | (code & 0x3F));
+    return 2;
+  } else if (code < 0x10000) {
+    dst[0] = (uint8_t)(0xE0 | (code >> 12));
+    dst[1] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+    dst[2] = (uint8_t)(0x80 | (code & 0x3F));
+    return 3;
+  }
+  dst[0] = (uint8_t)(0xF0 | (code >> 18));
+  dst[1] = (uint8_t)(0x80 | ((code >> 12) & 0x3F));
+  dst[2] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+  dst[3] = (uint8_t)(0x80 | (code & 0x3F));
+  return 4;
+}
+
+int32_t
+JSON_unescape(const uint8_t *src, size_t len, uint8_t *dst, const char **error)
+{
+  size_t i = 0, o = 0;
+
+  /* Every escape is at least as long as what it decodes to, so o never
+     overtakes i and src and dst may be the same buffer */
+  while (i < len) {
+    uint8_t c = src[i++];
+    if (c != '\\') {
+      dst[o++] = c;
+      continue;
+    }
+    if (len <= i) {
+      *error = "Unterminated escape sequence";
+      return -1;
+    }
+    c = src[i++];
+    switch (c) {
+      case '"':  dst[o++] = '"';  break;
+      case '\\': dst[o++] = '\\'; break;
+      case '/':  dst[o++] = '/';  break;
+      case 'b':  dst[o++] = '\b'; break;
+      case 'f':  dst[o++] = '\f'; break;
+      case 'n':  dst[o++] = '\n'; break;
+      case 'r':  dst[o++] = '\r'; break;
+      case 't':  dst[o++] = '\t'; break;
+      case 'u': {
+        int32_t code;
+        if (len < i + 4) {
+          *error = "Incomplete unicode escape sequence";
+          return -1;
+        }
+        code = read_hex4(src + i);
+        if (code < 0) {
+          *error = "Invalid hex in unicode escape";
+          return -1;
+        }
+        i += 4;
+        /* A high surrogate followed by \uDC00-\uDFFF is one code point */
+        if (0xD800 <= code && code <= 0xDBFF && i + 6 <= len &&
+            src[i] == '\\' && src[i + 1] == 'u') {
+          int32_t low = read_hex4(src + i + 2);
+          if (0xDC00 <= low && low <= 0xDFFF) {
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            i += 6;
+          }
+        }
+        o += put_utf8(dst + o, (uint32_t)code);
+        break;
+      }
+      default:
+        *error = "Unknown escape sequence";
+        return -1;
+    }
+  }
+  return (int32_t)o;
+}
+
+json_number_t
+JSON_scan_number(json_scanner_t *s, int64_t *ival, double *fval)
+{
+  const uint8_t *p = s->src + s->pos;
+  const uint8_t *end = s->src + s->len;
+  const uint8_t *start = p;
+  bool negative = false;
+  bool is_float = false;
+  bool overflow = false;
+  uint64_t acc = 0;
+
+  if (p < end && *p == '-') {
+    negative = true;
+    p++;
+  }
+  if (end <= p || *p < '0' || '9' < *p) {
+    s->error = "Invalid number";
+    return JSON_NUMBER_ERROR;
+  }
+  while (p < end && '0' <= *p && *p <= '9') {
+    uint64_t d = (uint64_t)(*p - '0');
+    if ((UINT64_MAX - d) / 10 < acc) overflow = true;
+    acc = acc * 10 + d;
+    p++;
+  }
+  if (p < end && *p == '.') {
+    is_float = true;
+    p++;
+    if (end <= p || *p < '0' || '9' < *p) {
+      s->error = "Invalid number";
+      return JSON_NUMBER_ERROR;
+    }
+    while (p < end && '0' <= *p && *p <= '9') p++;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    is_float = true;
+    p++;
+    if (p < end && (*p == '+' || *p == '-')) p++;
+    if (end <= p || *p < '0' || '9' < *p) {
+      s->error = "Invalid number";
+      return JSON_NUMBER_ERROR;
+    }
+    while (p < end && '0' <= *p && *p <= '9') p++;
+  }
+  s->pos = (size_t)(p - s->src);
+
+  if (!is_float && !overflow) {
+    if (negative) {
+      if (acc <= (uint64_t)INT64_MAX + 1) {
+        *ival = (acc == (uint64_t)INT64_MAX + 1) ? INT64_MIN : -(int64_t)acc;
+        return JSON_NUMBER_INTEGER;
+      }
+    } else if (acc <= (uint64_t)INT64_MAX) {
+      *ival = (int64_t)acc;
+      return JSON_NUMBER_INTEGER;
+    }
+  }
+  /* strtod wants a terminated string */
+  {
+    char buf[JSON_NUMBER_MAX_LEN + 1];
+    size_t n = (size_t)(p - start);
+    if (JSON_NUMBER_MAX_LEN < n) {
+      s->error = "Number too long";
+      return JSON_NUMBER_ERROR;
+    }
+    memcpy(buf, start, n);
+    buf[n] = '\0';
+    *fval = strtod(buf, NULL);
+  }
+  return JSON_NUMBER_FLOAT;
+}
+
+/*
+ * Generator
+ */
+
+static const char hex_chars[] = "0123456789abcdef";
+
+void
+JSON_escape_string(const uint8_t *src, size_t len, json_out_func out, void *ctx)
+{
+  size_t run = 0;
+
+  out(ctx, "\"", 1);
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = src[i];
+    const char *esc;
+    char ubuf[6];
+    size_t esc_len = 2;
+
+    if (0x20 <= c && c != '"' && c != '\\') continue;
+    switch (c) {
+      case '"':  esc = "\\\""; break;
+      case '\\': esc = "\\\\"; break;
+      case '\b': esc = "\\b";  break;
+      case '\f': esc = "\\f";  break;
+      case '\n': esc = "\\n";  break;
+      case '\r': esc = "\\r";  break;
+      case '\t': esc = "\\t";  break;
+      default:
+        ubuf[0] = '\\'; ubuf[1] = 'u'; ubuf[2] = '0'; ubuf[3] = '0';
+        ubuf[4] = hex_chars[c >> 4];
+        ubuf[5] = hex_chars[c & 0x0f];
+        esc = ubuf;
+        esc_len = 6;
+        break;
+    }
+    if (run < i) out(ctx, (const char *)src + run, i - run);
+    out(ctx, esc, esc_len);
+    run = i + 1;
+  }
+  if (run < len) out(ctx, (const char *)src + run, len - run);
+  out(ctx, "\"", 1);
+}
+
+/*
+ * Incremental parser
+ */
+
+#if 64 < JSON_MAX_NESTING
+#error "JSON_MAX_NESTING must fit the 64-bit container stack"
+#endif
+
+enum {
+  STREAM_VALUE,          /* a value; top level, after ':' or after ',' in an array */
+  STREAM_VALUE_OR_END,   /* after '[' */
+  STREAM_KEY,            /* after ',' in an object */
+  STREAM_KEY_OR_END,     /* after '{' */
+  STREAM_COLON,
+  STREAM_COMMA_OR_END,
+};
+
+/* Outcome of scanning one token */
+enum {
+  TOKEN_OK,
+  TOKEN_INCOMPLETE,
+  TOKEN_ERROR,
+};
+
+void
+JSON_stream_init(json_stream_t *st)
+{
+  memset(st, 0, sizeof(*st));
+  st->state = STREAM_VALUE;
+}
+
+static bool
+stream_in_object(json_stream_t *st)
+{
+  return (st->objects >> (st->depth - 1)) & 1;
+}
+
+static void
+stream_after_value(json_stream_t *st)
+{
+  st->state = (st->depth == 0) ? STREAM_VALUE : STREAM_COMMA_OR_END;
+}
+
+static int
+stream_scan_string(json_stream_t *st, json_scanner_t *s, json_event_t *ev)
+{
+  /* Resume after the part an earlier feed has already looked at */
+  size_t i = s->pos + 1 + st->scanned;
+  bool escaped = st->scanned_escaped;
+
+  while (i < s->len) {
+    uint8_t c = s->src[i];
+    if (c == '"') {
+      ev->str = s->src + s->pos + 1;
+      ev->len = i - s->pos - 1;
+      ev->escaped = escaped;
+      s->pos = i + 1;
+      st->scanned = 0;
+      st->scanned_escaped = false;
+      return TOKEN_OK;
+    }
+    if (c == '\\') {
+      if (s->len <= i + 1) break; /* the escaped byte is in the next piece */
+      escaped = true;
+      i += 2;
+      continue;
+    }
+    if (c < 0x20) {
+      st->scanned = 0;
+      st->scanned_escaped = false;
+      s->error = "Control character in string";
+      return TOKEN_ERROR;
+    }
+    i++;
+  }
+  st->scanned = i - s->pos - 1;
+  st->scanned_escaped = escaped;
+  return TOKEN_INCOMPLETE;
+}
+
+static int
+stream_scan_number(json_scanner_t *s, bool final, json_event_t *ev)
+{
+  size_t end = s->pos;
+  json_scanner_t num;
+
+  while (end < s->len) {
+    uint8_t c = s->src[end];
+    if (!(('0' <= c && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')) break;
+    end++;
+  }
+  /* "12" at the end of a piece may go on as "123" */
+  if (end == s->len && !final) return TOKEN_INCOMPLETE;
+  JSON_scanner_init(&num, s->src + s->pos, end - s->pos);
+  switch (JSON_scan_number(&num, &ev->ival, &ev->fval)) {
+    case JSON_NUMBER_INTEGER:
+      ev->type = JSON_EVENT_INTEGER;
+      break;
+    case JSON_NUMBER_FLOAT:
+      ev->type = JSON_EVENT_FLOAT;
+      break;
+    default:
+      s->error = num.error;
+      return TOKEN_ERROR;
+  }
+  if (num.pos != num.len) {
+    s->error = "Invalid number";
+    return TOKEN_ERROR;
+  }
+  s->pos = end;
+  return TOKEN_OK;
+}
+
+static int
+stream_scan_literal(json_scanner_t *s, bool final, const char *word)
+{
+  size_t n = strlen(word);
+  size_t avail = s->len - s->pos;
+
+  if (avail < n && !final && memcmp(s->src + s->pos, word, avail) == 0) {
+    return TOKEN_INCOMPLETE;
+  }
+  return JSON_scan_literal(s, word) ? TOKEN_OK : TOKEN_ERROR;
+}
+
+static int
+stream_scan_value(json_stream_t *st, json_scanner_t *s, bool final, int c, json_event_t *ev)
+{
+  int r;
+
+  switch (c) {
+    case '{':
+    case '[':
+      if (JSON_MAX_NESTING <= st->depth) {
+        s->error = "Nesting too deep";
+        return TOKEN_ERROR;
+      }
+      s->pos++;
+      if (c == '{') {
+        st->objects |= (uint64_t)1 << st->depth;
+        ev->type = JSON_EVENT_START_OBJECT;
+        st->state = STREAM_KEY_OR_END;
+      } else {
+        st->objects &= ~((uint64_t)1 << st->depth);
+        ev->type = JSON_EVENT_START_ARRAY;
+        st->state = STREAM_VALUE_OR_END;
+      }
+      st->depth++;
+      return TOKEN_OK;
+    case '"':
+      ev->type = JSON_EVENT_STRING;
+      r = stream_scan_string(st, s, ev);
+      break;
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+      r = stream_scan_number(s, final, ev);
+      break;
+    case 't':
+      ev->type = JSON_EVENT_TRUE;
+      r = stream_scan_literal(s, final, "true");
+      break;
+    case 'f':
+      ev->type = JSON_EVENT_FALSE;
+      r = stream_scan_literal(s, final, "false");
+      break;
+    case 'n':
+      ev->type = JSON_EVENT_NULL;
+      r = stream_scan_literal(s, final, "null");
+      break;
+    default:
+      s->error = "Unexpected character";
+      return TOKEN_ERROR;
+  }
+  if (r == TOKEN_OK) stream_after_value(st);
+  return r;
+}
+
+static bool
+stream_close(json_stream_t *st, json_scanner_t *s, int c, json_event_t *ev)
+{
+  bool object = stream_in_object(st);
+
+  if (c != (object ? '}' : ']')) {
+    s->error = "Unexpected character";
+    return false;
+  }
+  s->pos++;
+  st->depth--;
+  ev->type = object ? JSON_EVENT_END_OBJECT : JSON_EVENT_END_ARRAY;
+  stream_after_value(st);
+  return true;
+}
+
+size_t
+JSON_stream_feed(json_stream_t *st, const uint8_t *buf, size_t len, bool final,
+                 json_event_func fn, void *ctx)
+{
+  json_scanner_t s;
+  json_event_t ev;
+  size_t start = 0;
+  int c;
+
+  JSON_scanner_init(&s, buf, len);
+  st->error = NULL;
+  while (0 <= (c = JSON_peek(&s))) {
+    int r = TOKEN_OK;
+    start = s.pos;
+    ev.escaped = false;
+    switch (st->state) {
+      case STREAM_VALUE_OR_END:
+        if (c == ']') {
+          r = stream_close(st, &s, c, &ev) ? TOKEN_OK : TOKEN_ERROR;
+          break;
+        }
+        /* fall through */
+      case STREAM_VALUE:
+        r = stream_scan_value(st, &s, final, c, &ev);
+        break;
+      case STREAM_KEY_OR_END:
+        if (c == '}') {
+          r = stream_close(st, &s, c, &ev) ? TOKEN_OK : TOKEN_ERROR;
+          break;
+        }
+        /* fall through */
+      case STREAM_KEY:
+        if (c != '"') {
+          s.error = "Expected '\"'";
+          r = TOKEN_ERROR;
+          break;
+        }
+        ev.type = JSON_EVENT_KEY;
+        r = stream_scan_string(st, &s, &ev);
+        if (r == TOKEN_OK) st->state = STREAM_COLON;
+        break;
+      case STREAM_COLON:
+        if (c != ':') {
+          s.error = "Expected ':'";
+          r = TOKEN_ERROR;
+          break;
+        }
+        s.pos++;
+        st->state = STREAM_VALUE;
+        continue;
+      case STREAM_COMMA_OR_END:
+        if (c == ',') {
+          s.pos++;
+          st->state = stream_in_object(st) ? STREAM_KEY : STREAM_VALUE;
+          continue;
+        }
+        r = stream_close(st, &s, c, &ev) ? TOKEN_OK : TOKEN_ERROR;
+        break;
+    }
+    if (r != TOKEN_OK) {
+      /* Stop in front of the token: an unfinished one is fed again with
+         the next piece */
+      if (r == TOKEN_ERROR) {
+        st->error = s.error ? s.error : "Unexpected character";
+      } else if (final) {
+        st->error = "Unexpected end of input";
+      }
+      st->offset += start;
+      return start;
+    }
+    if (!fn(ctx, &ev)) {
+      st->offset += s.pos;
+      return s.pos;
+    }
+  }
+  if (final && (st->depth != 0 || st->state != STREAM_VALUE)) {
+    st->error = "Unexpected end of input";
+  }
+  st->offset += s.pos;
+  return s.pos;
+}
+
+#if defined(PICORB_VM_MRUBY)
+
+#include "mruby/json.c"
+
+#elif defined(PICORB_VM_MRUBYC)
+
+#include "mrubyc/json.c"
+
+#endif
@@ -0,0 +1,499 @@
+#include "mruby.h"
+#include "mruby/presym.h"
+#include "mruby/string.h"
+#include "mruby/array.h"
+#include "mruby/hash.h"
+#include "mruby/variable.h"
+#include "mruby/data.h"
+#include "mruby/class.h"
+
+static struct RClass *
+json_error_class(mrb_state *mrb, mrb_sym name)
+{
+  struct RClass *module_JSON = mrb_module_get_id(mrb, MRB_SYM(JSON));
+  return mrb_class_get_under_id(mrb, module_JSON, name);
+}
+
+static mrb_noreturn void
+json_raise_parser_error(mrb_state *mrb, json_scanner_t *s)
+{
+  mrb_raisef(mrb, json_error_class(mrb, MRB_SYM(ParserError)), "%s at index %d",
+             s->error ? s->error : "Unexpected character", (int)s->pos);
+}
+
+/*
+ * Parser
+ */
+
+static mrb_value json_parse_value(mrb_state *mrb, json_scanner_t *s, int depth);
+
+/* String from a raw body, nil with *error set on a bad escape */
+static mrb_value
+json_str_new(mrb_state *mrb, const uint8_t *body, size_t len, bool escaped, const char **error)
+{
+  if (!escaped) {
+    return mrb_str_new(mrb, (const char *)body, len);
+  }
+  /* Decode straight into the new String; it never grows */
+  mrb_value str = mrb_str_new(mrb, NULL, len);
+  int32_t n = JSON_unescape(body, len, (uint8_t *)RSTRING_PTR(str), error);
+  if (n < 0) {
+    return mrb_nil_value();
+  }
+  mrb_str_resize(mrb, str, n);
+  return str;
+}
+
+static mrb_value
+json_parse_string(mrb_state *mrb, json_scanner_t *s)
+{
+  const uint8_t *body;
+  size_t len;
+  bool escaped;
+
+  if (!JSON_scan_string(s, &body, &len, &escaped)) {
+    json_raise_parser_error(mrb, s);
+  }
+  mrb_value str = json_str_new(mrb, body, len, escaped, &s->error);
+  if (mrb_nil_p(str)) {
+    json_raise_parser_error(mrb, s);
+  }
+  return str;
+}
+
+static mrb_value
+json_parse_number(mrb_state *mrb, json_scanner_t *s)
+{
+  int64_t ival;
+  double fval;
+
+  switch (JSON_scan_number(s, &ival, &fval)) {
+    case JSON_NUMBER_INTEGER:
+      if (MRB_INT_MIN <= ival && ival <= MRB_INT_MAX) {
+        return mrb_int_value(mrb, (mrb_int)ival);
+      }
+      fval = (double)ival;
+      /* fall through */
+    case JSON_NUMBER_FLOAT:
+#ifndef MRB_NO_FLOAT
+      return mrb_float_value(mrb, (mrb_float)fval);
+#else
+      s->error = "Float is not supported";
+      json_raise_parser_error(mrb, s);
+#endif
+    default:
+      json_raise_parser_error(mrb, s);
+  }
+}
+
+static mrb_value
+json_parse_array(mrb_state *mrb, json_scanner_t *s, int depth)
+{
+  mrb_value ary = mrb_ary_new(mrb);
+
+  s->pos++; /* '[' */
+  if (JSON_peek(s) == ']') {
+    s->pos++;
+    return ary;
+  }
+  while (true) {
+    int ai = mrb_gc_arena_save(mrb);
+    mrb_ary_push(mrb, ary, json_parse_value(mrb, s, depth));
+    mrb_gc_arena_restore(mrb, ai);
+    if (JSON_peek(s) == ']') {
+      s->pos++;
+      return ary;
+    }
+    if (!JSON_expect(s, ',')) {
+      json_raise_parser_error(mrb, s);
+    }
+  }
+}
+
+static mrb_value
+json_parse_object(mrb_state *mrb, json_scanner_t *s, int depth)
+{
+  mrb_value hash = mrb_hash_new(mrb);
+
+  s->pos++; /* '{' */
+  if (JSON_peek(s) == '}') {
+    s->pos++;
+    return hash;
+  }
+  while (true) {
+    int ai = mrb_gc_arena_save(mrb);
+    mrb_value key = json_parse_string(mrb, s);
+    if (!JSON_expect(s, ':')) {
+      json_raise_parser_error(mrb, s);
+    }
+    mrb_hash_set(mrb, hash, key, json_parse_value(mrb, s, depth));
+    mrb_gc_arena_restore(mrb, ai);
+    if (JSON_peek(s) == '}') {
+      s->pos++;
+      return hash;
+    }
+    if (!JSON_expect(s, ',')) {
+      json_raise_parser_error(mrb, s);
+    }
+  }
+}
+
+static mrb_value
+json_parse_value(mrb_state *mrb, json_scanner_t *s, int depth)
+{
+  switch (JSON_peek(s)) {
+    case '{':
+    case '[':
+      if (JSON_MAX_NESTING <= depth) {
+        s->error = "Nesting too deep";
+        json_raise_parser_error(mrb, s);
+      }
+      if (s->src[s->pos] == '{') {
+        return json_parse_object(mrb, s, depth + 1);
+      }
+      return json_parse_array(mrb, s, depth + 1);
+    case '"':
+      return json_parse_string(mrb, s);
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+      return json_parse_number(mrb, s);
+    case 't':
+      if (JSON_scan_literal(s, "true")) return mrb_true_value();
+      break;
+    case 'f':
+      if (JSON_scan_literal(s, "false")) return mrb_false_value();
+      break;
+    case 'n':
+      if (JSON_scan_literal(s, "null")) return mrb_nil_value();
+      break;
+    default:
+      s->error = "Unexpected character";
+      break;
+  }
+  json_raise_parser_error(mrb, s);
+}
+
+static mrb_value
+mrb_json_s_parse(mrb_state *mrb, mrb_value self)
+{
+  mrb_value json;
+  json_scanner_t s;
+
+  mrb_get_args(mrb, "S", &json);
+  JSON_scanner_init(&s, (const uint8_t *)RSTRING_PTR(json), RSTRING_LEN(json));
+  /* Like the Ruby parser before it, anything after the first value is
+     ignored: JSON::Digger hands over slices such as "1," */
+  return json_parse_value(mrb, &s, 0);
+}
+
+/*
+ * Generator
+ */
+
+typedef struct {
+  mrb_state *mrb;
+  mrb_value out;
+  int depth;
+  /* JSON.dump: text collects in buf and goes to io.write whenever it
+     fills up, instead of into out */
+  mrb_value io;
+  char *buf;
+  size_t len;
+} json_generator_t;
+
+typedef struct {
+  json_generator_t *g;
+  mrb_int count;
+} json_object_iter_t;
+
+static void
+json_flush(json_generator_t *g)
+{
+  if (g->len == 0) return;
+  int ai = mrb_gc_arena_save(g->mrb);
+  mrb_value chunk = mrb_str_new(g->mrb, g->buf, g->len);
+  g->len = 0;
+  mrb_funcall_id(g->mrb, g->io, MRB_SYM(write), 1, chunk);
+  mrb_gc_arena_restore(g->mrb, ai);
+}
+
+static void
+json_str_out(void *ctx, const char *buf, size_t len)
+{
+  json_generator_t *g = (json_generator_t *)ctx;
+
+  if (!g->buf) {
+    mrb_str_cat(g->mrb, g->out, buf, len);
+    return;
+  }
+  while (0 < len) {
+    size_t n = JSON_DUMP_BUFFER_SIZE - g->len;
+    if (len < n) n = len;
+    memcpy(g->buf + g->len, buf, n);
+    g->len += n;
+    buf += n;
+    len -= n;
+    if (g->len == JSON_DUMP_BUFFER_SIZE) json_flush(g);
+  }
+}
+
+#define JSON_OUT_LIT(g, lit) json_str_out((g), (lit), sizeof(lit) - 1)
+
+static void json_generate_value(mrb_state *mrb, json_generator_t *g, mrb_value obj);
+
+static void
+json_generate_string(mrb_state *mrb, json_generator_t *g, mrb_value str)
+{
+  JSON_escape_string((const uint8_t *)RSTRING_PTR(str), RSTRING_LEN(str), json_str_out, g);
+}
+
+static int
+json_generate_pair(mrb_state *mrb, mrb_value key, mrb_value val, void *data)
+{
+  json_object_iter_t *iter = (json_object_iter_t *)data;
+  json_generator_t *g = iter->g;
+
+  if (0 < iter->count++) {
+    JSON_OUT_LIT(g, ",");
+  }
+  if (!mrb_string_p(key)) key = mrb_obj_as_string(mrb, key);
+  json_generate_string(mrb, g, key);
+  JSON_OUT_LIT(g, ":");
+  json_generate_value(mrb, g, val);
+  return 0;
+}
+
+static void
+json_generate_value(mrb_state *mrb, json_generator_t *g, mrb_value obj)
+{
+  int ai = mrb_gc_arena_save(mrb);
+
+  switch (mrb_type(obj)) {
+    case MRB_TT_FALSE:
+      if (mrb_nil_p(obj)) {
+        JSON_OUT_LIT(g, "null");
+      } else {
+        JSON_OUT_LIT(g, "false");
+      }
+      break;
+    case MRB_TT_TRUE:
+      JSON_OUT_LIT(g, "true");
+      break;
+    case MRB_TT_STRING:
+      json_generate_string(mrb, g, obj);
+      break;
+    case MRB_TT_SYMBOL:
+      json_generate_string(mrb, g, mrb_sym_str(mrb, mrb_symbol(obj)));
+      break;
+    case MRB_TT_INTEGER:
+#ifndef MRB_NO_FLOAT
+    case MRB_TT_FLOAT:
+#endif
+      /* Number#to_s, as the Ruby generator did */
+      {
+        mrb_value num = mrb_obj_as_string(mrb, obj);
+        json_str_out(g, RSTRING_PTR(num), RSTRING_LEN(num));
+      }
+      break;
+    case MRB_TT_ARRAY:
+    case MRB_TT_HASH:
+      if (JSON_MAX_NESTING <= g->depth) {
+        mrb_raisef(mrb, json_error_class(mrb, MRB_SYM(GeneratorError)),
+                   "nesting of %d is too deep", g->depth + 1);
+      }
+      g->depth++;
+      if (mrb_array_p(obj)) {
+        JSON_OUT_LIT(g, "[");
+        for (mrb_int i = 0; i < RARRAY_LEN(obj); i++) {
+          if (0 < i) JSON_OUT_LIT(g, ",");
+          json_generate_value(mrb, g, RARRAY_PTR(obj)[i]);
+        }
+        JSON_OUT_LIT(g, "]");
+      } else {
+        json_object_iter_t iter = { g, 0 };
+        JSON_OUT_LIT(g, "{");
+        mrb_hash_foreach(mrb, mrb_hash_ptr(obj), json_generate_pair, &iter);
+        JSON_OUT_LIT(g, "}");
+      }
+      g->depth--;
+      break;
+    default:
+      json_generate_string(mrb, g, mrb_obj_as_string(mrb, obj));
+      break;
+  }
+  mrb_gc_arena_restore(mrb, ai);
+}
+
+static mrb_value
+json_generate(mrb_state *mrb, mrb_value obj)
+{
+  json_generator_t g;
+
+  g.mrb = mrb;
+  g.out = mrb_str_new_capa(mrb, 64);
+  g.depth = 0;
+  g.io = mrb_nil_value();
+  g.buf = NULL;
+  g.len = 0;
+  json_generate_value(mrb, &g, obj);
+  return g.out;
+}
+
+static mrb_value
+mrb_json_s_generate(mrb_state *mrb, mrb_value self)
+{
+  mrb_value obj;
+
+  mrb_get_args(mrb, "o", &obj);
+  return json_generate(mrb, obj);
+}
+
+/* JSON.dump(obj, io = nil): write the text to io in JSON_DUMP_BUFFER_SIZE
+   pieces, or return it like JSON.generate without io */
+static mrb_value
+mrb_json_s_dump(mrb_state *mrb, mrb_value self)
+{
+  mrb_value obj, io = mrb_nil_value();
+  char buf[JSON_DUMP_BUFFER_SIZE];
+  json_generator_t g;
+
+  mrb_get_args(mrb, "o|o", &obj, &io);
+  if (mrb_nil_p(io)) {
+    return json_generate(mrb, obj);
+  }
+  g.mrb = mrb;
+  g.out = mrb_nil_value();
+  g.depth = 0;
+  g.io = io;
+  g.buf = buf;
+  g.len = 0;
+  json_generate_value(mrb, &g, obj);
+  json_flush(&g);
+  return io;
+}
+
+/*
+ * JSON::StreamParser
+ */
+
+static void
+mrb_json_stream_free(mrb_state *mrb, void *ptr)
+{
+  mrb_free(mrb, ptr);
+}
+
+static const struct mrb_data_type mrb_json_stream_type = {
+  "JSONStreamParser", mrb_json_stream_free,
+};
+
+typedef struct {
+  mrb_state *mrb;
+  mrb_value events;
+  json_stream_t *st;
+} json_stream_ctx_t;
+
+static mrb_noreturn void
+json_raise_stream_error(mrb_state *mrb, json_stream_t *st)
+{
+  mrb_raisef(mrb, json_error_class(mrb, MRB_SYM(ParserError)), "%s at index %d",
+             st->error, (int)st->offset);
+}
+
+static bool
+json_stream_event(void *ctx, const json_event_t *ev)
+{
+  json_stream_ctx_t *c = (json_stream_ctx_t *)ctx;
+  mrb_state *mrb = c->mrb;
+  int ai = mrb_gc_arena_save(mrb);
+  mrb_sym name = MRB_SYM(value);
+  mrb_value value = mrb_nil_value();
+
+  switch (ev->type) {
+    case JSON_EVENT_START_OBJECT: name = MRB_SYM(start_object); break;
+    case JSON_EVENT_END_OBJECT:   name = MRB_SYM(end_object); break;
+    case JSON_EVENT_START_ARRAY:  name = MRB_SYM(start_array); break;
+    case JSON_EVENT_END_ARRAY:    name = MRB_SYM(end_array); break;
+    case JSON_EVENT_KEY:
+      name = MRB_SYM(key);
+      /* fall through */
+    case JSON_EVENT_STRING:
+      value = json_str_new(mrb, ev->str, ev->len, ev->escaped, &c->st->error);
+      if (mrb_nil_p(value)) {
+        json_raise_stream_error(mrb, c->st);
+      }
+      break;
+    case JSON_EVENT_INTEGER:
+      if (MRB_INT_MIN <= ev->ival && ev->ival <= MRB_INT_MAX) {
+        value = mrb_int_value(mrb, (mrb_int)ev->ival);
+        break;
+      }
+#ifndef MRB_NO_FLOAT
+      value = mrb_float_value(mrb, (mrb_float)ev->ival);
+#endif
+      break;
+    case JSON_EVENT_FLOAT:
+#ifndef MRB_NO_FLOAT
+      value = mrb_float_value(mrb, (mrb_float)ev->fval);
+#endif
+      break;
+    case JSON_EVENT_TRUE:  value = mrb_true_value(); break;
+    case JSON_EVENT_FALSE: value = mrb_false_value(); break;
+    case JSON_EVENT_NULL:  break;
+  }
+  mrb_ary_push(mrb, c->events, mrb_symbol_value(name));
+  mrb_ary_push(mrb, c->events, value);
+  mrb_gc_arena_restore(mrb, ai);
+  return true;
+}
+
+static mrb_value
+mrb_json_stream_s__new(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value self = mrb_obj_new(mrb, mrb_class_ptr(klass), 0, NULL);
+  json_stream_t *st = (json_stream_t *)mrb_malloc(mrb, sizeof(json_stream_t));
+  JSON_stream_init(st);
+  DATA_PTR(self) = st;
+  DATA_TYPE(self) = &mrb_json_stream_type;
+  return self;
+}
+
+/* _feed(data, final, events) -> bytes consumed */
+static mrb_value
+mrb_json_stream__feed(mrb_state *mrb, mrb_value self)
+{
+  json_stream_t *st = (json_stream_t *)mrb_data_get_ptr(mrb, self, &mrb_json_stream_type);
+  mrb_value data, events;
+  mrb_bool final;
+  json_stream_ctx_t ctx;
+
+  mrb_get_args(mrb, "SbA", &data, &final, &events);
+  ctx.mrb = mrb;
+  ctx.events = events;
+  ctx.st = st;
+  size_t consumed = JSON_stream_feed(st, (const uint8_t *)RSTRING_PTR(data), RSTRING_LEN(data),
+                                     final, json_stream_event, &ctx);
+  if (st->error) {
+    json_raise_stream_error(mrb, st);
+  }
+  return mrb_int_value(mrb, (mrb_int)consumed);
+}
+
+void
+mrb_picoruby_json_gem_init(mrb_state* mrb)
+{
+  struct RClass *module_JSON = mrb_define_module_id(mrb, MRB_SYM(JSON));
+
+  mrb_define_class_method_id(mrb, module_JSON, MRB_SYM(parse), mrb_json_s_parse, MRB_ARGS_REQ(1));
+  mrb_define_class_method_id(mrb, module_JSON, MRB_SYM(generate), mrb_json_s_generate, MRB_ARGS_REQ(1));
+  mrb_define_class_method_id(mrb, module_JSON, MRB_SYM(dump), mrb_json_s_dump, MRB_ARGS_ARG(1, 1));
+
+  struct RClass *class_StreamParser = mrb_define_class_under_id(mrb, module_JSON, MRB_SYM(StreamParser), mrb->object_class);
+  MRB_SET_INSTANCE_TT(class_StreamParser, MRB_TT_CDATA);
+  mrb_define_class_method_id(mrb, class_StreamParser, MRB_SYM(_new), mrb_json_stream_s__new, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, class_StreamParser, MRB_SYM(_feed), mrb_json_stream__feed, MRB_ARGS_REQ(3));
+}
+
+void
+mrb_picoruby_json_gem_final(mrb_state* mrb)
+{
+}
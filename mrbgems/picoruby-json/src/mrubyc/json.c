@@ -0,0 +1,524 @@
+#include <stdio.h>
+#include <mrubyc.h>
+
+static void
+json_raise(mrbc_vm *vm, const char *class_name, const char *message)
+{
+  mrbc_class *cls = MRBC_CLASS(StandardError);
+  mrbc_class *module_JSON = mrbc_get_class_by_name("JSON");
+  if (module_JSON) {
+    mrbc_value *c = mrbc_get_class_const(module_JSON, mrbc_str_to_symid(class_name));
+    if (c && c->tt == MRBC_TT_CLASS) cls = c->cls;
+  }
+  mrbc_raise(vm, cls, message);
+}
+
+static void
+json_raise_parser_error(mrbc_vm *vm, json_scanner_t *s)
+{
+  char message[64];
+  snprintf(message, sizeof(message), "%s at index %d",
+           s->error ? s->error : "Unexpected character", (int)s->pos);
+  json_raise(vm, "ParserError", message);
+}
+
+/*
+ * Parser
+ *
+ * Every function returns false after setting s->error. The caller
+ * releases what it had built so far, and c_json_parse raises once the
+ * recursion has unwound.
+ */
+
+static bool json_parse_value(mrbc_vm *vm, json_scanner_t *s, int depth, mrbc_value *ret);
+
+/* String from a raw body; false with *error set on a bad escape */
+static bool
+json_str_new(mrbc_vm *vm, const uint8_t *body, size_t len, bool escaped,
+             mrbc_value *ret, const char **error)
+{
+  if (!escaped) {
+    *ret = mrbc_string_new(vm, body, len);
+    return true;
+  }
+  /* Decode straight into the new String; it never grows */
+  *ret = mrbc_string_new(vm, NULL, len);
+  int32_t n = JSON_unescape(body, len, ret->string->data, error);
+  if (n < 0) {
+    mrbc_decref(ret);
+    return false;
+  }
+  ret->string->size = n;
+  ret->string->data[n] = '\0';
+  return true;
+}
+
+static bool
+json_parse_string(mrbc_vm *vm, json_scanner_t *s, mrbc_value *ret)
+{
+  const uint8_t *body;
+  size_t len;
+  bool escaped;
+
+  if (!JSON_scan_string(s, &body, &len, &escaped)) return false;
+  return json_str_new(vm, body, len, escaped, ret, &s->error);
+}
+
+static bool
+json_parse_number(mrbc_vm *vm, json_scanner_t *s, mrbc_value *ret)
+{
+  int64_t ival;
+  double fval;
+
+  switch (JSON_scan_number(s, &ival, &fval)) {
+    case JSON_NUMBER_INTEGER:
+      if ((int64_t)(mrbc_int_t)ival == ival) {
+        *ret = mrbc_integer_value((mrbc_int_t)ival);
+        return true;
+      }
+      fval = (double)ival;
+      /* fall through */
+    case JSON_NUMBER_FLOAT:
+#if MRBC_USE_FLOAT
+      *ret = mrbc_float_value(vm, fval);
+      return true;
+#else
+      s->error = "Float is not supported";
+      return false;
+#endif
+    default:
+      return false;
+  }
+}
+
+static bool
+json_parse_array(mrbc_vm *vm, json_scanner_t *s, int depth, mrbc_value *ret)
+{
+  mrbc_value ary = mrbc_array_new(vm, 0);
+  mrbc_value item;
+
+  s->pos++; /* '[' */
+  if (JSON_peek(s) == ']') {
+    s->pos++;
+    *ret = ary;
+    return true;
+  }
+  while (true) {
+    if (!json_parse_value(vm, s, depth, &item)) break;
+    mrbc_array_push(&ary, &item);
+    if (JSON_peek(s) == ']') {
+      s->pos++;
+      *ret = ary;
+      return true;
+    }
+    if (!JSON_expect(s, ',')) break;
+  }
+  mrbc_decref(&ary);
+  return false;
+}
+
+static bool
+json_parse_object(mrbc_vm *vm, json_scanner_t *s, int depth, mrbc_value *ret)
+{
+  mrbc_value hash = mrbc_hash_new(vm, 0);
+  mrbc_value key, value;
+
+  s->pos++; /* '{' */
+  if (JSON_peek(s) == '}') {
+    s->pos++;
+    *ret = hash;
+    return true;
+  }
+  while (true) {
+    if (!json_parse_string(vm, s, &key)) break;
+    if (!JSON_expect(s, ':') || !json_parse_value(vm, s, depth, &value)) {
+      mrbc_decref(&key);
+      break;
+    }
+    mrbc_hash_set(&hash, &key, &value);
+    if (JSON_peek(s) == '}') {
+      s->pos++;
+      *ret = hash;
+      return true;
+    }
+    if (!JSON_expect(s, ',')) break;
+  }
+  mrbc_decref(&hash);
+  return false;
+}
+
+static bool
+json_parse_value(mrbc_vm *vm, json_scanner_t *s, int depth, mrbc_value *ret)
+{
+  switch (JSON_peek(s)) {
+    case '{':
+    case '[':
+      if (JSON_MAX_NESTING <= depth) {
+        s->error = "Nesting too deep";
+        return false;
+      }
+      if (s->src[s->pos] == '{') {
+        return json_parse_object(vm, s, depth + 1, ret);
+      }
+      return json_parse_array(vm, s, depth + 1, ret);
+    case '"':
+      return json_parse_string(vm, s, ret);
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+      return json_parse_number(vm, s, ret);
+    case 't':
+      *ret = mrbc_true_value();
+      return JSON_scan_literal(s, "true");
+    case 'f':
+      *ret = mrbc_false_value();
+      return JSON_scan_literal(s, "false");
+    case 'n':
+      *ret = mrbc_nil_value();
+      return JSON_scan_literal(s, "null");
+    default:
+      s->error = "Unexpected character";
+      return false;
+  }
+}
+
+static void
+c_json_parse(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  json_scanner_t s;
+  mrbc_value ret;
+
+  if (argc != 1 || GET_TT_ARG(1) != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "no implicit conversion into String");
+    return;
+  }
+  JSON_scanner_init(&s, GET_ARG(1).string->data, GET_ARG(1).string->size);
+  /* Like the Ruby parser before it, anything after the first value is
+     ignored: JSON::Digger hands over slices such as "1," */
+  if (!json_parse_value(vm, &s, 0, &ret)) {
+    json_raise_parser_error(vm, &s);
+    return;
+  }
+  SET_RETURN(ret);
+}
+
+/*
+ * Generator
+ *
+ * Output goes to a raw buffer that becomes the result String, so the
+ * text is not copied again at the end.
+ */
+
+typedef struct {
+  mrbc_vm *vm;
+  mrbc_value *v;
+  int argc;
+  uint8_t *buf;
+  size_t len;
+  size_t capa;
+  int depth;
+  const char *error_class;
+  const char *error;
+  /* JSON.dump: buf is a fixed JSON_DUMP_BUFFER_SIZE area that goes to
+     io.write whenever it fills up */
+  mrbc_value *io;
+} json_generator_t;
+
+static void
+json_flush(json_generator_t *g)
+{
+  if (g->len == 0 || g->error) return;
+  mrbc_value chunk = mrbc_string_new(g->vm, g->buf, g->len);
+  g->len = 0;
+  mrbc_value ret = mrbc_send(g->vm, g->v, g->argc, g->io, "write", 1, &chunk);
+  mrbc_decref(&ret);
+  mrbc_decref(&chunk);
+  if (g->vm->exception.tt == MRBC_TT_EXCEPTION) {
+    /* Leave the exception from write as it is */
+    g->error = "write failed";
+  }
+}
+
+static void
+json_buf_out(void *ctx, const char *data, size_t len)
+{
+  json_generator_t *g = (json_generator_t *)ctx;
+
+  if (g->error) return;
+  if (g->io) {
+    while (0 < len && !g->error) {
+      size_t n = JSON_DUMP_BUFFER_SIZE - g->len;
+      if (len < n) n = len;
+      memcpy(g->buf + g->len, data, n);
+      g->len += n;
+      data += n;
+      len -= n;
+      if (g->len == JSON_DUMP_BUFFER_SIZE) json_flush(g);
+    }
+    return;
+  }
+  /* One byte more for the terminator mrbc_string_new_alloc writes */
+  if (g->capa < g->len + len + 1) {
+    size_t capa = g->capa ? g->capa : 64;
+    while (capa < g->len + len + 1) capa *= 2;
+    /* mrbc_realloc does not take NULL */
+    uint8_t *buf = g->buf ? (uint8_t *)mrbc_realloc(g->vm, g->buf, capa)
+                          : (uint8_t *)mrbc_alloc(g->vm, capa);
+    if (!buf) {
+      g->error_class = "GeneratorError";
+      g->error = "out of memory";
+      return;
+    }
+    g->buf = buf;
+    g->capa = capa;
+  }
+  memcpy(g->buf + g->len, data, len);
+  g->len += len;
+}
+
+#define JSON_OUT_LIT(g, lit) json_buf_out((g), (lit), sizeof(lit) - 1)
+
+static void
+json_generate_to_s(json_generator_t *g, mrbc_value *obj, bool quote)
+{
+  mrbc_value str = mrbc_send(g->vm, g->v, g->argc, obj, "to_s", 0);
+  if (str.tt != MRBC_TT_STRING) {
+    mrbc_decref(&str);
+    g->error_class = "GeneratorError";
+    g->error = "to_s did not return a String";
+    return;
+  }
+  if (quote) {
+    JSON_escape_string(str.string->data, str.string->size, json_buf_out, g);
+  } else {
+    json_buf_out(g, (const char *)str.string->data, str.string->size);
+  }
+  mrbc_decref(&str);
+}
+
+static void
+json_generate_value(json_generator_t *g, mrbc_value *obj)
+{
+  if (g->error) return;
+  switch (mrbc_type(*obj)) {
+    case MRBC_TT_NIL:
+      JSON_OUT_LIT(g, "null");
+      break;
+    case MRBC_TT_FALSE:
+      JSON_OUT_LIT(g, "false");
+      break;
+    case MRBC_TT_TRUE:
+      JSON_OUT_LIT(g, "true");
+      break;
+    case MRBC_TT_STRING:
+      JSON_escape_string(obj->string->data, obj->string->size, json_buf_out, g);
+      break;
+    case MRBC_TT_SYMBOL: {
+      const char *name = mrbc_symid_to_str(mrbc_symbol(*obj));
+      JSON_escape_string((const uint8_t *)name, strlen(name), json_buf_out, g);
+      break;
+    }
+    case MRBC_TT_INTEGER: {
+      char num[24];
+      int n = snprintf(num, sizeof(num), "%lld", (long long)mrbc_integer(*obj));
+      json_buf_out(g, num, n);
+      break;
+    }
+#if MRBC_USE_FLOAT
+    case MRBC_TT_FLOAT:
+      /* Float#to_s, as the Ruby generator did */
+      json_generate_to_s(g, obj, false);
+      break;
+#endif
+    case MRBC_TT_ARRAY:
+    case MRBC_TT_HASH:
+      if (JSON_MAX_NESTING <= g->depth) {
+        g->error_class = "GeneratorError";
+        g->error = "nesting is too deep";
+        return;
+      }
+      g->depth++;
+      if (mrbc_type(*obj) == MRBC_TT_ARRAY) {
+        int size = mrbc_array_size(obj);
+        JSON_OUT_LIT(g, "[");
+        for (int i = 0; i < size; i++) {
+          mrbc_value item = mrbc_array_get(obj, i);
+          if (0 < i) JSON_OUT_LIT(g, ",");
+          json_generate_value(g, &item);
+        }
+        JSON_OUT_LIT(g, "]");
+      } else {
+        mrbc_hash_iterator ite = mrbc_hash_iterator_new(obj);
+        bool first = true;
+        JSON_OUT_LIT(g, "{");
+        while (mrbc_hash_i_has_next(&ite)) {
+          mrbc_value *kv = mrbc_hash_i_next(&ite);
+          if (!first) JSON_OUT_LIT(g, ",");
+          first = false;
+          if (mrbc_type(kv[0]) == MRBC_TT_STRING || mrbc_type(kv[0]) == MRBC_TT_SYMBOL) {
+            json_generate_value(g, &kv[0]);
+          } else {
+            json_generate_to_s(g, &kv[0], true);
+          }
+          JSON_OUT_LIT(g, ":");
+          json_generate_value(g, &kv[1]);
+        }
+        JSON_OUT_LIT(g, "}");
+      }
+      g->depth--;
+      break;
+    default:
+      json_generate_to_s(g, obj, true);
+      break;
+  }
+}
+
+static void
+c_json_generate(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  json_generator_t g = { vm, v, argc, NULL, 0, 0, 0, NULL, NULL, NULL };
+
+  if (argc != 1) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+  json_generate_value(&g, &v[1]);
+  if (g.error) {
+    if (g.buf) mrbc_free(vm, g.buf);
+    json_raise(vm, g.error_class, g.error);
+    return;
+  }
+  if (!g.buf) {
+    SET_RETURN(mrbc_string_new(vm, "", 0));
+    return;
+  }
+  mrbc_value ret = mrbc_string_new_alloc(vm, g.buf, g.len);
+  SET_RETURN(ret);
+}
+
+/* JSON.dump(obj, io = nil): write the text to io in JSON_DUMP_BUFFER_SIZE
+   pieces, or return it like JSON.generate without io */
+static void
+c_json_dump(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  uint8_t buf[JSON_DUMP_BUFFER_SIZE];
+  json_generator_t g = { vm, v, argc, buf, 0, sizeof(buf), 0, NULL, NULL, NULL };
+
+  if (argc < 1 || 2 < argc) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+  if (argc == 1 || GET_TT_ARG(2) == MRBC_TT_NIL) {
+    c_json_generate(vm, v, 1);
+    return;
+  }
+  g.io = &v[2];
+  json_generate_value(&g, &v[1]);
+  json_flush(&g);
+  if (g.error) {
+    if (g.error_class) json_raise(vm, g.error_class, g.error);
+    return;
+  }
+  mrbc_incref(&v[2]);
+  SET_RETURN(v[2]);
+}
+
+/*
+ * JSON::StreamParser
+ */
+
+typedef struct {
+  mrbc_vm *vm;
+  mrbc_value *events;
+  json_stream_t *st;
+} json_stream_ctx_t;
+
+static bool
+json_stream_event(void *ctx, const json_event_t *ev)
+{
+  json_stream_ctx_t *c = (json_stream_ctx_t *)ctx;
+  const char *name = "value";
+  mrbc_value value = mrbc_nil_value();
+
+  switch (ev->type) {
+    case JSON_EVENT_START_OBJECT: name = "start_object"; break;
+    case JSON_EVENT_END_OBJECT:   name = "end_object"; break;
+    case JSON_EVENT_START_ARRAY:  name = "start_array"; break;
+    case JSON_EVENT_END_ARRAY:    name = "end_array"; break;
+    case JSON_EVENT_KEY:
+      name = "key";
+      /* fall through */
+    case JSON_EVENT_STRING:
+      if (!json_str_new(c->vm, ev->str, ev->len, ev->escaped, &value, &c->st->error)) {
+        return false;
+      }
+      break;
+    case JSON_EVENT_INTEGER:
+      if ((int64_t)(mrbc_int_t)ev->ival == ev->ival) {
+        value = mrbc_integer_value((mrbc_int_t)ev->ival);
+        break;
+      }
+#if MRBC_USE_FLOAT
+      value = mrbc_float_value(c->vm, (double)ev->ival);
+#endif
+      break;
+    case JSON_EVENT_FLOAT:
+#if MRBC_USE_FLOAT
+      value = mrbc_float_value(c->vm, ev->fval);
+#endif
+      break;
+    case JSON_EVENT_TRUE:  value = mrbc_true_value(); break;
+    case JSON_EVENT_FALSE: value = mrbc_false_value(); break;
+    case JSON_EVENT_NULL:  break;
+  }
+  mrbc_value sym = mrbc_symbol_value(mrbc_str_to_symid(name));
+  mrbc_array_push(c->events, &sym);
+  mrbc_array_push(c->events, &value);
+  return true;
+}
+
+static void
+c_json_stream__new(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  mrbc_value self = mrbc_instance_new(vm, v->cls, sizeof(json_stream_t));
+  JSON_stream_init((json_stream_t *)self.instance->data);
+  SET_RETURN(self);
+}
+
+/* _feed(data, final, events) -> bytes consumed */
+static void
+c_json_stream__feed(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  json_stream_t *st = (json_stream_t *)v->instance->data;
+  json_stream_ctx_t ctx;
+
+  if (argc != 3 || GET_TT_ARG(1) != MRBC_TT_STRING || GET_TT_ARG(3) != MRBC_TT_ARRAY) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong arguments");
+    return;
+  }
+  ctx.vm = vm;
+  ctx.events = &GET_ARG(3);
+  ctx.st = st;
+  size_t consumed = JSON_stream_feed(st, GET_ARG(1).string->data, GET_ARG(1).string->size,
+                                     GET_TT_ARG(2) == MRBC_TT_TRUE, json_stream_event, &ctx);
+  if (st->error) {
+    char message[64];
+    snprintf(message, sizeof(message), "%s at index %d", st->error, (int)st->offset);
+    json_raise(vm, "ParserError", message);
+    return;
+  }
+  SET_INT_RETURN((mrbc_int_t)consumed);
+}
+
+void
+mrbc_json_init(mrbc_vm *vm)
+{
+  mrbc_class *module_JSON = mrbc_define_module(vm, "JSON");
+
+  mrbc_define_method(vm, module_JSON, "parse", c_json_parse);
+  mrbc_define_method(vm, module_JSON, "generate", c_json_generate);
+  mrbc_define_method(vm, module_JSON, "dump", c_json_dump);
+
+  mrbc_class *class_StreamParser = mrbc_define_class_under(vm, module_JSON, "StreamParser", mrbc_class_object);
+  mrbc_define_method(vm, class_StreamParser, "_new", c_json_stream__new);
+  mrbc_define_method(vm, class_StreamParser, "_feed", c_json_stream__feed);
+}
@@ -79,4 +79,121 @@ class JsonTest < Picotest::Test
     assert_equal("ChatChannel", identifier_parsed["channel"])
     assert_equal("lobby", identifier_parsed["room"])
   end
+
+  def test_parse_unicode_escape_as_utf8
+    assert_equal("\u00e9", JSON.parse('"\\u00e9"'))
+    assert_equal("a\u3042b", JSON.parse('"a\\u3042b"'))
+    # Surrogate pair
+    assert_equal("\u{1F600}", JSON.parse('"\\ud83d\\ude00"'))
+  end
+
+  def test_parse_numbers
+    assert_equal([0, -12, 3.25, 1000.0, -0.5], JSON.parse('[0, -12, 3.25, 1e3, -5E-1]'))
+  end
+
+  def test_parse_error_raises_parser_error
+    assert_raise(JSON::ParserError) { JSON.parse('') }
+    assert_raise(JSON::ParserError) { JSON.parse('{"a" 1}') }
+    assert_raise(JSON::ParserError) { JSON.parse('[1, 2') }
+    assert_raise(JSON::ParserError) { JSON.parse('"unterminated') }
+    assert_raise(JSON::ParserError) { JSON.parse('"\\x"') }
+    assert_raise(JSON::ParserError) { JSON.parse('[' * 100) }
+  end
+
+  def test_parse_rejects_raw_control_characters
+    assert_raise(JSON::ParserError) { JSON.parse("\"a\nb\"") }
+    assert_raise(JSON::ParserError) { JSON.parse("[\"\t\"]") }
+    assert_raise(JSON::ParserError) { JSON.parse("{\"\x01\": 1}") }
+    assert_raise(JSON::ParserError) { JSON::StreamParser.new.feed("[\"a\x1fb\"]") }
+    # Escaped, they are fine
+    assert_equal("a\nb", JSON.parse('"a\\nb"'))
+    assert_equal(["\t"], JSON.parse('["\\t"]'))
+  end
+
+  def test_generate_control_characters_and_keys
+    assert_equal('"\\u0001"', JSON.generate("\x01"))
+    assert_equal('{"1":[1.5,"sym"]}', JSON.generate({1 => [1.5, :sym]}))
+  end
+
+  def test_stream_parser_events_across_chunks
+    events = []
+    parser = JSON::StreamParser.new
+    parser.feed('{"a":[1') { |e, v| events << [e, v] }
+    parser.feed('2,tr') { |e, v| events << [e, v] }
+    parser.feed('ue],"b\\u00e9":"x"}') { |e, v| events << [e, v] }
+    parser.finish { |e, v| events << [e, v] }
+    assert_equal([[:start_object, nil], [:key, "a"], [:start_array, nil], [:value, 12],
+                  [:value, true], [:end_array, nil], [:key, "b\u00e9"], [:value, "x"],
+                  [:end_object, nil]], events)
+  end
+
+  def test_stream_parser_selector
+    json = '{"items":[{"name":"a","tags":[1,2]},{"name":"b"}],"total":2}'
+    names = []
+    parser = JSON::StreamParser.new("$.items[*].name")
+    i = 0
+    while i < json.size
+      parser.feed(json[i, 5]) { |v| names << v }
+      i += 5
+    end
+    parser.finish
+    assert_equal(["a", "b"], names)
+    items = []
+    parser = JSON::StreamParser.new("$['items'][0]")
+    parser.feed(json) { |v| items << v }
+    parser.finish
+    assert_equal([{"name" => "a", "tags" => [1, 2]}], items)
+  end
+
+  def test_stream_parser_json_lines_and_errors
+    values = []
+    parser = JSON::StreamParser.new("$")
+    parser.feed("{\"a\":1}\n[2]\n3") { |v| values << v }
+    parser.finish { |v| values << v }
+    assert_equal([{"a" => 1}, [2], 3], values)
+    assert_raise(JSON::ParserError) { JSON::StreamParser.new.feed('{"a" 1}') }
+    parser = JSON::StreamParser.new
+    parser.feed('[1, 2')
+    assert_raise(JSON::ParserError) { parser.finish }
+  end
+
+  class ChunkIO
+    attr_reader :chunks
+
+    def initialize
+      @chunks = []
+    end
+
+    def write(str)
+      @chunks << str.dup
+      str.bytesize
+    end
+  end
+
+  def test_dump_writes_to_io_in_pieces
+    io = ChunkIO.new
+    obj = {"values" => [1, 2, 3] * 100, "name" => "a" * 300}
+    assert_equal(io, JSON.dump(obj, io))
+    assert_equal(JSON.generate(obj), io.chunks.join)
+    assert(1 < io.chunks.size)
+    assert_equal('[1,"a"]', JSON.dump([1, "a"]))
+  end
+
+  def test_stream_generator
+    io = ChunkIO.new
+    gen = JSON::StreamGenerator.new(io, 16)
+    gen.start_object
+    gen.add("device", "pico")
+    gen.start_array("samples")
+    3.times { |i| gen.add({"t" => i}) }
+    gen.end_array
+    gen.end_object
+    gen.add(1)
+    gen.finish
+    assert_equal("{\"device\":\"pico\",\"samples\":[{\"t\":0},{\"t\":1},{\"t\":2}]}\n1", io.chunks.join)
+    gen = JSON::StreamGenerator.new(io)
+    gen.start_array
+    assert_raise(JSON::GeneratorError) { gen.finish }
+    assert_raise(ArgumentError) { gen.add("key", 1) }
+  end
 end
@@ -1,17 +1,40 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "../../lib/littlefs/lfs.h"
 #include "../../include/littlefs.h"
 
 /*
- * RAM backed block device for host builds.
+ * Block device for host builds.
  *
- * There is no flash on the host, so the volume lives in a malloc'd buffer and
- * is gone when the process exits. It behaves like the real thing otherwise
- * (erase leaves 0xff behind, programming only clears bits), which is enough to
- * exercise littlefs and anything layered on top of it, such as
+ * There is no flash on the host. By default the volume lives in a malloc'd
+ * buffer and is gone when the process exits. It behaves like the real thing
+ * otherwise (erase leaves 0xff behind, programming only clears bits), which is
+ * enough to exercise littlefs and anything layered on top of it, such as
  * picoruby-sqlite3, without a board attached.
+ *
+ * For a simulator or a load test, the environment can ask for more:
+ *
+ *   PICORUBY_LFS_IMAGE        Keep the volume in this image file, mapped with
+ *                             mmap, so it survives the process. A new file is
+ *                             created erased. An existing one keeps its size
+ *                             unless PICORUBY_LFS_BLOCK_COUNT is given (it is
+ *                             grown, erased, if smaller), so a dump of a
+ *                             board's flash can be used as is and an image
+ *                             made here can be flashed to one.
+ *   PICORUBY_LFS_BLOCK_SIZE   Bytes per block (LFS_RAM_BLOCK_SIZE)
+ *   PICORUBY_LFS_BLOCK_COUNT  Blocks in the volume (LFS_RAM_BLOCK_COUNT)
+ *   PICORUBY_LFS_LATENCY      "read,prog,erase": microseconds each operation
+ *                             takes, to model a real chip
+ *   PICORUBY_LFS_STATS        Where to write the operation counts and the
+ *                             erase count per block at exit; "-" for stderr
  */
 
 #if !defined(LFS_RAM_BLOCK_SIZE)
@@ -21,38 +44,184 @@
 #define LFS_RAM_BLOCK_COUNT  128   /* 512 KB */
 #endif
 #define LFS_RAM_PAGE_SIZE    256
-#define LFS_RAM_TOTAL_SIZE   ((size_t)LFS_RAM_BLOCK_SIZE * LFS_RAM_BLOCK_COUNT)
 
-static uint8_t *lfs_ram_storage = NULL;
+enum { LFS_HOST_READ, LFS_HOST_PROG, LFS_HOST_ERASE, LFS_HOST_OPS };
+
+static struct {
+  bool ready;
+  uint8_t *storage;         /* NULL if the device could not be set up */
+  size_t size;
+  lfs_size_t block_size;
+  lfs_size_t block_count;
+  int fd;                   /* image file, or -1 */
+  long latency_us[LFS_HOST_OPS];
+  uint64_t ops[LFS_HOST_OPS];
+  uint64_t bytes[LFS_HOST_OPS];
+  uint32_t *erase_counts;   /* per block, when PICORUBY_LFS_STATS is set */
+  const char *stats_path;
+} lfs_host = { .fd = -1 };
+
+static unsigned long
+lfs_host_env_ulong(const char *name, unsigned long fallback)
+{
+  const char *value = getenv(name);
+  if (value == NULL || *value == '\0') return fallback;
+  char *end;
+  unsigned long n = strtoul(value, &end, 0);
+  if (*end != '\0' || n == 0) {
+    fprintf(stderr, "littlefs: ignoring %s=%s\n", name, value);
+    return fallback;
+  }
+  return n;
+}
+
+static void
+lfs_host_delay(int op)
+{
+  long us = lfs_host.latency_us[op];
+  if (us <= 0) return;
+  struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+static void
+lfs_host_report(void)
+{
+  FILE *out = (strcmp(lfs_host.stats_path, "-") == 0) ? stderr : fopen(lfs_host.stats_path, "w");
+  if (out == NULL) {
+    perror(lfs_host.stats_path);
+    return;
+  }
+  static const char *names[LFS_HOST_OPS] = { "read", "prog", "erase" };
+  for (int op = 0; op < LFS_HOST_OPS; op++) {
+    fprintf(out, "%s: %llu ops, %llu bytes\n", names[op],
+            (unsigned long long)lfs_host.ops[op], (unsigned long long)lfs_host.bytes[op]);
+  }
+  if (lfs_host.erase_counts) {
+    uint32_t min = UINT32_MAX, max = 0;
+    for (lfs_size_t i = 0; i < lfs_host.block_count; i++) {
+      uint32_t n = lfs_host.erase_counts[i];
+      if (n < min) min = n;
+      if (max < n) max = n;
+    }
+    fprintf(out, "erases per block: min %u, max %u\n", (unsigned)min, (unsigned)max);
+    for (lfs_size_t i = 0; i < lfs_host.block_count; i++) {
+      fprintf(out, "%s%u", (i % 16 == 0) ? (i ? "\n" : "") : " ", (unsigned)lfs_host.erase_counts[i]);
+    }
+    fprintf(out, "\n");
+  }
+  if (out != stderr) fclose(out);
+}
+
+static void
+lfs_host_cleanup(void)
+{
+  if (lfs_host.stats_path) lfs_host_report();
+  if (0 <= lfs_host.fd) {
+    msync(lfs_host.storage, lfs_host.size, MS_SYNC);
+    munmap(lfs_host.storage, lfs_host.size);
+    close(lfs_host.fd);
+    lfs_host.fd = -1;
+  } else {
+    free(lfs_host.storage);
+  }
+  lfs_host.storage = NULL;
+  free(lfs_host.erase_counts);
+  lfs_host.erase_counts = NULL;
+}
 
+/* Maps the image, creating or growing it as needed. The new part is
+   erased. */
 static uint8_t *
-lfs_ram_ensure_storage(void)
+lfs_host_map_image(const char *path, size_t size)
+{
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    perror(path);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  size_t old_size = (size_t)st.st_size;
+  if (lfs_host.block_size <= old_size && getenv("PICORUBY_LFS_BLOCK_COUNT") == NULL) {
+    size = old_size - old_size % lfs_host.block_size;
+  }
+  if (old_size < size && ftruncate(fd, (off_t)size) != 0) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  uint8_t *storage = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (storage == MAP_FAILED) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  if (old_size < size) memset(storage + old_size, 0xff, size - old_size);
+  lfs_host.fd = fd;
+  lfs_host.size = size;
+  lfs_host.block_count = (lfs_size_t)(size / lfs_host.block_size);
+  return storage;
+}
+
+static void
+lfs_host_setup(void)
 {
-  if (lfs_ram_storage == NULL) {
-    lfs_ram_storage = (uint8_t *)malloc(LFS_RAM_TOTAL_SIZE);
-    if (lfs_ram_storage == NULL) return NULL;
-    memset(lfs_ram_storage, 0xff, LFS_RAM_TOTAL_SIZE);
+  if (lfs_host.ready) return;
+  lfs_host.ready = true;
+
+  lfs_host.block_size = (lfs_size_t)lfs_host_env_ulong("PICORUBY_LFS_BLOCK_SIZE", LFS_RAM_BLOCK_SIZE);
+  if (lfs_host.block_size % LFS_RAM_PAGE_SIZE != 0) {
+    fprintf(stderr, "littlefs: block size must be a multiple of %d\n", LFS_RAM_PAGE_SIZE);
+    lfs_host.block_size = LFS_RAM_BLOCK_SIZE;
   }
-  return lfs_ram_storage;
+  lfs_host.block_count = (lfs_size_t)lfs_host_env_ulong("PICORUBY_LFS_BLOCK_COUNT", LFS_RAM_BLOCK_COUNT);
+  lfs_host.size = (size_t)lfs_host.block_size * lfs_host.block_count;
+
+  const char *latency = getenv("PICORUBY_LFS_LATENCY");
+  if (latency && *latency) {
+    sscanf(latency, "%ld,%ld,%ld", &lfs_host.latency_us[LFS_HOST_READ],
+           &lfs_host.latency_us[LFS_HOST_PROG], &lfs_host.latency_us[LFS_HOST_ERASE]);
+  }
+
+  const char *image = getenv("PICORUBY_LFS_IMAGE");
+  if (image && *image) {
+    lfs_host.storage = lfs_host_map_image(image, lfs_host.size);
+  } else {
+    lfs_host.storage = (uint8_t *)malloc(lfs_host.size);
+    if (lfs_host.storage) memset(lfs_host.storage, 0xff, lfs_host.size);
+  }
+
+  const char *stats = getenv("PICORUBY_LFS_STATS");
+  if (stats && *stats) {
+    lfs_host.stats_path = stats;
+    lfs_host.erase_counts = (uint32_t *)calloc(lfs_host.block_count, sizeof(uint32_t));
+  }
+  atexit(lfs_host_cleanup);
 }
 
 static int
-lfs_ram_read(const struct lfs_config *c, lfs_block_t block,
-             lfs_off_t off, void *buffer, lfs_size_t size)
+lfs_host_read(const struct lfs_config *c, lfs_block_t block,
+              lfs_off_t off, void *buffer, lfs_size_t size)
 {
-  uint8_t *storage = lfs_ram_ensure_storage();
-  if (storage == NULL) return LFS_ERR_IO;
-  memcpy(buffer, storage + (size_t)block * c->block_size + off, size);
+  if (lfs_host.storage == NULL) return LFS_ERR_IO;
+  memcpy(buffer, lfs_host.storage + (size_t)block * c->block_size + off, size);
+  lfs_host.ops[LFS_HOST_READ]++;
+  lfs_host.bytes[LFS_HOST_READ] += size;
+  lfs_host_delay(LFS_HOST_READ);
   return LFS_ERR_OK;
 }
 
 static int
-lfs_ram_prog(const struct lfs_config *c, lfs_block_t block,
-             lfs_off_t off, const void *buffer, lfs_size_t size)
+lfs_host_prog(const struct lfs_config *c, lfs_block_t block,
+              lfs_off_t off, const void *buffer, lfs_size_t size)
 {
-  uint8_t *storage = lfs_ram_ensure_storage();
-  if (storage == NULL) return LFS_ERR_IO;
-  uint8_t *dst = storage + (size_t)block * c->block_size + off;
+  if (lfs_host.storage == NULL) return LFS_ERR_IO;
+  uint8_t *dst = lfs_host.storage + (size_t)block * c->block_size + off;
   const uint8_t *src = (const uint8_t *)buffer;
   lfs_size_t i = 0;
   while (i < size) {
@@ -60,38 +229,47 @@ lfs_ram_prog(const struct lfs_config *c, lfs_block_t block,
     dst[i] &= src[i];
     i++;
   }
+  lfs_host.ops[LFS_HOST_PROG]++;
+  lfs_host.bytes[LFS_HOST_PROG] += size;
+  lfs_host_delay(LFS_HOST_PROG);
   return LFS_ERR_OK;
 }
 
 static int
-lfs_ram_erase(const struct lfs_config *c, lfs_block_t block)
+lfs_host_erase(const struct lfs_config *c, lfs_block_t block)
 {
-  uint8_t *storage = lfs_ram_ensure_storage();
-  if (storage == NULL) return LFS_ERR_IO;
-  memset(storage + (size_t)block * c->block_size, 0xff, c->block_size);
+  if (lfs_host.storage == NULL) return LFS_ERR_IO;
+  memset(lfs_host.storage + (size_t)block * c->block_size, 0xff, c->block_size);
+  lfs_host.ops[LFS_HOST_ERASE]++;
+  lfs_host.bytes[LFS_HOST_ERASE] += c->block_size;
+  if (lfs_host.erase_counts) lfs_host.erase_counts[block]++;
+  lfs_host_delay(LFS_HOST_ERASE);
   return LFS_ERR_OK;
 }
 
 static int
-lfs_ram_sync(const struct lfs_config *c)
+lfs_host_sync(const struct lfs_config *c)
 {
   (void)c;
+  /* Pages of a shared mapping reach the file even if the process dies,
+     so there is nothing to wait for here */
   return LFS_ERR_OK;
 }
 
 void
 littlefs_hal_init_config(struct lfs_config *cfg)
 {
+  lfs_host_setup();
   memset(cfg, 0, sizeof(struct lfs_config));
-  cfg->read  = lfs_ram_read;
-  cfg->prog  = lfs_ram_prog;
-  cfg->erase = lfs_ram_erase;
-  cfg->sync  = lfs_ram_sync;
+  cfg->read  = lfs_host_read;
+  cfg->prog  = lfs_host_prog;
+  cfg->erase = lfs_host_erase;
+  cfg->sync  = lfs_host_sync;
 
   cfg->read_size      = LFS_RAM_PAGE_SIZE;
   cfg->prog_size      = LFS_RAM_PAGE_SIZE;
-  cfg->block_size     = LFS_RAM_BLOCK_SIZE;
-  cfg->block_count    = LFS_RAM_BLOCK_COUNT;
+  cfg->block_size     = lfs_host.block_size;
+  cfg->block_count    = lfs_host.block_count;
   cfg->block_cycles   = 500;
   cfg->cache_size     = LFS_RAM_PAGE_SIZE;
   cfg->lookahead_size = 16;
@@ -100,7 +278,10 @@ littlefs_hal_init_config(struct lfs_config *cfg)
 void
 littlefs_hal_erase_all(void)
 {
-  uint8_t *storage = lfs_ram_ensure_storage();
-  if (storage == NULL) return;
-  memset(storage, 0xff, LFS_RAM_TOTAL_SIZE);
+  lfs_host_setup();
+  if (lfs_host.storage == NULL) return;
+  memset(lfs_host.storage, 0xff, lfs_host.size);
+  if (lfs_host.erase_counts) {
+    for (lfs_size_t i = 0; i < lfs_host.block_count; i++) lfs_host.erase_counts[i]++;
+  }
 }
@@ -147,13 +147,15 @@ mrb_read(mrb_state *mrb, mrb_value self)
   lfs_file_data_t *fd = (lfs_file_data_t *)mrb_data_get_ptr(mrb, self, &mrb_lfs_file_type);
   mrb_int btr;
   mrb_get_args(mrb, "i", &btr);
-  char buff[btr];
-  lfs_ssize_t br = lfs_file_read(littlefs_get_lfs(), &fd->file, buff, (lfs_size_t)btr);
+  /* Read straight into the string. A sector-sized buffer would be too
+     much for the stack */
+  mrb_value str = mrb_str_new(mrb, NULL, btr);
+  lfs_ssize_t br = lfs_file_read(littlefs_get_lfs(), &fd->file, RSTRING_PTR(str), (lfs_size_t)btr);
   if (br < 0) {
     mrb_raise_iff_lfs_error(mrb, (int)br, "lfs_file_read");
   }
   if (0 < br) {
-    return mrb_str_new(mrb, (const void *)buff, br);
+    return mrb_str_resize(mrb, str, br);
   }
   return mrb_nil_value();
 }
@@ -128,18 +128,30 @@ c_read(mrbc_vm *vm, mrbc_value v[], int argc)
 {
   lfs_file_data_t *fd = (lfs_file_data_t *)v->instance->data;
   lfs_size_t btr = GET_INT_ARG(1);
-  char buff[btr];
-  lfs_ssize_t br = lfs_file_read(littlefs_get_lfs(), &fd->file, buff, btr);
-  if (br < 0) {
-    mrbc_raise_iff_lfs_error(vm, (int)br, "lfs_file_read");
+  /* Read straight into the string. A sector-sized buffer would be too
+     much for the stack */
+  mrbc_value value = mrbc_string_new(vm, NULL, btr);
+  if (value.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), "out of memory");
     return;
   }
-  if (0 < br) {
-    mrbc_value value = mrbc_string_new(vm, (const void *)buff, br);
-    SET_RETURN(value);
-  } else {
+  lfs_ssize_t br = lfs_file_read(littlefs_get_lfs(), &fd->file, value.string->data, btr);
+  if (br <= 0) {
+    mrbc_decref(&value);
+    if (br < 0) {
+      mrbc_raise_iff_lfs_error(vm, (int)br, "lfs_file_read");
+      return;
+    }
     SET_NIL_RETURN();
+    return;
+  }
+  if ((lfs_size_t)br < btr) {
+    value.string->data[br] = '\0';
+    value.string->size = br;
+    uint8_t *data = mrbc_realloc(vm, value.string->data, br + 1);
+    if (data) value.string->data = data;
   }
+  SET_RETURN(value);
 }
 
 static void
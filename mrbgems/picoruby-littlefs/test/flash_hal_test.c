@@ -0,0 +1,149 @@
+/*
+ * Host test for the POSIX block device (ports/posix/flash_hal.c)
+ *
+ * Formats a volume kept in a PICORUBY_LFS_IMAGE file, writes a file and
+ * maps the image again as a new process would, to check that the file
+ * survives, that an existing image keeps its size and that growing one
+ * leaves the new blocks erased.
+ *
+ *   make -C test flash_hal
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../ports/posix/flash_hal.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+static char image[] = "/tmp/flash_hal_test_XXXXXX";
+static const char content[] = "Hello, littlefs\n";
+
+/* What a process exit and the next start do to the device */
+static void
+restart(void)
+{
+  lfs_host_cleanup();
+  lfs_host.ready = false;
+}
+
+static off_t
+image_size(void)
+{
+  struct stat st;
+  if (stat(image, &st) != 0) return -1;
+  return st.st_size;
+}
+
+static void
+write_file(struct lfs_config *cfg)
+{
+  lfs_t lfs;
+  lfs_file_t file;
+
+  CHECK(lfs_format(&lfs, cfg) == LFS_ERR_OK);
+  CHECK(lfs_mount(&lfs, cfg) == LFS_ERR_OK);
+  CHECK(lfs_file_open(&lfs, &file, "hello.txt", LFS_O_WRONLY | LFS_O_CREAT) == LFS_ERR_OK);
+  CHECK(lfs_file_write(&lfs, &file, content, sizeof(content) - 1) == (lfs_ssize_t)sizeof(content) - 1);
+  CHECK(lfs_file_close(&lfs, &file) == LFS_ERR_OK);
+  CHECK(lfs_unmount(&lfs) == LFS_ERR_OK);
+}
+
+static void
+check_file(struct lfs_config *cfg)
+{
+  lfs_t lfs;
+  lfs_file_t file;
+  char buf[64];
+
+  CHECK(lfs_mount(&lfs, cfg) == LFS_ERR_OK);
+  CHECK(lfs_file_open(&lfs, &file, "hello.txt", LFS_O_RDONLY) == LFS_ERR_OK);
+  memset(buf, 0, sizeof(buf));
+  CHECK(lfs_file_read(&lfs, &file, buf, sizeof(buf)) == (lfs_ssize_t)sizeof(content) - 1);
+  CHECK(strcmp(buf, content) == 0);
+  CHECK(lfs_file_close(&lfs, &file) == LFS_ERR_OK);
+  CHECK(lfs_unmount(&lfs) == LFS_ERR_OK);
+}
+
+static void
+test_new_image_is_created_erased(struct lfs_config *cfg)
+{
+  setenv("PICORUBY_LFS_BLOCK_COUNT", "16", 1);
+  littlefs_hal_init_config(cfg);
+  CHECK(lfs_host.storage != NULL);
+  CHECK(0 <= lfs_host.fd);
+  CHECK(cfg->block_count == 16);
+  CHECK(image_size() == 16 * LFS_RAM_BLOCK_SIZE);
+  bool erased = true;
+  for (size_t i = 0; i < lfs_host.size; i++) {
+    if (lfs_host.storage[i] != 0xff) erased = false;
+  }
+  CHECK(erased);
+  write_file(cfg);
+}
+
+static void
+test_file_survives_a_restart(struct lfs_config *cfg)
+{
+  restart();
+  /* An existing image keeps its size */
+  unsetenv("PICORUBY_LFS_BLOCK_COUNT");
+  littlefs_hal_init_config(cfg);
+  CHECK(cfg->block_count == 16);
+  CHECK(image_size() == 16 * LFS_RAM_BLOCK_SIZE);
+  check_file(cfg);
+}
+
+static void
+test_grown_image_keeps_the_volume(struct lfs_config *cfg)
+{
+  restart();
+  setenv("PICORUBY_LFS_BLOCK_COUNT", "32", 1);
+  littlefs_hal_init_config(cfg);
+  CHECK(cfg->block_count == 32);
+  CHECK(image_size() == 32 * LFS_RAM_BLOCK_SIZE);
+  bool erased = true;
+  for (size_t i = 16 * LFS_RAM_BLOCK_SIZE; i < lfs_host.size; i++) {
+    if (lfs_host.storage[i] != 0xff) erased = false;
+  }
+  CHECK(erased);
+  check_file(cfg);
+}
+
+int
+main(void)
+{
+  struct lfs_config cfg;
+  int fd = mkstemp(image);
+
+  if (fd < 0) {
+    perror(image);
+    return 1;
+  }
+  /* Start from no file at all */
+  close(fd);
+  unlink(image);
+  setenv("PICORUBY_LFS_IMAGE", image, 1);
+
+  test_new_image_is_created_erased(&cfg);
+  test_file_survives_a_restart(&cfg);
+  test_grown_image_keeps_the_volume(&cfg);
+  restart();
+  unlink(image);
+  if (failures) {
+    fprintf(stderr, "flash_hal_test: %d failure(s)\n", failures);
+    return 1;
+  }
+  printf("flash_hal_test: ok\n");
+  return 0;
+}
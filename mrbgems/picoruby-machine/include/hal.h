@@ -58,9 +58,26 @@ void picorb_hal_idle_cpu(mrb_state *mrb);
  * feeds. Registering from a different VM discards the previous VM's
  * entries, so a service that outlives an mrb_close (one registered from
  * a HAL init, say) is re-registered rather than duplicated.
+ *
+ * A service that only has work now and then should say so through
+ * picorb_scheduler_service_add_opts(): with period_us it runs at most
+ * once per period, and with a ready predicate only when the predicate
+ * returns true. The predicate is called on every pass, so it must be
+ * cheaper still -- a flag or counter check. A run longer than budget_us
+ * counts as an overrun and defers the next run by the excess.
  */
+#ifndef PICORB_SCHEDULER_SERVICE_MAX
 #define PICORB_SCHEDULER_SERVICE_MAX 4
+#endif
+typedef struct {
+  const char *name;     /* shown by Machine.scheduler_services */
+  uint32_t period_us;   /* 0: every pass */
+  uint32_t budget_us;   /* 0: unlimited */
+  bool (*ready)(mrb_state *mrb, void *ud); /* NULL: always ready */
+} picorb_scheduler_service_opts_t;
 void picorb_scheduler_service_add(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud), void *ud);
+void picorb_scheduler_service_add_opts(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud), void *ud,
+                                       const picorb_scheduler_service_opts_t *opts);
 void picorb_scheduler_service_remove(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud), void *ud);
 #endif
 
@@ -73,8 +90,18 @@ void picorb_hal_idle_cpu(void);
 /* Same contract as the mruby side above. mruby/c's hook is process-
  * global rather than per-VM, so there is no owner to track and the
  * callback takes no VM argument. */
+#ifndef PICORB_SCHEDULER_SERVICE_MAX
 #define PICORB_SCHEDULER_SERVICE_MAX 4
+#endif
+typedef struct {
+  const char *name;
+  uint32_t period_us;
+  uint32_t budget_us;
+  bool (*ready)(void *ud);
+} picorb_scheduler_service_opts_t;
 void picorb_scheduler_service_add(void (*fn)(void *ud), void *ud);
+void picorb_scheduler_service_add_opts(void (*fn)(void *ud), void *ud,
+                                       const picorb_scheduler_service_opts_t *opts);
 void picorb_scheduler_service_remove(void (*fn)(void *ud), void *ud);
 #endif
 
@@ -83,6 +110,48 @@ void picorb_scheduler_service_remove(void (*fn)(void *ud), void *ud);
 #endif
 #endif
 
+/*
+ * Per-service accounting behind Machine.scheduler_services. index runs
+ * from 0 until the call returns false; there are no entries when the VM
+ * has no scheduler hook.
+ */
+typedef struct {
+  const char *name;
+  uint32_t period_us;
+  uint32_t budget_us;
+  uint32_t runs;
+  uint32_t skips;       /* passes skipped by period or predicate */
+  uint32_t overruns;    /* runs longer than budget_us */
+  uint32_t max_us;
+  uint64_t total_us;
+} picorb_scheduler_service_stat_t;
+bool picorb_scheduler_service_stat(int index, picorb_scheduler_service_stat_t *stat);
+void picorb_scheduler_service_stat_reset(void);
+
+#if defined(PICORB_PLATFORM_POSIX)
+/*
+ * I/O reactor (ports/posix/reactor.c)
+ *
+ * fn is called with the ready PICORB_REACTOR_* bits when fd becomes ready,
+ * from a scheduler service while tasks run and from picorb_hal_idle_cpu()
+ * while none is runnable. When busy is given, the entry stays silent from
+ * one notification until the owner sets *busy back to false.
+ * picorb_reactor_wakeup() may be called from any thread.
+ */
+#define PICORB_REACTOR_READABLE 0x01
+#define PICORB_REACTOR_WRITABLE 0x02
+typedef void (*picorb_reactor_func)(void *ud, int events);
+bool picorb_reactor_add(int fd, int events, picorb_reactor_func fn, void *ud, const bool *busy);
+void picorb_reactor_remove(int fd);
+int picorb_reactor_wait(int timeout_ms);
+void picorb_reactor_wakeup(void);
+#if defined(PICORB_VM_MRUBY)
+void picorb_reactor_init(mrb_state *mrb);
+#else
+void picorb_reactor_init(void);
+#endif
+#endif
+
 int picorb_hal_write(int fd, const void *buf, int nbytes);
 bool picorb_hal_cdc_connected(uint8_t itf);
 int picorb_hal_cdc_write(uint8_t itf, const void *buf, int nbytes, uint32_t timeout_ms);
@@ -97,6 +97,12 @@ picorb_hal_init(void)
   tval.it_value.tv_sec     = sec;
   tval.it_value.tv_usec    = usec;
   setitimer(ITIMER_REAL, &tval, 0);
+
+#if defined(PICORB_VM_MRUBY)
+  picorb_reactor_init(mrb);
+#else
+  picorb_reactor_init();
+#endif
 #endif
 }
 
@@ -117,7 +123,13 @@ void picorb_hal_disable_irq(void)
 
 void
 picorb_hal_idle_cpu(void){
+#ifndef __EMSCRIPTEN__
+  /* Returns on the next tick (SIGALRM), or earlier when a watched fd
+     becomes ready */
+  picorb_reactor_wait(1000);
+#else
   sleep(1);
+#endif
 }
 #endif
 
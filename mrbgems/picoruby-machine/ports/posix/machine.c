@@ -140,8 +140,11 @@ stdin_reader(void *arg)
         struct timespec ts = {0, 1000000}; // 1ms
         nanosleep(&ts, NULL);
       }
+      /* Let an idle VM see the input now rather than at the next tick */
+      picorb_reactor_wakeup();
     } else if (n == 0) {
       stdin_eof = true; // real EOF (closed pipe / Ctrl-D at the OS layer)
+      picorb_reactor_wakeup();
       break;
     } else {
       if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
@@ -0,0 +1,303 @@
+/*
+ * I/O reactor for the POSIX port
+ *
+ * File descriptors that tasks wait on are registered here. The reactor is
+ * dispatched from a scheduler service while tasks run (without blocking)
+ * and from picorb_hal_idle_cpu() when none is runnable, where it parks the
+ * VM in epoll_wait() (poll() where epoll is unavailable). A readable fd
+ * therefore wakes the idle VM at once instead of at the next tick, and the
+ * SIGALRM tick still ends the wait so that sleeping tasks are resumed on
+ * time.
+ *
+ * The table is touched only from the VM thread. picorb_reactor_wakeup() is
+ * the exception: other threads (the stdin reader) use it to end a wait.
+ * Callbacks run inside the wait and must not add or remove entries.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../../include/hal.h"
+
+#if defined(__linux__)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
+
+typedef struct {
+  int fd;
+  int events;
+  picorb_reactor_func fn;
+  void *ud;
+  const bool *busy;
+  bool armed;
+} reactor_entry_t;
+
+static reactor_entry_t **entries_;
+static int entry_count_;
+static int entry_capa_;
+
+#ifdef USE_EPOLL
+static int epfd_ = -1;
+static int wake_fd_ = -1;
+#define REACTOR_MAX_EVENTS 16
+#else
+static int wake_pipe_[2] = {-1, -1};
+static struct pollfd *pollfds_;
+static reactor_entry_t **polled_;
+#endif
+
+static bool
+reactor_grow(void)
+{
+  int capa = entry_capa_ ? entry_capa_ * 2 : 8;
+  reactor_entry_t **entries = (reactor_entry_t **)realloc(entries_, sizeof(reactor_entry_t *) * capa);
+  if (!entries) return false;
+  entries_ = entries;
+#ifndef USE_EPOLL
+  /* One slot more for the wakeup pipe */
+  struct pollfd *pollfds = (struct pollfd *)realloc(pollfds_, sizeof(struct pollfd) * (capa + 1));
+  if (!pollfds) return false;
+  pollfds_ = pollfds;
+  reactor_entry_t **polled = (reactor_entry_t **)realloc(polled_, sizeof(reactor_entry_t *) * (capa + 1));
+  if (!polled) return false;
+  polled_ = polled;
+#endif
+  entry_capa_ = capa;
+  return true;
+}
+
+static bool
+reactor_open(void)
+{
+#ifdef USE_EPOLL
+  if (0 <= epfd_) return true;
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd_ < 0) return false;
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (0 <= wake_fd_) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; /* NULL marks the wakeup fd */
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+  }
+  return true;
+#else
+  if (0 <= wake_pipe_[0]) return true;
+  if (!reactor_grow() || pipe(wake_pipe_) < 0) return false;
+  for (int i = 0; i < 2; i++) {
+    fcntl(wake_pipe_[i], F_SETFL, fcntl(wake_pipe_[i], F_GETFL) | O_NONBLOCK);
+    fcntl(wake_pipe_[i], F_SETFD, FD_CLOEXEC);
+  }
+  return true;
+#endif
+}
+
+#ifdef USE_EPOLL
+static bool
+reactor_ctl(int op, reactor_entry_t *entry)
+{
+  struct epoll_event ev;
+  ev.events = 0;
+  if (entry->events & PICORB_REACTOR_READABLE) ev.events |= EPOLLIN;
+  if (entry->events & PICORB_REACTOR_WRITABLE) ev.events |= EPOLLOUT;
+  /* An entry with a busy flag reports once and stays quiet until the
+     owner has cleared the flag, so an fd nobody reads yet cannot keep
+     epoll_wait() returning */
+  if (entry->busy) ev.events |= EPOLLONESHOT;
+  ev.data.ptr = entry;
+  return epoll_ctl(epfd_, op, entry->fd, &ev) == 0;
+}
+#endif
+
+static void
+reactor_drain_wakeup(void)
+{
+#ifdef USE_EPOLL
+  uint64_t count;
+  while (read(wake_fd_, &count, sizeof(count)) == (ssize_t)sizeof(count)) ;
+#else
+  char buf[16];
+  while (0 < read(wake_pipe_[0], buf, sizeof(buf))) ;
+#endif
+}
+
+bool
+picorb_reactor_add(int fd, int events, picorb_reactor_func fn, void *ud, const bool *busy)
+{
+  reactor_entry_t *entry;
+
+  if (fd < 0 || fn == NULL || !reactor_open()) return false;
+  if (entry_count_ == entry_capa_ && !reactor_grow()) return false;
+  entry = (reactor_entry_t *)malloc(sizeof(reactor_entry_t));
+  if (!entry) return false;
+  entry->fd = fd;
+  entry->events = events;
+  entry->fn = fn;
+  entry->ud = ud;
+  entry->busy = busy;
+  entry->armed = true;
+#ifdef USE_EPOLL
+  if (!reactor_ctl(EPOLL_CTL_ADD, entry)) {
+    free(entry);
+    return false;
+  }
+#endif
+  entries_[entry_count_++] = entry;
+  return true;
+}
+
+void
+picorb_reactor_remove(int fd)
+{
+  for (int i = 0; i < entry_count_; i++) {
+    if (entries_[i]->fd == fd) {
+#ifdef USE_EPOLL
+      epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, NULL);
+#endif
+      free(entries_[i]);
+      entry_count_--;
+      entries_[i] = entries_[entry_count_];
+      return;
+    }
+  }
+}
+
+int
+picorb_reactor_wait(int timeout_ms)
+{
+  int dispatched = 0;
+
+  if (!reactor_open()) return 0;
+  /* Re-arm entries whose owner has taken the last notification */
+  for (int i = 0; i < entry_count_; i++) {
+    reactor_entry_t *entry = entries_[i];
+    if (!entry->armed && entry->busy && !*entry->busy) {
+#ifdef USE_EPOLL
+      if (!reactor_ctl(EPOLL_CTL_MOD, entry)) continue;
+#endif
+      entry->armed = true;
+    }
+  }
+
+#ifdef USE_EPOLL
+  struct epoll_event events[REACTOR_MAX_EVENTS];
+  int n = epoll_wait(epfd_, events, REACTOR_MAX_EVENTS, timeout_ms);
+  if (n <= 0) return 0; /* timeout, or EINTR from the tick */
+  for (int i = 0; i < n; i++) {
+    reactor_entry_t *entry = (reactor_entry_t *)events[i].data.ptr;
+    if (entry == NULL) {
+      reactor_drain_wakeup();
+      continue;
+    }
+    int ready = 0;
+    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ready |= PICORB_REACTOR_READABLE;
+    if (events[i].events & (EPOLLOUT | EPOLLERR)) ready |= PICORB_REACTOR_WRITABLE;
+    if (entry->busy) entry->armed = false;
+    entry->fn(entry->ud, ready);
+    dispatched++;
+  }
+#else
+  nfds_t n = 0;
+  pollfds_[n].fd = wake_pipe_[0];
+  pollfds_[n].events = POLLIN;
+  polled_[n++] = NULL;
+  for (int i = 0; i < entry_count_; i++) {
+    reactor_entry_t *entry = entries_[i];
+    if (!entry->armed) continue;
+    pollfds_[n].fd = entry->fd;
+    pollfds_[n].events = 0;
+    if (entry->events & PICORB_REACTOR_READABLE) pollfds_[n].events |= POLLIN;
+    if (entry->events & PICORB_REACTOR_WRITABLE) pollfds_[n].events |= POLLOUT;
+    polled_[n++] = entry;
+  }
+  if (poll(pollfds_, n, timeout_ms) <= 0) return 0;
+  for (nfds_t i = 0; i < n; i++) {
+    short revents = pollfds_[i].revents;
+    if (revents == 0) continue;
+    if (polled_[i] == NULL) {
+      reactor_drain_wakeup();
+      continue;
+    }
+    int ready = 0;
+    if (revents & (POLLIN | POLLHUP | POLLERR)) ready |= PICORB_REACTOR_READABLE;
+    if (revents & (POLLOUT | POLLERR)) ready |= PICORB_REACTOR_WRITABLE;
+    if (polled_[i]->busy) polled_[i]->armed = false;
+    polled_[i]->fn(polled_[i]->ud, ready);
+    dispatched++;
+  }
+#endif
+  return dispatched;
+}
+
+void
+picorb_reactor_wakeup(void)
+{
+#ifdef USE_EPOLL
+  uint64_t one = 1;
+  if (0 <= wake_fd_) (void)!write(wake_fd_, &one, sizeof(one));
+#else
+  if (0 <= wake_pipe_[1]) (void)!write(wake_pipe_[1], "", 1);
+#endif
+}
+
+#if defined(PICORB_VM_MRUBY) && defined(MRB_USE_TASK_SCHEDULER)
+static bool
+reactor_pending(mrb_state *mrb, void *ud)
+{
+  (void)mrb;
+  (void)ud;
+  return 0 < entry_count_;
+}
+
+static void
+reactor_service(mrb_state *mrb, void *ud)
+{
+  (void)mrb;
+  (void)ud;
+  picorb_reactor_wait(0);
+}
+#elif defined(PICORB_VM_MRUBYC) && defined(MRBC_TASK_SCHEDULER_HOOK)
+static bool
+reactor_pending(void *ud)
+{
+  (void)ud;
+  return 0 < entry_count_;
+}
+
+static void
+reactor_service(void *ud)
+{
+  (void)ud;
+  picorb_reactor_wait(0);
+}
+#endif
+
+#if defined(PICORB_VM_MRUBY)
+void
+picorb_reactor_init(mrb_state *mrb)
+{
+  reactor_open();
+#if defined(MRB_USE_TASK_SCHEDULER)
+  static const picorb_scheduler_service_opts_t opts = { "reactor", 0, 0, reactor_pending };
+  picorb_scheduler_service_add_opts(mrb, reactor_service, NULL, &opts);
+#else
+  (void)mrb;
+#endif
+}
+#else
+void
+picorb_reactor_init(void)
+{
+  reactor_open();
+#if defined(MRBC_TASK_SCHEDULER_HOOK)
+  static const picorb_scheduler_service_opts_t opts = { "reactor", 0, 0, reactor_pending };
+  picorb_scheduler_service_add_opts(reactor_service, NULL, &opts);
+#endif
+}
+#endif
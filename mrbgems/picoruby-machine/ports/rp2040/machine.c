@@ -283,18 +283,24 @@ usb_irq_handler(void)
 /* cyw43_arch POLL mode: cyw43_driver, lwIP and btstack share one
  * async_context that is only serviced from thread context. Pump it at
  * every scheduler entry so a compute-bound task or a long GC drain
- * cannot starve the network/BLE stack. Guarded by
- * cyw43_is_initialized() so this is a no-op until Wi-Fi/BLE has been
- * brought up. Must stay cheap and never sleep -- idling belongs to
+ * cannot starve the network/BLE stack. The cyw43_is_initialized()
+ * predicate keeps the dispatcher from calling it until Wi-Fi/BLE has
+ * been brought up. Must stay cheap and never sleep -- idling belongs to
  * picorb_hal_idle_cpu(). */
+static bool
+rp2_scheduler_service_ready(mrb_state *mrb, void *ud)
+{
+  (void)mrb;
+  (void)ud;
+  return cyw43_is_initialized(&cyw43_state);
+}
+
 static void
 rp2_scheduler_service(mrb_state *mrb, void *ud)
 {
   (void)mrb;
   (void)ud;
-  if (cyw43_is_initialized(&cyw43_state)) {
-    cyw43_arch_poll();
-  }
+  cyw43_arch_poll();
 }
 #endif
 
@@ -308,7 +314,12 @@ picorb_hal_init(void)
 #if defined(PICORB_VM_MRUBY)
   mrb_ = (mrb_state *)mrb;
 #if defined(PICO_CYW43_ARCH_POLL)
-  picorb_scheduler_service_add(mrb, rp2_scheduler_service, NULL);
+  {
+    static const picorb_scheduler_service_opts_t opts = {
+      "cyw43", 0, 0, rp2_scheduler_service_ready
+    };
+    picorb_scheduler_service_add_opts(mrb, rp2_scheduler_service, NULL, &opts);
+  }
 #endif
 #endif
   RingBuffer_init(stdin_rb, PICORB_STDIN_BUFFER_SIZE);
@@ -3,6 +3,7 @@
 #include "mruby/string.h"
 #include "mruby/presym.h"
 #include "mruby/array.h"
+#include "mruby/hash.h"
 #include "../../include/machine.h"
 #include "../../include/hal.h"
 #include "../../../picoruby-io-console/include/io-console.h"
@@ -234,6 +235,35 @@ mrb_s_uptime_formatted(mrb_state *mrb, mrb_value self)
 }
 
 
+static mrb_value
+mrb_s_scheduler_services(mrb_state *mrb, mrb_value klass)
+{
+  picorb_scheduler_service_stat_t stat;
+  mrb_value ary = mrb_ary_new(mrb);
+  int i = 0;
+
+  while (picorb_scheduler_service_stat(i++, &stat)) {
+    mrb_value hash = mrb_hash_new_capa(mrb, 8);
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(name)), mrb_str_new_cstr(mrb, stat.name));
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(period_us)), mrb_int_value(mrb, stat.period_us));
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(budget_us)), mrb_int_value(mrb, stat.budget_us));
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(runs)), mrb_int_value(mrb, stat.runs));
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(skips)), mrb_int_value(mrb, stat.skips));
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(overruns)), mrb_int_value(mrb, stat.overruns));
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(max_us)), mrb_int_value(mrb, stat.max_us));
+    mrb_hash_set(mrb, hash, mrb_symbol_value(MRB_SYM(total_us)), mrb_int_value(mrb, (mrb_int)stat.total_us));
+    mrb_ary_push(mrb, ary, hash);
+  }
+  return ary;
+}
+
+static mrb_value
+mrb_s_reset_scheduler_services(mrb_state *mrb, mrb_value klass)
+{
+  picorb_scheduler_service_stat_reset();
+  return mrb_nil_value();
+}
+
 static mrb_noreturn void
 raise_interrupt(mrb_state *mrb)
 {
@@ -523,6 +553,8 @@ mrb_picoruby_machine_gem_init(mrb_state* mrb)
   mrb_define_class_method_id(mrb, module_Machine, MRB_SYM(uptime_us), mrb_s_uptime_us, MRB_ARGS_NONE());
   mrb_define_class_method_id(mrb, module_Machine, MRB_SYM(board_millis), mrb_s_board_millis, MRB_ARGS_NONE());
   mrb_define_class_method_id(mrb, module_Machine, MRB_SYM(uptime_formatted), mrb_s_uptime_formatted, MRB_ARGS_NONE());
+  mrb_define_class_method_id(mrb, module_Machine, MRB_SYM(scheduler_services), mrb_s_scheduler_services, MRB_ARGS_NONE());
+  mrb_define_class_method_id(mrb, module_Machine, MRB_SYM(reset_scheduler_services), mrb_s_reset_scheduler_services, MRB_ARGS_NONE());
 
   mrb_define_class_method_id(mrb, module_Machine, MRB_SYM(exit), mrb_s_exit, MRB_ARGS_OPT(1));
   mrb_define_class_method_id(mrb, module_Machine, MRB_SYM(_reboot), mrb_s__reboot, MRB_ARGS_NONE());
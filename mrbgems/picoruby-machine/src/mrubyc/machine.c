@@ -256,6 +256,42 @@ c_Machine_board_millis(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_INT_RETURN((mrbc_uint_t)(Machine_uptime_us() / 1000));
 }
 
+static void
+scheduler_service_stat_set(mrbc_value *hash, const char *name, mrbc_value value)
+{
+  mrbc_value key = mrbc_symbol_value(mrbc_str_to_symid(name));
+  mrbc_hash_set(hash, &key, &value);
+}
+
+static void
+c_Machine_scheduler_services(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  picorb_scheduler_service_stat_t stat;
+  mrbc_value ary = mrbc_array_new(vm, 0);
+  int i = 0;
+
+  while (picorb_scheduler_service_stat(i++, &stat)) {
+    mrbc_value hash = mrbc_hash_new(vm, 8);
+    scheduler_service_stat_set(&hash, "name", mrbc_string_new_cstr(vm, stat.name));
+    scheduler_service_stat_set(&hash, "period_us", mrbc_integer_value(stat.period_us));
+    scheduler_service_stat_set(&hash, "budget_us", mrbc_integer_value(stat.budget_us));
+    scheduler_service_stat_set(&hash, "runs", mrbc_integer_value(stat.runs));
+    scheduler_service_stat_set(&hash, "skips", mrbc_integer_value(stat.skips));
+    scheduler_service_stat_set(&hash, "overruns", mrbc_integer_value(stat.overruns));
+    scheduler_service_stat_set(&hash, "max_us", mrbc_integer_value(stat.max_us));
+    scheduler_service_stat_set(&hash, "total_us", mrbc_integer_value((mrbc_int_t)stat.total_us));
+    mrbc_array_push(&ary, &hash);
+  }
+  SET_RETURN(ary);
+}
+
+static void
+c_Machine_reset_scheduler_services(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  picorb_scheduler_service_stat_reset();
+  SET_NIL_RETURN();
+}
+
 static void
 c_Machine_uptime_formatted(mrbc_vm *vm, mrbc_value *v, int argc)
 {
@@ -540,6 +576,8 @@ mrbc_machine_init(mrbc_vm *vm)
   mrbc_define_method(vm, module_Machine, "uptime_us", c_Machine_uptime_us);
   mrbc_define_method(vm, module_Machine, "board_millis", c_Machine_board_millis);
   mrbc_define_method(vm, module_Machine, "uptime_formatted", c_Machine_uptime_formatted);
+  mrbc_define_method(vm, module_Machine, "scheduler_services", c_Machine_scheduler_services);
+  mrbc_define_method(vm, module_Machine, "reset_scheduler_services", c_Machine_reset_scheduler_services);
 
   mrbc_define_method(vm, module_Machine, "exit", c_Machine_exit);
   mrbc_define_method(vm, module_Machine, "_reboot", c_Machine__reboot);
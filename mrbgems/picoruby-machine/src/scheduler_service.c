@@ -4,9 +4,91 @@
  * See the contract in include/hal.h. The table is plain static state
  * written only at gem init/final time and read only from the VM thread,
  * so it needs no locking.
+ *
+ * A pass does not call every service: one with a period runs at most
+ * once per period, and one with a ready predicate runs only when the
+ * predicate says there is work. Each run is timed, so that
+ * Machine.scheduler_services can tell which service eats the time.
  */
 
 #include "../include/hal.h"
+#include "../include/machine.h"
+
+#if (defined(PICORB_VM_MRUBY) && defined(MRB_USE_TASK_SCHEDULER)) || \
+    (defined(PICORB_VM_MRUBYC) && defined(MRBC_TASK_SCHEDULER_HOOK))
+#define SCHEDULER_HOOK_AVAILABLE
+#endif
+
+/* Accounting shared by both VMs */
+typedef struct {
+  const char *name;
+  uint32_t period_us;
+  uint32_t budget_us;
+  uint64_t next_us;    /* earliest time of the next run */
+  uint32_t runs;
+  uint32_t skips;
+  uint32_t overruns;
+  uint32_t max_us;
+  uint64_t total_us;
+} scheduler_service_stat_t;
+
+#if defined(SCHEDULER_HOOK_AVAILABLE)
+static void
+service_stat_init(scheduler_service_stat_t *stat, const picorb_scheduler_service_opts_t *opts)
+{
+  stat->name = (opts && opts->name) ? opts->name : "";
+  stat->period_us = opts ? opts->period_us : 0;
+  stat->budget_us = opts ? opts->budget_us : 0;
+  stat->next_us = 0;
+  stat->runs = 0;
+  stat->skips = 0;
+  stat->overruns = 0;
+  stat->max_us = 0;
+  stat->total_us = 0;
+}
+
+static void
+service_stat_account(scheduler_service_stat_t *stat, uint64_t start, uint64_t end)
+{
+  uint32_t elapsed = (uint32_t)(end - start);
+
+  stat->runs++;
+  stat->total_us += elapsed;
+  if (stat->max_us < elapsed) stat->max_us = elapsed;
+  if (stat->period_us) stat->next_us = start + stat->period_us;
+  if (stat->budget_us && stat->budget_us < elapsed) {
+    /* Pay back the excess before the next run, so a service that keeps
+       blowing its budget gets called less often instead of starving
+       the tasks. */
+    stat->overruns++;
+    if (stat->next_us < end) stat->next_us = end;
+    stat->next_us += elapsed - stat->budget_us;
+  }
+}
+#endif
+
+static void
+service_stat_copy(picorb_scheduler_service_stat_t *out, const scheduler_service_stat_t *stat)
+{
+  out->name = stat->name;
+  out->period_us = stat->period_us;
+  out->budget_us = stat->budget_us;
+  out->runs = stat->runs;
+  out->skips = stat->skips;
+  out->overruns = stat->overruns;
+  out->max_us = stat->max_us;
+  out->total_us = stat->total_us;
+}
+
+static void
+service_stat_reset(scheduler_service_stat_t *stat)
+{
+  stat->runs = 0;
+  stat->skips = 0;
+  stat->overruns = 0;
+  stat->max_us = 0;
+  stat->total_us = 0;
+}
 
 #if defined(PICORB_VM_MRUBY) && defined(MRB_USE_TASK_SCHEDULER)
 
@@ -16,6 +98,8 @@
 typedef struct {
   void (*fn)(mrb_state *mrb, void *ud);
   void *ud;
+  bool (*ready)(mrb_state *mrb, void *ud);
+  scheduler_service_stat_t stat;
 } scheduler_service_t;
 
 static scheduler_service_t services_[PICORB_SCHEDULER_SERVICE_MAX];
@@ -30,16 +114,26 @@ static void
 scheduler_dispatch(mrb_state *mrb, void *ud)
 {
   int i = 0;
+  uint64_t now = Machine_uptime_us();
 
   (void)ud;
   while (i < service_count_) {
-    services_[i].fn(mrb, services_[i].ud);
+    scheduler_service_t *svc = &services_[i];
+    if (now < svc->stat.next_us || (svc->ready && !svc->ready(mrb, svc->ud))) {
+      svc->stat.skips++;
+    } else {
+      uint64_t start = now;
+      svc->fn(mrb, svc->ud);
+      now = Machine_uptime_us();
+      service_stat_account(&svc->stat, start, now);
+    }
     i++;
   }
 }
 
 void
-picorb_scheduler_service_add(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud), void *ud)
+picorb_scheduler_service_add_opts(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud), void *ud,
+                                  const picorb_scheduler_service_opts_t *opts)
 {
   int i = 0;
 
@@ -59,10 +153,18 @@ picorb_scheduler_service_add(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud
   }
   services_[service_count_].fn = fn;
   services_[service_count_].ud = ud;
+  services_[service_count_].ready = opts ? opts->ready : NULL;
+  service_stat_init(&services_[service_count_].stat, opts);
   service_count_++;
   mrb_task_set_scheduler_hook(mrb, scheduler_dispatch, NULL);
 }
 
+void
+picorb_scheduler_service_add(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud), void *ud)
+{
+  picorb_scheduler_service_add_opts(mrb, fn, ud, NULL);
+}
+
 void
 picorb_scheduler_service_remove(mrb_state *mrb, void (*fn)(mrb_state *mrb, void *ud), void *ud)
 {
@@ -92,6 +194,8 @@ picorb_scheduler_service_remove(mrb_state *mrb, void (*fn)(mrb_state *mrb, void
 typedef struct {
   void (*fn)(void *ud);
   void *ud;
+  bool (*ready)(void *ud);
+  scheduler_service_stat_t stat;
 } scheduler_service_t;
 
 static scheduler_service_t services_[PICORB_SCHEDULER_SERVICE_MAX];
@@ -101,16 +205,26 @@ static void
 scheduler_dispatch(void *ud)
 {
   int i = 0;
+  uint64_t now = Machine_uptime_us();
 
   (void)ud;
   while (i < service_count_) {
-    services_[i].fn(services_[i].ud);
+    scheduler_service_t *svc = &services_[i];
+    if (now < svc->stat.next_us || (svc->ready && !svc->ready(svc->ud))) {
+      svc->stat.skips++;
+    } else {
+      uint64_t start = now;
+      svc->fn(svc->ud);
+      now = Machine_uptime_us();
+      service_stat_account(&svc->stat, start, now);
+    }
     i++;
   }
 }
 
 void
-picorb_scheduler_service_add(void (*fn)(void *ud), void *ud)
+picorb_scheduler_service_add_opts(void (*fn)(void *ud), void *ud,
+                                  const picorb_scheduler_service_opts_t *opts)
 {
   int i = 0;
 
@@ -127,10 +241,18 @@ picorb_scheduler_service_add(void (*fn)(void *ud), void *ud)
   }
   services_[service_count_].fn = fn;
   services_[service_count_].ud = ud;
+  services_[service_count_].ready = opts ? opts->ready : NULL;
+  service_stat_init(&services_[service_count_].stat, opts);
   service_count_++;
   mrbc_task_set_scheduler_hook(scheduler_dispatch, NULL);
 }
 
+void
+picorb_scheduler_service_add(void (*fn)(void *ud), void *ud)
+{
+  picorb_scheduler_service_add_opts(fn, ud, NULL);
+}
+
 void
 picorb_scheduler_service_remove(void (*fn)(void *ud), void *ud)
 {
@@ -151,4 +273,31 @@ picorb_scheduler_service_remove(void (*fn)(void *ud), void *ud)
   }
 }
 
+#else /* no scheduler hook */
+
+/* Nothing can be registered, but Machine.scheduler_services still
+   answers, with an empty list. */
+typedef struct {
+  scheduler_service_stat_t stat;
+} scheduler_service_t;
+
+static scheduler_service_t services_[1];
+static int service_count_;
+
 #endif /* scheduler hook available */
+
+bool
+picorb_scheduler_service_stat(int index, picorb_scheduler_service_stat_t *stat)
+{
+  if (index < 0 || service_count_ <= index || stat == NULL) return false;
+  service_stat_copy(stat, &services_[index].stat);
+  return true;
+}
+
+void
+picorb_scheduler_service_stat_reset(void)
+{
+  for (int i = 0; i < service_count_; i++) {
+    service_stat_reset(&services_[i].stat);
+  }
+}
@@ -123,4 +123,19 @@ class MachineTest < Picotest::Test
       Machine.sleep(deep: false, source: MachineTestFakePin.new(5), level: GPIO::EDGE_FALL)
     end
   end
+
+  # Registration, periods, ready predicates and overruns are covered by
+  # the host test in scheduler_service_test.c, which registers its own
+  # services. Here the services of the running VM are checked.
+  def test_scheduler_services_reports_each_service
+    Machine.reset_scheduler_services
+    services = Machine.scheduler_services
+    assert_equal Array, services.class
+    skip "no scheduler service is registered in this build" if services.empty?
+    services.each do |s|
+      assert_equal String, s[:name].class
+      assert_equal Integer, s[:runs].class
+      assert s[:max_us] <= s[:total_us]
+    end
+  end
 end
@@ -0,0 +1,152 @@
+/*
+ * Host test for the POSIX I/O reactor (ports/posix/reactor.c)
+ *
+ * Parks in picorb_reactor_wait() as picorb_hal_idle_cpu() does and checks
+ * that the wait ends on socket readiness, on the SIGALRM tick and on
+ * picorb_reactor_wakeup(), well before its 1000 ms timeout.
+ *
+ *   make -C test reactor
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../ports/posix/reactor.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+static long
+now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static int notified_events;
+static int notified_count;
+
+static void
+on_ready(void *ud, int events)
+{
+  (void)ud;
+  notified_events = events;
+  notified_count++;
+}
+
+static void *
+write_later(void *ptr)
+{
+  int fd = *(int *)ptr;
+  usleep(50 * 1000);
+  (void)!write(fd, "x", 1);
+  return NULL;
+}
+
+static void *
+wakeup_later(void *ptr)
+{
+  (void)ptr;
+  usleep(50 * 1000);
+  picorb_reactor_wakeup();
+  return NULL;
+}
+
+static void
+sig_alarm(int dummy)
+{
+  (void)dummy;
+}
+
+static void
+test_wakes_on_socket_readiness(void)
+{
+  int sv[2];
+  pthread_t tid;
+  bool busy = false;
+
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  CHECK(picorb_reactor_add(sv[0], PICORB_REACTOR_READABLE, on_ready, NULL, &busy));
+  notified_count = 0;
+  pthread_create(&tid, NULL, write_later, &sv[1]);
+
+  long start = now_ms();
+  CHECK(picorb_reactor_wait(1000) == 1);
+  CHECK(now_ms() - start < 500);
+  CHECK(notified_count == 1);
+  CHECK(notified_events & PICORB_REACTOR_READABLE);
+  pthread_join(tid, NULL);
+
+  /* Unread data does not end the wait again while the owner is busy */
+  busy = true;
+  CHECK(picorb_reactor_wait(20) == 0);
+  CHECK(notified_count == 1);
+  busy = false;
+  CHECK(picorb_reactor_wait(20) == 1);
+  CHECK(notified_count == 2);
+
+  picorb_reactor_remove(sv[0]);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+static void
+test_wakes_on_tick(void)
+{
+  struct sigaction sa;
+  struct itimerval tval;
+
+  /* Installed like picorb_hal_init(): SA_RESTART does not restart
+     epoll_wait() or poll() */
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sig_alarm;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGALRM, &sa, 0);
+  memset(&tval, 0, sizeof(tval));
+  tval.it_value.tv_usec = 20 * 1000;
+  setitimer(ITIMER_REAL, &tval, 0);
+
+  long start = now_ms();
+  CHECK(picorb_reactor_wait(1000) == 0);
+  CHECK(now_ms() - start < 500);
+}
+
+static void
+test_wakes_on_wakeup(void)
+{
+  pthread_t tid;
+
+  pthread_create(&tid, NULL, wakeup_later, NULL);
+  long start = now_ms();
+  CHECK(picorb_reactor_wait(1000) == 0);
+  CHECK(now_ms() - start < 500);
+  pthread_join(tid, NULL);
+}
+
+int
+main(void)
+{
+  test_wakes_on_socket_readiness();
+  test_wakes_on_tick();
+  test_wakes_on_wakeup();
+  if (failures) {
+    fprintf(stderr, "reactor_test: %d failure(s)\n", failures);
+    return 1;
+  }
+  printf("reactor_test: ok\n");
+  return 0;
+}
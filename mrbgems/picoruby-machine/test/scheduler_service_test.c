@@ -0,0 +1,224 @@
+/*
+ * Host test for the scheduler service multiplexer (src/scheduler_service.c)
+ *
+ * Registers its own services, drives scheduler passes by calling the hook
+ * the way mruby/c does, and fakes Machine_uptime_us() so that periods,
+ * budgets and overruns can be checked exactly.
+ *
+ *   make -C test scheduler_service
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/scheduler_service.c"
+
+static int failures;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+/* What the services see of the VM */
+
+static uint64_t now_us;
+static void (*hook_)(void *ud);
+static int printed;
+
+uint64_t
+Machine_uptime_us(void)
+{
+  return now_us;
+}
+
+void
+mrbc_task_set_scheduler_hook(void (*fn)(void *ud), void *ud)
+{
+  (void)ud;
+  hook_ = fn;
+}
+
+int
+mrbc_printf(const char *fstr, ...)
+{
+  (void)fstr;
+  printed++;
+  return 0;
+}
+
+static void
+pass_at(uint64_t t)
+{
+  now_us = t;
+  if (hook_) hook_(NULL);
+}
+
+/* Services. ud points at the microseconds one run takes. */
+
+static int runs_;
+
+static void
+busy_service(void *ud)
+{
+  runs_++;
+  now_us += *(uint32_t *)ud;
+}
+
+static void
+other_service(void *ud)
+{
+  (void)ud;
+}
+
+static bool ready_flag_;
+
+static bool
+flag_ready(void *ud)
+{
+  (void)ud;
+  return ready_flag_;
+}
+
+static picorb_scheduler_service_stat_t
+stat_of(const char *name)
+{
+  picorb_scheduler_service_stat_t stat;
+  int i = 0;
+
+  while (picorb_scheduler_service_stat(i++, &stat)) {
+    if (strcmp(stat.name, name) == 0) return stat;
+  }
+  memset(&stat, 0, sizeof(stat));
+  stat.name = NULL;
+  return stat;
+}
+
+static void
+test_registered_service_is_reported(void)
+{
+  static uint32_t cost = 10;
+  static const picorb_scheduler_service_opts_t opts = { "every", 0, 0, NULL };
+
+  picorb_scheduler_service_add_opts(busy_service, &cost, &opts);
+  /* The same fn and ud again is a no-op */
+  picorb_scheduler_service_add_opts(busy_service, &cost, &opts);
+  CHECK(hook_ != NULL);
+  CHECK(stat_of("every").name != NULL);
+  CHECK(!picorb_scheduler_service_stat(1, &(picorb_scheduler_service_stat_t){0}));
+
+  runs_ = 0;
+  pass_at(1000);
+  pass_at(2000);
+  picorb_scheduler_service_stat_t stat = stat_of("every");
+  CHECK(runs_ == 2);
+  CHECK(stat.runs == 2);
+  CHECK(stat.skips == 0);
+  CHECK(stat.max_us == 10);
+  CHECK(stat.total_us == 20);
+
+  picorb_scheduler_service_stat_reset();
+  stat = stat_of("every");
+  CHECK(stat.runs == 0 && stat.total_us == 0 && stat.max_us == 0);
+
+  picorb_scheduler_service_remove(busy_service, &cost);
+  CHECK(stat_of("every").name == NULL);
+  CHECK(hook_ == NULL);
+}
+
+static void
+test_period(void)
+{
+  static uint32_t cost = 0;
+  static const picorb_scheduler_service_opts_t opts = { "periodic", 1000, 0, NULL };
+
+  picorb_scheduler_service_add_opts(busy_service, &cost, &opts);
+  pass_at(10000);   /* runs, next at 11000 */
+  pass_at(10500);   /* skipped */
+  pass_at(10999);   /* skipped */
+  pass_at(11000);   /* runs */
+  picorb_scheduler_service_stat_t stat = stat_of("periodic");
+  CHECK(stat.period_us == 1000);
+  CHECK(stat.runs == 2);
+  CHECK(stat.skips == 2);
+  picorb_scheduler_service_remove(busy_service, &cost);
+}
+
+static void
+test_ready_predicate(void)
+{
+  static const picorb_scheduler_service_opts_t opts = { "on-demand", 0, 0, flag_ready };
+
+  picorb_scheduler_service_add_opts(other_service, NULL, &opts);
+  ready_flag_ = false;
+  pass_at(20000);
+  pass_at(20100);
+  ready_flag_ = true;
+  pass_at(20200);
+  picorb_scheduler_service_stat_t stat = stat_of("on-demand");
+  CHECK(stat.runs == 1);
+  CHECK(stat.skips == 2);
+  picorb_scheduler_service_remove(other_service, NULL);
+}
+
+static void
+test_overrun_defers_the_next_run(void)
+{
+  static uint32_t cost = 300;
+  static const picorb_scheduler_service_opts_t opts = { "slow", 0, 100, NULL };
+
+  picorb_scheduler_service_add_opts(busy_service, &cost, &opts);
+  pass_at(30000);   /* takes 300 us against a budget of 100 */
+  picorb_scheduler_service_stat_t stat = stat_of("slow");
+  CHECK(stat.runs == 1);
+  CHECK(stat.overruns == 1);
+  CHECK(stat.max_us == 300);
+  /* The excess of 200 us is paid back after the run ended at 30300 */
+  pass_at(30499);
+  CHECK(stat_of("slow").runs == 1);
+  pass_at(30500);
+  stat = stat_of("slow");
+  CHECK(stat.runs == 2);
+  CHECK(stat.skips == 1);
+  CHECK(stat.overruns == 2);
+  picorb_scheduler_service_remove(busy_service, &cost);
+}
+
+static void
+test_table_is_bounded(void)
+{
+  static uint32_t costs[PICORB_SCHEDULER_SERVICE_MAX + 1];
+
+  printed = 0;
+  for (int i = 0; i <= PICORB_SCHEDULER_SERVICE_MAX; i++) {
+    picorb_scheduler_service_add(busy_service, &costs[i]);
+  }
+  CHECK(printed == 1);
+  CHECK(picorb_scheduler_service_stat(PICORB_SCHEDULER_SERVICE_MAX - 1,
+                                      &(picorb_scheduler_service_stat_t){0}));
+  CHECK(!picorb_scheduler_service_stat(PICORB_SCHEDULER_SERVICE_MAX,
+                                       &(picorb_scheduler_service_stat_t){0}));
+  for (int i = 0; i <= PICORB_SCHEDULER_SERVICE_MAX; i++) {
+    picorb_scheduler_service_remove(busy_service, &costs[i]);
+  }
+  CHECK(hook_ == NULL);
+}
+
+int
+main(void)
+{
+  test_registered_service_is_reported();
+  test_period();
+  test_ready_predicate();
+  test_overrun_defers_the_next_run();
+  test_table_is_bounded();
+  if (failures) {
+    fprintf(stderr, "scheduler_service_test: %d failure(s)\n", failures);
+    return 1;
+  }
+  printf("scheduler_service_test: ok\n");
+  return 0;
+}
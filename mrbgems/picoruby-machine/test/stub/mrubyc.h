@@ -0,0 +1,8 @@
+/* Just enough of mrubyc.h for the host tests in this directory */
+#ifndef MRUBYC_STUB_H_
+#define MRUBYC_STUB_H_
+
+void mrbc_task_set_scheduler_hook(void (*fn)(void *ud), void *ud);
+int mrbc_printf(const char *fstr, ...);
+
+#endif
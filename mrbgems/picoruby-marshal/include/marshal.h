@@ -0,0 +1,140 @@
+#ifndef MARSHAL_DEFINED_H_
+#define MARSHAL_DEFINED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MARSHAL_MAJOR_VERSION 4
+#define MARSHAL_MINOR_VERSION 8
+
+/* Deepest nesting Marshal.dump and Marshal.load accept. Both recurse on
+ * the C stack. */
+#ifndef MARSHAL_MAX_DEPTH
+#define MARSHAL_MAX_DEPTH 64
+#endif
+
+/* Bytes Marshal.load asks an IO for at a time */
+#ifndef MARSHAL_READ_BUFFER_SIZE
+#define MARSHAL_READ_BUFFER_SIZE 256
+#endif
+
+/* Bytes Marshal.dump collects before each io.write */
+#ifndef MARSHAL_WRITE_BUFFER_SIZE
+#define MARSHAL_WRITE_BUFFER_SIZE 256
+#endif
+
+/* Longest "A::B" class path mruby/c writes */
+#ifndef MARSHAL_CLASS_PATH_MAX
+#define MARSHAL_CLASS_PATH_MAX 128
+#endif
+
+/* Integers in this range are written as 'i', others as 'l' (as CRuby) */
+#define MARSHAL_FIXNUM_MAX ((int64_t)0x3fffffff)
+#define MARSHAL_FIXNUM_MIN (-(int64_t)0x40000000)
+
+#define MARSHAL_TYPE_NIL        '0'
+#define MARSHAL_TYPE_TRUE       'T'
+#define MARSHAL_TYPE_FALSE      'F'
+#define MARSHAL_TYPE_FIXNUM     'i'
+#define MARSHAL_TYPE_EXTENDED   'e'
+#define MARSHAL_TYPE_UCLASS     'C'
+#define MARSHAL_TYPE_OBJECT     'o'
+#define MARSHAL_TYPE_DATA       'd'
+#define MARSHAL_TYPE_USERDEF    'u'
+#define MARSHAL_TYPE_USRMARSHAL 'U'
+#define MARSHAL_TYPE_FLOAT      'f'
+#define MARSHAL_TYPE_BIGNUM     'l'
+#define MARSHAL_TYPE_STRING     '"'
+#define MARSHAL_TYPE_REGEXP     '/'
+#define MARSHAL_TYPE_ARRAY      '['
+#define MARSHAL_TYPE_HASH       '{'
+#define MARSHAL_TYPE_HASH_DEF   '}'
+#define MARSHAL_TYPE_STRUCT     'S'
+#define MARSHAL_TYPE_MODULE_OLD 'M'
+#define MARSHAL_TYPE_CLASS      'c'
+#define MARSHAL_TYPE_MODULE     'm'
+#define MARSHAL_TYPE_SYMBOL     ':'
+#define MARSHAL_TYPE_SYMLINK    ';'
+#define MARSHAL_TYPE_IVAR       'I'
+#define MARSHAL_TYPE_LINK       '@'
+
+/*
+ * Writer. Output goes to out in pieces; the VM glue either collects
+ * them into a String or passes them on to io.write.
+ */
+typedef void (*marshal_out_func)(void *ctx, const uint8_t *buf, size_t len);
+
+typedef struct {
+  marshal_out_func out;
+  void *ctx;
+} marshal_writer_t;
+
+void Marshal_w_byte(marshal_writer_t *w, uint8_t c);
+/* Length or fixnum in the packed form of CRuby's w_long */
+void Marshal_w_long(marshal_writer_t *w, int32_t x);
+/* Length followed by the bytes */
+void Marshal_w_bytes(marshal_writer_t *w, const void *buf, size_t len);
+/* 'i' or 'l' with the value, whichever CRuby would write */
+void Marshal_w_integer(marshal_writer_t *w, int64_t n);
+/* Float text body (after 'f'), in CRuby's format so output matches */
+void Marshal_w_float(marshal_writer_t *w, double d);
+
+/*
+ * Reader. A String source is read in place: p/end cover it and fill is
+ * NULL. An IO source is copied into buf through fill, which returns
+ * the bytes it got (0 at the end).
+ *
+ * The reader never asks for more than the document still needs, so an
+ * IO can carry other data after the dump (dRuby sends messages back to
+ * back). pending counts bytes the rest of the document will take for
+ * sure; the glue adds to it with Marshal_r_expect() when it learns how
+ * many items follow, and takes one off with Marshal_r_item() as each
+ * starts.
+ */
+typedef size_t (*marshal_fill_func)(void *ctx, uint8_t *buf, size_t size);
+
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+  marshal_fill_func fill;
+  void *ctx;
+  uint8_t *buf;
+  size_t pending;
+  const char *error;
+} marshal_reader_t;
+
+void Marshal_reader_init(marshal_reader_t *r, const uint8_t *src, size_t len);
+void Marshal_reader_init_io(marshal_reader_t *r, uint8_t *buf, marshal_fill_func fill, void *ctx);
+bool Marshal_r_byte(marshal_reader_t *r, uint8_t *c);
+bool Marshal_r_long(marshal_reader_t *r, int32_t *x);
+/* Read len bytes into dst */
+bool Marshal_r_read(marshal_reader_t *r, void *dst, size_t len);
+/* Check "\x04\x08". error is "incompatible" on a version mismatch */
+bool Marshal_r_version(marshal_reader_t *r, uint8_t *major, uint8_t *minor);
+/* Body of 'l': fits tells whether *ival holds it; otherwise *fval does */
+bool Marshal_r_bignum(marshal_reader_t *r, int64_t *ival, double *fval, bool *fits);
+/* Body of 'f' */
+bool Marshal_r_float(marshal_reader_t *r, double *d);
+
+static inline void
+Marshal_r_expect(marshal_reader_t *r, size_t items)
+{
+  r->pending += items;
+}
+
+static inline void
+Marshal_r_item(marshal_reader_t *r)
+{
+  if (0 < r->pending) r->pending--;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MARSHAL_DEFINED_H_ */
@@ -1,4 +1,4 @@
-require 'pack'
+# Marshal.dump and Marshal.load are implemented in C (src/marshal.c).
 
 module Marshal
   MAJOR_VERSION = 4
@@ -9,302 +9,24 @@ module Marshal
   TYPE_TRUE      = 'T'
   TYPE_FALSE     = 'F'
   TYPE_FIXNUM    = 'i'
+  TYPE_BIGNUM    = 'l'
   TYPE_FLOAT     = 'f'
   TYPE_STRING    = '"'
   TYPE_SYMBOL    = ':'
+  TYPE_SYMLINK   = ';'
+  TYPE_LINK      = '@'
   TYPE_ARRAY     = '['
   TYPE_HASH      = '{'
   TYPE_IVAR      = 'I'
-
-  class << self
-    def dump(obj) # steep:ignore MethodArityMismatch
-      result = VERSION_STRING.dup
-      result << dump_object(obj)
-      result
-    end
-
-    def load(data) # steep:ignore MethodArityMismatch
-      # @type var data: String
-      raise ArgumentError, "marshal data too short" if data.bytesize < 2
-
-      major = data.getbyte(0) || 0
-      minor = data.getbyte(1) || 0
-
-      if major != MAJOR_VERSION || minor != MINOR_VERSION
-        raise TypeError, "incompatible marshal file format (can't be read)\n\tformat version #{major}.#{minor} required; #{MAJOR_VERSION}.#{MINOR_VERSION} given"
-      end
-
-      pos = 2
-      obj, pos = load_object(data, pos)
-      obj
-    end
-
-    private
-
-    def dump_object(obj)
-      case obj
-      when NilClass
-        TYPE_NIL
-      when TrueClass
-        TYPE_TRUE
-      when FalseClass
-        TYPE_FALSE
-      when Integer
-        # @type var obj: Integer
-        dump_integer(obj)
-      when Float
-        # @type var obj: Float
-        dump_float(obj)
-      when String
-        # @type var obj: String
-        dump_string(obj)
-      when Symbol
-        # @type var obj: Symbol
-        dump_symbol(obj)
-      when Array
-        dump_array(obj)
-      when Hash
-        dump_hash(obj)
-      else
-        raise ArgumentError, "can't dump #{obj.class}"
-      end
-    end
-
-    def dump_integer(n)
-      TYPE_FIXNUM + encode_fixnum(n)
-    end
-
-    def encode_fixnum(n)
-      if n == 0
-        "\x00"
-      elsif n > 0
-        if n < 123
-          [n + 5].pack('C')
-        elsif n < 256
-          "\x01" + [n].pack('C')
-        elsif n < 65536
-          "\x02" + [n].pack('v')
-        elsif n < 16777216
-          "\x03" + [n & 0xFF, (n >> 8) & 0xFF, (n >> 16) & 0xFF].pack('CCC')
-        else
-          "\x04" + [n].pack('V')
-        end
-      else
-        # Negative numbers
-        if n >= -123
-          [n - 5].pack('c')
-        elsif n >= -256
-          "\xFF" + [n].pack('c')
-        elsif n >= -65536
-          "\xFE" + [n].pack('v')
-        elsif n >= -16777216
-          "\xFD" + [n & 0xFF, (n >> 8) & 0xFF, (n >> 16) & 0xFF].pack('CCC')
-        else
-          "\xFC" + [n].pack('V')
-        end
-      end
-    end
-
-    def dump_float(f)
-      str = f.to_s
-      TYPE_FLOAT + encode_fixnum(str.size) + str
-    end
-
-    def dump_string(s)
-      TYPE_STRING + encode_fixnum(s.bytesize) + s
-    end
-
-    def dump_symbol(sym)
-      name = sym.to_s
-      TYPE_SYMBOL + encode_fixnum(name.bytesize) + name
-    end
-
-    def dump_array(ary)
-      result = TYPE_ARRAY + encode_fixnum(ary.size)
-      i = 0
-      while i < ary.size
-        result << dump_object(ary[i])
-        i += 1
-      end
-      result
-    end
-
-    def dump_hash(hash)
-      result = TYPE_HASH + encode_fixnum(hash.size)
-      keys = hash.keys
-      i = 0
-      while i < keys.size
-        key = keys[i]
-        result << dump_object(key)
-        result << dump_object(hash[key])
-        i += 1
-      end
-      result
-    end
-
-    def load_object(data, pos)
-      raise ArgumentError, "marshal data too short" if pos >= data.bytesize
-
-      type = [(data.getbyte(pos) || 0)].pack("C")
-      pos += 1
-
-      case type
-      when TYPE_NIL
-        [nil, pos]
-      when TYPE_TRUE
-        [true, pos]
-      when TYPE_FALSE
-        [false, pos]
-      when TYPE_FIXNUM
-        load_integer(data, pos)
-      when TYPE_FLOAT
-        load_float(data, pos)
-      when TYPE_STRING
-        load_string(data, pos)
-      when TYPE_SYMBOL
-        load_symbol(data, pos)
-      when TYPE_ARRAY
-        load_array(data, pos)
-      when TYPE_HASH
-        load_hash(data, pos)
-      when TYPE_IVAR
-        load_ivar(data, pos)
-      else
-        raise ArgumentError, "unsupported type: #{(type.getbyte(0) || 0).to_s(16)}"
-      end
-    end
-
-    def load_integer(data, pos)
-      n, pos = decode_fixnum(data, pos)
-      [n, pos]
-    end
-
-    def decode_fixnum(data, pos)
-      raise ArgumentError, "marshal data too short" if pos >= data.bytesize
-
-      c = data.getbyte(pos) || 0
-      pos += 1
-
-      if c == 0
-        return [0, pos]
-      elsif c > 5 && c < 128
-        return [c - 5, pos]
-      elsif c >= 128 && c < 251
-        return [c - 251, pos]
-      elsif c == 1
-        raise ArgumentError, "marshal data too short" if pos >= data.bytesize
-        n = data.getbyte(pos) || 0
-        return [n, pos + 1]
-      elsif c == 2
-        raise ArgumentError, "marshal data too short" if pos + 1 >= data.bytesize
-        n = (data.getbyte(pos) || 0) | ((data.getbyte(pos + 1) || 0) << 8)
-        return [n, pos + 2]
-      elsif c == 3
-        raise ArgumentError, "marshal data too short" if pos + 2 >= data.bytesize
-        n = (data.getbyte(pos) || 0) |
-            ((data.getbyte(pos + 1) || 0) << 8) |
-            ((data.getbyte(pos + 2) || 0) << 16)
-        return [n, pos + 3]
-      elsif c == 4
-        raise ArgumentError, "marshal data too short" if pos + 3 >= data.bytesize
-        n = (data.getbyte(pos) || 0) |
-            ((data.getbyte(pos + 1) || 0) << 8) |
-            ((data.getbyte(pos + 2) || 0) << 16) |
-            ((data.getbyte(pos + 3) || 0) << 24)
-        return [n, pos + 4]
-      elsif c == 255
-        raise ArgumentError, "marshal data too short" if pos >= data.bytesize
-        n = data.getbyte(pos) || 0
-        n -= 256 if n > 127
-        return [n, pos + 1]
-      elsif c == 254
-        raise ArgumentError, "marshal data too short" if pos + 1 >= data.bytesize
-        n = (data.getbyte(pos) || 0) | ((data.getbyte(pos + 1) || 0) << 8)
-        n -= 65536 if n > 32767
-        return [n, pos + 2]
-      elsif c == 253
-        raise ArgumentError, "marshal data too short" if pos + 2 >= data.bytesize
-        n = (data.getbyte(pos) || 0) |
-            ((data.getbyte(pos + 1) || 0) << 8) |
-            ((data.getbyte(pos + 2) || 0) << 16)
-        n -= 16777216 if n > 8388607
-        return [n, pos + 3]
-      elsif c == 252
-        raise ArgumentError, "marshal data too short" if pos + 3 >= data.bytesize
-        n = (data.getbyte(pos) || 0) |
-            ((data.getbyte(pos + 1) || 0) << 8) |
-            ((data.getbyte(pos + 2) || 0) << 16) |
-            ((data.getbyte(pos + 3) || 0) << 24)
-        n -= 4294967296 if n > 2147483647
-        return [n, pos + 4]
-      else
-        raise ArgumentError, "unknown fixnum encoding: #{c.to_s(16)}"
-      end
-    end
-
-    def load_float(data, pos)
-      len, pos = decode_fixnum(data, pos)
-      raise ArgumentError, "marshal data too short" if pos + len > data.size
-      str = data[pos, len]
-      raise ArgumentError, "marshal data too short" if str.nil?
-      [str.to_f, pos + len]
-    end
-
-    def load_string(data, pos)
-      len, pos = decode_fixnum(data, pos)
-      raise ArgumentError, "marshal data too short" if pos + len > data.bytesize
-      [data.byteslice(pos, len) || "", pos + len]
-    end
-
-    def load_symbol(data, pos)
-      len, pos = decode_fixnum(data, pos)
-      raise ArgumentError, "marshal data too short" if pos + len > data.bytesize
-      [(data.byteslice(pos, len) || "").to_sym, pos + len]
-    end
-
-    def load_array(data, pos)
-      len, pos = decode_fixnum(data, pos)
-      ary = [] #: Array[untyped]
-      i = 0
-      while i < len
-        elem, pos = load_object(data, pos)
-        ary << elem
-        i += 1
-      end
-      [ary, pos]
-    end
-
-    def load_hash(data, pos)
-      len, pos = decode_fixnum(data, pos)
-      hash = {} #: Hash[untyped, untyped]
-      i = 0
-      while i < len
-        key, pos = load_object(data, pos)
-        value, pos = load_object(data, pos)
-        hash[key] = value
-        i += 1
-      end
-      [hash, pos]
-    end
-
-    def load_ivar(data, pos)
-      # Load the object with instance variables
-      obj, pos = load_object(data, pos)
-
-      # Load number of instance variables
-      num_ivars, pos = decode_fixnum(data, pos)
-
-      # Skip instance variables (we just return the base object)
-      i = 0
-      while i < num_ivars
-        # Skip ivar name (symbol)
-        _, pos = load_object(data, pos)
-        # Skip ivar value
-        _, pos = load_object(data, pos)
-        i += 1
-      end
-
-      [obj, pos]
-    end
+  TYPE_OBJECT    = 'o'
+  TYPE_STRUCT    = 'S'
+  TYPE_USERDEF   = 'u'
+  TYPE_USRMARSHAL = 'U'
+  TYPE_CLASS     = 'c'
+  TYPE_MODULE    = 'm'
+
+  # Called from the mruby/c loader, which cannot splat arguments
+  def self._struct_new(klass, values)
+    klass.new(*values)
   end
 end
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../include/marshal.h"
+
+/*
+ * Writer
+ */
+
+void
+Marshal_w_byte(marshal_writer_t *w, uint8_t c)
+{
+  w->out(w->ctx, &c, 1);
+}
+
+void
+Marshal_w_long(marshal_writer_t *w, int32_t x)
+{
+  uint8_t buf[5];
+  int i;
+
+  if (x == 0) {
+    Marshal_w_byte(w, 0);
+    return;
+  }
+  if (0 < x && x < 123) {
+    Marshal_w_byte(w, (uint8_t)(x + 5));
+    return;
+  }
+  if (-124 < x && x < 0) {
+    Marshal_w_byte(w, (uint8_t)((x - 5) & 0xff));
+    return;
+  }
+  for (i = 1; i < (int)sizeof(buf); i++) {
+    buf[i] = (uint8_t)(x & 0xff);
+    x >>= 8; /* arithmetic: negative numbers end at -1 */
+    if (x == 0) {
+      buf[0] = (uint8_t)i;
+      break;
+    }
+    if (x == -1) {
+      buf[0] = (uint8_t)-i;
+      break;
+    }
+  }
+  w->out(w->ctx, buf, i + 1);
+}
+
+void
+Marshal_w_bytes(marshal_writer_t *w, const void *buf, size_t len)
+{
+  Marshal_w_long(w, (int32_t)len);
+  if (0 < len) w->out(w->ctx, (const uint8_t *)buf, len);
+}
+
+void
+Marshal_w_integer(marshal_writer_t *w, int64_t n)
+{
+  uint8_t buf[8];
+  uint64_t u;
+  int len = 0;
+
+  if (MARSHAL_FIXNUM_MIN <= n && n <= MARSHAL_FIXNUM_MAX) {
+    Marshal_w_byte(w, MARSHAL_TYPE_FIXNUM);
+    Marshal_w_long(w, (int32_t)n);
+    return;
+  }
+  /* Sign and magnitude in 16-bit words, least significant first */
+  Marshal_w_byte(w, MARSHAL_TYPE_BIGNUM);
+  Marshal_w_byte(w, n < 0 ? '-' : '+');
+  u = n < 0 ? (uint64_t)(-(n + 1)) + 1 : (uint64_t)n;
+  while (u) {
+    buf[len++] = (uint8_t)(u & 0xff);
+    u >>= 8;
+  }
+  if (len & 1) buf[len++] = 0;
+  Marshal_w_long(w, len / 2);
+  w->out(w->ctx, buf, len);
+}
+
+void
+Marshal_w_float(marshal_writer_t *w, double d)
+{
+  char buf[40];
+  char digits[20];
+  int len = 0;
+
+  if (isinf(d)) {
+    Marshal_w_bytes(w, d < 0 ? "-inf" : "inf", d < 0 ? 4 : 3);
+    return;
+  }
+  if (isnan(d)) {
+    Marshal_w_bytes(w, "nan", 3);
+    return;
+  }
+  if (d == 0.0) {
+    Marshal_w_bytes(w, signbit(d) ? "-0" : "0", signbit(d) ? 2 : 1);
+    return;
+  }
+
+  /* Shortest digits that read back as the same double, as ruby_dtoa
+     mode 0 gives them */
+  char sci[32];
+  int prec;
+  for (prec = 1; prec < 17; prec++) {
+    snprintf(sci, sizeof(sci), "%.*e", prec - 1, fabs(d));
+    if (strtod(sci, NULL) == fabs(d)) break;
+  }
+  if (prec == 17) snprintf(sci, sizeof(sci), "%.16e", fabs(d));
+  int digs = 0;
+  char *p = sci;
+  while (*p && *p != 'e') {
+    if (*p != '.') digits[digs++] = *p;
+    p++;
+  }
+  while (1 < digs && digits[digs - 1] == '0') digs--;
+  int decpt = atoi(p + 1) + 1;
+
+  /* Same layout as w_float in CRuby's marshal.c */
+  if (d < 0) buf[len++] = '-';
+  if (decpt < -3 || digs < decpt) {
+    buf[len++] = digits[0];
+    if (1 < digs) {
+      buf[len++] = '.';
+      memcpy(buf + len, digits + 1, digs - 1);
+      len += digs - 1;
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "e%d", decpt - 1);
+  } else if (0 < decpt) {
+    memcpy(buf + len, digits, decpt);
+    len += decpt;
+    if (decpt < digs) {
+      buf[len++] = '.';
+      memcpy(buf + len, digits + decpt, digs - decpt);
+      len += digs - decpt;
+    }
+  } else {
+    buf[len++] = '0';
+    buf[len++] = '.';
+    memset(buf + len, '0', -decpt);
+    len -= decpt;
+    memcpy(buf + len, digits, digs);
+    len += digs;
+  }
+  Marshal_w_bytes(w, buf, len);
+}
+
+/*
+ * Reader
+ */
+
+void
+Marshal_reader_init(marshal_reader_t *r, const uint8_t *src, size_t len)
+{
+  r->p = src;
+  r->end = src + len;
+  r->fill = NULL;
+  r->ctx = NULL;
+  r->buf = NULL;
+  r->pending = 0;
+  r->error = NULL;
+}
+
+void
+Marshal_reader_init_io(marshal_reader_t *r, uint8_t *buf, marshal_fill_func fill, void *ctx)
+{
+  r->p = buf;
+  r->end = buf;
+  r->fill = fill;
+  r->ctx = ctx;
+  r->buf = buf;
+  r->pending = 0;
+  r->error = NULL;
+}
+
+/* Make at least one byte available, asking for no more than need plus
+   what is sure to follow */
+static bool
+reader_fill(marshal_reader_t *r, size_t need)
+{
+  if (r->error) return false;
+  if (r->fill) {
+    size_t want = need + r->pending;
+    if (want < need || MARSHAL_READ_BUFFER_SIZE < want) want = MARSHAL_READ_BUFFER_SIZE;
+    size_t got = r->fill(r->ctx, r->buf, want);
+    if (0 < got) {
+      r->p = r->buf;
+      r->end = r->buf + got;
+      return true;
+    }
+  }
+  r->error = "marshal data too short";
+  return false;
+}
+
+bool
+Marshal_r_byte(marshal_reader_t *r, uint8_t *c)
+{
+  if (r->end <= r->p && !reader_fill(r, 1)) return false;
+  *c = *r->p++;
+  return true;
+}
+
+bool
+Marshal_r_read(marshal_reader_t *r, void *dst, size_t len)
+{
+  uint8_t *d = (uint8_t *)dst;
+
+  while (0 < len) {
+    if (r->end <= r->p && !reader_fill(r, len)) return false;
+    size_t n = (size_t)(r->end - r->p);
+    if (len < n) n = len;
+    if (d) {
+      memcpy(d, r->p, n);
+      d += n;
+    }
+    r->p += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool
+Marshal_r_long(marshal_reader_t *r, int32_t *x)
+{
+  uint8_t b;
+  int c, i;
+
+  if (!Marshal_r_byte(r, &b)) return false;
+  c = (int8_t)b;
+  if (c == 0) {
+    *x = 0;
+    return true;
+  }
+  if (0 < c) {
+    if (4 < c) {
+      *x = c - 5;
+      return true;
+    }
+    uint32_t v = 0;
+    for (i = 0; i < c; i++) {
+      if (!Marshal_r_byte(r, &b)) return false;
+      v |= (uint32_t)b << (8 * i);
+    }
+    *x = (int32_t)v;
+    return true;
+  }
+  if (c < -4) {
+    *x = c + 5;
+    return true;
+  }
+  c = -c;
+  uint32_t v = 0xffffffff;
+  for (i = 0; i < c; i++) {
+    if (!Marshal_r_byte(r, &b)) return false;
+    v &= ~((uint32_t)0xff << (8 * i));
+    v |= (uint32_t)b << (8 * i);
+  }
+  *x = (int32_t)v;
+  return true;
+}
+
+bool
+Marshal_r_version(marshal_reader_t *r, uint8_t *major, uint8_t *minor)
+{
+  if (!Marshal_r_byte(r, major) || !Marshal_r_byte(r, minor)) return false;
+  if (*major != MARSHAL_MAJOR_VERSION || MARSHAL_MINOR_VERSION < *minor) {
+    r->error = "incompatible";
+    return false;
+  }
+  return true;
+}
+
+bool
+Marshal_r_bignum(marshal_reader_t *r, int64_t *ival, double *fval, bool *fits)
+{
+  uint8_t sign, b;
+  int32_t words;
+  uint64_t u = 0;
+  double f = 0.0;
+  bool big = false;
+
+  if (!Marshal_r_byte(r, &sign) || !Marshal_r_long(r, &words)) return false;
+  if (words < 0) {
+    r->error = "dump format error (bignum)";
+    return false;
+  }
+  for (int32_t i = 0; i < words * 2; i++) {
+    if (!Marshal_r_byte(r, &b)) return false;
+    if (i < 8) u |= (uint64_t)b << (8 * i);
+    else if (b) big = true;
+    f += ldexp((double)b, 8 * i);
+  }
+  if (sign == '-') {
+    *fits = !big && u <= (uint64_t)INT64_MAX + 1;
+    if (*fits) *ival = (u == (uint64_t)INT64_MAX + 1) ? INT64_MIN : -(int64_t)u;
+    *fval = -f;
+  } else {
+    *fits = !big && u <= (uint64_t)INT64_MAX;
+    if (*fits) *ival = (int64_t)u;
+    *fval = f;
+  }
+  return true;
+}
+
+bool
+Marshal_r_float(marshal_reader_t *r, double *d)
+{
+  char buf[64];
+  int32_t len;
+
+  if (!Marshal_r_long(r, &len)) return false;
+  if (len < 0) {
+    r->error = "dump format error (float)";
+    return false;
+  }
+  /* Old versions append mantissa bytes after a NUL; strtod stops there */
+  size_t n = (size_t)len < sizeof(buf) - 1 ? (size_t)len : sizeof(buf) - 1;
+  if (!Marshal_r_read(r, buf, n) || !Marshal_r_read(r, NULL, len - n)) return false;
+  buf[n] = '\0';
+  if (strcmp(buf, "nan") == 0) {
+    *d = NAN;
+  } else if (strcmp(buf, "inf") == 0) {
+    *d = INFINITY;
+  } else if (strcmp(buf, "-inf") == 0) {
+    *d = -INFINITY;
+  } else {
+    *d = strtod(buf, NULL);
+  }
+  return true;
+}
+
+#if defined(PICORB_VM_MRUBY)
+
+#include "mruby/marshal.c"
+
+#elif defined(PICORB_VM_MRUBYC)
+
+#include "mrubyc/marshal.c"
+
+#endif
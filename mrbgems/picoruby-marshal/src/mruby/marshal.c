@@ -0,0 +1,714 @@
+#include "mruby.h"
+#include "mruby/presym.h"
+#include "mruby/string.h"
+#include "mruby/array.h"
+#include "mruby/hash.h"
+#include "mruby/class.h"
+#include "mruby/variable.h"
+
+/*
+ * Dump
+ *
+ * objects maps the address of every object written so far to its index,
+ * so that a second reference becomes a '@' link; list holds the objects
+ * themselves in that order (nil for floats and bignums, which are
+ * counted but never linked, as in CRuby).
+ */
+
+typedef struct {
+  mrb_state *mrb;
+  marshal_writer_t w;
+  mrb_value out;
+  mrb_value io;
+  uint8_t *buf;       /* with io: pending output */
+  size_t len;
+  mrb_value objects;  /* Hash: address -> index */
+  mrb_value list;     /* Array: index -> object */
+  mrb_value symbols;  /* Hash: Symbol -> index */
+  int depth;
+} marshal_dump_t;
+
+static void
+marshal_flush(marshal_dump_t *d)
+{
+  if (d->len == 0) return;
+  int ai = mrb_gc_arena_save(d->mrb);
+  mrb_value chunk = mrb_str_new(d->mrb, (const char *)d->buf, d->len);
+  d->len = 0;
+  mrb_funcall_id(d->mrb, d->io, MRB_SYM(write), 1, chunk);
+  mrb_gc_arena_restore(d->mrb, ai);
+}
+
+static void
+marshal_out(void *ctx, const uint8_t *buf, size_t len)
+{
+  marshal_dump_t *d = (marshal_dump_t *)ctx;
+
+  if (!d->buf) {
+    mrb_str_cat(d->mrb, d->out, (const char *)buf, len);
+    return;
+  }
+  while (0 < len) {
+    size_t n = MARSHAL_WRITE_BUFFER_SIZE - d->len;
+    if (len < n) n = len;
+    memcpy(d->buf + d->len, buf, n);
+    d->len += n;
+    buf += n;
+    len -= n;
+    if (d->len == MARSHAL_WRITE_BUFFER_SIZE) marshal_flush(d);
+  }
+}
+
+static mrb_value
+marshal_address(marshal_dump_t *d, mrb_value obj)
+{
+  return mrb_int_value(d->mrb, (mrb_int)(intptr_t)mrb_ptr(obj));
+}
+
+/* Write a link and return true if obj was written before */
+static bool
+marshal_w_link(marshal_dump_t *d, mrb_value obj)
+{
+  mrb_value index = mrb_hash_fetch(d->mrb, d->objects, marshal_address(d, obj), mrb_nil_value());
+
+  if (mrb_nil_p(index)) return false;
+  /* The key is the address cut down to mrb_int; make sure it really is
+     the same object */
+  if (mrb_ptr(mrb_ary_ref(d->mrb, d->list, mrb_integer(index))) != mrb_ptr(obj)) return false;
+  Marshal_w_byte(&d->w, MARSHAL_TYPE_LINK);
+  Marshal_w_long(&d->w, (int32_t)mrb_integer(index));
+  return true;
+}
+
+static void
+marshal_remember(marshal_dump_t *d, mrb_value obj)
+{
+  mrb_int index = RARRAY_LEN(d->list);
+
+  if (mrb_nil_p(obj)) {
+    mrb_ary_push(d->mrb, d->list, obj);
+    return;
+  }
+  mrb_hash_set(d->mrb, d->objects, marshal_address(d, obj), mrb_int_value(d->mrb, index));
+  mrb_ary_push(d->mrb, d->list, obj);
+}
+
+static void
+marshal_w_symbol(marshal_dump_t *d, mrb_sym sym)
+{
+  mrb_state *mrb = d->mrb;
+  mrb_value key = mrb_symbol_value(sym);
+  mrb_value index = mrb_hash_fetch(mrb, d->symbols, key, mrb_nil_value());
+  mrb_int len;
+  const char *name;
+  bool ascii = true;
+
+  if (!mrb_nil_p(index)) {
+    Marshal_w_byte(&d->w, MARSHAL_TYPE_SYMLINK);
+    Marshal_w_long(&d->w, (int32_t)mrb_integer(index));
+    return;
+  }
+  name = mrb_sym_name_len(mrb, sym, &len);
+  for (mrb_int i = 0; i < len; i++) {
+    if (name[i] & 0x80) ascii = false;
+  }
+  if (!ascii) Marshal_w_byte(&d->w, MARSHAL_TYPE_IVAR);
+  Marshal_w_byte(&d->w, MARSHAL_TYPE_SYMBOL);
+  Marshal_w_bytes(&d->w, name, len);
+  mrb_hash_set(mrb, d->symbols, key, mrb_int_value(mrb, mrb_hash_size(mrb, d->symbols)));
+  if (!ascii) {
+    /* One ivar, E: true (UTF-8), as CRuby writes non-ASCII symbols */
+    Marshal_w_long(&d->w, 1);
+    marshal_w_symbol(d, MRB_SYM(E));
+    Marshal_w_byte(&d->w, MARSHAL_TYPE_TRUE);
+  }
+}
+
+static void
+marshal_w_class(marshal_dump_t *d, uint8_t type, struct RClass *cls)
+{
+  mrb_value path = mrb_class_path(d->mrb, cls);
+
+  if (mrb_nil_p(path)) {
+    mrb_raise(d->mrb, E_TYPE_ERROR, "can't dump anonymous class");
+  }
+  Marshal_w_byte(&d->w, type);
+  marshal_w_symbol(d, mrb_intern_str(d->mrb, path));
+}
+
+static void marshal_w_object(marshal_dump_t *d, mrb_value obj);
+
+static int
+marshal_w_pair(mrb_state *mrb, mrb_value key, mrb_value val, void *data)
+{
+  marshal_dump_t *d = (marshal_dump_t *)data;
+
+  marshal_w_object(d, key);
+  marshal_w_object(d, val);
+  return 0;
+}
+
+static void
+marshal_w_struct(marshal_dump_t *d, mrb_value obj)
+{
+  mrb_state *mrb = d->mrb;
+  mrb_value members = mrb_funcall_id(mrb, obj, MRB_SYM(members), 0);
+  mrb_value values = mrb_funcall_id(mrb, obj, MRB_SYM(to_h), 0);
+
+  if (!mrb_array_p(members) || !mrb_hash_p(values)) {
+    mrb_raisef(mrb, E_TYPE_ERROR, "can't dump %C", mrb_obj_class(mrb, obj));
+  }
+  marshal_w_class(d, MARSHAL_TYPE_STRUCT, mrb_obj_class(mrb, obj));
+  Marshal_w_long(&d->w, (int32_t)RARRAY_LEN(members));
+  for (mrb_int i = 0; i < RARRAY_LEN(members); i++) {
+    mrb_value member = RARRAY_PTR(members)[i];
+    marshal_w_symbol(d, mrb_obj_to_sym(mrb, member));
+    marshal_w_object(d, mrb_hash_get(mrb, values, member));
+  }
+}
+
+static void
+marshal_w_ivars(marshal_dump_t *d, mrb_value obj)
+{
+  mrb_state *mrb = d->mrb;
+  mrb_value names = mrb_funcall_id(mrb, obj, MRB_SYM(instance_variables), 0);
+
+  Marshal_w_long(&d->w, (int32_t)RARRAY_LEN(names));
+  for (mrb_int i = 0; i < RARRAY_LEN(names); i++) {
+    mrb_sym name = mrb_symbol(RARRAY_PTR(names)[i]);
+    marshal_w_symbol(d, name);
+    marshal_w_object(d, mrb_iv_get(mrb, obj, name));
+  }
+}
+
+static void
+marshal_w_object(marshal_dump_t *d, mrb_value obj)
+{
+  mrb_state *mrb = d->mrb;
+  int ai = mrb_gc_arena_save(mrb);
+
+  if (MARSHAL_MAX_DEPTH <= d->depth) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "exceed depth limit");
+  }
+  d->depth++;
+  switch (mrb_type(obj)) {
+    case MRB_TT_FALSE:
+      Marshal_w_byte(&d->w, mrb_nil_p(obj) ? MARSHAL_TYPE_NIL : MARSHAL_TYPE_FALSE);
+      break;
+    case MRB_TT_TRUE:
+      Marshal_w_byte(&d->w, MARSHAL_TYPE_TRUE);
+      break;
+    case MRB_TT_INTEGER: {
+      int64_t n = (int64_t)mrb_integer(obj);
+      if (n < MARSHAL_FIXNUM_MIN || MARSHAL_FIXNUM_MAX < n) marshal_remember(d, mrb_nil_value());
+      Marshal_w_integer(&d->w, n);
+      break;
+    }
+    case MRB_TT_SYMBOL:
+      marshal_w_symbol(d, mrb_symbol(obj));
+      break;
+#ifndef MRB_NO_FLOAT
+    case MRB_TT_FLOAT:
+      marshal_remember(d, mrb_nil_value());
+      Marshal_w_byte(&d->w, MARSHAL_TYPE_FLOAT);
+      Marshal_w_float(&d->w, (double)mrb_float(obj));
+      break;
+#endif
+    default:
+      if (marshal_w_link(d, obj)) break;
+      if (mrb_respond_to(mrb, obj, MRB_SYM(marshal_dump))) {
+        marshal_remember(d, obj);
+        mrb_value data = mrb_funcall_id(mrb, obj, MRB_SYM(marshal_dump), 0);
+        marshal_w_class(d, MARSHAL_TYPE_USRMARSHAL, mrb_obj_class(mrb, obj));
+        marshal_w_object(d, data);
+        break;
+      }
+      if (mrb_respond_to(mrb, obj, MRB_SYM(_dump))) {
+        mrb_value data = mrb_funcall_id(mrb, obj, MRB_SYM(_dump), 1, mrb_int_value(mrb, -1));
+        if (!mrb_string_p(data)) {
+          mrb_raise(mrb, E_TYPE_ERROR, "_dump() must return string");
+        }
+        marshal_w_class(d, MARSHAL_TYPE_USERDEF, mrb_obj_class(mrb, obj));
+        Marshal_w_bytes(&d->w, RSTRING_PTR(data), RSTRING_LEN(data));
+        /* Remembered after, like CRuby */
+        marshal_remember(d, obj);
+        break;
+      }
+      marshal_remember(d, obj);
+      switch (mrb_type(obj)) {
+        case MRB_TT_STRING:
+          /* With E: true, so that CRuby loads it as UTF-8 */
+          Marshal_w_byte(&d->w, MARSHAL_TYPE_IVAR);
+          Marshal_w_byte(&d->w, MARSHAL_TYPE_STRING);
+          Marshal_w_bytes(&d->w, RSTRING_PTR(obj), RSTRING_LEN(obj));
+          Marshal_w_long(&d->w, 1);
+          marshal_w_symbol(d, MRB_SYM(E));
+          Marshal_w_byte(&d->w, MARSHAL_TYPE_TRUE);
+          break;
+        case MRB_TT_ARRAY:
+          Marshal_w_byte(&d->w, MARSHAL_TYPE_ARRAY);
+          Marshal_w_long(&d->w, (int32_t)RARRAY_LEN(obj));
+          for (mrb_int i = 0; i < RARRAY_LEN(obj); i++) {
+            marshal_w_object(d, RARRAY_PTR(obj)[i]);
+          }
+          break;
+        case MRB_TT_HASH:
+          Marshal_w_byte(&d->w, MARSHAL_TYPE_HASH);
+          Marshal_w_long(&d->w, (int32_t)mrb_hash_size(mrb, obj));
+          mrb_hash_foreach(mrb, mrb_hash_ptr(obj), marshal_w_pair, d);
+          break;
+        case MRB_TT_CLASS:
+        case MRB_TT_MODULE: {
+          mrb_value path = mrb_class_path(mrb, mrb_class_ptr(obj));
+          if (mrb_nil_p(path)) {
+            mrb_raise(mrb, E_TYPE_ERROR, "can't dump anonymous class");
+          }
+          Marshal_w_byte(&d->w, mrb_type(obj) == MRB_TT_CLASS ? MARSHAL_TYPE_CLASS : MARSHAL_TYPE_MODULE);
+          Marshal_w_bytes(&d->w, RSTRING_PTR(path), RSTRING_LEN(path));
+          break;
+        }
+        default: {
+          struct RClass *cls = mrb_obj_class(mrb, obj);
+          /* Struct and Data: both answer members and to_h */
+          if (mrb_respond_to(mrb, obj, MRB_SYM(members)) &&
+              mrb_respond_to(mrb, obj, MRB_SYM(to_h)) &&
+              mrb_respond_to(mrb, mrb_obj_value(cls), MRB_SYM(members))) {
+            marshal_w_struct(d, obj);
+          } else if (mrb_type(obj) == MRB_TT_OBJECT) {
+            marshal_w_class(d, MARSHAL_TYPE_OBJECT, cls);
+            marshal_w_ivars(d, obj);
+          } else {
+            mrb_raisef(mrb, E_TYPE_ERROR, "can't dump %C", cls);
+          }
+          break;
+        }
+      }
+      break;
+  }
+  d->depth--;
+  mrb_gc_arena_restore(mrb, ai);
+}
+
+/* Marshal.dump(obj, io = nil) */
+static mrb_value
+mrb_marshal_s_dump(mrb_state *mrb, mrb_value self)
+{
+  mrb_value obj, io = mrb_nil_value();
+  uint8_t buf[MARSHAL_WRITE_BUFFER_SIZE];
+  marshal_dump_t d;
+
+  mrb_get_args(mrb, "o|o", &obj, &io);
+  d.mrb = mrb;
+  d.w.out = marshal_out;
+  d.w.ctx = &d;
+  d.io = io;
+  d.buf = mrb_nil_p(io) ? NULL : buf;
+  d.len = 0;
+  d.out = mrb_nil_p(io) ? mrb_str_new_capa(mrb, 32) : mrb_nil_value();
+  d.objects = mrb_hash_new(mrb);
+  d.list = mrb_ary_new(mrb);
+  d.symbols = mrb_hash_new(mrb);
+  d.depth = 0;
+  Marshal_w_byte(&d.w, MARSHAL_MAJOR_VERSION);
+  Marshal_w_byte(&d.w, MARSHAL_MINOR_VERSION);
+  marshal_w_object(&d, obj);
+  if (d.buf) {
+    marshal_flush(&d);
+    return io;
+  }
+  return d.out;
+}
+
+/*
+ * Load
+ *
+ * Every object that can be the target of a '@' link goes into objects
+ * in the order it appears, which also keeps it from the GC until the
+ * load is over.
+ */
+
+typedef struct {
+  mrb_state *mrb;
+  marshal_reader_t r;
+  mrb_value io;
+  mrb_value objects;  /* Array */
+  mrb_value symbols;  /* Array of Symbol */
+  int depth;
+} marshal_load_t;
+
+static mrb_noreturn void
+marshal_raise(marshal_load_t *l)
+{
+  mrb_raise(l->mrb, E_ARGUMENT_ERROR, l->r.error ? l->r.error : "dump format error");
+}
+
+static size_t
+marshal_fill(void *ctx, uint8_t *buf, size_t size)
+{
+  marshal_load_t *l = (marshal_load_t *)ctx;
+  mrb_state *mrb = l->mrb;
+  int ai = mrb_gc_arena_save(mrb);
+  size_t n = 0;
+
+  mrb_value chunk = mrb_funcall_id(mrb, l->io, MRB_SYM(read), 1, mrb_int_value(mrb, (mrb_int)size));
+  if (mrb_string_p(chunk)) {
+    n = (size_t)RSTRING_LEN(chunk);
+    if (size < n) n = size;
+    memcpy(buf, RSTRING_PTR(chunk), n);
+  }
+  mrb_gc_arena_restore(mrb, ai);
+  return n;
+}
+
+static uint8_t
+marshal_r_byte(marshal_load_t *l)
+{
+  uint8_t c;
+  if (!Marshal_r_byte(&l->r, &c)) marshal_raise(l);
+  return c;
+}
+
+static int32_t
+marshal_r_long(marshal_load_t *l)
+{
+  int32_t x;
+  if (!Marshal_r_long(&l->r, &x)) marshal_raise(l);
+  return x;
+}
+
+static int32_t
+marshal_r_count(marshal_load_t *l)
+{
+  int32_t n = marshal_r_long(l);
+  if (n < 0) {
+    l->r.error = "dump format error (negative length)";
+    marshal_raise(l);
+  }
+  return n;
+}
+
+static mrb_value
+marshal_r_bytes(marshal_load_t *l)
+{
+  int32_t len = marshal_r_count(l);
+  mrb_value str = mrb_str_new_capa(l->mrb, len);
+
+  if (!Marshal_r_read(&l->r, RSTRING_PTR(str), len)) marshal_raise(l);
+  mrb_str_resize(l->mrb, str, len);
+  return str;
+}
+
+static mrb_value
+marshal_entry(marshal_load_t *l, mrb_value obj)
+{
+  mrb_ary_push(l->mrb, l->objects, obj);
+  return obj;
+}
+
+static mrb_value marshal_r_object(marshal_load_t *l);
+static mrb_sym marshal_r_symbol(marshal_load_t *l);
+
+/* The ivars after an 'I' object; only those of plain objects are kept */
+static void
+marshal_r_ivars(marshal_load_t *l, mrb_value obj)
+{
+  int32_t n = marshal_r_count(l);
+
+  Marshal_r_expect(&l->r, 2 * (size_t)n);
+  for (int32_t i = 0; i < n; i++) {
+    mrb_sym name = marshal_r_symbol(l);
+    mrb_value value = marshal_r_object(l);
+    if (mrb_type(obj) == MRB_TT_OBJECT) mrb_iv_set(l->mrb, obj, name, value);
+  }
+}
+
+static mrb_value
+marshal_r_symbol_body(marshal_load_t *l)
+{
+  mrb_value str = marshal_r_bytes(l);
+  mrb_value sym = mrb_symbol_value(mrb_intern_str(l->mrb, str));
+
+  mrb_ary_push(l->mrb, l->symbols, sym);
+  return sym;
+}
+
+static mrb_sym
+marshal_r_symbol(marshal_load_t *l)
+{
+  mrb_value sym = marshal_r_object(l);
+  if (!mrb_symbol_p(sym)) {
+    l->r.error = "dump format error (symbol expected)";
+    marshal_raise(l);
+  }
+  return mrb_symbol(sym);
+}
+
+/* The constant a class path names. Data classes are objects here, so the
+   last name need not be a class. */
+static mrb_value
+marshal_path2const(marshal_load_t *l, const char *path, mrb_int len)
+{
+  mrb_state *mrb = l->mrb;
+  mrb_value v = mrb_obj_value(mrb->object_class);
+  const char *p = path;
+  const char *end = path + len;
+
+  while (p < end) {
+    const char *q = p;
+    while (q < end && *q != ':') q++;
+    mrb_sym name = mrb_intern(mrb, p, q - p);
+    if ((mrb_type(v) != MRB_TT_CLASS && mrb_type(v) != MRB_TT_MODULE) ||
+        !mrb_const_defined(mrb, v, name)) {
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "undefined class/module %s", mrb_str_to_cstr(mrb, mrb_str_new(mrb, path, len)));
+    }
+    v = mrb_const_get(mrb, v, name);
+    p = (q + 2 <= end) ? q + 2 : end;
+  }
+  return v;
+}
+
+static struct RClass *
+marshal_path2class(marshal_load_t *l, const char *path, mrb_int len)
+{
+  mrb_state *mrb = l->mrb;
+  mrb_value v = marshal_path2const(l, path, len);
+
+  if (mrb_type(v) != MRB_TT_CLASS && mrb_type(v) != MRB_TT_MODULE) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "%s does not refer to class/module", mrb_str_to_cstr(mrb, mrb_str_new(mrb, path, len)));
+  }
+  return mrb_class_ptr(v);
+}
+
+static mrb_value
+marshal_r_const(marshal_load_t *l)
+{
+  mrb_int len;
+  const char *name = mrb_sym_name_len(l->mrb, marshal_r_symbol(l), &len);
+  return marshal_path2const(l, name, len);
+}
+
+static struct RClass *
+marshal_r_class(marshal_load_t *l)
+{
+  mrb_int len;
+  const char *name = mrb_sym_name_len(l->mrb, marshal_r_symbol(l), &len);
+  return marshal_path2class(l, name, len);
+}
+
+static mrb_value
+marshal_alloc(marshal_load_t *l, struct RClass *cls)
+{
+  if (cls->tt != MRB_TT_CLASS || (MRB_INSTANCE_TT(cls) != 0 && MRB_INSTANCE_TT(cls) != MRB_TT_OBJECT)) {
+    mrb_raisef(l->mrb, E_ARGUMENT_ERROR, "dump format error: can't allocate %C", cls);
+  }
+  return mrb_obj_value(mrb_obj_alloc(l->mrb, MRB_TT_OBJECT, cls));
+}
+
+static mrb_value
+marshal_r_object(marshal_load_t *l)
+{
+  mrb_state *mrb = l->mrb;
+  int ai = mrb_gc_arena_save(mrb);
+  mrb_value v = mrb_nil_value();
+
+  if (MARSHAL_MAX_DEPTH <= l->depth) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "exceed depth limit");
+  }
+  l->depth++;
+  Marshal_r_item(&l->r);
+  uint8_t type = marshal_r_byte(l);
+  switch (type) {
+    case MARSHAL_TYPE_NIL:
+      break;
+    case MARSHAL_TYPE_TRUE:
+      v = mrb_true_value();
+      break;
+    case MARSHAL_TYPE_FALSE:
+      v = mrb_false_value();
+      break;
+    case MARSHAL_TYPE_FIXNUM:
+      v = mrb_int_value(mrb, (mrb_int)marshal_r_long(l));
+      break;
+    case MARSHAL_TYPE_BIGNUM: {
+      int64_t ival;
+      double fval;
+      bool fits;
+      if (!Marshal_r_bignum(&l->r, &ival, &fval, &fits)) marshal_raise(l);
+      if (fits && MRB_INT_MIN <= ival && ival <= MRB_INT_MAX) {
+        v = mrb_int_value(mrb, (mrb_int)ival);
+      } else {
+#ifndef MRB_NO_FLOAT
+        /* No Bignum here; a float keeps the magnitude */
+        v = mrb_float_value(mrb, (mrb_float)fval);
+#else
+        mrb_raise(mrb, E_RANGE_ERROR, "bignum too big");
+#endif
+      }
+      marshal_entry(l, v);
+      break;
+    }
+    case MARSHAL_TYPE_FLOAT: {
+      double d;
+      if (!Marshal_r_float(&l->r, &d)) marshal_raise(l);
+#ifndef MRB_NO_FLOAT
+      v = marshal_entry(l, mrb_float_value(mrb, (mrb_float)d));
+#else
+      mrb_raise(mrb, E_NOTIMP_ERROR, "Float is not supported");
+#endif
+      break;
+    }
+    case MARSHAL_TYPE_STRING:
+      v = marshal_entry(l, marshal_r_bytes(l));
+      break;
+    case MARSHAL_TYPE_SYMBOL:
+      v = marshal_r_symbol_body(l);
+      break;
+    case MARSHAL_TYPE_SYMLINK: {
+      int32_t index = marshal_r_long(l);
+      if (index < 0 || RARRAY_LEN(l->symbols) <= index) {
+        l->r.error = "bad symbol";
+        marshal_raise(l);
+      }
+      v = RARRAY_PTR(l->symbols)[index];
+      break;
+    }
+    case MARSHAL_TYPE_LINK: {
+      int32_t index = marshal_r_long(l);
+      if (index < 0 || RARRAY_LEN(l->objects) <= index) {
+        l->r.error = "dump format error (unlinked)";
+        marshal_raise(l);
+      }
+      v = RARRAY_PTR(l->objects)[index];
+      break;
+    }
+    case MARSHAL_TYPE_IVAR:
+      /* Encoding and other ivars of a String, Symbol or Regexp, or of
+         the string of a _dump ('Iu'), which belong to no object here */
+      v = marshal_r_object(l);
+      marshal_r_ivars(l, mrb_nil_value());
+      break;
+    case MARSHAL_TYPE_ARRAY: {
+      int32_t n = marshal_r_count(l);
+      v = marshal_entry(l, mrb_ary_new(mrb));
+      Marshal_r_expect(&l->r, n);
+      for (int32_t i = 0; i < n; i++) {
+        mrb_ary_push(mrb, v, marshal_r_object(l));
+      }
+      break;
+    }
+    case MARSHAL_TYPE_HASH:
+    case MARSHAL_TYPE_HASH_DEF: {
+      int32_t n = marshal_r_count(l);
+      v = marshal_entry(l, mrb_hash_new(mrb));
+      Marshal_r_expect(&l->r, 2 * (size_t)n + (type == MARSHAL_TYPE_HASH_DEF));
+      for (int32_t i = 0; i < n; i++) {
+        mrb_value key = marshal_r_object(l);
+        mrb_hash_set(mrb, v, key, marshal_r_object(l));
+      }
+      if (type == MARSHAL_TYPE_HASH_DEF) {
+        mrb_funcall_id(mrb, v, MRB_SYM_E(default), 1, marshal_r_object(l));
+      }
+      break;
+    }
+    case MARSHAL_TYPE_OBJECT: {
+      struct RClass *cls = marshal_r_class(l);
+      v = marshal_entry(l, marshal_alloc(l, cls));
+      marshal_r_ivars(l, v);
+      break;
+    }
+    case MARSHAL_TYPE_STRUCT: {
+      mrb_value cls = marshal_r_const(l);
+      mrb_int index = RARRAY_LEN(l->objects);
+      marshal_entry(l, mrb_nil_value()); /* taken once the values are in */
+      int32_t n = marshal_r_count(l);
+      mrb_value values = mrb_ary_new_capa(mrb, n);
+      Marshal_r_expect(&l->r, 2 * (size_t)n);
+      for (int32_t i = 0; i < n; i++) {
+        marshal_r_symbol(l);
+        mrb_ary_push(mrb, values, marshal_r_object(l));
+      }
+      v = mrb_funcall_argv(mrb, cls, MRB_SYM(new), RARRAY_LEN(values), RARRAY_PTR(values));
+      mrb_ary_set(mrb, l->objects, index, v);
+      break;
+    }
+    case MARSHAL_TYPE_USERDEF: {
+      mrb_value cls = mrb_obj_value(marshal_r_class(l));
+      mrb_value data = marshal_r_bytes(l);
+      v = marshal_entry(l, mrb_funcall_id(mrb, cls, MRB_SYM(_load), 1, data));
+      break;
+    }
+    case MARSHAL_TYPE_USRMARSHAL: {
+      struct RClass *cls = marshal_r_class(l);
+      v = marshal_entry(l, marshal_alloc(l, cls));
+      mrb_funcall_id(mrb, v, MRB_SYM(marshal_load), 1, marshal_r_object(l));
+      break;
+    }
+    case MARSHAL_TYPE_CLASS:
+    case MARSHAL_TYPE_MODULE:
+    case MARSHAL_TYPE_MODULE_OLD: {
+      mrb_value path = marshal_r_bytes(l);
+      struct RClass *cls = marshal_path2class(l, RSTRING_PTR(path), RSTRING_LEN(path));
+      v = marshal_entry(l, mrb_obj_value(cls));
+      break;
+    }
+    case MARSHAL_TYPE_EXTENDED:
+    case MARSHAL_TYPE_UCLASS:
+      /* Neither the extending module nor the subclass is kept */
+      marshal_r_symbol(l);
+      v = marshal_r_object(l);
+      break;
+    default:
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "dump format error(0x%x)", (int)type);
+  }
+  l->depth--;
+  mrb_gc_arena_restore(mrb, ai);
+  return v;
+}
+
+/* Marshal.load(source): source is a String or an IO that answers read */
+static mrb_value
+mrb_marshal_s_load(mrb_state *mrb, mrb_value self)
+{
+  mrb_value source;
+  uint8_t buf[MARSHAL_READ_BUFFER_SIZE];
+  uint8_t major, minor;
+  marshal_load_t l;
+
+  mrb_get_args(mrb, "o", &source);
+  l.mrb = mrb;
+  l.io = mrb_nil_value();
+  l.depth = 0;
+  if (mrb_string_p(source)) {
+    Marshal_reader_init(&l.r, (const uint8_t *)RSTRING_PTR(source), RSTRING_LEN(source));
+  } else if (mrb_respond_to(mrb, source, MRB_SYM(read))) {
+    l.io = source;
+    Marshal_reader_init_io(&l.r, buf, marshal_fill, &l);
+  } else {
+    mrb_raise(mrb, E_TYPE_ERROR, "instance of IO needed");
+  }
+  l.objects = mrb_ary_new(mrb);
+  l.symbols = mrb_ary_new(mrb);
+  if (!Marshal_r_version(&l.r, &major, &minor)) {
+    if (l.r.error && strcmp(l.r.error, "incompatible") == 0) {
+      mrb_raisef(mrb, E_TYPE_ERROR,
+                 "incompatible marshal file format (can't be read)\n\tformat version %d.%d required; %d.%d given",
+                 MARSHAL_MAJOR_VERSION, MARSHAL_MINOR_VERSION, (int)major, (int)minor);
+    }
+    marshal_raise(&l);
+  }
+  return marshal_r_object(&l);
+}
+
+void
+mrb_picoruby_marshal_gem_init(mrb_state* mrb)
+{
+  struct RClass *module_Marshal = mrb_define_module_id(mrb, MRB_SYM(Marshal));
+
+  mrb_define_class_method_id(mrb, module_Marshal, MRB_SYM(dump), mrb_marshal_s_dump, MRB_ARGS_ARG(1, 1));
+  mrb_define_class_method_id(mrb, module_Marshal, MRB_SYM(load), mrb_marshal_s_load, MRB_ARGS_REQ(1));
+}
+
+void
+mrb_picoruby_marshal_gem_final(mrb_state* mrb)
+{
+}
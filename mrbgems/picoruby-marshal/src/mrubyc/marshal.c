@@ -0,0 +1,914 @@
+#include <mrubyc.h>
+
+/*
+ * mruby/c cannot unwind a raise through C frames, so every function
+ * here returns false (or nil with failed set) once an exception is
+ * pending, and the callers release what they hold on the way out.
+ */
+
+static bool
+marshal_exception_p(mrbc_vm *vm)
+{
+  return vm->exception.tt == MRBC_TT_EXCEPTION;
+}
+
+static void *
+marshal_address(mrbc_value *obj)
+{
+  switch (obj->tt) {
+    case MRBC_TT_STRING: return obj->string;
+    case MRBC_TT_ARRAY:  return obj->array;
+    case MRBC_TT_HASH:   return obj->hash;
+    case MRBC_TT_OBJECT: return obj->instance;
+    case MRBC_TT_CLASS:
+    case MRBC_TT_MODULE: return obj->cls;
+    default:             return NULL;
+  }
+}
+
+static bool
+marshal_respond_to(mrbc_value *obj, const char *name)
+{
+  mrbc_method method;
+  return mrbc_find_method(&method, find_class_by_object(obj), mrbc_str_to_symid(name)) != 0;
+}
+
+/*
+ * Dump
+ *
+ * objects maps the address of every object written so far to its index
+ * in addrs; floats and bignums take an index (NULL) but are never
+ * linked, as in CRuby.
+ */
+
+typedef struct {
+  mrbc_vm *vm;
+  mrbc_value *v;
+  int argc;
+  marshal_writer_t w;
+  uint8_t *buf;
+  size_t len;
+  size_t capa;
+  mrbc_value *io;       /* with io, buf is a fixed area flushed to io.write */
+  mrbc_value objects;   /* Hash: address -> index */
+  void **addrs;
+  int32_t count;
+  mrbc_value symbols;   /* Hash: Symbol -> index */
+  int depth;
+  bool failed;
+} marshal_dump_t;
+
+static void
+marshal_fail(marshal_dump_t *d, mrbc_class *cls, const char *message)
+{
+  if (!d->failed && !marshal_exception_p(d->vm)) mrbc_raise(d->vm, cls, message);
+  d->failed = true;
+}
+
+static void
+marshal_flush(marshal_dump_t *d)
+{
+  if (d->len == 0 || d->failed) return;
+  mrbc_value chunk = mrbc_string_new(d->vm, d->buf, d->len);
+  d->len = 0;
+  mrbc_value ret = mrbc_send(d->vm, d->v, d->argc, d->io, "write", 1, &chunk);
+  mrbc_decref(&ret);
+  mrbc_decref(&chunk);
+  if (marshal_exception_p(d->vm)) d->failed = true;
+}
+
+static void
+marshal_out(void *ctx, const uint8_t *buf, size_t len)
+{
+  marshal_dump_t *d = (marshal_dump_t *)ctx;
+
+  if (d->failed) return;
+  if (d->io) {
+    while (0 < len && !d->failed) {
+      size_t n = MARSHAL_WRITE_BUFFER_SIZE - d->len;
+      if (len < n) n = len;
+      memcpy(d->buf + d->len, buf, n);
+      d->len += n;
+      buf += n;
+      len -= n;
+      if (d->len == MARSHAL_WRITE_BUFFER_SIZE) marshal_flush(d);
+    }
+    return;
+  }
+  /* One byte more for the terminator mrbc_string_new_alloc writes */
+  if (d->capa < d->len + len + 1) {
+    size_t capa = d->capa ? d->capa : 32;
+    while (capa < d->len + len + 1) capa *= 2;
+    /* mrbc_realloc does not take NULL */
+    uint8_t *p = d->buf ? (uint8_t *)mrbc_realloc(d->vm, d->buf, capa)
+                        : (uint8_t *)mrbc_alloc(d->vm, capa);
+    if (!p) {
+      marshal_fail(d, MRBC_CLASS(NoMemoryError), "out of memory");
+      return;
+    }
+    d->buf = p;
+    d->capa = capa;
+  }
+  memcpy(d->buf + d->len, buf, len);
+  d->len += len;
+}
+
+static void
+marshal_remember(marshal_dump_t *d, void *addr)
+{
+  if (d->failed) return;
+  if ((d->count & 15) == 0) {
+    size_t size = sizeof(void *) * (d->count + 16);
+    void **p = d->addrs ? (void **)mrbc_realloc(d->vm, d->addrs, size)
+                        : (void **)mrbc_alloc(d->vm, size);
+    if (!p) {
+      marshal_fail(d, MRBC_CLASS(NoMemoryError), "out of memory");
+      return;
+    }
+    d->addrs = p;
+  }
+  d->addrs[d->count] = addr;
+  if (addr) {
+    mrbc_value key = mrbc_integer_value((mrbc_int_t)(intptr_t)addr);
+    mrbc_value index = mrbc_integer_value(d->count);
+    mrbc_hash_set(&d->objects, &key, &index);
+  }
+  d->count++;
+}
+
+/* Write a link and return true if obj was written before */
+static bool
+marshal_w_link(marshal_dump_t *d, void *addr)
+{
+  mrbc_value key = mrbc_integer_value((mrbc_int_t)(intptr_t)addr);
+  mrbc_value index = mrbc_hash_get(&d->objects, &key);
+
+  if (index.tt != MRBC_TT_INTEGER) return false;
+  /* The key is the address cut down to mrbc_int_t; make sure it really
+     is the same object */
+  if (d->addrs[mrbc_integer(index)] != addr) return false;
+  Marshal_w_byte(&d->w, MARSHAL_TYPE_LINK);
+  Marshal_w_long(&d->w, (int32_t)mrbc_integer(index));
+  return true;
+}
+
+static void
+marshal_w_symbol(marshal_dump_t *d, mrbc_sym sym)
+{
+  mrbc_value key = mrbc_symbol_value(sym);
+  mrbc_value index = mrbc_hash_get(&d->symbols, &key);
+  const char *name = mrbc_symid_to_str(sym);
+  size_t len = strlen(name);
+  bool ascii = true;
+
+  if (index.tt == MRBC_TT_INTEGER) {
+    Marshal_w_byte(&d->w, MARSHAL_TYPE_SYMLINK);
+    Marshal_w_long(&d->w, (int32_t)mrbc_integer(index));
+    return;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (name[i] & 0x80) ascii = false;
+  }
+  if (!ascii) Marshal_w_byte(&d->w, MARSHAL_TYPE_IVAR);
+  Marshal_w_byte(&d->w, MARSHAL_TYPE_SYMBOL);
+  Marshal_w_bytes(&d->w, name, len);
+  index = mrbc_integer_value(mrbc_hash_size(&d->symbols));
+  mrbc_hash_set(&d->symbols, &key, &index);
+  if (!ascii) {
+    /* One ivar, E: true (UTF-8), as CRuby writes non-ASCII symbols */
+    Marshal_w_long(&d->w, 1);
+    marshal_w_symbol(d, mrbc_str_to_symid("E"));
+    Marshal_w_byte(&d->w, MARSHAL_TYPE_TRUE);
+  }
+}
+
+/* Append s to the path of len bytes in buf, cut to fit */
+static size_t
+marshal_path_append(char *buf, size_t size, size_t len, const char *s)
+{
+  size_t n = strlen(s);
+  if (size - 1 - len < n) n = size - 1 - len;
+  memcpy(buf + len, s, n);
+  buf[len + n] = '\0';
+  return len + n;
+}
+
+/* mruby/c names a nested class with a symbol made of the symbols of its
+   outer class and its own name, so "A::B" is put back together from them.
+   Returns the length of the path. */
+static size_t
+marshal_class_path(mrbc_sym sym, char *buf, size_t size, size_t len)
+{
+  if (mrbc_is_nested_symid(sym)) {
+    mrbc_sym outer, name;
+    mrbc_separate_nested_symid(sym, &outer, &name);
+    len = marshal_class_path(outer, buf, size, len);
+    len = marshal_path_append(buf, size, len, "::");
+    return marshal_class_path(name, buf, size, len);
+  }
+  return marshal_path_append(buf, size, len, mrbc_symid_to_str(sym));
+}
+
+static void
+marshal_w_class(marshal_dump_t *d, uint8_t type, mrbc_class *cls)
+{
+  char path[MARSHAL_CLASS_PATH_MAX];
+
+  Marshal_w_byte(&d->w, type);
+  if (!mrbc_is_nested_symid(cls->sym_id)) {
+    marshal_w_symbol(d, cls->sym_id);
+    return;
+  }
+  marshal_class_path(cls->sym_id, path, sizeof(path), 0);
+  marshal_w_symbol(d, mrbc_symbol(mrbc_symbol_new(d->vm, path)));
+}
+
+static void marshal_w_object(marshal_dump_t *d, mrbc_value *obj);
+
+static void
+marshal_w_struct(marshal_dump_t *d, mrbc_value *obj)
+{
+  mrbc_value members = mrbc_send(d->vm, d->v, d->argc, obj, "members", 0);
+  mrbc_value values = mrbc_send(d->vm, d->v, d->argc, obj, "to_h", 0);
+
+  if (members.tt != MRBC_TT_ARRAY || values.tt != MRBC_TT_HASH) {
+    marshal_fail(d, MRBC_CLASS(TypeError), "can't dump Struct");
+  } else {
+    int n = mrbc_array_size(&members);
+    marshal_w_class(d, MARSHAL_TYPE_STRUCT, find_class_by_object(obj));
+    Marshal_w_long(&d->w, n);
+    for (int i = 0; i < n && !d->failed; i++) {
+      mrbc_value member = mrbc_array_get(&members, i);
+      mrbc_value value = mrbc_hash_get(&values, &member);
+      if (member.tt != MRBC_TT_SYMBOL) {
+        marshal_fail(d, MRBC_CLASS(TypeError), "Struct member is not a Symbol");
+        break;
+      }
+      marshal_w_symbol(d, mrbc_symbol(member));
+      marshal_w_object(d, &value);
+    }
+  }
+  mrbc_decref(&members);
+  mrbc_decref(&values);
+}
+
+static void
+marshal_w_ivars(marshal_dump_t *d, mrbc_value *obj)
+{
+  mrbc_kv_handle *kvh = &obj->instance->ivar;
+  char name[64];
+
+  Marshal_w_long(&d->w, kvh->n_stored);
+  for (int i = 0; i < kvh->n_stored && !d->failed; i++) {
+    /* mruby/c keeps ivar names without the '@' */
+    snprintf(name, sizeof(name), "@%s", mrbc_symid_to_str(kvh->data[i].sym_id));
+    marshal_w_symbol(d, mrbc_symbol(mrbc_symbol_new(d->vm, name)));
+    marshal_w_object(d, &kvh->data[i].value);
+  }
+}
+
+static void
+marshal_w_object(marshal_dump_t *d, mrbc_value *obj)
+{
+  if (d->failed) return;
+  if (MARSHAL_MAX_DEPTH <= d->depth) {
+    marshal_fail(d, MRBC_CLASS(ArgumentError), "exceed depth limit");
+    return;
+  }
+  d->depth++;
+  switch (obj->tt) {
+    case MRBC_TT_NIL:
+      Marshal_w_byte(&d->w, MARSHAL_TYPE_NIL);
+      break;
+    case MRBC_TT_FALSE:
+      Marshal_w_byte(&d->w, MARSHAL_TYPE_FALSE);
+      break;
+    case MRBC_TT_TRUE:
+      Marshal_w_byte(&d->w, MARSHAL_TYPE_TRUE);
+      break;
+    case MRBC_TT_INTEGER: {
+      int64_t n = (int64_t)mrbc_integer(*obj);
+      if (n < MARSHAL_FIXNUM_MIN || MARSHAL_FIXNUM_MAX < n) marshal_remember(d, NULL);
+      Marshal_w_integer(&d->w, n);
+      break;
+    }
+    case MRBC_TT_SYMBOL:
+      marshal_w_symbol(d, mrbc_symbol(*obj));
+      break;
+#if MRBC_USE_FLOAT
+    case MRBC_TT_FLOAT:
+      marshal_remember(d, NULL);
+      Marshal_w_byte(&d->w, MARSHAL_TYPE_FLOAT);
+      Marshal_w_float(&d->w, mrbc_float(*obj));
+      break;
+#endif
+    case MRBC_TT_STRING:
+    case MRBC_TT_ARRAY:
+    case MRBC_TT_HASH:
+    case MRBC_TT_OBJECT:
+    case MRBC_TT_CLASS:
+    case MRBC_TT_MODULE: {
+      void *addr = marshal_address(obj);
+      if (marshal_w_link(d, addr)) break;
+      if (marshal_respond_to(obj, "marshal_dump")) {
+        marshal_remember(d, addr);
+        mrbc_value data = mrbc_send(d->vm, d->v, d->argc, obj, "marshal_dump", 0);
+        if (marshal_exception_p(d->vm)) {
+          d->failed = true;
+        } else {
+          marshal_w_class(d, MARSHAL_TYPE_USRMARSHAL, find_class_by_object(obj));
+          marshal_w_object(d, &data);
+        }
+        mrbc_decref(&data);
+        break;
+      }
+      if (marshal_respond_to(obj, "_dump")) {
+        mrbc_value limit = mrbc_integer_value(-1);
+        mrbc_value data = mrbc_send(d->vm, d->v, d->argc, obj, "_dump", 1, &limit);
+        if (marshal_exception_p(d->vm)) {
+          d->failed = true;
+        } else if (data.tt != MRBC_TT_STRING) {
+          marshal_fail(d, MRBC_CLASS(TypeError), "_dump() must return string");
+        } else {
+          marshal_w_class(d, MARSHAL_TYPE_USERDEF, find_class_by_object(obj));
+          Marshal_w_bytes(&d->w, data.string->data, data.string->size);
+          /* Remembered after, like CRuby */
+          marshal_remember(d, addr);
+        }
+        mrbc_decref(&data);
+        break;
+      }
+      marshal_remember(d, addr);
+      if (obj->tt == MRBC_TT_STRING) {
+        /* With E: true, so that CRuby loads it as UTF-8 */
+        Marshal_w_byte(&d->w, MARSHAL_TYPE_IVAR);
+        Marshal_w_byte(&d->w, MARSHAL_TYPE_STRING);
+        Marshal_w_bytes(&d->w, obj->string->data, obj->string->size);
+        Marshal_w_long(&d->w, 1);
+        marshal_w_symbol(d, mrbc_str_to_symid("E"));
+        Marshal_w_byte(&d->w, MARSHAL_TYPE_TRUE);
+      } else if (obj->tt == MRBC_TT_ARRAY) {
+        int n = mrbc_array_size(obj);
+        Marshal_w_byte(&d->w, MARSHAL_TYPE_ARRAY);
+        Marshal_w_long(&d->w, n);
+        for (int i = 0; i < n && !d->failed; i++) {
+          mrbc_value item = mrbc_array_get(obj, i);
+          marshal_w_object(d, &item);
+        }
+      } else if (obj->tt == MRBC_TT_HASH) {
+        mrbc_hash_iterator ite = mrbc_hash_iterator_new(obj);
+        Marshal_w_byte(&d->w, MARSHAL_TYPE_HASH);
+        Marshal_w_long(&d->w, mrbc_hash_size(obj));
+        while (mrbc_hash_i_has_next(&ite) && !d->failed) {
+          mrbc_value *kv = mrbc_hash_i_next(&ite);
+          marshal_w_object(d, &kv[0]);
+          marshal_w_object(d, &kv[1]);
+        }
+      } else if (obj->tt == MRBC_TT_CLASS || obj->tt == MRBC_TT_MODULE) {
+        char path[MARSHAL_CLASS_PATH_MAX];
+        size_t len = marshal_class_path(obj->cls->sym_id, path, sizeof(path), 0);
+        Marshal_w_byte(&d->w, obj->tt == MRBC_TT_CLASS ? MARSHAL_TYPE_CLASS : MARSHAL_TYPE_MODULE);
+        Marshal_w_bytes(&d->w, path, len);
+      } else if (marshal_respond_to(obj, "members") && marshal_respond_to(obj, "to_h")) {
+        /* Struct and Data */
+        marshal_w_struct(d, obj);
+      } else {
+        marshal_w_class(d, MARSHAL_TYPE_OBJECT, obj->instance->cls);
+        marshal_w_ivars(d, obj);
+      }
+      break;
+    }
+    default:
+      marshal_fail(d, MRBC_CLASS(TypeError), "can't dump this object");
+      break;
+  }
+  d->depth--;
+}
+
+/* Marshal.dump(obj, io = nil) */
+static void
+c_marshal_dump(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  uint8_t buf[MARSHAL_WRITE_BUFFER_SIZE];
+  marshal_dump_t d;
+
+  if (argc < 1 || 2 < argc) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+  memset(&d, 0, sizeof(d));
+  d.vm = vm;
+  d.v = v;
+  d.argc = argc;
+  d.w.out = marshal_out;
+  d.w.ctx = &d;
+  if (argc == 2 && GET_TT_ARG(2) != MRBC_TT_NIL) {
+    d.io = &v[2];
+    d.buf = buf;
+    d.capa = sizeof(buf);
+  }
+  d.objects = mrbc_hash_new(vm, 0);
+  d.symbols = mrbc_hash_new(vm, 0);
+  Marshal_w_byte(&d.w, MARSHAL_MAJOR_VERSION);
+  Marshal_w_byte(&d.w, MARSHAL_MINOR_VERSION);
+  marshal_w_object(&d, &v[1]);
+  if (d.io) marshal_flush(&d);
+  mrbc_decref(&d.objects);
+  mrbc_decref(&d.symbols);
+  if (d.addrs) mrbc_free(vm, d.addrs);
+  if (d.failed) {
+    if (!d.io && d.buf) mrbc_free(vm, d.buf);
+    return;
+  }
+  if (d.io) {
+    mrbc_incref(&v[2]);
+    SET_RETURN(v[2]);
+    return;
+  }
+  /* The buffer becomes the String as it is */
+  mrbc_value ret = mrbc_string_new_alloc(vm, d.buf, d.len);
+  SET_RETURN(ret);
+}
+
+/*
+ * Load
+ *
+ * Every object that can be the target of a '@' link goes into objects
+ * in the order it appears; the table holds a reference of its own.
+ */
+
+typedef struct {
+  mrbc_vm *vm;
+  mrbc_value *v;
+  int argc;
+  marshal_reader_t r;
+  mrbc_value *io;
+  mrbc_value objects;   /* Array */
+  mrbc_value symbols;   /* Array of Symbol */
+  int depth;
+  bool failed;
+} marshal_load_t;
+
+static void
+marshal_load_fail(marshal_load_t *l, mrbc_class *cls, const char *message)
+{
+  if (!l->failed && !marshal_exception_p(l->vm)) {
+    mrbc_raise(l->vm, cls, message ? message : "dump format error");
+  }
+  l->failed = true;
+}
+
+static void
+marshal_load_format_error(marshal_load_t *l)
+{
+  marshal_load_fail(l, MRBC_CLASS(ArgumentError), l->r.error);
+}
+
+static size_t
+marshal_fill(void *ctx, uint8_t *buf, size_t size)
+{
+  marshal_load_t *l = (marshal_load_t *)ctx;
+  mrbc_value n = mrbc_integer_value((mrbc_int_t)size);
+  size_t got = 0;
+
+  mrbc_value chunk = mrbc_send(l->vm, l->v, l->argc, l->io, "read", 1, &n);
+  if (chunk.tt == MRBC_TT_STRING) {
+    got = chunk.string->size;
+    if (size < got) got = size;
+    memcpy(buf, chunk.string->data, got);
+  }
+  mrbc_decref(&chunk);
+  if (marshal_exception_p(l->vm)) {
+    l->failed = true;
+    return 0;
+  }
+  return got;
+}
+
+static bool
+marshal_r_count(marshal_load_t *l, int32_t *n)
+{
+  if (!Marshal_r_long(&l->r, n)) {
+    marshal_load_format_error(l);
+    return false;
+  }
+  if (*n < 0) {
+    marshal_load_fail(l, MRBC_CLASS(ArgumentError), "dump format error (negative length)");
+    return false;
+  }
+  return true;
+}
+
+static bool
+marshal_r_bytes(marshal_load_t *l, mrbc_value *ret)
+{
+  int32_t len;
+
+  if (!marshal_r_count(l, &len)) return false;
+  *ret = mrbc_string_new(l->vm, NULL, len);
+  if (ret->tt != MRBC_TT_STRING) {
+    marshal_load_fail(l, MRBC_CLASS(NoMemoryError), "out of memory");
+    return false;
+  }
+  if (!Marshal_r_read(&l->r, ret->string->data, len)) {
+    mrbc_decref(ret);
+    marshal_load_format_error(l);
+    return false;
+  }
+  ret->string->data[len] = '\0';
+  return true;
+}
+
+static void
+marshal_entry(marshal_load_t *l, mrbc_value *obj)
+{
+  mrbc_incref(obj);
+  mrbc_array_push(&l->objects, obj);
+}
+
+static mrbc_value marshal_r_object(marshal_load_t *l);
+
+static bool
+marshal_r_symbol(marshal_load_t *l, mrbc_sym *sym)
+{
+  mrbc_value v = marshal_r_object(l);
+
+  if (l->failed) return false;
+  if (v.tt != MRBC_TT_SYMBOL) {
+    mrbc_decref(&v);
+    marshal_load_fail(l, MRBC_CLASS(ArgumentError), "dump format error (symbol expected)");
+    return false;
+  }
+  *sym = mrbc_symbol(v);
+  return true;
+}
+
+/* The ivars after an 'I' object or of an 'o'; only those of plain
+   objects are kept */
+static bool
+marshal_r_ivars(marshal_load_t *l, mrbc_value *obj)
+{
+  int32_t n;
+
+  if (!marshal_r_count(l, &n)) return false;
+  Marshal_r_expect(&l->r, 2 * (size_t)n);
+  for (int32_t i = 0; i < n; i++) {
+    mrbc_sym name;
+    if (!marshal_r_symbol(l, &name)) return false;
+    mrbc_value value = marshal_r_object(l);
+    if (l->failed) return false;
+    const char *s = mrbc_symid_to_str(name);
+    if (obj->tt == MRBC_TT_OBJECT && s[0] == '@') {
+      mrbc_value ivar = mrbc_symbol_new(l->vm, s + 1);
+      mrbc_instance_setiv(obj, mrbc_symbol(ivar), &value);
+    }
+    mrbc_decref(&value);
+  }
+  return true;
+}
+
+/* The constant a class path names. Data classes are objects in mruby/c,
+   so this is not always a class. */
+static mrbc_value *
+marshal_path2const(marshal_load_t *l, const char *path)
+{
+  mrbc_value *c = NULL;
+  char name[64];
+  const char *p = path;
+
+  while (*p) {
+    const char *q = strstr(p, "::");
+    size_t len = q ? (size_t)(q - p) : strlen(p);
+    if (sizeof(name) <= len) len = sizeof(name) - 1;
+    memcpy(name, p, len);
+    name[len] = '\0';
+    mrbc_sym sym = mrbc_symbol(mrbc_symbol_new(l->vm, name));
+    if (c == NULL) {
+      c = mrbc_get_const(sym);
+    } else if (c->tt == MRBC_TT_CLASS || c->tt == MRBC_TT_MODULE) {
+      c = mrbc_get_class_const(c->cls, sym);
+    } else {
+      c = NULL;
+    }
+    if (c == NULL) break;
+    p = q ? q + 2 : p + len;
+  }
+  if (c == NULL) {
+    char message[96];
+    snprintf(message, sizeof(message), "undefined class/module %s", path);
+    marshal_load_fail(l, MRBC_CLASS(ArgumentError), message);
+  }
+  return c;
+}
+
+static mrbc_value *
+marshal_r_const(marshal_load_t *l)
+{
+  mrbc_sym sym;
+
+  if (!marshal_r_symbol(l, &sym)) return NULL;
+  return marshal_path2const(l, mrbc_symid_to_str(sym));
+}
+
+static mrbc_class *
+marshal_r_class(marshal_load_t *l)
+{
+  mrbc_value *c = marshal_r_const(l);
+
+  if (c == NULL) return NULL;
+  if (c->tt != MRBC_TT_CLASS) {
+    marshal_load_fail(l, MRBC_CLASS(ArgumentError), "dump format error (class expected)");
+    return NULL;
+  }
+  return c->cls;
+}
+
+static mrbc_value
+marshal_r_object(marshal_load_t *l)
+{
+  mrbc_vm *vm = l->vm;
+  mrbc_value v = mrbc_nil_value();
+  uint8_t type;
+
+  if (l->failed) return v;
+  if (MARSHAL_MAX_DEPTH <= l->depth) {
+    marshal_load_fail(l, MRBC_CLASS(ArgumentError), "exceed depth limit");
+    return v;
+  }
+  Marshal_r_item(&l->r);
+  if (!Marshal_r_byte(&l->r, &type)) {
+    marshal_load_format_error(l);
+    return v;
+  }
+  l->depth++;
+  switch (type) {
+    case MARSHAL_TYPE_NIL:
+      break;
+    case MARSHAL_TYPE_TRUE:
+      v = mrbc_true_value();
+      break;
+    case MARSHAL_TYPE_FALSE:
+      v = mrbc_false_value();
+      break;
+    case MARSHAL_TYPE_FIXNUM: {
+      int32_t n;
+      if (!Marshal_r_long(&l->r, &n)) {
+        marshal_load_format_error(l);
+        break;
+      }
+      v = mrbc_integer_value(n);
+      break;
+    }
+    case MARSHAL_TYPE_BIGNUM: {
+      int64_t ival;
+      double fval;
+      bool fits;
+      if (!Marshal_r_bignum(&l->r, &ival, &fval, &fits)) {
+        marshal_load_format_error(l);
+        break;
+      }
+      if (fits && (int64_t)(mrbc_int_t)ival == ival) {
+        v = mrbc_integer_value((mrbc_int_t)ival);
+      } else {
+#if MRBC_USE_FLOAT
+        /* No Bignum here; a float keeps the magnitude */
+        v = mrbc_float_value(vm, fval);
+#else
+        marshal_load_fail(l, MRBC_CLASS(RangeError), "bignum too big");
+        break;
+#endif
+      }
+      marshal_entry(l, &v);
+      break;
+    }
+    case MARSHAL_TYPE_FLOAT: {
+      double d;
+      if (!Marshal_r_float(&l->r, &d)) {
+        marshal_load_format_error(l);
+        break;
+      }
+#if MRBC_USE_FLOAT
+      v = mrbc_float_value(vm, d);
+      marshal_entry(l, &v);
+#else
+      marshal_load_fail(l, MRBC_CLASS(NotImplementedError), "Float is not supported");
+#endif
+      break;
+    }
+    case MARSHAL_TYPE_STRING:
+      if (marshal_r_bytes(l, &v)) marshal_entry(l, &v);
+      break;
+    case MARSHAL_TYPE_SYMBOL: {
+      mrbc_value name;
+      if (!marshal_r_bytes(l, &name)) break;
+      v = mrbc_symbol_new(vm, (const char *)name.string->data);
+      mrbc_decref(&name);
+      mrbc_array_push(&l->symbols, &v);
+      break;
+    }
+    case MARSHAL_TYPE_SYMLINK:
+    case MARSHAL_TYPE_LINK: {
+      mrbc_value *table = type == MARSHAL_TYPE_LINK ? &l->objects : &l->symbols;
+      int32_t index;
+      if (!Marshal_r_long(&l->r, &index)) {
+        marshal_load_format_error(l);
+        break;
+      }
+      if (index < 0 || mrbc_array_size(table) <= index) {
+        marshal_load_fail(l, MRBC_CLASS(ArgumentError), "dump format error (unlinked)");
+        break;
+      }
+      v = mrbc_array_get(table, index);
+      mrbc_incref(&v);
+      break;
+    }
+    case MARSHAL_TYPE_IVAR:
+      /* Encoding and other ivars of a String, Symbol or Regexp */
+      v = marshal_r_object(l);
+      if (!l->failed) marshal_r_ivars(l, &v);
+      break;
+    case MARSHAL_TYPE_ARRAY: {
+      int32_t n;
+      if (!marshal_r_count(l, &n)) break;
+      v = mrbc_array_new(vm, 0);
+      marshal_entry(l, &v);
+      Marshal_r_expect(&l->r, n);
+      for (int32_t i = 0; i < n; i++) {
+        mrbc_value item = marshal_r_object(l);
+        if (l->failed) break;
+        mrbc_array_push(&v, &item);
+      }
+      break;
+    }
+    case MARSHAL_TYPE_HASH:
+    case MARSHAL_TYPE_HASH_DEF: {
+      int32_t n;
+      if (!marshal_r_count(l, &n)) break;
+      v = mrbc_hash_new(vm, 0);
+      marshal_entry(l, &v);
+      Marshal_r_expect(&l->r, 2 * (size_t)n + (type == MARSHAL_TYPE_HASH_DEF));
+      for (int32_t i = 0; i < n; i++) {
+        mrbc_value key = marshal_r_object(l);
+        if (l->failed) break;
+        mrbc_value value = marshal_r_object(l);
+        if (l->failed) {
+          mrbc_decref(&key);
+          break;
+        }
+        mrbc_hash_set(&v, &key, &value);
+      }
+      if (type == MARSHAL_TYPE_HASH_DEF && !l->failed) {
+        /* mruby/c has no Hash default; it is read and dropped */
+        mrbc_value def = marshal_r_object(l);
+        mrbc_decref(&def);
+      }
+      break;
+    }
+    case MARSHAL_TYPE_OBJECT:
+    case MARSHAL_TYPE_USRMARSHAL: {
+      mrbc_class *cls = marshal_r_class(l);
+      if (!cls) break;
+      v = mrbc_instance_new(vm, cls, 0);
+      marshal_entry(l, &v);
+      if (type == MARSHAL_TYPE_OBJECT) {
+        marshal_r_ivars(l, &v);
+        break;
+      }
+      mrbc_value data = marshal_r_object(l);
+      if (!l->failed) {
+        mrbc_value ret = mrbc_send(vm, l->v, l->argc, &v, "marshal_load", 1, &data);
+        mrbc_decref(&ret);
+        if (marshal_exception_p(vm)) l->failed = true;
+      }
+      mrbc_decref(&data);
+      break;
+    }
+    case MARSHAL_TYPE_STRUCT: {
+      mrbc_value *cls = marshal_r_const(l);
+      int32_t n;
+      if (!cls || !marshal_r_count(l, &n)) break;
+      int32_t index = mrbc_array_size(&l->objects);
+      mrbc_array_push(&l->objects, &v); /* taken once the values are in */
+      mrbc_value values = mrbc_array_new(vm, n);
+      Marshal_r_expect(&l->r, 2 * (size_t)n);
+      for (int32_t i = 0; i < n; i++) {
+        mrbc_sym member;
+        if (!marshal_r_symbol(l, &member)) break;
+        mrbc_value value = marshal_r_object(l);
+        if (l->failed) break;
+        mrbc_array_push(&values, &value);
+      }
+      if (!l->failed) {
+        /* new takes the values as separate arguments; Ruby spreads them */
+        mrbc_value marshal = *mrbc_get_const(mrbc_str_to_symid("Marshal"));
+        v = mrbc_send(vm, l->v, l->argc, &marshal, "_struct_new", 2, cls, &values);
+        if (marshal_exception_p(vm)) {
+          l->failed = true;
+        } else {
+          mrbc_incref(&v);
+          mrbc_array_set(&l->objects, index, &v);
+        }
+      }
+      mrbc_decref(&values);
+      break;
+    }
+    case MARSHAL_TYPE_USERDEF: {
+      mrbc_value *cls = marshal_r_const(l);
+      mrbc_value data;
+      if (!cls || !marshal_r_bytes(l, &data)) break;
+      v = mrbc_send(vm, l->v, l->argc, cls, "_load", 1, &data);
+      mrbc_decref(&data);
+      if (marshal_exception_p(vm)) {
+        l->failed = true;
+        break;
+      }
+      marshal_entry(l, &v);
+      break;
+    }
+    case MARSHAL_TYPE_CLASS:
+    case MARSHAL_TYPE_MODULE:
+    case MARSHAL_TYPE_MODULE_OLD: {
+      mrbc_value path;
+      if (!marshal_r_bytes(l, &path)) break;
+      mrbc_value *c = marshal_path2const(l, (const char *)path.string->data);
+      mrbc_decref(&path);
+      if (!c) break;
+      v = *c;
+      mrbc_incref(&v);
+      marshal_entry(l, &v);
+      break;
+    }
+    case MARSHAL_TYPE_EXTENDED:
+    case MARSHAL_TYPE_UCLASS: {
+      /* Neither the extending module nor the subclass is kept */
+      mrbc_sym sym;
+      if (marshal_r_symbol(l, &sym)) v = marshal_r_object(l);
+      break;
+    }
+    default: {
+      char message[32];
+      snprintf(message, sizeof(message), "dump format error(0x%x)", (int)type);
+      marshal_load_fail(l, MRBC_CLASS(ArgumentError), message);
+      break;
+    }
+  }
+  l->depth--;
+  if (l->failed) {
+    mrbc_decref(&v);
+    v = mrbc_nil_value();
+  }
+  return v;
+}
+
+/* Marshal.load(source): source is a String or an IO that answers read */
+static void
+c_marshal_load(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  uint8_t buf[MARSHAL_READ_BUFFER_SIZE];
+  uint8_t major = 0, minor = 0;
+  marshal_load_t l;
+
+  if (argc != 1) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+  memset(&l, 0, sizeof(l));
+  l.vm = vm;
+  l.v = v;
+  l.argc = argc;
+  if (GET_TT_ARG(1) == MRBC_TT_STRING) {
+    Marshal_reader_init(&l.r, GET_ARG(1).string->data, GET_ARG(1).string->size);
+  } else if (marshal_respond_to(&v[1], "read")) {
+    l.io = &v[1];
+    Marshal_reader_init_io(&l.r, buf, marshal_fill, &l);
+  } else {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "instance of IO needed");
+    return;
+  }
+  if (!Marshal_r_version(&l.r, &major, &minor)) {
+    if (l.r.error && strcmp(l.r.error, "incompatible") == 0) {
+      mrbc_raisef(vm, MRBC_CLASS(TypeError),
+                  "incompatible marshal file format (can't be read)\n\tformat version %d.%d required; %d.%d given",
+                  MARSHAL_MAJOR_VERSION, MARSHAL_MINOR_VERSION, (int)major, (int)minor);
+    } else if (!l.failed) {
+      marshal_load_format_error(&l);
+    }
+    return;
+  }
+  l.objects = mrbc_array_new(vm, 0);
+  l.symbols = mrbc_array_new(vm, 0);
+  mrbc_value ret = marshal_r_object(&l);
+  mrbc_decref(&l.objects);
+  mrbc_decref(&l.symbols);
+  if (l.failed) return;
+  SET_RETURN(ret);
+}
+
+void
+mrbc_marshal_init(mrbc_vm *vm)
+{
+  mrbc_class *module_Marshal = mrbc_define_module(vm, "Marshal");
+
+  mrbc_define_method(vm, module_Marshal, "dump", c_marshal_dump);
+  mrbc_define_method(vm, module_Marshal, "load", c_marshal_load);
+}
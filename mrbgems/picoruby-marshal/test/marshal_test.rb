@@ -1,3 +1,87 @@
+class MarshalTestPoint
+  attr_reader :x, :y
+  def initialize(x, y)
+    @x = x
+    @y = y
+  end
+end
+
+class MarshalTestReader
+  def initialize(data)
+    @data = data
+    @pos = 0
+  end
+
+  def read(n)
+    s = @data.byteslice(@pos, n)
+    @pos += n
+    s
+  end
+end
+
+# Answers what Marshal asks of a Struct, which neither VM has.
+# CRuby writes Struct.new(:a, :b) named MarshalTestPair the same way.
+class MarshalTestPair
+  attr_reader :a, :b
+  def self.members
+    [:a, :b]
+  end
+
+  def initialize(a, b)
+    @a = a
+    @b = b
+  end
+
+  def members
+    [:a, :b]
+  end
+
+  def to_h
+    {a: @a, b: @b}
+  end
+end
+
+MarshalTestCoord = Data.define(:lat, :lng) if Object.const_defined?(:Data)
+
+class MarshalTestVersion
+  attr_reader :s
+  def self._load(s)
+    new(s)
+  end
+
+  def initialize(s)
+    @s = s
+  end
+
+  def _dump(level)
+    @s
+  end
+end
+
+class MarshalTestBox
+  attr_reader :items
+  def initialize(items)
+    @items = items
+  end
+
+  def marshal_dump
+    [@items, :box]
+  end
+
+  def marshal_load(a)
+    @items = a[0]
+  end
+end
+
+module MarshalTestNS
+  class Point
+    attr_reader :x
+    def initialize(x)
+      @x = x
+    end
+  end
+end
+
 class MarshalTest < Picotest::Test
   def test_marshal_nil
     data = Marshal.dump(nil)
@@ -124,6 +208,109 @@ class MarshalTest < Picotest::Test
     assert_equal msg, result
   end
 
+  def test_marshal_dump_is_cruby_compatible
+    assert_equal "\x04\bI\"\nhello\x06:\x06ET", Marshal.dump("hello")
+    assert_equal "\x04\b[\ai\x06i\x02\xE8\x03", Marshal.dump([1, 1000])
+    assert_equal "\x04\bf\b1.5", Marshal.dump(1.5)
+  end
+
+  def test_marshal_shared_references
+    s = "x"
+    result = Marshal.load(Marshal.dump([s, s, :y, :y]))
+    assert_equal ["x", "x", :y, :y], result
+    assert result[0].equal?(result[1])
+  end
+
+  def test_marshal_object
+    result = Marshal.load(Marshal.dump(MarshalTestPoint.new(1, "two")))
+    assert_equal MarshalTestPoint, result.class
+    assert_equal 1, result.x
+    assert_equal "two", result.y
+  end
+
+  # The expected bytes below are what CRuby 3.3 writes
+
+  def test_marshal_struct_matches_cruby
+    data = "\x04\bS:\x14MarshalTestPair\a:\x06ai\x06:\x06bI\"\x06x\x06:\x06ET"
+    assert_equal data, Marshal.dump(MarshalTestPair.new(1, "x"))
+    result = Marshal.load(data)
+    assert_equal MarshalTestPair, result.class
+    assert_equal 1, result.a
+    assert_equal "x", result.b
+  end
+
+  def test_marshal_nested_class_matches_cruby
+    data = "\x04\bo:\x19MarshalTestNS::Point\x06:\a@xi\x06"
+    assert_equal data, Marshal.dump(MarshalTestNS::Point.new(1))
+    result = Marshal.load(data)
+    assert_equal MarshalTestNS::Point, result.class
+    assert_equal 1, result.x
+    assert_equal "\x04\bc\x19MarshalTestNS::Point", Marshal.dump(MarshalTestNS::Point)
+    assert_equal "\x04\bm\x12MarshalTestNS", Marshal.dump(MarshalTestNS)
+    assert_equal MarshalTestNS::Point, Marshal.load(Marshal.dump(MarshalTestNS::Point))
+  end
+
+  def test_marshal_load_cruby_data
+    skip "Data is not available" unless Object.const_defined?(:Data)
+    # Data.define does not name its class here, so only loading is checked
+    result = Marshal.load("\x04\bS:\x15MarshalTestCoord\a:\blati(:\blngi\x01\x8B")
+    assert_equal 35, result.lat
+    assert_equal 139, result.lng
+  end
+
+  def test_marshal_userdef_matches_cruby
+    data = "\x04\bu:\x17MarshalTestVersion\n1.2.3"
+    assert_equal data, Marshal.dump(MarshalTestVersion.new("1.2.3"))
+    result = Marshal.load(data)
+    assert_equal MarshalTestVersion, result.class
+    assert_equal "1.2.3", result.s
+  end
+
+  def test_marshal_load_cruby_userdef_with_encoding
+    # A UTF-8 string from _dump is written as 'Iu'; its E belongs to no object
+    result = Marshal.load("\x04\bIu:\x17MarshalTestVersion\n1.2.3\x06:\x06ET")
+    assert_equal MarshalTestVersion, result.class
+    assert_equal "1.2.3", result.s
+    assert_equal [:@s], result.instance_variables
+  end
+
+  def test_marshal_userdef_shared_reference
+    data = "\x04\b[\au:\x17MarshalTestVersion\x069@\x06"
+    v = MarshalTestVersion.new("9")
+    assert_equal data, Marshal.dump([v, v])
+    result = Marshal.load(data)
+    assert_equal "9", result[0].s
+    assert_equal result[0].object_id, result[1].object_id
+  end
+
+  def test_marshal_usrmarshal_matches_cruby
+    data = "\x04\bU:\x13MarshalTestBox[\a[\ai\x06I\"\x06a\x06:\x06ET:\bbox"
+    assert_equal data, Marshal.dump(MarshalTestBox.new([1, "a"]))
+    result = Marshal.load(data)
+    assert_equal MarshalTestBox, result.class
+    assert_equal [1, "a"], result.items
+  end
+
+  def test_marshal_usrmarshal_shared_reference
+    data = "\x04\b[\aU:\x13MarshalTestBox[\a[\x06i\a:\bbox@\x06"
+    b = MarshalTestBox.new([2])
+    assert_equal data, Marshal.dump([b, b])
+    result = Marshal.load(data)
+    assert_equal [2], result[0].items
+    assert_equal result[0].object_id, result[1].object_id
+  end
+
+  def test_marshal_bignum
+    # 2**40 as written by CRuby
+    assert_equal 1099511627776, Marshal.load("\x04\bl+\b\x00\x00\x00\x00\x00\x01")
+  end
+
+  def test_marshal_load_from_io_without_overread
+    io = MarshalTestReader.new(Marshal.dump([1, "a"]) + Marshal.dump({b: 2}))
+    assert_equal [1, "a"], Marshal.load(io)
+    assert_equal({b: 2}, Marshal.load(io))
+  end
+
   def test_marshal_version_check
     data = "\x04\x08" + "0"  # Valid version + nil
     result = Marshal.load(data)
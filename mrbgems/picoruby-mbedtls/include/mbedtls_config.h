@@ -106,6 +106,9 @@
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
 #define MBEDTLS_SSL_PROTO_TLS1_2
 
+/* Resume with RFC 5077 tickets as well as session IDs (SSLSocket#session) */
+#define MBEDTLS_SSL_SESSION_TICKETS
+
 /* Required for SSL_TLS_C */
 #define MBEDTLS_MD5_C
 #define MBEDTLS_SSL_ALPN
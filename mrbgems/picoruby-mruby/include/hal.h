@@ -61,7 +61,12 @@ void mrb_task_disable_irq(void);
 #define hal_enable_irq() mrb_task_enable_irq()
 #define hal_disable_irq() mrb_task_disable_irq()
 
-#if defined(PICORB_PLATFORM_POSIX)
+#if defined(PICORB_PLATFORM_POSIX) && !defined(__EMSCRIPTEN__)
+// Parks in the I/O reactor of picoruby-machine until the next tick
+// (SIGALRM) or until a watched fd becomes ready
+int picorb_reactor_wait(int timeout_ms);
+#define hal_idle_cpu(mrb)    picorb_reactor_wait(1000)
+#elif defined(PICORB_PLATFORM_POSIX)
 #define hal_idle_cpu(mrb)    sleep(1) // maybe interrupt by SIGINT
 #else
 void hal_idle_cpu(mrb_state *mrb);
@@ -0,0 +1,125 @@
+module Net
+  # --------------------------------------------------------------------------
+  # ChunkedDecoder - Incremental decoder for Transfer-Encoding: chunked
+  #
+  # Received bytes are fed as they arrive, split at any position.
+  # Chunk data is yielded without the framing, and every byte is looked at
+  # once, so decoding costs O(n) regardless of how the data was split.
+  # --------------------------------------------------------------------------
+  class ChunkedDecoder
+    STATE_SIZE = 0      # reading "<hex-size>[;ext]\r\n"
+    STATE_DATA = 1      # reading chunk data
+    STATE_DATA_END = 2  # reading "\r\n" after chunk data
+    STATE_TRAILER = 3   # reading trailer fields up to an empty line
+    STATE_DONE = 4
+
+    # Longest size or trailer line accepted
+    MAX_LINE_LENGTH = 1024
+
+    attr_reader :trailers
+
+    def initialize
+      @state = STATE_SIZE
+      @remaining = 0
+      @line = ""
+      @trailers = {}
+    end
+
+    def finished?
+      @state == STATE_DONE
+    end
+
+    # Decode data and yield each piece of chunk data.
+    # Returns bytes that follow the end of the body (a String, possibly
+    # empty) once finished, or nil while more data is needed.
+    def feed(data)
+      pos = 0
+      len = data.bytesize
+      while pos < len
+        if @state == STATE_DONE
+          break
+        elsif @state == STATE_DATA
+          n = len - pos
+          n = @remaining if @remaining < n
+          piece = data.byteslice(pos, n)
+          yield piece if piece
+          pos += n
+          @remaining -= n
+          @state = STATE_DATA_END if @remaining == 0
+        else
+          nl = pos
+          nl += 1 while nl < len && data.getbyte(nl) != 10 # "\n"
+          if nl == len
+            append_line(data.byteslice(pos, len - pos) || "")
+            pos = len
+          else
+            append_line(data.byteslice(pos, nl - pos) || "")
+            pos = nl + 1
+            line = @line
+            @line = ""
+            line = line.byteslice(0, line.bytesize - 1) || "" if line.end_with?("\r")
+            process_line(line)
+          end
+        end
+      end
+      return nil unless @state == STATE_DONE
+      data.byteslice(pos, len - pos) || ""
+    end
+
+    private
+
+    def append_line(str)
+      if MAX_LINE_LENGTH < @line.bytesize + str.bytesize
+        raise HTTPBadResponse, "Chunk line too long"
+      end
+      @line << str
+    end
+
+    def process_line(line)
+      case @state
+      when STATE_SIZE
+        @remaining = parse_size(line)
+        @state = (@remaining == 0) ? STATE_TRAILER : STATE_DATA
+      when STATE_DATA_END
+        raise HTTPBadResponse, "Missing CRLF after chunk data" unless line.empty?
+        @state = STATE_SIZE
+      when STATE_TRAILER
+        if line.empty?
+          @state = STATE_DONE
+        else
+          colon_idx = line.index(':')
+          if colon_idx
+            key = line.byteslice(0, colon_idx)&.strip
+            value = line.byteslice((colon_idx + 1)..-1)&.strip
+            @trailers[key.downcase] = value || '' if key
+          end
+        end
+      end
+    end
+
+    # "1a;name=value" -> 26
+    def parse_size(line)
+      size = 0
+      digits = 0
+      i = 0
+      while c = line.getbyte(i)
+        if 48 <= c && c <= 57       # '0'..'9'
+          d = c - 48
+        elsif 97 <= c && c <= 102   # 'a'..'f'
+          d = c - 87
+        elsif 65 <= c && c <= 70    # 'A'..'F'
+          d = c - 55
+        elsif c == 32 || c == 9 || c == 59 # ' ', '\t', ';'
+          break
+        else
+          raise HTTPBadResponse, "Invalid chunk size"
+        end
+        size = size * 16 + d
+        digits += 1
+        i += 1
+      end
+      raise HTTPBadResponse, "Invalid chunk size" if digits == 0
+      size
+    end
+  end
+end
@@ -8,8 +8,13 @@ module Net
   class HTTP
     attr_accessor :address, :port, :open_timeout, :read_timeout
     attr_accessor :use_ssl, :verify_mode, :ca_file, :ca_path
+    attr_accessor :keep_alive_timeout
     attr_reader :started
 
+    # Methods that may be sent again when a reused connection turned out
+    # to be closed by the server
+    IDEMPOTENT_METHODS = %w[GET HEAD PUT DELETE OPTIONS TRACE]
+
     # Create new HTTP client
     def initialize(address, port = nil)
       @address = address
@@ -22,38 +27,17 @@ module Net
       @ca_path = nil
       @open_timeout = 60
       @read_timeout = 60
+      # Seconds an idle persistent connection is trusted to be open
+      @keep_alive_timeout = 2
+      @last_communicated = nil
+      @requests_on_socket = 0
     end
 
     # Start HTTP session
     def start
       raise IOError, "HTTP session already started" if @started
 
-      # Create socket connection
-      begin
-        # Wrap with SSLSocket if SSL is enabled
-        if @use_ssl
-          # Create SSL context
-          ssl_ctx = SSLContext.new
-
-          # Set CA file if provided
-          if @ca_file
-            ssl_ctx.ca_file = @ca_file # steep:ignore
-          end
-
-          # Set verify mode (default to VERIFY_PEER if not specified)
-          ssl_ctx.verify_mode = @verify_mode || SSLContext::VERIFY_PEER
-
-          # Connect directly with hostname and port
-          # (avoids unnecessary plain TCP connection on platforms like RP2040
-          # where SSLSocket creates its own TLS+TCP connection internally)
-          @socket = SSLSocket.open(@address, @port, ssl_ctx)
-        else
-          @socket = TCPSocket.new(@address, @port)
-        end
-      rescue => e
-        raise IOError, "Failed to connect to #{@address}:#{@port} - #{e.message}"
-      end
-
+      connect
       @started = true
 
       # If block given, yield self and ensure finish
@@ -70,10 +54,7 @@ module Net
 
     # Finish HTTP session
     def finish
-      if @socket
-        @socket.close
-      end
-      @socket = nil
+      disconnect
       @started = false
     end
 
@@ -83,9 +64,12 @@ module Net
     end
 
     # Send GET request
+    # With a block, the body is yielded chunk by chunk as it arrives
+    # (response.body is not available then). With dest, each chunk is
+    # written to it (see HTTPResponse#read_body).
     if RUBY_ENGINE == 'mruby'
       def get(path, initheader = nil, dest = nil, &block)
-        request(Get.new(path, initheader), &block)
+        request_streaming(Get.new(path, initheader), dest, &block)
       end
     else # mruby/c
       def get(path, initheader = nil, dest = nil, &block)
@@ -95,7 +79,7 @@ module Net
           # @type var res: Net::HTTPResponse
           return res # Truth: It's a String
         end
-        request(Get.new(path, initheader), &block)
+        request_streaming(Get.new(path, initheader), dest, &block)
       end
     end
 
@@ -108,50 +92,95 @@ module Net
     def post(path, data, initheader = nil, dest = nil, &block)
       req = Post.new(path, initheader)
       req.body = data
-      request(req, &block)
+      request_streaming(req, dest, &block)
     end
 
     # Send PUT request
     def put(path, data, initheader = nil, dest = nil, &block)
       req = Put.new(path, initheader)
       req.body = data
-      request(req, &block)
+      request_streaming(req, dest, &block)
     end
 
     # Send DELETE request
     def delete(path, initheader = nil, dest = nil, &block)
-      request(Delete.new(path, initheader), &block)
+      request_streaming(Delete.new(path, initheader), dest, &block)
     end
 
     # Send generic HTTP request
+    # In a started session the connection is kept alive and reused by the
+    # next request. Without a session, one is started for this request only.
     def request(req, body = nil, &block)
-      start unless @started
       raise ArgumentError, "Request must be an HTTPRequest" unless req.is_a?(HTTPGenericRequest)
+      unless @started
+        req['connection'] ||= 'close'
+        response = nil
+        start do
+          response = request(req, body, &block)
+        end
+        # @type var response: HTTPResponse
+        return response
+      end
 
       # Set body if provided
       req.body = body if body
 
       # Set default headers
+      req['connection'] ||= 'keep-alive'
       req.set_default_headers(@address, @port)
 
-      # Send request
-      request_string = req.to_s
-      @socket.write(request_string)
-
-      # Read response
-      response_string = read_response
+      response = transport_request(req)
 
-      # Parse response
-      response = HTTPResponse.parse(response_string)
-
-      # Call block with response body if given
-      if block && response.body
-        yield response.body
+      if block
+        # Let the block stream the body with response.read_body { |chunk| }
+        yield response
       end
+      # Whatever the block did not read is read here so that the
+      # connection is left at the end of the response
+      response.read_body unless response.body_read?
 
+      end_transport(req, response)
       response
     end
 
+    # Send several requests over one connection without waiting for each
+    # response (HTTP pipelining), and return the responses in order.
+    # Only idempotent requests can be pipelined. IOError is raised when the
+    # server closes the connection before answering all of them.
+    def pipeline(requests)
+      raise IOError, "HTTP session not yet started" unless @started
+      wire = ""
+      i = 0
+      while i < requests.size
+        req = requests[i]
+        unless IDEMPOTENT_METHODS.include?(req.method)
+          raise ArgumentError, "#{req.method} request cannot be pipelined"
+        end
+        req['connection'] ||= 'keep-alive'
+        req.set_default_headers(@address, @port)
+        wire << req.to_s
+        i += 1
+      end
+      begin_transport
+      socket = @socket
+      raise IOError, "not connected" unless socket
+      socket.write(wire)
+      responses = [] #: Array[HTTPResponse]
+      i = 0
+      while i < requests.size
+        response = HTTPResponse.read_new(socket, requests[i].response_body_permitted?)
+        response.read_body
+        responses << response
+        end_transport(requests[i], response)
+        socket = @socket
+        i += 1
+        if socket.nil? && i < requests.size
+          raise IOError, "connection closed after #{i} of #{requests.size} pipelined requests"
+        end
+      end
+      responses
+    end
+
     # Class method: Simple GET request
     # Note: Renamed from 'get' to avoid mruby/c limitation where class methods
     # and instance methods cannot have the same name
@@ -170,14 +199,9 @@ module Net
         use_ssl = false
       end
 
-      http = new(host, port)
-      http.use_ssl = use_ssl if use_ssl
-      body = nil
-      http.start do |h|
-        response = h.get(path)
-        body = response.body
+      HTTPConnectionPool::DEFAULT.with(host, port, use_ssl) do |h|
+        h.get(path).body
       end
-      body
     end
 
     if RUBY_ENGINE == 'mruby'
@@ -203,9 +227,7 @@ module Net
         use_ssl = false
       end
 
-      http = new(host, port)
-      http.use_ssl = use_ssl if use_ssl
-      http.start do |h|
+      HTTPConnectionPool::DEFAULT.with(host, port, use_ssl) do |h|
         h.get(path)
       end
     end
@@ -218,92 +240,105 @@ module Net
       req['content-type'] = 'application/x-www-form-urlencoded'
       req.body = URI.encode_www_form(params)
 
-      http = new(uri.host, uri.port)
-      http.use_ssl = (uri.scheme == 'https')
-      http.start do |h|
+      HTTPConnectionPool::DEFAULT.with(uri.host, uri.port, uri.scheme == 'https') do |h|
         h.request(req)
       end
     end
 
     private
 
-    # Read full HTTP response from socket
-    def read_response
-      response = ""
-      headers_done = false
-      content_length = nil
-
-      # Read status line and headers
+    def connect
+      # Create socket connection
       begin
-        while true
-          response << @socket.readpartial(100)
+        # Wrap with SSLSocket if SSL is enabled
+        if @use_ssl
+          # Create SSL context
+          ssl_ctx = SSLContext.new
 
-          # Check if we have complete headers
-          if response.include?("\r\n\r\n")
-            headers_done = true
-            break
+          # Set CA file if provided
+          if @ca_file
+            ssl_ctx.ca_file = @ca_file # steep:ignore
           end
+
+          # Set verify mode (default to VERIFY_PEER if not specified)
+          ssl_ctx.verify_mode = @verify_mode || SSLContext::VERIFY_PEER
+
+          # Connect directly with hostname and port
+          # (avoids unnecessary plain TCP connection on platforms like RP2040
+          # where SSLSocket creates its own TLS+TCP connection internally)
+          @socket = SSLSocket.open(@address, @port, ssl_ctx)
+        else
+          @socket = TCPSocket.new(@address, @port)
         end
-      rescue EOFError
+      rescue => e
+        raise IOError, "Failed to connect to #{@address}:#{@port} - #{e.message}"
       end
+      @last_communicated = nil
+      @requests_on_socket = 0
+    end
 
-      unless headers_done
-        raise HTTPBadResponse, "Incomplete HTTP headers"
-      end
+    def disconnect
+      socket = @socket
+      @socket = nil
+      socket.close if socket && !socket.closed?
+    end
 
-      # Parse headers to determine body reading strategy
-      header_end = response.index("\r\n\r\n") || 0
-      headers_part = response[0..header_end + 3] || ''
-
-      # Check for Content-Length (case-insensitive search)
-      headers_lower = headers_part.downcase
-      cl_idx = headers_lower.index('content-length:')
-      if cl_idx
-        # Extract the value after "content-length:"
-        start_idx = cl_idx + 15  # length of "content-length:"
-        line_end = headers_part.index("\r\n", start_idx)
-        if line_end
-          value_str = headers_part[start_idx..(line_end - 1)]&.strip || ''
-          # Parse integer from string
-          i = 0
-          started = false
-          while c = value_str.getbyte(i)
-            if 48 <= c && c <= 57 # '0'..'9'
-              content_length = (content_length || 0) * 10 + (c - 48) # '0'.ord
-              started = true
-            else
-              break if started # stop at first non-digit after digits
-            end
-            i += 1
-          end
-        end
+    # Reconnect if the connection was closed or has been idle too long
+    def begin_transport
+      if @socket && @last_communicated
+        idle_us = Machine.uptime_us - @last_communicated.to_i
+        disconnect if @keep_alive_timeout * 1_000_000 < idle_us
       end
+      if @socket.nil? || @socket&.closed?
+        connect
+      end
+    end
 
-      # Read body based on headers
-      if !content_length.nil?
-        # Read exact content length
-        # @type var content_length: Integer
-        remaining = content_length - (response.bytesize - header_end - 4)
-        if remaining > 0
-          body = @socket.read(remaining)
-          response << body if body
-        end
-      elsif headers_lower.index('transfer-encoding:') && headers_lower.index('chunked')
-        # Read chunked encoding (simplified)
-        begin
-          while true
-            response << @socket.readpartial(100)
-            break if response.end_with?("\r\n0\r\n\r\n")
-          end
-        rescue EOFError
-        end
+    # Keep the connection for the next request, or close it
+    def end_transport(req, response)
+      req_conn = req['connection']
+      if response.keep_alive? && !(req_conn && req_conn.downcase == 'close')
+        @last_communicated = Machine.uptime_us
+        @requests_on_socket += 1
       else
-        # Read until connection closes
-        body = @socket.read
-        response << body unless body.empty?
+        disconnect
       end
+    end
 
-      response
+    # Write req and read the response headers.
+    # A server may close an idle persistent connection at any time, so an
+    # idempotent request on a reused connection is sent once more on a
+    # fresh connection if the old one turns out to be dead.
+    def transport_request(req)
+      begin_transport
+      reused = 0 < @requests_on_socket
+      begin
+        return send_and_read_headers(req)
+      rescue => e
+        raise e unless reused && IDEMPOTENT_METHODS.include?(req.method)
+      end
+      disconnect
+      connect
+      send_and_read_headers(req)
+    end
+
+    def send_and_read_headers(req)
+      socket = @socket
+      raise IOError, "not connected" unless socket
+      socket.write(req.to_s)
+      # Read status line and headers; the body stays in the socket
+      HTTPResponse.read_new(socket, req.response_body_permitted?)
+    end
+
+    def request_streaming(req, dest, &block)
+      return request(req) unless block || dest
+      request(req) do |response|
+        if block
+          response.read_body(&block)
+        else
+          response.read_body(dest)
+        end
+      end
     end
 
     # Check if using SSL
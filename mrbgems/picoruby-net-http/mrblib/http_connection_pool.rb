@@ -0,0 +1,105 @@
+module Net
+  # --------------------------------------------------------------------------
+  # HTTPConnectionPool - Started Net::HTTP sessions kept for reuse
+  #
+  # Repeated requests to the same host reuse the open TCP connection, and
+  # on HTTPS the TLS session, instead of connecting (and handshaking) again.
+  # A session left idle longer than its keep_alive_timeout is finished the
+  # next time the pool is used, or by #prune.
+  # --------------------------------------------------------------------------
+  class HTTPConnectionPool
+    DEFAULT_SIZE = 2
+
+    attr_reader :size
+
+    def initialize(size = DEFAULT_SIZE)
+      @size = size
+      @idle = [] #: Array[HTTP]
+      # Machine.uptime_us at which each idle session was checked in
+      @idle_since = [] #: Array[Integer]
+    end
+
+    # Number of idle sessions
+    def idle_count
+      @idle.size
+    end
+
+    # Take an idle session for host, or start a new one
+    def checkout(host, port, use_ssl)
+      prune
+      i = 0
+      while i < @idle.size
+        http = @idle[i]
+        if http.address == host && http.port == port && http.use_ssl == use_ssl
+          @idle.delete_at(i)
+          @idle_since.delete_at(i)
+          return http if http.started
+        else
+          i += 1
+        end
+      end
+      http = HTTP.new(host, port)
+      http.use_ssl = use_ssl
+      http.start
+      http
+    end
+
+    # Return a session; the oldest idle one is finished when the pool is full
+    def checkin(http)
+      prune
+      return unless http.started
+      @idle << http
+      @idle_since << Machine.uptime_us
+      if @size < @idle.size
+        @idle_since.shift
+        @idle.shift&.finish
+      end
+      nil
+    end
+
+    # Yield a session for host and return it to the pool afterwards.
+    # A session that raised is finished rather than reused.
+    def with(host, port, use_ssl)
+      http = checkout(host, port, use_ssl)
+      begin
+        result = yield(http)
+      rescue => e
+        http.finish
+        raise e
+      end
+      checkin(http)
+      result
+    end
+
+    # Finish the idle sessions that have outlived their keep_alive_timeout
+    def prune
+      now = Machine.uptime_us
+      i = 0
+      while i < @idle.size
+        http = @idle[i]
+        if http.keep_alive_timeout * 1_000_000 < now - @idle_since[i]
+          @idle.delete_at(i)
+          @idle_since.delete_at(i)
+          http.finish
+        else
+          i += 1
+        end
+      end
+      nil
+    end
+
+    # Finish all idle sessions
+    def clear
+      @idle_since.clear
+      while http = @idle.shift
+        http.finish
+      end
+      nil
+    end
+
+    # Pool shared by Net::HTTP.get, get_response and post_form.
+    # Nothing prunes it between calls, so a script that is done with HTTP
+    # should call DEFAULT.clear to free the sockets (and TLS contexts).
+    DEFAULT = HTTPConnectionPool.new
+  end
+end
@@ -7,7 +7,12 @@ module Net
   # --------------------------------------------------------------------------
   class HTTPResponse
     attr_reader :code, :message, :http_version
-    attr_accessor :header, :body
+    attr_accessor :header
+    attr_writer :body
+
+    # Size of each body chunk read from the socket.
+    # Follows the socket receive buffer so that one chunk is one recv.
+    BODY_CHUNK_SIZE = BasicSocket::READ_BUFFER_SIZE
 
     def initialize(code = nil, message = nil, http_version = nil)
       @code = code
@@ -15,6 +20,10 @@ module Net
       @http_version = http_version
       @header = {}
       @body = nil
+      @socket = nil
+      @body_exist = false
+      @read = true
+      @trailers = {}
     end
 
     # Parse raw HTTP response
@@ -28,9 +37,39 @@ module Net
         raise HTTPBadResponse, "Invalid HTTP response"
       end
 
-      # Parse status line
-      status_line = lines.shift
-      # Expected format: "HTTP/1.1 200 OK"
+      response = new_from_status_line(lines.shift)
+
+      # Parse headers
+      while !lines.empty? && (line = lines.shift) && line != ""
+        response.add_header_line(line)
+      end
+
+      # Remaining lines are body
+      response.body = lines.join("\r\n") if !lines.empty?
+
+      response
+    end
+
+    # Read the status line and headers from socket.
+    # The body is left in the socket until read_body (or body) is called.
+    def self.read_new(socket, body_permitted = true)
+      status_line = socket.gets("\r\n")
+      if status_line.nil? || status_line.empty?
+        raise HTTPBadResponse, "Empty HTTP response"
+      end
+      response = new_from_status_line(status_line.strip)
+      while true
+        line = socket.gets("\r\n")
+        raise HTTPBadResponse, "Incomplete HTTP headers" if line.nil?
+        break if line == "\r\n"
+        response.add_header_line(line)
+      end
+      response.__attach_body(socket, body_permitted)
+      response
+    end
+
+    # Expected format: "HTTP/1.1 200 OK"
+    def self.new_from_status_line(status_line)
       if status_line && status_line.start_with?('HTTP/')
         parts = status_line.split(' ', 3)
         if parts.length >= 3
@@ -43,23 +82,113 @@ module Net
       else
         raise HTTPBadResponse, "Invalid HTTP response status line"
       end
+      new(code, message, http_version)
+    end
 
-      response = new(code, message, http_version)
+    # Parse "Key: value" and store it with a downcased key
+    def add_header_line(line)
+      colon_idx = line.index(':')
+      if colon_idx
+        key = line.byteslice(0, colon_idx)&.strip
+        value = line.byteslice((colon_idx + 1)..-1)&.strip
+        @header[key.downcase] = value || '' if key
+      end
+    end
 
-      # Parse headers
-      while !lines.empty? && (line = lines.shift) && line != ""
-        colon_idx = line.index(':')
-        if colon_idx
-          key = line.byteslice(0, colon_idx)&.strip
-          value = line.byteslice((colon_idx + 1)..-1)&.strip
-          response.header[key.downcase] = value || '' if key
-        end
+    # Called by Net::HTTP after the headers are read
+    def __attach_body(socket, body_permitted)
+      code = @code.to_i
+      @socket = socket
+      @body_exist = body_permitted && 200 <= code && code != 204 && code != 304
+      @read = false
+    end
+
+    # Whole body as a String. Reads it from the socket on first call.
+    def body
+      read_body unless @read
+      @body
+    end
+
+    # Trailer fields of a chunked body (downcased keys).
+    # Available after the body has been read.
+    def trailers
+      @trailers
+    end
+
+    # True once the body has been read (or there is no body to read)
+    def body_read?
+      @read
+    end
+
+    # Whether the server lets the connection be used for another request.
+    # A body that ends only when the connection closes cannot be followed
+    # by another response.
+    def keep_alive?
+      conn = @header['connection']
+      conn = conn.downcase if conn
+      return false if conn && conn.include?('close')
+      return false if @body_exist && !chunked? && content_length.nil?
+      if @http_version == '1.0'
+        return !conn.nil? && conn.include?('keep-alive')
       end
+      true
+    end
 
-      # Remaining lines are body
-      response.body = lines.join("\r\n") if !lines.empty?
+    def content_length
+      value = @header['content-length']
+      return nil unless value
+      len = value.to_i
+      len < 0 ? nil : len
+    end
 
-      response
+    def chunked?
+      value = @header['transfer-encoding']
+      return false unless value
+      value.downcase.include?('chunked')
+    end
+
+    # Read the body.
+    #   read_body                 -> whole body as a String
+    #   read_body { |chunk| ... } -> each chunk as it arrives (body is not kept)
+    #   read_body(dest)           -> each chunk is written to dest with
+    #                                dest.write (File, socket) or dest << (String)
+    # Memory use is bounded by BODY_CHUNK_SIZE unless the whole body is kept.
+    def read_body(dest = nil, &block)
+      if @read
+        # A kept body (e.g. from HTTPResponse.parse) is passed as one chunk;
+        # a body that was already streamed cannot be read again.
+        if dest || block
+          body = @body
+          raise IOError, "read_body called twice" unless body
+          if block
+            block.call(body)
+          else
+            write_chunk(dest, body)
+          end
+        end
+        return @body
+      end
+      @read = true
+      if block
+        each_body_chunk(&block)
+        return nil
+      elsif dest
+        each_body_chunk { |chunk| write_chunk(dest, chunk) }
+        return dest
+      end
+      return nil unless @body_exist
+      body = ""
+      each_body_chunk { |chunk| body << chunk }
+      @body = body
+    end
+
+    # Stream the body into a file without keeping it in memory.
+    # Works with any File class that supports File.open(path, "w").
+    def save_body(path)
+      File.open(path, "w") do |file|
+        read_body(file)
+      end
+      nil
     end
 
     # Get header value (case-insensitive)
@@ -77,14 +206,6 @@ module Net
       [self[key]]
     end
 
-    # Read body (for compatibility)
-    def read_body(&block)
-      if block
-        yield @body || ''
-      end
-      @body
-    end
-
     # Check if response is successful (2xx)
     def success?
       @code && @code.to_i >= 200 && @code.to_i < 300
@@ -133,6 +254,47 @@ module Net
     def to_s
       "#{@http_version} #{@code} #{@message}"
     end
+
+    private
+
+    def write_chunk(dest, chunk)
+      if dest.respond_to?(:write)
+        dest.write(chunk)
+      else
+        dest << chunk
+      end
+    end
+
+    def each_body_chunk
+      socket = @socket
+      @socket = nil
+      return unless socket && @body_exist
+      if chunked?
+        decoder = ChunkedDecoder.new
+        rest = nil
+        while rest.nil?
+          rest = decoder.feed(socket.readpartial(BODY_CHUNK_SIZE)) do |chunk|
+            yield chunk
+          end
+        end
+        # Bytes after the body belong to the next response
+        socket.ungetc(rest) if !rest.empty? && socket.respond_to?(:ungetc)
+        @trailers = decoder.trailers
+      elsif remaining = content_length
+        while 0 < remaining
+          chunk = socket.readpartial(remaining < BODY_CHUNK_SIZE ? remaining : BODY_CHUNK_SIZE)
+          remaining -= chunk.bytesize
+          yield chunk
+        end
+      else
+        begin
+          while true
+            yield socket.readpartial(BODY_CHUNK_SIZE)
+          end
+        rescue EOFError
+        end
+      end
+    end
   end
 
   # Response code type classes
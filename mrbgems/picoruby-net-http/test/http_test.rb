@@ -4,6 +4,29 @@
 # actual network connections. Full integration tests would require
 # a test HTTP server.
 
+# Minimal socket that serves a canned response
+class FakeHTTPSocket
+  def initialize(data)
+    @data = data
+  end
+
+  def gets(sep)
+    return nil if @data.empty?
+    idx = @data.index(sep)
+    len = idx ? idx + sep.bytesize : @data.bytesize
+    line = @data.byteslice(0, len) || ""
+    @data = @data.byteslice(len, @data.bytesize - len) || ""
+    line
+  end
+
+  def readpartial(maxlen)
+    raise EOFError, "end of file reached" if @data.empty?
+    chunk = @data.byteslice(0, maxlen) || ""
+    @data = @data.byteslice(chunk.bytesize, @data.bytesize - chunk.bytesize) || ""
+    chunk
+  end
+end
+
 class NetHTTPTest < Picotest::Test
   # Test 1: Net::HTTP class exists
   def test_net_http_class_exists
@@ -81,6 +104,146 @@ class NetHTTPTest < Picotest::Test
     assert_equal 'Hello', response.body
   end
 
+  # Test 12b: HTTPResponse streams a Content-Length body in chunks
+  def test_http_response_read_new_streaming
+    socket = FakeHTTPSocket.new("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nHello")
+    response = Net::HTTPResponse.read_new(socket)
+    assert_equal '200', response.code
+    assert_equal '5', response['content-length']
+    body = ""
+    response.read_body { |chunk| body << chunk }
+    assert_equal 'Hello', body
+    assert_raise(IOError) { response.read_body { |chunk| } }
+  end
+
+  # Test 12c: HTTPResponse decodes a chunked body into dest
+  def test_http_response_read_new_chunked
+    socket = FakeHTTPSocket.new("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nHel\r\n2\r\nlo\r\n0\r\n\r\n")
+    response = Net::HTTPResponse.read_new(socket)
+    dest = ""
+    response.read_body(dest)
+    assert_equal 'Hello', dest
+    assert_equal({}, response.trailers)
+  end
+
+  # Test 12d: ChunkedDecoder handles data split at any position
+  def test_chunked_decoder_split_input
+    data = "5\r\nHello\r\n7;ext=1\r\n, world\r\n0\r\nX-Checksum: abc\r\n\r\nNEXT"
+    decoder = Net::ChunkedDecoder.new
+    body = ""
+    rest = nil
+    i = 0
+    while rest.nil?
+      rest = decoder.feed(data.byteslice(i, 3) || "") { |chunk| body << chunk }
+      i += 3
+    end
+    assert_equal 'Hello, world', body
+    assert_equal 'abc', decoder.trailers['x-checksum']
+    assert_true decoder.finished?
+    assert_equal 'N', rest
+    assert_equal 'NEXT', rest + data.byteslice(i, data.bytesize - i)
+  end
+
+  # Test 12e: ChunkedDecoder rejects a malformed size line
+  def test_chunked_decoder_invalid_size
+    decoder = Net::ChunkedDecoder.new
+    assert_raise(Net::HTTPBadResponse) { decoder.feed("zz\r\n") { |chunk| } }
+  end
+
+  # Test 12f: HTTPResponse keep-alive rules
+  def test_http_response_keep_alive
+    response = Net::HTTPResponse.read_new(FakeHTTPSocket.new("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"))
+    assert_true response.keep_alive?
+    response = Net::HTTPResponse.read_new(FakeHTTPSocket.new("HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 0\r\n\r\n"))
+    assert_false response.keep_alive?
+    # Body delimited by connection close
+    response = Net::HTTPResponse.read_new(FakeHTTPSocket.new("HTTP/1.1 200 OK\r\n\r\n"))
+    assert_false response.keep_alive?
+    response = Net::HTTPResponse.read_new(FakeHTTPSocket.new("HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n"))
+    assert_false response.keep_alive?
+    response = Net::HTTPResponse.read_new(FakeHTTPSocket.new("HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 0\r\n\r\n"))
+    assert_true response.keep_alive?
+  end
+
+  # Test 12g: HTTPConnectionPool starts empty
+  def test_http_connection_pool_new
+    pool = Net::HTTPConnectionPool.new(3)
+    assert_equal 3, pool.size
+    assert_equal 0, pool.idle_count
+  end
+
+  # Test 12h: HTTPConnectionPool reuses checked-in sessions
+  def test_http_connection_pool_checkout_and_checkin
+    server = TCPServer.new("127.0.0.1", 18110)
+    pool = Net::HTTPConnectionPool.new(1)
+    first = pool.checkout("127.0.0.1", 18110, false)
+    assert_true first.started
+    pool.checkin(first)
+    assert_equal 1, pool.idle_count
+    assert_equal first.object_id, pool.checkout("127.0.0.1", 18110, false).object_id
+    assert_equal 0, pool.idle_count
+    second = pool.checkout("127.0.0.1", 18110, false)
+    assert_true first.object_id != second.object_id
+    pool.checkin(first)
+    pool.checkin(second)
+    # The pool is full, so the oldest idle session is finished
+    assert_equal 1, pool.idle_count
+    assert_false first.started
+    pool.checkin(first)
+    assert_equal 1, pool.idle_count
+    pool.with("127.0.0.1", 18110, false) do |http|
+      assert_equal second.object_id, http.object_id
+    end
+    assert_equal 1, pool.idle_count
+    assert_raise(RuntimeError) do
+      pool.with("127.0.0.1", 18110, false) { raise "boom" }
+    end
+    assert_equal 0, pool.idle_count
+    assert_false second.started
+    pool.clear
+    server.close
+  end
+
+  # Test 12i: HTTPConnectionPool finishes sessions idle past keep_alive_timeout
+  def test_http_connection_pool_prunes_expired_sessions
+    server = TCPServer.new("127.0.0.1", 18112)
+    pool = Net::HTTPConnectionPool.new(2)
+    expired = pool.checkout("127.0.0.1", 18112, false)
+    expired.keep_alive_timeout = 0
+    fresh = pool.checkout("127.0.0.1", 18112, false)
+    pool.checkin(expired)
+    pool.checkin(fresh)
+    sleep_ms 2
+    pool.prune
+    assert_equal 1, pool.idle_count
+    assert_false expired.started
+    assert_true fresh.started
+    # checkout prunes before it looks for a session
+    fresh.keep_alive_timeout = 0
+    sleep_ms 2
+    other = pool.checkout("127.0.0.1", 18112, false)
+    assert_true fresh.object_id != other.object_id
+    assert_false fresh.started
+    assert_equal 0, pool.idle_count
+    other.finish
+    server.close
+  end
+
+  # Test 12j: pipeline raises when the server closes the connection early
+  def test_http_pipeline_connection_closed
+    server = TCPServer.new("127.0.0.1", 18111)
+    http = Net::HTTP.new("127.0.0.1", 18111)
+    http.start
+    peer = server.accept
+    peer.write("HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\nok")
+    assert_raise(IOError) do
+      http.pipeline([Net::Get.new("/a"), Net::Get.new("/b")])
+    end
+    http.finish
+    peer.close
+    server.close
+  end
+
   # Test 13: HTTPResponse success check
   def test_http_response_success
     response = Net::HTTPResponse.new('200', 'OK', '1.1')
@@ -0,0 +1,96 @@
+#ifndef WEBSOCKET_DEFINED_H_
+#define WEBSOCKET_DEFINED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest message WS_inflate produces; a peer can't make us allocate
+ * more than this however small the compressed payload is */
+#ifndef WS_INFLATE_MAX_SIZE
+#define WS_INFLATE_MAX_SIZE (1024 * 1024)
+#endif
+
+/* Entries in the match table of WS_deflate, a power of 2. Each takes
+ * four bytes for as long as a message is being compressed. */
+#ifndef WS_DEFLATE_HASH_SIZE
+#define WS_DEFLATE_HASH_SIZE 1024
+#endif
+
+/* 2 bytes, 8 of extended length and 4 of masking key */
+#define WS_MAX_HEADER_SIZE 14
+
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT         0x1
+#define WS_OPCODE_BINARY       0x2
+#define WS_OPCODE_CLOSE        0x8
+#define WS_OPCODE_PING         0x9
+#define WS_OPCODE_PONG         0xA
+
+typedef struct {
+  bool fin;
+  /* Set on the first frame of a permessage-deflate message */
+  bool rsv1;
+  uint8_t opcode;
+  bool masked;
+  uint8_t mask_key[4];
+  uint64_t length;
+  size_t header_size;
+} ws_header_t;
+
+/*
+ * Parse the frame header at the head of buf.
+ *
+ * Returns 1 with h filled in, 0 if len is too short (h->header_size is
+ * then the number of bytes needed to go on) or -1 with *error set when
+ * the header breaks RFC 6455: RSV2 or RSV3 set, an unknown opcode, a
+ * fragmented or over-long control frame, or a length with its most
+ * significant bit set.
+ */
+int WS_parse_header(const uint8_t *buf, size_t len, ws_header_t *h, const char **error);
+
+/* Write the header of a frame to out, which has WS_MAX_HEADER_SIZE
+ * bytes, and return its size. mask_key is NULL for an unmasked frame. */
+size_t WS_encode_header(uint8_t *out, bool fin, bool rsv1, uint8_t opcode,
+                        uint64_t length, const uint8_t *mask_key);
+
+/* XOR data with the repeated mask_key in place. Masking twice restores
+ * the data. */
+void WS_mask(uint8_t *data, size_t len, const uint8_t mask_key[4]);
+
+/* realloc(3) with the VM's allocator; free when size is 0 */
+typedef void *(*ws_realloc_t)(void *ctx, void *ptr, size_t size);
+
+/* Output of WS_deflate and WS_inflate. capa is always more than len so
+ * that the VM glue can terminate the data in place. */
+typedef struct {
+  uint8_t *data;
+  size_t len;
+  size_t capa;
+  ws_realloc_t realloc;
+  void *ctx;
+} ws_buffer_t;
+
+/*
+ * permessage-deflate (RFC 7692) without context takeover: every
+ * message is compressed on its own, so no window survives between
+ * messages.
+ *
+ * WS_deflate compresses src with fixed Huffman codes and back
+ * references no further than 1 << window_bits (8 to 15), and leaves out
+ * the trailing 0x00 0x00 0xff 0xff. WS_inflate takes a payload in that
+ * form. Both return NULL on success or a static message; out is then
+ * to be freed by the caller either way.
+ */
+const char *WS_deflate(const uint8_t *src, size_t len, int window_bits, ws_buffer_t *out);
+const char *WS_inflate(const uint8_t *src, size_t len, ws_buffer_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WEBSOCKET_DEFINED_H_ */
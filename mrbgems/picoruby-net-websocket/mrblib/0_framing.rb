@@ -0,0 +1,169 @@
+require 'rng'
+
+module Net
+  module WebSocket
+    # Frame I/O shared by Client and Server::Connection. The including
+    # class sets @socket and @masked, and @deflate once permessage-deflate
+    # has been agreed on.
+    module Framing
+      # Bytes asked of the socket at a time
+      READ_SIZE = 1024
+
+      # permessage-deflate as offered and accepted. Messages are
+      # compressed one by one, so neither side keeps a window between them.
+      DEFLATE_EXTENSION = "permessage-deflate; server_no_context_takeover; client_no_context_takeover"
+
+      # Largest message, in bytes, that receive takes before it closes the
+      # connection with CLOSE_MESSAGE_TOO_BIG. Compressed messages are
+      # also limited to Frame::MAX_MESSAGE_SIZE once inflated.
+      attr_accessor :max_message_size
+
+      private
+
+      def init_framing(masked, max_message_size)
+        @masked = masked
+        @max_message_size = max_message_size
+        @rbuf = ""
+        @deflate = false
+        @deflate_window_bits = 15
+        @message = nil
+        @message_opcode = nil
+        @message_compressed = false
+      end
+
+      def send_frame(opcode, payload)
+        socket = @socket
+        raise WebSocketError.new("Not connected") if socket.nil? || socket.closed?
+
+        compressed = false
+        if @deflate && (opcode == OPCODE_TEXT || opcode == OPCODE_BINARY) && 0 < payload.bytesize
+          deflated = Frame.deflate(payload, @deflate_window_bits)
+          # Compression is per message, so a payload that does not
+          # shrink goes as it is
+          if deflated.bytesize < payload.bytesize
+            payload = deflated
+            compressed = true
+          end
+        end
+        mask_key = @masked ? RNG.random_string(4) : nil
+        socket.write(Frame.encode(opcode, payload, true, compressed, mask_key))
+      end
+
+      # Returns [opcode, payload] of the next message or control frame.
+      # With nonblock, returns nil rather than wait for a frame to start.
+      def receive_frame(nonblock = false)
+        while true
+          frame = Frame.shift(@rbuf)
+          if frame.is_a?(Integer)
+            # Refuse a data frame too large for the message before it is
+            # buffered. Control frames have bit 3 of the opcode set.
+            if ((@rbuf.getbyte(0) || 0) & 0x08) == 0 &&
+               @max_message_size < (@message ? @message.bytesize : 0) + frame - 14
+              message_too_big
+            end
+            return nil unless fill_buffer(frame, nonblock)
+            next
+          end
+          fin, rsv1, opcode, payload = frame
+
+          if rsv1 && !(@deflate && (opcode == OPCODE_TEXT || opcode == OPCODE_BINARY))
+            raise ProtocolError.new("Unexpected RSV1 bit")
+          end
+          # Control frames may come between the fragments of a message
+          return [opcode, payload] if OPCODE_CLOSE <= opcode
+
+          if opcode == OPCODE_CONTINUATION
+            message = @message
+            raise ProtocolError.new("Unexpected continuation frame") unless message
+            message_too_big if @max_message_size < message.bytesize + payload.bytesize
+            message << payload
+          else
+            raise ProtocolError.new("Expected continuation frame") if @message
+            message_too_big if @max_message_size < payload.bytesize
+            @message = payload
+            @message_opcode = opcode
+            @message_compressed = rsv1
+          end
+          next unless fin
+
+          opcode = @message_opcode || opcode
+          payload = @message || payload
+          compressed = @message_compressed
+          @message = nil
+          @message_opcode = nil
+          @message_compressed = false
+          if compressed
+            payload = Frame.inflate(payload)
+            message_too_big if @max_message_size < payload.bytesize
+          end
+          return [opcode, payload]
+        end
+        # Should never reach here. Just for steep check
+        raise ConnectionClosed.new("Connection closed. Should never reach here")
+      end
+
+      # Close with CLOSE_MESSAGE_TOO_BIG (RFC 6455 7.4.1) without waiting
+      # for the peer's close frame, and raise MessageTooBig
+      def message_too_big
+        @message = nil
+        @message_opcode = nil
+        @message_compressed = false
+        begin
+          send_frame(OPCODE_CLOSE, [CLOSE_MESSAGE_TOO_BIG].pack("n"))
+        rescue
+          # The peer may already be gone
+        end
+        @socket&.close
+        raise MessageTooBig.new("Message larger than #{@max_message_size} bytes")
+      end
+
+      # Read until @rbuf has size bytes. Returns false if nonblock and
+      # nothing has arrived to start a frame.
+      def fill_buffer(size, nonblock)
+        while @rbuf.bytesize < size
+          begin
+            if nonblock && @rbuf.empty?
+              chunk = @socket.read_nonblock(READ_SIZE)
+              return false unless chunk
+            else
+              chunk = @socket.readpartial(READ_SIZE)
+            end
+          rescue EOFError
+            raise ConnectionClosed.new("Connection closed")
+          end
+          @rbuf << chunk
+        end
+        true
+      end
+
+      def buffered?
+        !@rbuf.empty?
+      end
+
+      def mask_data(data, mask_key)
+        Frame.mask!(data.dup, mask_key)
+      end
+
+      # The parameters of the first permessage-deflate element in a
+      # Sec-WebSocket-Extensions value, or nil if there is none
+      def deflate_params(extensions)
+        elements = extensions.split(",")
+        ei = 0
+        while ei < elements.size
+          tokens = elements[ei].split(";")
+          ei += 1
+          next unless tokens[0]&.strip&.downcase == "permessage-deflate"
+          params = {} #: Hash[String, String]
+          ti = 1
+          while ti < tokens.size
+            name, value = tokens[ti].split("=", 2)
+            params[name.strip.downcase] = value ? value.strip : "" if name
+            ti += 1
+          end
+          return params
+        end
+        nil
+      end
+    end
+  end
+end
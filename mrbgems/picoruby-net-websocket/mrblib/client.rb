@@ -6,19 +6,24 @@ require 'pack'
 module Net
   module WebSocket
     class Client
+      include Framing
+
       attr_reader :url, :host, :port, :path
       attr_accessor :ssl_context
 
-      def initialize(url)
+      # With deflate: true, permessage-deflate is offered to the server.
+      # Messages over max_message_size bytes are refused.
+      def initialize(url, deflate: false, max_message_size: Frame::MAX_MESSAGE_SIZE)
         @url = url
         @headers = {}
-        @fragments = []
         @use_ssl = false
+        @deflate_offer = deflate
+        init_framing(true, max_message_size)
         parse_url(url)
       end
 
-      def self.connect(url, &block)
-        client = new(url)
+      def self.connect(url, deflate: false, max_message_size: Frame::MAX_MESSAGE_SIZE, &block)
+        client = new(url, deflate: deflate, max_message_size: max_message_size)
         client.connect
         if block
           begin
@@ -86,12 +91,12 @@ module Net
           end
 
           begin
-            byte0 = @socket.read_nonblock(1)
-          rescue EOFError
+            frame = receive_frame(true)
+          rescue ConnectionClosed
             raise ConnectionClosed.new("Connection closed by server")
           end
-          if byte0
-            opcode, payload = receive_frame(byte0)
+          if frame
+            opcode, payload = frame
 
             case opcode
             when OPCODE_TEXT, OPCODE_BINARY
@@ -127,12 +132,12 @@ module Net
         # Wait for close frame from server
         begin
           max_wait = 10  # Wait up to 1 second (10 * 100ms)
-          while max_wait > 0 && !@socket.ready?
+          while max_wait > 0 && !buffered? && !@socket.ready?
             sleep_ms 100
             max_wait -= 1
           end
 
-          if @socket.ready?
+          if buffered? || @socket.ready?
             opcode, response = receive_frame
             if opcode == OPCODE_CLOSE
               # Close acknowledged
@@ -183,13 +188,7 @@ module Net
 
       def perform_handshake
         # Generate Sec-WebSocket-Key
-        key_bytes = ""
-        ki = 0
-        while ki < 16
-          key_bytes << [RNG.random_int % 256].pack("C")
-          ki += 1
-        end
-        sec_key = Base64.encode64(key_bytes)
+        sec_key = Base64.encode64(RNG.random_string(16))
 
         # Build HTTP request
         request = "GET #{@path} HTTP/1.1\r\n"
@@ -198,6 +197,9 @@ module Net
         request << "Connection: Upgrade\r\n"
         request << "Sec-WebSocket-Key: #{sec_key}\r\n"
         request << "Sec-WebSocket-Version: 13\r\n"
+        if @deflate_offer
+          request << "Sec-WebSocket-Extensions: #{Framing::DEFLATE_EXTENSION}\r\n"
+        end
 
         # Add custom headers
         header_keys = @headers.keys
@@ -225,9 +227,42 @@ module Net
         # For simplicity, we don't verify Sec-WebSocket-Accept
         # In production, you should verify it using SHA-1 hash
 
+        extensions = response_header(response, "sec-websocket-extensions")
+        negotiate_deflate(extensions) if extensions
+
         true
       end
 
+      def response_header(response, name)
+        lines = response.split("\r\n")
+        li = 1
+        while li < lines.size
+          line = lines[li]
+          colon_pos = line.index(':')
+          if colon_pos && line.byteslice(0, colon_pos)&.downcase == name
+            return line.byteslice(colon_pos + 1..-1)&.strip
+          end
+          li += 1
+        end
+        nil
+      end
+
+      # The server may only accept what was offered, and we need it not
+      # to keep its window between messages
+      def negotiate_deflate(extensions)
+        params = @deflate_offer ? deflate_params(extensions) : nil
+        unless params && params["server_no_context_takeover"]
+          raise HandshakeError.new("Unsupported extension: #{extensions}")
+        end
+        if (bits = params["client_max_window_bits"])
+          @deflate_window_bits = bits.to_i
+          unless 8 <= @deflate_window_bits && @deflate_window_bits <= 15
+            raise HandshakeError.new("Invalid client_max_window_bits: #{bits}")
+          end
+        end
+        @deflate = true
+      end
+
       def read_http_response
         response = ""
         while true
@@ -252,157 +287,6 @@ module Net
         line
       end
 
-      def send_frame(opcode, payload)
-        raise WebSocketError.new("Not connected") unless connected?
-
-        # Build frame
-        frame = ""
-
-        # Byte 0: FIN + opcode
-        fin = 0x80  # FIN bit set
-        frame << [fin | opcode].pack("C")
-
-        # Byte 1: MASK + payload length
-        mask_bit = 0x80  # Client must mask
-        length = payload.bytesize
-
-        if length < 126
-          frame << [mask_bit | length].pack("C")
-        elsif length < 65536
-          frame << [mask_bit | 126].pack("C")
-          frame << [length].pack("n")
-        else
-          frame << [mask_bit | 127].pack("C")
-          high = length >> 32
-          low = length & 0xffffffff
-          frame << [high, low].pack("NN")
-        end
-
-        # Masking key (4 random bytes)
-        mask_key = ""
-        mi = 0
-        while mi < 4
-          mask_key << [RNG.random_int % 256].pack("C")
-          mi += 1
-        end
-        frame << mask_key
-
-        # Masked payload
-        masked_payload = mask_data(payload, mask_key)
-        frame << masked_payload
-
-        @socket.write(frame)
-      end
-
-      def receive_frame(first_byte = nil)
-        while true
-          # Read byte 0: FIN + opcode
-          if first_byte
-            byte0 = first_byte
-            first_byte = nil
-          else
-            begin
-              byte0 = @socket.readpartial(1)
-            rescue EOFError
-              raise ConnectionClosed.new("Connection closed")
-            end
-          end
-
-          byte0_val = byte0.getbyte(0) || 0
-          fin = (byte0_val & 0x80) != 0
-          opcode = byte0_val & 0x0F
-
-          # Read byte 1: MASK + payload length
-          begin
-            byte1 = @socket.readpartial(1)
-          rescue EOFError
-            raise ConnectionClosed.new("Connection closed")
-          end
-
-          byte1_val = byte1.getbyte(0) || 0
-          masked = (byte1_val & 0x80) != 0
-          payload_len = byte1_val & 0x7F
-
-          # Read extended payload length
-          if payload_len == 126
-            len_bytes = @socket.read(2)
-            if len_bytes.nil? || len_bytes.bytesize < 2
-              raise ConnectionClosed.new("Incomplete frame")
-            end
-            payload_len = len_bytes.unpack("n")[0]
-          elsif payload_len == 127
-            len_bytes = @socket.read(8)
-            if len_bytes.nil? || len_bytes.bytesize < 8
-              raise ConnectionClosed.new("Incomplete frame")
-            end
-            high, low = len_bytes.unpack("NN")
-            payload_len = ((high || 0) << 32) | (low || 0) # steep:ignore NoMethod
-          end
-
-          # Read masking key (if present)
-          mask_key = nil
-          if masked
-            mask_key = @socket.read(4)
-          end
-
-          # Read payload
-          payload = ""
-          if payload_len > 0
-            payload = @socket.read(payload_len)
-            if payload.nil? || payload.bytesize < payload_len
-              raise ConnectionClosed.new("Incomplete frame")
-            end
-          end
-
-          # Unmask payload (if masked)
-          if masked && mask_key
-            payload = mask_data(payload, mask_key)
-          end
-
-          # Handle fragmentation
-          if !fin
-            # Fragmented message
-            @fragments << {opcode: opcode, payload: payload}
-            # Continue loop to read next fragment
-          elsif opcode == OPCODE_CONTINUATION
-            # Final fragment
-            first_fragment = @fragments.shift
-            unless first_fragment
-              raise ProtocolError.new("Unexpected continuation frame")
-            end
-            opcode = first_fragment[:opcode]
-            full_payload = first_fragment[:payload]
-
-            fi = 0
-            while fi < @fragments.length
-              full_payload << @fragments[fi][:payload]
-              fi += 1
-            end
-            full_payload << payload
-
-            @fragments = []
-            return [opcode, full_payload]
-          else
-            return [opcode, payload]
-          end
-        end
-        # Should never reach here. Just for steep check
-        raise ConnectionClosed.new("Connection closed. Should never reach here")
-      end
-
-      def mask_data(data, mask_key)
-        result = ""
-        i = 0
-        len = data.bytesize
-        while i < len
-          byte = (data.getbyte(i) || 0)
-          masked_byte = byte ^ (mask_key.getbyte(i % 4) || 0)
-          result << [masked_byte].pack("C")
-          i += 1
-        end
-        result
-      end
-
       def handle_close_frame(payload)
         if payload.bytesize >= 2
           code = payload.byteslice(0, 2).unpack("n")[0] # steep:ignore
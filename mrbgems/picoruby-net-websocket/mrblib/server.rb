@@ -9,9 +9,13 @@ module Net
     class Server
       attr_reader :host, :port
 
-      def initialize(host: '0.0.0.0', port: 8080)
+      # With deflate: true, permessage-deflate is accepted from clients
+      # that offer it. Messages over max_message_size bytes are refused.
+      def initialize(host: '0.0.0.0', port: 8080, deflate: false, max_message_size: Frame::MAX_MESSAGE_SIZE)
         @host = host
         @port = port
+        @deflate = deflate
+        @max_message_size = max_message_size
         @server = nil
       end
 
@@ -24,7 +28,7 @@ module Net
         raise WebSocketError.new("Server not started") unless @server
 
         client_socket = @server.accept
-        Connection.new(client_socket)
+        Connection.new(client_socket, deflate: @deflate, max_message_size: @max_message_size)
       end
 
       def accept_loop(&block)
@@ -42,23 +46,26 @@ module Net
       private
 
       class Connection
-        def initialize(socket)
+        include Framing
+
+        def initialize(socket, deflate: false, max_message_size: Frame::MAX_MESSAGE_SIZE)
           @socket = socket
-          @fragments = []
+          @deflate_accept = deflate
+          init_framing(false, max_message_size)
           perform_handshake
         end
 
         def send_text(text)
-          send_frame(OPCODE_TEXT, text, masked: false)
+          send_frame(OPCODE_TEXT, text)
         end
 
         def send_binary(data)
-          send_frame(OPCODE_BINARY, data, masked: false)
+          send_frame(OPCODE_BINARY, data)
         end
 
         def send(data, type: :text)
           opcode = type == :binary ? OPCODE_BINARY : OPCODE_TEXT
-          send_frame(opcode, data, masked: false)
+          send_frame(opcode, data)
         end
 
         def receive(timeout: nil)
@@ -70,12 +77,12 @@ module Net
             end
 
             begin
-              byte0 = @socket.read_nonblock(1)
-            rescue EOFError
+              frame = receive_frame(true)
+            rescue ConnectionClosed
               raise ConnectionClosed.new("Connection closed by client")
             end
-            if byte0
-              opcode, payload = receive_frame(byte0)
+            if frame
+              opcode, payload = frame
 
               case opcode
               when OPCODE_TEXT, OPCODE_BINARY
@@ -84,7 +91,7 @@ module Net
                 handle_close_frame(payload)
                 raise ConnectionClosed.new("Connection closed by client")
               when OPCODE_PING
-                send_frame(OPCODE_PONG, payload, masked: false)
+                send_frame(OPCODE_PONG, payload)
               when OPCODE_PONG
                 # Ignore pong
               end
@@ -96,23 +103,23 @@ module Net
         end
 
         def ping(payload = "")
-          send_frame(OPCODE_PING, payload, masked: false)
+          send_frame(OPCODE_PING, payload)
         end
 
         def close(code = CLOSE_NORMAL, reason = "")
           return unless @socket && !@socket.closed?
 
           payload = [code].pack("n") + reason
-          send_frame(OPCODE_CLOSE, payload, masked: false)
+          send_frame(OPCODE_CLOSE, payload)
 
           begin
             max_wait = 10
-            while max_wait > 0 && !@socket.ready?
+            while max_wait > 0 && !buffered? && !@socket.ready?
               sleep_ms 100
               max_wait -= 1
             end
 
-            if @socket.ready?
+            if buffered? || @socket.ready?
               opcode, response = receive_frame
             end
           rescue
@@ -147,11 +154,30 @@ module Net
           response << "Upgrade: websocket\r\n"
           response << "Connection: Upgrade\r\n"
           response << "Sec-WebSocket-Accept: #{accept_key}\r\n"
+          extensions = headers['sec-websocket-extensions']
+          if @deflate_accept && extensions && accept_deflate(extensions)
+            response << "Sec-WebSocket-Extensions: #{Framing::DEFLATE_EXTENSION}"
+            response << "; server_max_window_bits=#{@deflate_window_bits}" if @deflate_window_bits < 15
+            response << "\r\n"
+          end
           response << "\r\n"
 
           @socket.write(response)
         end
 
+        # Only the first permessage-deflate offer is considered. A
+        # server_max_window_bits in it limits how far back we refer.
+        def accept_deflate(extensions)
+          params = deflate_params(extensions)
+          return false unless params
+          if (bits = params["server_max_window_bits"])
+            window_bits = bits.to_i
+            return false unless 8 <= window_bits && window_bits <= 15
+            @deflate_window_bits = window_bits
+          end
+          @deflate = true
+        end
+
         def read_http_request
           request = ""
           while true
@@ -213,145 +239,6 @@ module Net
           Base64.encode64(hash)
         end
 
-        def send_frame(opcode, payload, masked: false)
-          frame = ""
-
-          fin = 0x80
-          frame << [fin | opcode].pack("C")
-
-          mask_bit = masked ? 0x80 : 0x00
-          length = payload.bytesize
-
-          if length < 126
-            frame << [mask_bit | length].pack("C")
-          elsif length < 65536
-            frame << [mask_bit | 126].pack("C")
-            frame << [length].pack("n")
-          else
-            frame << [mask_bit | 127].pack("C")
-            high = length >> 32
-            low = length & 0xffffffff
-            frame << [high, low].pack("NN")
-          end
-
-          if masked
-            mask_key = ""
-            mi = 0
-            while mi < 4
-              mask_key << [RNG.random_int % 256].pack("C")
-              mi += 1
-            end
-            frame << mask_key
-            masked_payload = mask_data(payload, mask_key)
-            frame << masked_payload
-          else
-            frame << payload
-          end
-
-          @socket.write(frame)
-        end
-
-        def receive_frame(first_byte = nil)
-          while true
-            if first_byte
-              byte0 = first_byte
-              first_byte = nil
-            else
-              begin
-                byte0 = @socket.readpartial(1)
-              rescue EOFError
-                raise ConnectionClosed.new("Connection closed")
-              end
-            end
-
-            byte0_val = byte0.getbyte(0) || 0
-            fin = (byte0_val & 0x80) != 0
-            opcode = byte0_val & 0x0F
-
-            begin
-              byte1 = @socket.readpartial(1)
-            rescue EOFError
-              raise ConnectionClosed.new("Connection closed")
-            end
-
-            byte1_val = byte1.getbyte(0) || 0
-            masked = (byte1_val & 0x80) != 0
-            payload_len = byte1_val & 0x7F
-
-            if payload_len == 126
-              len_bytes = @socket.read(2)
-              if len_bytes.nil? || len_bytes.bytesize < 2
-                raise ConnectionClosed.new("Incomplete frame")
-              end
-              payload_len = len_bytes.unpack("n")[0]
-            elsif payload_len == 127
-              len_bytes = @socket.read(8)
-              if len_bytes.nil? || len_bytes.bytesize < 8
-                raise ConnectionClosed.new("Incomplete frame")
-              end
-              high, low = len_bytes.unpack("NN")
-              payload_len = ((high || 0) << 32) | (low || 0) # steep:ignore NoMethod
-            end
-
-            mask_key = nil
-            if masked
-              mask_key = @socket.read(4)
-            end
-
-            payload = ""
-            if payload_len > 0
-              payload = @socket.read(payload_len)
-              if payload.nil? || payload.bytesize < payload_len
-                raise ConnectionClosed.new("Incomplete frame")
-              end
-            end
-
-            if masked && mask_key
-              payload = mask_data(payload, mask_key)
-            end
-
-            if !fin
-              @fragments << {opcode: opcode, payload: payload}
-              # Continue loop to read next fragment
-            elsif opcode == OPCODE_CONTINUATION
-              first_fragment = @fragments.shift
-              unless first_fragment
-                raise ProtocolError.new("Unexpected continuation frame")
-              end
-              opcode = first_fragment[:opcode]
-              full_payload = first_fragment[:payload]
-
-              fi = 0
-              len = @fragments.length
-              while fi < len
-                full_payload << @fragments[fi][:payload]
-                fi += 1
-              end
-              full_payload << payload
-
-              @fragments.clear
-              return [opcode, full_payload]
-            else
-              return [opcode, payload]
-            end
-          end
-          # Should never reach here. Just for steep check
-          raise ConnectionClosed.new("Connection closed. Should never reach here")
-        end
-
-        def mask_data(data, mask_key)
-          result = ""
-          i = 0
-          len = data.bytesize
-          while i < len
-            byte = (data.getbyte(i) || 0)
-            masked_byte = byte ^ (mask_key.getbyte(i % 4) || 0)
-            result << [masked_byte].pack("C")
-            i += 1
-          end
-          result
-        end
-
         def handle_close_frame(payload)
           if payload.bytesize >= 2
             code = payload.byteslice(0, 2).unpack("n")[0] # steep:ignore
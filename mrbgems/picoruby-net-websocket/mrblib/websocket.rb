@@ -1,6 +1,6 @@
 #
 # WebSocket library for PicoRuby
-# This is a pure Ruby implementation of WebSocket (RFC 6455).
+# WebSocket (RFC 6455) with frames encoded and masked in C.
 # Designed for real-time communication in IoT devices.
 #
 
@@ -10,6 +10,7 @@ module Net
     class HandshakeError < WebSocketError; end
     class ProtocolError < WebSocketError; end
     class ConnectionClosed < WebSocketError; end
+    class MessageTooBig < WebSocketError; end
 
     # Opcodes
     OPCODE_CONTINUATION = 0x0
@@ -25,6 +26,7 @@ module Net
     CLOSE_PROTOCOL_ERROR = 1002
     CLOSE_UNSUPPORTED_DATA = 1003
     CLOSE_ABNORMAL = 1006
+    CLOSE_MESSAGE_TOO_BIG = 1009
 
     # Magic GUID for handshake
     WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
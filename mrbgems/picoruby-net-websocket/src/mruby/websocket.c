@@ -0,0 +1,189 @@
+#include "mruby.h"
+#include "mruby/presym.h"
+#include "mruby/string.h"
+#include "mruby/array.h"
+#include "mruby/class.h"
+
+static void
+ws_raise_protocol_error(mrb_state *mrb, const char *message)
+{
+  struct RClass *module_Net = mrb_module_get_id(mrb, MRB_SYM(Net));
+  struct RClass *module_WebSocket = mrb_module_get_under_id(mrb, module_Net, MRB_SYM(WebSocket));
+  mrb_raise(mrb, mrb_class_get_under_id(mrb, module_WebSocket, MRB_SYM(ProtocolError)), message);
+}
+
+static const uint8_t *
+ws_mask_key(mrb_state *mrb, mrb_value key)
+{
+  if (mrb_nil_p(key)) return NULL;
+  mrb_ensure_string_type(mrb, key);
+  if (RSTRING_LEN(key) != 4) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "mask key must be 4 bytes");
+  }
+  return (const uint8_t *)RSTRING_PTR(key);
+}
+
+static void *
+ws_realloc(void *ctx, void *ptr, size_t size)
+{
+  mrb_state *mrb = (mrb_state *)ctx;
+  if (size == 0) {
+    mrb_free(mrb, ptr);
+    return NULL;
+  }
+  return mrb_realloc_simple(mrb, ptr, size);
+}
+
+/*
+ * Frame.mask!(data, mask_key) -> data
+ *
+ * Masks or unmasks data in place.
+ */
+static mrb_value
+mrb_frame_s_mask_bang(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value data, key;
+
+  mrb_get_args(mrb, "So", &data, &key);
+  const uint8_t *mask_key = ws_mask_key(mrb, key);
+  if (!mask_key) mrb_raise(mrb, E_ARGUMENT_ERROR, "mask key must be 4 bytes");
+  mrb_str_modify(mrb, RSTRING(data));
+  WS_mask((uint8_t *)RSTRING_PTR(data), RSTRING_LEN(data), mask_key);
+  return data;
+}
+
+/*
+ * Frame.encode(opcode, payload, fin, rsv1, mask_key) -> String
+ *
+ * The whole frame, masked with mask_key unless it is nil.
+ */
+static mrb_value
+mrb_frame_s_encode(mrb_state *mrb, mrb_value klass)
+{
+  mrb_int opcode;
+  mrb_value payload, key;
+  mrb_bool fin, rsv1;
+  uint8_t header[WS_MAX_HEADER_SIZE];
+
+  mrb_get_args(mrb, "iSbbo", &opcode, &payload, &fin, &rsv1, &key);
+  const uint8_t *mask_key = ws_mask_key(mrb, key);
+  size_t len = RSTRING_LEN(payload);
+  size_t header_size = WS_encode_header(header, fin, rsv1, (uint8_t)opcode, len, mask_key);
+
+  mrb_value frame = mrb_str_new_capa(mrb, header_size + len);
+  mrb_str_cat(mrb, frame, (const char *)header, header_size);
+  mrb_str_cat(mrb, frame, RSTRING_PTR(payload), len);
+  if (mask_key) WS_mask((uint8_t *)RSTRING_PTR(frame) + header_size, len, mask_key);
+  return frame;
+}
+
+/*
+ * Frame.shift(buffer) -> [fin, rsv1, opcode, payload] or Integer
+ *
+ * Takes the frame at the head of buffer out of it and returns it
+ * unmasked. If the frame is not all there yet, buffer is left alone and
+ * the size it has to reach is returned instead.
+ */
+static mrb_value
+mrb_frame_s_shift(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value buffer;
+  ws_header_t h;
+  const char *error;
+
+  mrb_get_args(mrb, "S", &buffer);
+  size_t len = RSTRING_LEN(buffer);
+  int ret = WS_parse_header((const uint8_t *)RSTRING_PTR(buffer), len, &h, &error);
+  if (ret < 0) ws_raise_protocol_error(mrb, error);
+  if (ret == 0) return mrb_int_value(mrb, (mrb_int)h.header_size);
+  if ((uint64_t)(MRB_INT_MAX - h.header_size) < h.length) {
+    ws_raise_protocol_error(mrb, "frame too large");
+  }
+  size_t frame_size = h.header_size + (size_t)h.length;
+  if (len < frame_size) return mrb_int_value(mrb, (mrb_int)frame_size);
+
+  mrb_value payload = mrb_str_new(mrb, RSTRING_PTR(buffer) + h.header_size, (size_t)h.length);
+  if (h.masked) WS_mask((uint8_t *)RSTRING_PTR(payload), RSTRING_LEN(payload), h.mask_key);
+  mrb_str_modify(mrb, RSTRING(buffer));
+  memmove(RSTRING_PTR(buffer), RSTRING_PTR(buffer) + frame_size, len - frame_size);
+  mrb_str_resize(mrb, buffer, len - frame_size);
+
+  mrb_value values[4] = {
+    mrb_bool_value(h.fin),
+    mrb_bool_value(h.rsv1),
+    mrb_int_value(mrb, h.opcode),
+    payload,
+  };
+  return mrb_ary_new_from_values(mrb, 4, values);
+}
+
+/* The contents of out as a String; out is freed */
+static mrb_value
+ws_buffer_str(mrb_state *mrb, ws_buffer_t *out)
+{
+  mrb_value str = mrb_str_new(mrb, (const char *)out->data, out->len);
+  mrb_free(mrb, out->data);
+  return str;
+}
+
+/*
+ * Frame.deflate(data, window_bits = 15) -> String
+ */
+static mrb_value
+mrb_frame_s_deflate(mrb_state *mrb, mrb_value klass)
+{
+  const char *src;
+  mrb_int len;
+  mrb_int window_bits = 15;
+  ws_buffer_t out = { NULL, 0, 0, ws_realloc, mrb };
+
+  mrb_get_args(mrb, "s|i", &src, &len, &window_bits);
+  if (window_bits < 8 || 15 < window_bits) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "window_bits must be 8 to 15");
+  }
+  const char *error = WS_deflate((const uint8_t *)src, len, (int)window_bits, &out);
+  if (error) {
+    mrb_free(mrb, out.data);
+    mrb_raise(mrb, E_RUNTIME_ERROR, error);
+  }
+  return ws_buffer_str(mrb, &out);
+}
+
+/*
+ * Frame.inflate(data) -> String
+ */
+static mrb_value
+mrb_frame_s_inflate(mrb_state *mrb, mrb_value klass)
+{
+  const char *src;
+  mrb_int len;
+  ws_buffer_t out = { NULL, 0, 0, ws_realloc, mrb };
+
+  mrb_get_args(mrb, "s", &src, &len);
+  const char *error = WS_inflate((const uint8_t *)src, len, &out);
+  if (error) {
+    mrb_free(mrb, out.data);
+    ws_raise_protocol_error(mrb, error);
+  }
+  return ws_buffer_str(mrb, &out);
+}
+
+void
+mrb_picoruby_net_websocket_gem_init(mrb_state* mrb)
+{
+  struct RClass *module_Net = mrb_define_module_id(mrb, MRB_SYM(Net));
+  struct RClass *module_WebSocket = mrb_define_module_under_id(mrb, module_Net, MRB_SYM(WebSocket));
+  struct RClass *module_Frame = mrb_define_module_under_id(mrb, module_WebSocket, MRB_SYM(Frame));
+
+  mrb_define_class_method_id(mrb, module_Frame, MRB_SYM_B(mask), mrb_frame_s_mask_bang, MRB_ARGS_REQ(2));
+  mrb_define_class_method_id(mrb, module_Frame, MRB_SYM(encode), mrb_frame_s_encode, MRB_ARGS_REQ(5));
+  mrb_define_class_method_id(mrb, module_Frame, MRB_SYM(shift), mrb_frame_s_shift, MRB_ARGS_REQ(1));
+  mrb_define_class_method_id(mrb, module_Frame, MRB_SYM(deflate), mrb_frame_s_deflate, MRB_ARGS_ARG(1, 1));
+  mrb_define_class_method_id(mrb, module_Frame, MRB_SYM(inflate), mrb_frame_s_inflate, MRB_ARGS_REQ(1));
+  mrb_define_const_id(mrb, module_Frame, MRB_SYM(MAX_MESSAGE_SIZE), mrb_int_value(mrb, WS_INFLATE_MAX_SIZE));
+}
+
+void
+mrb_picoruby_net_websocket_gem_final(mrb_state* mrb)
+{
+}
@@ -0,0 +1,229 @@
+#include <mrubyc.h>
+
+static void
+ws_raise_protocol_error(mrbc_vm *vm, const char *message)
+{
+  mrbc_class *cls = MRBC_CLASS(StandardError);
+  mrbc_class *module_Net = mrbc_get_class_by_name("Net");
+  if (module_Net) {
+    mrbc_value *m = mrbc_get_class_const(module_Net, mrbc_str_to_symid("WebSocket"));
+    if (m && m->tt == MRBC_TT_MODULE) {
+      mrbc_value *c = mrbc_get_class_const(m->cls, mrbc_str_to_symid("ProtocolError"));
+      if (c && c->tt == MRBC_TT_CLASS) cls = c->cls;
+    }
+  }
+  mrbc_raise(vm, cls, message);
+}
+
+/* The key in v, NULL for nil; raises and returns NULL if it is bad */
+static const uint8_t *
+ws_mask_key(mrbc_vm *vm, mrbc_value *v, bool *ok)
+{
+  *ok = true;
+  if (v->tt == MRBC_TT_NIL) return NULL;
+  if (v->tt != MRBC_TT_STRING || v->string->size != 4) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "mask key must be 4 bytes");
+    *ok = false;
+    return NULL;
+  }
+  return v->string->data;
+}
+
+static void *
+ws_realloc(void *ctx, void *ptr, size_t size)
+{
+  mrbc_vm *vm = (mrbc_vm *)ctx;
+  if (size == 0) {
+    mrbc_free(vm, ptr);
+    return NULL;
+  }
+  /* mrbc_realloc does not take NULL */
+  return ptr ? mrbc_realloc(vm, ptr, size) : mrbc_alloc(vm, size);
+}
+
+/*
+ * Frame.mask!(data, mask_key) -> data
+ *
+ * Masks or unmasks data in place.
+ */
+static void
+c_frame_mask_bang(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  bool ok;
+
+  if (argc != 2 || GET_TT_ARG(1) != MRBC_TT_STRING || GET_TT_ARG(2) != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong arguments");
+    return;
+  }
+  const uint8_t *mask_key = ws_mask_key(vm, &v[2], &ok);
+  if (!ok) return;
+  WS_mask(v[1].string->data, v[1].string->size, mask_key);
+  mrbc_incref(&v[1]);
+  SET_RETURN(v[1]);
+}
+
+/*
+ * Frame.encode(opcode, payload, fin, rsv1, mask_key) -> String
+ *
+ * The whole frame, masked with mask_key unless it is nil.
+ */
+static void
+c_frame_encode(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  uint8_t header[WS_MAX_HEADER_SIZE];
+  bool ok;
+
+  if (argc != 5 || GET_TT_ARG(1) != MRBC_TT_INTEGER || GET_TT_ARG(2) != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong arguments");
+    return;
+  }
+  const uint8_t *mask_key = ws_mask_key(vm, &v[5], &ok);
+  if (!ok) return;
+  size_t len = v[2].string->size;
+  size_t header_size = WS_encode_header(header, mrbc_test(&v[3]), mrbc_test(&v[4]),
+                                        (uint8_t)GET_INT_ARG(1), len, mask_key);
+
+  mrbc_value frame = mrbc_string_new(vm, NULL, header_size + len);
+  if (frame.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), "out of memory");
+    return;
+  }
+  uint8_t *data = frame.string->data;
+  memcpy(data, header, header_size);
+  memcpy(data + header_size, v[2].string->data, len);
+  data[header_size + len] = '\0';
+  if (mask_key) WS_mask(data + header_size, len, mask_key);
+  SET_RETURN(frame);
+}
+
+/*
+ * Frame.shift(buffer) -> [fin, rsv1, opcode, payload] or Integer
+ *
+ * Takes the frame at the head of buffer out of it and returns it
+ * unmasked. If the frame is not all there yet, buffer is left alone and
+ * the size it has to reach is returned instead.
+ */
+static void
+c_frame_shift(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  ws_header_t h;
+  const char *error;
+
+  if (argc != 1 || GET_TT_ARG(1) != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong arguments");
+    return;
+  }
+  mrbc_string *buffer = v[1].string;
+  size_t len = buffer->size;
+  int ret = WS_parse_header(buffer->data, len, &h, &error);
+  if (ret < 0) {
+    ws_raise_protocol_error(vm, error);
+    return;
+  }
+  if (ret == 0) {
+    SET_INT_RETURN((mrbc_int_t)h.header_size);
+    return;
+  }
+  if ((uint64_t)(INT32_MAX - h.header_size) < h.length) {
+    ws_raise_protocol_error(vm, "frame too large");
+    return;
+  }
+  size_t frame_size = h.header_size + (size_t)h.length;
+  if (len < frame_size) {
+    SET_INT_RETURN((mrbc_int_t)frame_size);
+    return;
+  }
+
+  mrbc_value payload = mrbc_string_new(vm, buffer->data + h.header_size, (int)h.length);
+  if (payload.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), "out of memory");
+    return;
+  }
+  if (h.masked) WS_mask(payload.string->data, payload.string->size, h.mask_key);
+  memmove(buffer->data, buffer->data + frame_size, len - frame_size);
+  buffer->size = len - frame_size;
+  buffer->data[buffer->size] = '\0';
+
+  mrbc_value ret_value = mrbc_array_new(vm, 4);
+  mrbc_value fin = mrbc_bool_value(h.fin);
+  mrbc_value rsv1 = mrbc_bool_value(h.rsv1);
+  mrbc_value opcode = mrbc_integer_value(h.opcode);
+  mrbc_array_push(&ret_value, &fin);
+  mrbc_array_push(&ret_value, &rsv1);
+  mrbc_array_push(&ret_value, &opcode);
+  mrbc_array_push(&ret_value, &payload);
+  SET_RETURN(ret_value);
+}
+
+/* Return the contents of out as a String, or raise error */
+static void
+ws_return_buffer(mrbc_vm *vm, mrbc_value *v, ws_buffer_t *out, const char *error, mrbc_class *error_class)
+{
+  if (error) {
+    if (out->data) mrbc_free(vm, out->data);
+    if (error_class) {
+      mrbc_raise(vm, error_class, error);
+    } else {
+      ws_raise_protocol_error(vm, error);
+    }
+    return;
+  }
+  /* capa > len leaves room for the terminator */
+  mrbc_value ret = mrbc_string_new_alloc(vm, out->data, out->len);
+  SET_RETURN(ret);
+}
+
+/*
+ * Frame.deflate(data, window_bits = 15) -> String
+ */
+static void
+c_frame_deflate(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  ws_buffer_t out = { NULL, 0, 0, ws_realloc, vm };
+  int window_bits = 15;
+
+  if (argc < 1 || 2 < argc || GET_TT_ARG(1) != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong arguments");
+    return;
+  }
+  if (argc == 2) {
+    if (GET_TT_ARG(2) != MRBC_TT_INTEGER || GET_INT_ARG(2) < 8 || 15 < GET_INT_ARG(2)) {
+      mrbc_raise(vm, MRBC_CLASS(ArgumentError), "window_bits must be 8 to 15");
+      return;
+    }
+    window_bits = (int)GET_INT_ARG(2);
+  }
+  const char *error = WS_deflate(v[1].string->data, v[1].string->size, window_bits, &out);
+  ws_return_buffer(vm, v, &out, error, MRBC_CLASS(RuntimeError));
+}
+
+/*
+ * Frame.inflate(data) -> String
+ */
+static void
+c_frame_inflate(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  ws_buffer_t out = { NULL, 0, 0, ws_realloc, vm };
+
+  if (argc != 1 || GET_TT_ARG(1) != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong arguments");
+    return;
+  }
+  const char *error = WS_inflate(v[1].string->data, v[1].string->size, &out);
+  ws_return_buffer(vm, v, &out, error, NULL);
+}
+
+void
+mrbc_net_websocket_init(mrbc_vm *vm)
+{
+  mrbc_class *module_Net = mrbc_define_module(vm, "Net");
+  mrbc_class *module_WebSocket = mrbc_define_module_under(vm, module_Net, "WebSocket");
+  mrbc_class *module_Frame = mrbc_define_module_under(vm, module_WebSocket, "Frame");
+
+  mrbc_define_method(vm, module_Frame, "mask!", c_frame_mask_bang);
+  mrbc_define_method(vm, module_Frame, "encode", c_frame_encode);
+  mrbc_define_method(vm, module_Frame, "shift", c_frame_shift);
+  mrbc_define_method(vm, module_Frame, "deflate", c_frame_deflate);
+  mrbc_define_method(vm, module_Frame, "inflate", c_frame_inflate);
+  mrbc_set_class_const(module_Frame, mrbc_str_to_symid("MAX_MESSAGE_SIZE"), &mrbc_integer_value(WS_INFLATE_MAX_SIZE));
+}
@@ -0,0 +1,552 @@
+#include <string.h>
+#include "../include/websocket.h"
+
+/*
+ * Frame header
+ */
+
+int
+WS_parse_header(const uint8_t *buf, size_t len, ws_header_t *h, const char **error)
+{
+  h->header_size = 2;
+  if (len < 2) return 0;
+
+  h->fin = (buf[0] & 0x80) != 0;
+  h->rsv1 = (buf[0] & 0x40) != 0;
+  h->opcode = buf[0] & 0x0f;
+  h->masked = (buf[1] & 0x80) != 0;
+  uint8_t len7 = buf[1] & 0x7f;
+
+  if (buf[0] & 0x30) {
+    *error = "reserved bits set";
+    return -1;
+  }
+  switch (h->opcode) {
+    case WS_OPCODE_CONTINUATION:
+    case WS_OPCODE_TEXT:
+    case WS_OPCODE_BINARY:
+      break;
+    case WS_OPCODE_CLOSE:
+    case WS_OPCODE_PING:
+    case WS_OPCODE_PONG:
+      if (!h->fin) {
+        *error = "fragmented control frame";
+        return -1;
+      }
+      if (125 < len7) {
+        *error = "control frame too long";
+        return -1;
+      }
+      break;
+    default:
+      *error = "unknown opcode";
+      return -1;
+  }
+
+  size_t ext = len7 == 126 ? 2 : (len7 == 127 ? 8 : 0);
+  h->header_size = 2 + ext + (h->masked ? 4 : 0);
+  if (len < h->header_size) return 0;
+
+  h->length = len7;
+  if (ext) {
+    h->length = 0;
+    for (size_t i = 0; i < ext; i++) {
+      h->length = (h->length << 8) | buf[2 + i];
+    }
+    if (h->length >> 63) {
+      *error = "invalid payload length";
+      return -1;
+    }
+  }
+  if (h->masked) memcpy(h->mask_key, buf + 2 + ext, 4);
+  return 1;
+}
+
+size_t
+WS_encode_header(uint8_t *out, bool fin, bool rsv1, uint8_t opcode,
+                 uint64_t length, const uint8_t *mask_key)
+{
+  size_t n = 2;
+  uint8_t mask_bit = mask_key ? 0x80 : 0;
+
+  out[0] = (fin ? 0x80 : 0) | (rsv1 ? 0x40 : 0) | (opcode & 0x0f);
+  if (length < 126) {
+    out[1] = mask_bit | (uint8_t)length;
+  } else if (length < 65536) {
+    out[1] = mask_bit | 126;
+    out[2] = (uint8_t)(length >> 8);
+    out[3] = (uint8_t)length;
+    n = 4;
+  } else {
+    out[1] = mask_bit | 127;
+    for (int i = 0; i < 8; i++) {
+      out[2 + i] = (uint8_t)(length >> (56 - 8 * i));
+    }
+    n = 10;
+  }
+  if (mask_key) {
+    memcpy(out + n, mask_key, 4);
+    n += 4;
+  }
+  return n;
+}
+
+/*
+ * Masking
+ *
+ * The bytes up to a word boundary go one at a time, then whole words
+ * are XORed with the key repeated over a word. A word is a multiple of
+ * four bytes, so the key lines up the same way at every word.
+ */
+
+#if UINTPTR_MAX > 0xffffffffu
+typedef uint64_t ws_word_t;
+#else
+typedef uint32_t ws_word_t;
+#endif
+
+void
+WS_mask(uint8_t *data, size_t len, const uint8_t mask_key[4])
+{
+  size_t i = 0;
+
+  while (i < len && ((uintptr_t)(data + i) & (sizeof(ws_word_t) - 1))) {
+    data[i] ^= mask_key[i & 3];
+    i++;
+  }
+  if (sizeof(ws_word_t) <= len - i) {
+    uint8_t key[sizeof(ws_word_t)];
+    ws_word_t word, key_word;
+    for (size_t j = 0; j < sizeof(key); j++) {
+      key[j] = mask_key[(i + j) & 3];
+    }
+    memcpy(&key_word, key, sizeof(key_word));
+    /* data + i is aligned, so these are single loads and stores */
+    for (; sizeof(ws_word_t) <= len - i; i += sizeof(ws_word_t)) {
+      memcpy(&word, data + i, sizeof(word));
+      word ^= key_word;
+      memcpy(data + i, &word, sizeof(word));
+    }
+  }
+  while (i < len) {
+    data[i] ^= mask_key[i & 3];
+    i++;
+  }
+}
+
+/*
+ * Raw DEFLATE (RFC 1951)
+ */
+
+static const uint16_t ws_length_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t ws_length_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t ws_distance_base[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t ws_distance_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Make room for n more bytes and one spare */
+static bool
+ws_buffer_reserve(ws_buffer_t *b, size_t n, size_t max)
+{
+  if (n < b->capa - b->len) return true;
+  if (max - b->len < n) return false;
+  size_t capa = b->capa ? b->capa : 64;
+  while (capa - b->len <= n) capa *= 2;
+  uint8_t *data = (uint8_t *)b->realloc(b->ctx, b->data, capa);
+  if (!data) return false;
+  b->data = data;
+  b->capa = capa;
+  return true;
+}
+
+typedef struct {
+  ws_buffer_t *out;
+  uint32_t bits;
+  int count;
+  bool full;
+} ws_deflate_t;
+
+static void
+ws_put_bits(ws_deflate_t *s, uint32_t bits, int n)
+{
+  s->bits |= bits << s->count;
+  s->count += n;
+  while (8 <= s->count) {
+    if (!ws_buffer_reserve(s->out, 1, SIZE_MAX)) {
+      s->full = true;
+      return;
+    }
+    s->out->data[s->out->len++] = (uint8_t)s->bits;
+    s->bits >>= 8;
+    s->count -= 8;
+  }
+}
+
+/* Huffman codes go most significant bit first */
+static void
+ws_put_code(ws_deflate_t *s, uint32_t code, int n)
+{
+  uint32_t reversed = 0;
+  for (int i = 0; i < n; i++) {
+    reversed = (reversed << 1) | ((code >> i) & 1);
+  }
+  ws_put_bits(s, reversed, n);
+}
+
+/* Fixed literal/length code of RFC 1951 3.2.6 */
+static void
+ws_put_symbol(ws_deflate_t *s, int sym)
+{
+  if (sym < 144) {
+    ws_put_code(s, 0x30 + sym, 8);
+  } else if (sym < 256) {
+    ws_put_code(s, 0x190 + sym - 144, 9);
+  } else if (sym < 280) {
+    ws_put_code(s, sym - 256, 7);
+  } else {
+    ws_put_code(s, 0xc0 + sym - 280, 8);
+  }
+}
+
+static void
+ws_put_match(ws_deflate_t *s, size_t length, size_t distance)
+{
+  int i = 28;
+  while (length < ws_length_base[i]) i--;
+  ws_put_symbol(s, 257 + i);
+  ws_put_bits(s, (uint32_t)(length - ws_length_base[i]), ws_length_extra[i]);
+  i = 29;
+  while (distance < ws_distance_base[i]) i--;
+  ws_put_code(s, i, 5);
+  ws_put_bits(s, (uint32_t)(distance - ws_distance_base[i]), ws_distance_extra[i]);
+}
+
+static uint32_t
+ws_hash(const uint8_t *p)
+{
+  uint32_t v = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+  return (v * 2654435761u) >> 16 & (WS_DEFLATE_HASH_SIZE - 1);
+}
+
+const char *
+WS_deflate(const uint8_t *src, size_t len, int window_bits, ws_buffer_t *out)
+{
+  ws_deflate_t s = { out, 0, 0, false };
+  size_t window = (size_t)1 << window_bits;
+  size_t pos = 0;
+
+  /* Fixed Huffman codes take at most 9 bits a byte */
+  if (!ws_buffer_reserve(out, len + len / 8 + 8, SIZE_MAX)) return "out of memory";
+  /* The last position each 3-byte prefix was seen at, plus one */
+  uint32_t *table = (uint32_t *)out->realloc(out->ctx, NULL, WS_DEFLATE_HASH_SIZE * sizeof(uint32_t));
+  if (!table) return "out of memory";
+  memset(table, 0, WS_DEFLATE_HASH_SIZE * sizeof(uint32_t));
+
+  /* BFINAL 0, BTYPE 01 */
+  ws_put_bits(&s, 2, 3);
+  while (pos < len && !s.full) {
+    size_t length = 0;
+    size_t distance = 0;
+    if (pos + 3 <= len) {
+      uint32_t h = ws_hash(src + pos);
+      size_t candidate = table[h];
+      table[h] = (uint32_t)(pos + 1);
+      if (candidate && pos + 1 - candidate <= window) {
+        const uint8_t *a = src + candidate - 1;
+        size_t max = len - pos < 258 ? len - pos : 258;
+        while (length < max && a[length] == src[pos + length]) length++;
+        distance = pos + 1 - candidate;
+      }
+    }
+    if (3 <= length) {
+      ws_put_match(&s, length, distance);
+      /* Index the matched bytes cheaply: only the last one */
+      pos += length;
+      if (pos + 2 < len) table[ws_hash(src + pos - 1)] = (uint32_t)pos;
+    } else {
+      ws_put_symbol(&s, src[pos]);
+      pos++;
+    }
+  }
+  out->realloc(out->ctx, table, 0);
+  /* End of block, then the header of the empty stored block that
+   * Z_SYNC_FLUSH writes. Its 0x00 0x00 0xff 0xff is left out. */
+  ws_put_symbol(&s, 256);
+  ws_put_bits(&s, 0, 3);
+  if (s.count) ws_put_bits(&s, 0, 8 - s.count);
+  return s.full ? "out of memory" : NULL;
+}
+
+/*
+ * INFLATE
+ *
+ * Canonical Huffman codes are decoded a bit at a time from a count of
+ * codes per length and the symbols in code order, which keeps the tables
+ * small enough for the C stack.
+ */
+
+typedef struct {
+  uint16_t counts[16];
+  uint16_t symbols[288];
+} ws_huffman_t;
+
+typedef struct {
+  const uint8_t *src;
+  size_t len;
+  size_t pos;
+  uint32_t bits;
+  int count;
+  ws_buffer_t *out;
+} ws_inflate_t;
+
+/* RFC 7692 7.2.2: the sender removed these from the end */
+static const uint8_t ws_inflate_tail[4] = { 0x00, 0x00, 0xff, 0xff };
+
+static bool
+ws_get_byte(ws_inflate_t *s, uint8_t *byte)
+{
+  if (s->len + 4 <= s->pos) return false;
+  *byte = s->pos < s->len ? s->src[s->pos] : ws_inflate_tail[s->pos - s->len];
+  s->pos++;
+  return true;
+}
+
+/* n bits, or -1 at the end of the input */
+static int
+ws_get_bits(ws_inflate_t *s, int n)
+{
+  uint8_t byte;
+  while (s->count < n) {
+    if (!ws_get_byte(s, &byte)) return -1;
+    s->bits |= (uint32_t)byte << s->count;
+    s->count += 8;
+  }
+  int value = (int)(s->bits & ((1u << n) - 1));
+  s->bits >>= n;
+  s->count -= n;
+  return value;
+}
+
+static bool
+ws_build_huffman(ws_huffman_t *h, const uint8_t *lengths, int n)
+{
+  uint16_t offsets[16];
+  int left = 1;
+
+  memset(h->counts, 0, sizeof(h->counts));
+  for (int i = 0; i < n; i++) h->counts[lengths[i]]++;
+  for (int len = 1; len < 16; len++) {
+    left = (left << 1) - h->counts[len];
+    /* Over-subscribed */
+    if (left < 0) return false;
+  }
+  offsets[1] = 0;
+  for (int len = 1; len < 15; len++) {
+    offsets[len + 1] = offsets[len] + h->counts[len];
+  }
+  for (int i = 0; i < n; i++) {
+    if (lengths[i]) h->symbols[offsets[lengths[i]]++] = (uint16_t)i;
+  }
+  return true;
+}
+
+static int
+ws_decode(ws_inflate_t *s, const ws_huffman_t *h)
+{
+  int code = 0, first = 0, index = 0;
+
+  for (int len = 1; len < 16; len++) {
+    int bit = ws_get_bits(s, 1);
+    if (bit < 0) return -1;
+    code |= bit;
+    int count = h->counts[len];
+    if (code - first < count) return h->symbols[index + code - first];
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+static const char *
+ws_inflate_stored(ws_inflate_t *s)
+{
+  uint8_t header[4];
+
+  s->bits = 0;
+  s->count = 0;
+  for (int i = 0; i < 4; i++) {
+    if (!ws_get_byte(s, &header[i])) return "truncated stored block";
+  }
+  size_t len = header[0] | (size_t)header[1] << 8;
+  if ((uint16_t)(header[2] | header[3] << 8) != (uint16_t)~len) return "invalid stored block length";
+  if (!ws_buffer_reserve(s->out, len, WS_INFLATE_MAX_SIZE)) return "message too large";
+  for (size_t i = 0; i < len; i++) {
+    if (!ws_get_byte(s, &s->out->data[s->out->len])) return "truncated stored block";
+    s->out->len++;
+  }
+  return NULL;
+}
+
+static const char *
+ws_inflate_codes(ws_inflate_t *s, const ws_huffman_t *lengths, const ws_huffman_t *distances)
+{
+  while (true) {
+    int sym = ws_decode(s, lengths);
+    if (sym < 0) return "invalid literal/length code";
+    if (sym < 256) {
+      if (!ws_buffer_reserve(s->out, 1, WS_INFLATE_MAX_SIZE)) return "message too large";
+      s->out->data[s->out->len++] = (uint8_t)sym;
+      continue;
+    }
+    if (sym == 256) return NULL;
+    sym -= 257;
+    if (29 <= sym) return "invalid literal/length code";
+    int extra = ws_get_bits(s, ws_length_extra[sym]);
+    if (extra < 0) return "truncated block";
+    size_t length = ws_length_base[sym] + extra;
+
+    sym = ws_decode(s, distances);
+    if (sym < 0 || 30 <= sym) return "invalid distance code";
+    extra = ws_get_bits(s, ws_distance_extra[sym]);
+    if (extra < 0) return "truncated block";
+    size_t distance = ws_distance_base[sym] + extra;
+    /* No context takeover: nothing before this message */
+    if (s->out->len < distance) return "distance too far back";
+
+    if (!ws_buffer_reserve(s->out, length, WS_INFLATE_MAX_SIZE)) return "message too large";
+    /* Byte by byte, as the copy may overlap what it writes */
+    uint8_t *p = s->out->data + s->out->len;
+    for (size_t i = 0; i < length; i++) p[i] = p[i - distance];
+    s->out->len += length;
+  }
+}
+
+static const char *
+ws_inflate_fixed(ws_inflate_t *s)
+{
+  ws_huffman_t lengths, distances;
+  uint8_t l[288];
+  int i = 0;
+
+  for (; i < 144; i++) l[i] = 8;
+  for (; i < 256; i++) l[i] = 9;
+  for (; i < 280; i++) l[i] = 7;
+  for (; i < 288; i++) l[i] = 8;
+  ws_build_huffman(&lengths, l, 288);
+  for (i = 0; i < 30; i++) l[i] = 5;
+  ws_build_huffman(&distances, l, 30);
+  return ws_inflate_codes(s, &lengths, &distances);
+}
+
+static const char *
+ws_inflate_dynamic(ws_inflate_t *s)
+{
+  static const uint8_t order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+  };
+  ws_huffman_t lengths, distances;
+  uint8_t l[288 + 32];
+
+  int nlen = ws_get_bits(s, 5);
+  int ndist = ws_get_bits(s, 5);
+  int ncode = ws_get_bits(s, 4);
+  if (nlen < 0 || ndist < 0 || ncode < 0) return "truncated block";
+  nlen += 257;
+  ndist += 1;
+  ncode += 4;
+  if (286 < nlen || 30 < ndist) return "invalid code lengths";
+
+  memset(l, 0, 19);
+  for (int i = 0; i < ncode; i++) {
+    int len = ws_get_bits(s, 3);
+    if (len < 0) return "truncated block";
+    l[order[i]] = (uint8_t)len;
+  }
+  if (!ws_build_huffman(&lengths, l, 19)) return "invalid code lengths";
+
+  int i = 0;
+  while (i < nlen + ndist) {
+    int sym = ws_decode(s, &lengths);
+    if (sym < 0) return "invalid code lengths";
+    if (sym < 16) {
+      l[i++] = (uint8_t)sym;
+      continue;
+    }
+    uint8_t len = 0;
+    int repeat;
+    if (sym == 16) {
+      if (i == 0) return "invalid code lengths";
+      len = l[i - 1];
+      repeat = ws_get_bits(s, 2) + 3;
+    } else if (sym == 17) {
+      repeat = ws_get_bits(s, 3) + 3;
+    } else {
+      repeat = ws_get_bits(s, 7) + 11;
+    }
+    /* -1 from the end of the input leaves it under its base */
+    if (repeat < (sym == 18 ? 11 : 3)) return "truncated block";
+    if (nlen + ndist < i + repeat) return "invalid code lengths";
+    while (repeat--) l[i++] = len;
+  }
+  if (l[256] == 0) return "missing end-of-block code";
+  if (!ws_build_huffman(&lengths, l, nlen)) return "invalid code lengths";
+  if (!ws_build_huffman(&distances, l + nlen, ndist)) return "invalid code lengths";
+  return ws_inflate_codes(s, &lengths, &distances);
+}
+
+const char *
+WS_inflate(const uint8_t *src, size_t len, ws_buffer_t *out)
+{
+  ws_inflate_t s = { src, len, 0, 0, 0, out };
+  const char *error = NULL;
+  int final = 0;
+
+  /* A first guess; the buffer grows as needed */
+  if (!ws_buffer_reserve(out, len < WS_INFLATE_MAX_SIZE / 2 ? len * 2 : 0, WS_INFLATE_MAX_SIZE)) {
+    return "out of memory";
+  }
+  /* A flushed message ends with the empty stored block restored above,
+   * and so on a byte boundary */
+  while (!final && s.pos < s.len + 4) {
+    final = ws_get_bits(&s, 1);
+    int type = ws_get_bits(&s, 2);
+    switch (type) {
+      case 0:
+        error = ws_inflate_stored(&s);
+        break;
+      case 1:
+        error = ws_inflate_fixed(&s);
+        break;
+      case 2:
+        error = ws_inflate_dynamic(&s);
+        break;
+      default:
+        error = type < 0 ? "truncated block" : "invalid block type";
+        break;
+    }
+    if (error) return error;
+  }
+  return NULL;
+}
+
+#if defined(PICORB_VM_MRUBY)
+
+#include "mruby/websocket.c"
+
+#elif defined(PICORB_VM_MRUBYC)
+
+#include "mrubyc/websocket.c"
+
+#endif
@@ -1,3 +1,38 @@
+# Feeds the bytes it was given to Framing and keeps what is written
+class WebSocketTestSocket
+  attr_reader :written
+
+  def initialize(input)
+    @input = input
+    @written = ""
+    @closed = false
+  end
+
+  def readpartial(n)
+    raise EOFError if @input.empty?
+    chunk = @input.byteslice(0, n) || ""
+    @input = @input.byteslice(n, @input.bytesize) || ""
+    chunk
+  end
+
+  def read_nonblock(n)
+    @input.empty? ? nil : readpartial(n)
+  end
+
+  def write(data)
+    @written << data
+    data.bytesize
+  end
+
+  def closed?
+    @closed
+  end
+
+  def close
+    @closed = true
+  end
+end
+
 class WebSocketTest < Picotest::Test
   def test_client_initialization
     client = Net::WebSocket::Client.new("ws://example.com:8080/socket")
@@ -150,6 +185,63 @@ class WebSocketTest < Picotest::Test
     end
   end
 
+  def receive_frame_from(client, input)
+    socket = WebSocketTestSocket.new(input)
+    client.instance_variable_set(:@socket, socket)
+    if picoruby?
+      client.__send__(:receive_frame)
+    else
+      client.receive_frame
+    end
+  end
+
+  def assert_closed_with_message_too_big(client)
+    socket = client.instance_variable_get(:@socket)
+    assert_true(socket.closed?)
+    frame = Net::WebSocket::Frame.shift(socket.written)
+    assert_equal([true, false, Net::WebSocket::OPCODE_CLOSE, "\x03\xF1"], frame)
+  end
+
+  def test_max_message_size_defaults_to_frame_limit
+    assert_equal(1024 * 1024, Net::WebSocket::Frame::MAX_MESSAGE_SIZE)
+    assert_equal(Net::WebSocket::Frame::MAX_MESSAGE_SIZE, Net::WebSocket::Client.new("ws://example.com").max_message_size)
+    assert_equal(1009, Net::WebSocket::CLOSE_MESSAGE_TOO_BIG)
+  end
+
+  def test_message_within_max_message_size
+    client = Net::WebSocket::Client.new("ws://example.com", max_message_size: 8)
+    input = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_TEXT, "abcd", false, false, nil)
+    input << Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_CONTINUATION, "efgh", true, false, nil)
+    assert_equal([Net::WebSocket::OPCODE_TEXT, "abcdefgh"], receive_frame_from(client, input))
+  end
+
+  def test_fragments_over_max_message_size_close_with_1009
+    client = Net::WebSocket::Client.new("ws://example.com", max_message_size: 8)
+    input = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_TEXT, "abcdef", false, false, nil)
+    input << Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_CONTINUATION, "ghi", true, false, nil)
+    assert_raise(Net::WebSocket::MessageTooBig) do
+      receive_frame_from(client, input)
+    end
+    assert_closed_with_message_too_big(client)
+  end
+
+  def test_frame_over_max_message_size_is_refused_before_buffering
+    client = Net::WebSocket::Client.new("ws://example.com")
+    client.max_message_size = 100
+    # Only the 10-byte header of a 64 KiB frame arrives
+    input = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_BINARY, "a" * 65536, true, false, nil)
+    assert_raise(Net::WebSocket::MessageTooBig) do
+      receive_frame_from(client, input.byteslice(0, 10) || "")
+    end
+    assert_closed_with_message_too_big(client)
+  end
+
+  def test_control_frame_is_not_limited_by_max_message_size
+    client = Net::WebSocket::Client.new("ws://example.com", max_message_size: 2)
+    input = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_PING, "ping!", true, false, nil)
+    assert_equal([Net::WebSocket::OPCODE_PING, "ping!"], receive_frame_from(client, input))
+  end
+
   def test_parse_url_with_nested_path
     client = Net::WebSocket::Client.new("ws://example.com/api/v1/websocket")
     assert_equal("/api/v1/websocket", client.path)
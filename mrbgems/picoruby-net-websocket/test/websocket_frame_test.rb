@@ -0,0 +1,88 @@
+class WebSocketFrameTest < Picotest::Test
+  def test_encode_unmasked
+    frame = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_TEXT, "Hello", true, false, nil)
+    assert_equal("\x81\x05Hello", frame)
+  end
+
+  def test_encode_masked
+    frame = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_TEXT, "Hello", true, false, "\x37\xfa\x21\x3d")
+    # RFC 6455 5.7
+    assert_equal("\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58", frame)
+  end
+
+  def test_encode_extended_lengths
+    frame = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_BINARY, "a" * 256, true, false, nil)
+    assert_equal("\x82\x7e\x01\x00", frame.byteslice(0, 4))
+    assert_equal(260, frame.bytesize)
+    frame = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_BINARY, "a" * 65536, false, true, nil)
+    assert_equal("\x42\x7f\x00\x00\x00\x00\x00\x01\x00\x00", frame.byteslice(0, 10))
+  end
+
+  def test_shift_round_trip
+    buffer = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_TEXT, "first", false, false, "abcd")
+    buffer << Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_CONTINUATION, "x" * 300, true, false, nil)
+    assert_equal([false, false, Net::WebSocket::OPCODE_TEXT, "first"], Net::WebSocket::Frame.shift(buffer))
+    assert_equal([true, false, Net::WebSocket::OPCODE_CONTINUATION, "x" * 300], Net::WebSocket::Frame.shift(buffer))
+    assert_equal("", buffer)
+  end
+
+  def test_shift_incomplete
+    frame = Net::WebSocket::Frame.encode(Net::WebSocket::OPCODE_BINARY, "b" * 200, true, false, "abcd")
+    assert_equal(2, Net::WebSocket::Frame.shift(""))
+    # 2 bytes, 2 of length and 4 of mask key
+    assert_equal(8, Net::WebSocket::Frame.shift(frame.byteslice(0, 3) || ""))
+    partial = frame.byteslice(0, 100) || ""
+    assert_equal(208, Net::WebSocket::Frame.shift(partial))
+    assert_equal(100, partial.bytesize)
+  end
+
+  def test_shift_rejects_bad_frames
+    assert_raise(Net::WebSocket::ProtocolError) do
+      Net::WebSocket::Frame.shift("\xa1\x00")
+    end
+    assert_raise(Net::WebSocket::ProtocolError) do
+      Net::WebSocket::Frame.shift("\x83\x00")
+    end
+    assert_raise(Net::WebSocket::ProtocolError) do
+      Net::WebSocket::Frame.shift("\x09\x00")
+    end
+    assert_raise(Net::WebSocket::ProtocolError) do
+      Net::WebSocket::Frame.shift("\x89\x7e\x00\x7e")
+    end
+  end
+
+  def test_mask_in_place_any_length
+    key = "\x01\x02\x04\x08"
+    len = 0
+    while len < 21
+      data = "\x00" * len
+      assert_equal(data, Net::WebSocket::Frame.mask!(data, key))
+      i = 0
+      while i < len
+        assert_equal(key.getbyte(i % 4), data.getbyte(i))
+        i += 1
+      end
+      len += 1
+    end
+  end
+
+  def test_deflate_round_trip
+    text = "WebSocket " * 100
+    deflated = Net::WebSocket::Frame.deflate(text)
+    assert(deflated.bytesize < text.bytesize)
+    assert_equal(text, Net::WebSocket::Frame.inflate(deflated))
+    assert_equal(text, Net::WebSocket::Frame.inflate(Net::WebSocket::Frame.deflate(text, 8)))
+    assert_equal("", Net::WebSocket::Frame.inflate(Net::WebSocket::Frame.deflate("")))
+  end
+
+  def test_inflate_rfc7692_example
+    # "Hello" compressed by zlib, from RFC 7692 7.2.3.1
+    assert_equal("Hello", Net::WebSocket::Frame.inflate("\xf2\x48\xcd\xc9\xc9\x07\x00"))
+  end
+
+  def test_inflate_rejects_corrupt_data
+    assert_raise(Net::WebSocket::ProtocolError) do
+      Net::WebSocket::Frame.inflate("\xff\xff\xff")
+    end
+  end
+end
@@ -69,6 +69,46 @@ class IO
     end
   end
 
+  # mruby/c does not distinguish between singleton and instance methods,
+  # so copy_stream would become a method of every IO there
+  if RUBY_ENGINE == 'mruby'
+    COPY_STREAM_CHUNK_SIZE = 4096
+
+    # Copy src to dst, each an IO-like object or a path, and return the
+    # number of bytes copied. A destination with sendfile (a socket) is
+    # handed the source whole, so that TCPSocket can send an IO from the
+    # kernel without reading it into Strings.
+    def self.copy_stream(src, dst, copy_length = nil, src_offset = nil)
+      src_io = src.is_a?(String) ? File.open(src, "r") : src
+      dst_io = dst.is_a?(String) ? File.open(dst, "w") : dst
+      begin
+        if dst_io.respond_to?(:sendfile)
+          return dst_io.sendfile(src_io, src_offset, copy_length)
+        end
+        # Position of src_io to restore when reading from src_offset
+        pos = nil
+        if src_offset
+          pos = src_io.pos
+          src_io.seek(src_offset)
+        end
+        copied = 0
+        while copy_length.nil? || copied < copy_length
+          size = COPY_STREAM_CHUNK_SIZE
+          size = copy_length - copied if copy_length && copy_length - copied < size
+          chunk = src_io.read(size)
+          break if chunk.nil? || chunk.empty?
+          dst_io.write(chunk)
+          copied += chunk.bytesize
+        end
+        src_io.seek(pos) if pos
+        copied
+      ensure
+        src_io.close if src.is_a?(String)
+        dst_io.close if dst.is_a?(String)
+      end
+    end
+  end
+
   # mruby/c does not distinguish between singleton and instance methods.
   # So, we don't define singleton methods here.
 #  def self.read(path, length=nil, offset=0, mode: "r")
@@ -4,19 +4,59 @@ class Sandbox
 
   TIMEOUT = 10_000 # 10 sec
 
+  # Returns false on timeout or Ctrl-Z, true otherwise
   def wait(timeout: TIMEOUT)
-    sleep_ms 5
     signal_self_manage = Machine.pop_signal_self_manage
-    loop(timeout, signal_self_manage)
+    if WAIT_BRIDGE
+      wait_for_event(timeout, signal_self_manage)
+    else
+      sleep_ms 5
+      loop(timeout, signal_self_manage)
+    end
+  end
+
+  # load_file keeps the bytecode it compiles from a source file in a cache
+  # file and runs that the next time, as long as the source has the same
+  # size, mtime and (with picoruby-crc) CRC-32. The cache file is the RITE
+  # binary followed by that key. It is "app.rb.mrbc" next to "app.rb" or,
+  # if :dir is set, "%lib%app.rb.mrbc" in that directory for "/lib/app.rb".
+  # A cache that cannot be written is not an error; the source is compiled
+  # every time instead.
+  BYTECODE_CACHE = { enabled: true, dir: nil }
+  CACHE_SUFFIX = ".mrbc"
+  CACHE_READ_SIZE = 512
+  RITE_HEADER_SIZE = 20
+
+  # The binary_size field of a RITE header
+  def self.rite_binary_size(bin)
+    size = 0
+    i = 8
+    while i < 12
+      size = (size << 8) | bin.getbyte(i).to_i
+      i += 1
+    end
+    size
   end
 
   def load_file(path, join: true)
-    f = File.open(path, "r")
-    begin
-      return nil unless rb = f.read
-      # exec_mrb keeps only a pointer into this string's data (it is not copied),
-      # so retain it on the instance to keep it alive for the task's lifetime and
-      # prevent GC from freeing the bytecode while the task is still running.
+    key = bytecode_cache_key(path)
+    if rb = key ? read_bytecode_cache(path, key) : nil
+      # exec_mrb keeps only a pointer into this string's data (it is not
+      # copied), so retain it on the instance to keep it alive for the task's
+      # lifetime and prevent GC from freeing the bytecode while the task is
+      # still running.
+      @code = rb
+      # A cache the VM refuses is replaced by compiling the source
+      started = exec_mrb(rb)
+    end
+    unless started
+      f = File.open(path, "r")
+      begin
+        rb = f.read
+      ensure
+        f.close
+      end
+      return nil unless rb
       @code = rb
       is_rite = rb.start_with?(RITE_VERSION)
       started = if is_rite
@@ -28,41 +68,120 @@ class Sandbox
         unless compile(rb, filename: path)
           raise RuntimeError, "#{path}: compile failed"
         end
+        write_bytecode_cache(path, key) if key
         execute
       end
-      if join && started
-        wait(timeout: nil)
+    end
+    if join && started
+      wait(timeout: nil)
+    end
+  end
+
+  def bytecode_cache_path(path)
+    if dir = BYTECODE_CACHE[:dir]
+      "#{dir}/#{path.split("/").join("%")}#{CACHE_SUFFIX}"
+    else
+      "#{path}#{CACHE_SUFFIX}"
+    end
+  end
+
+  private
+
+  # nil if the file is not to be cached
+  def bytecode_cache_key(path)
+    return nil unless BYTECODE_CACHE[:enabled]
+    return nil if path.end_with?(".mrb") || path.end_with?(CACHE_SUFFIX)
+    begin
+      stat = File::Stat.new(path)
+      key = "\0PRBC #{stat.size} #{stat.mtime.to_i}"
+    rescue
+      return nil
+    end
+    begin
+      digest = CRC::Digest.new
+    rescue NameError
+      return key
+    end
+    f = File.open(path, "r")
+    begin
+      while chunk = f.read(CACHE_READ_SIZE)
+        digest << chunk
       end
     ensure
       f.close
     end
+    "#{key} #{digest.finish}"
   end
 
-  private
+  def read_bytecode_cache(path, key)
+    cache_path = bytecode_cache_path(path)
+    return nil unless File.file?(cache_path)
+    f = File.open(cache_path, "r")
+    begin
+      data = f.read
+    ensure
+      f.close
+    end
+    return nil unless data && data.start_with?(RITE_VERSION)
+    size = data.bytesize - key.bytesize
+    return nil if size < RITE_HEADER_SIZE || data.byteslice(size, key.bytesize) != key
+    # The VM reads as far as the size in the RITE header says, so a
+    # truncated binary must not reach it
+    return nil if Sandbox.rite_binary_size(data) != size
+    data
+  rescue
+    nil
+  end
+
+  def write_bytecode_cache(path, key)
+    return unless bin = dump
+    f = File.open(bytecode_cache_path(path), "w")
+    begin
+      f.write(bin)
+      f.write(key)
+    ensure
+      f.close
+    end
+  rescue
+    # read-only volume, no room left, ...
+  end
+
+  # Blocks on a queue that the C side pushes :done or :signal to, so
+  # that the waiter neither sleeps past the end of the task nor runs
+  # while the task does
+  def wait_for_event(timeout, signal_self_manage)
+    queue = (@wait_queue ||= Task::Queue.new)
+    deadline = timeout ? Machine.board_millis + timeout : nil
+    while true
+      unless _watch(queue, !signal_self_manage)
+        # Too many sandboxes waited on at once
+        sleep_ms 5
+        return loop(deadline ? deadline - Machine.board_millis : nil, signal_self_manage)
+      end
+      event = if deadline
+        remaining = deadline - Machine.board_millis
+        0 < remaining ? queue.pop(timeout_ms: remaining) : nil
+      else
+        queue.pop
+      end
+      if event.nil?
+        _unwatch
+        queue.clear # a push may have come in since
+        puts "Error: Timeout (sandbox.state: #{self.state})"
+        return false
+      end
+      return true if event == :done
+      handled = handle_signal(Machine.poll_signal)
+      return handled unless handled.nil?
+    end
+  end
 
   def loop(timeout, signal_self_manage)
     n = 5
     while self.state != :DORMANT && self.state != :SUSPENDED do
       unless signal_self_manage
-        # poll_signal reports the pending signal as a value (:INT / :TSTP / nil)
-        # instead of raising Interrupt / SignalException, so Ctrl-C and Ctrl-Z
-        # are handled with plain control flow rather than rescue clauses.
-        case Machine.poll_signal
-        when :INT
-          begin
-            Watchdog.disable
-            puts "Watchdog disabled"
-          rescue NameError
-            # ignore. maybe POSIX
-          end
-          puts "^C"
-          Signal.raise(:INT)
-          self.stop
-          return true # should be false?
-        when :TSTP
-          Signal.raise(:TSTP)
-          return false
-        end
+        handled = handle_signal(Machine.poll_signal)
+        return handled unless handled.nil?
       end
       sleep_ms 5
       if timeout
@@ -76,4 +195,28 @@ class Sandbox
     return true
   end
 
+  # What wait returns for the signal, or nil to keep waiting
+  def handle_signal(signal)
+    # poll_signal reports the pending signal as a value (:INT / :TSTP / nil)
+    # instead of raising Interrupt / SignalException, so Ctrl-C and Ctrl-Z
+    # are handled with plain control flow rather than rescue clauses.
+    case signal
+    when :INT
+      begin
+        Watchdog.disable
+        puts "Watchdog disabled"
+      rescue NameError
+        # ignore. maybe POSIX
+      end
+      puts "^C"
+      Signal.raise(:INT)
+      self.stop
+      return true # should be false?
+    when :TSTP
+      Signal.raise(:TSTP)
+      return false
+    end
+    nil
+  end
+
 end
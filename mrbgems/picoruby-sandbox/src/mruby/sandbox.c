@@ -7,6 +7,7 @@
 #include <mruby/string.h>
 #include <mruby/variable.h>
 #include <mruby/proc.h>
+#include <mruby/array.h>
 // #include <mruby/debug.h>
 
 void mrc_resolve_intern(mrc_ccontext *cc, mrc_irep *irep);
@@ -17,9 +18,16 @@ void mrb_irep_incref(mrb_state *, struct mrb_irep *);
 void mrb_irep_decref(mrb_state *, struct mrb_irep *);
 void mrb_irep_cutref(mrb_state *, struct mrb_irep *);
 
+#if defined(SANDBOX_WAIT_BRIDGE)
+static void sandbox_unwatch(mrb_state *mrb, SandboxState *ss);
+#endif
+
 static void
 mrb_sandbox_state_free(mrb_state *mrb, void *ptr) {
   SandboxState *ss = (SandboxState *)ptr;
+#if defined(SANDBOX_WAIT_BRIDGE)
+  sandbox_unwatch(mrb, ss);
+#endif
   if (!mrb_nil_p(ss->task)) {
     mrb_gc_unregister(mrb, ss->task);
   }
@@ -253,6 +261,8 @@ mrb_sandbox_free_parser(mrb_state *mrb, mrb_value self)
 static mrb_bool
 sandbox_exec_vm_code_sub(mrb_state *mrb, SandboxState *ss)
 {
+  /* mrb_read_irep() refuses a broken binary */
+  if (!ss->irep) return FALSE;
   struct RProc *proc = mrb_proc_new(mrb, (const mrb_irep *)ss->irep);
   proc->e.target_class = mrb->object_class;
   proc->c = NULL;
@@ -263,6 +273,31 @@ sandbox_exec_vm_code_sub(mrb_state *mrb, SandboxState *ss)
 
 // created in mruby/src/load.c
 mrb_irep *mrb_read_irep(mrb_state *mrb, const uint8_t *bin);
+// created in mruby/src/dump.c
+#ifndef MRB_DUMP_DEBUG_INFO
+#define MRB_DUMP_DEBUG_INFO 1   /* as in mruby/dump.h */
+#endif
+int mrb_dump_irep(mrb_state *mrb, const mrb_irep *irep, uint8_t flags, uint8_t **bin, size_t *bin_size);
+
+/*
+ * Sandbox#dump -> String | nil
+ * The RITE binary of the script compiled last
+ */
+static mrb_value
+mrb_sandbox_dump(mrb_state *mrb, mrb_value self)
+{
+  SS();
+  if (!ss->irep) return mrb_nil_value();
+  uint8_t *bin = NULL;
+  size_t bin_size = 0;
+  /* Keep file names and line numbers for the backtraces of a cached script */
+  if (mrb_dump_irep(mrb, (const mrb_irep *)ss->irep, MRB_DUMP_DEBUG_INFO, &bin, &bin_size) != 0) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "Dump failed");
+  }
+  mrb_value str = mrb_str_new(mrb, (const char *)bin, bin_size);
+  mrb_free(mrb, bin);
+  return str;
+}
 
 static mrb_value
 mrb_sandbox_exec_vm_code(mrb_state *mrb, mrb_value self)
@@ -319,6 +354,147 @@ mrb_sandbox_close(mrb_state *mrb, mrb_value self)
   return mrb_nil_value();
 }
 
+#if defined(SANDBOX_WAIT_BRIDGE)
+
+/*
+ * Waiting for a sandbox
+ *
+ * Sandbox#wait hands a Task::Queue to _watch and pops it. The scheduler
+ * service below looks at every watched sandbox at each scheduler entry
+ * and pushes :done once its task is DORMANT or SUSPENDED, or :signal
+ * when Ctrl-C or Ctrl-Z is pending. The signal itself is left for
+ * Machine.poll_signal. A watch goes away when it fires.
+ */
+
+static struct {
+  SandboxState *ss;
+  bool signals;
+} sandbox_watches_[SANDBOX_WATCH_MAX];
+static int sandbox_watch_count_;
+static mrb_value sandbox_watch_queues_;   /* Array(SANDBOX_WATCH_MAX), rooted */
+
+static bool
+sandbox_task_stopped(mrb_state *mrb, SandboxState *ss)
+{
+  if (mrb_nil_p(ss->task)) return true;
+  mrb_value status = mrb_task_status(mrb, ss->task);
+  if (!mrb_symbol_p(status)) return false;
+  mrb_sym sym = mrb_symbol(status);
+  return sym == MRB_SYM(DORMANT) || sym == MRB_SYM(SUSPENDED);
+}
+
+static void
+sandbox_watch_remove(mrb_state *mrb, int i)
+{
+  sandbox_watch_count_--;
+  sandbox_watches_[i] = sandbox_watches_[sandbox_watch_count_];
+  mrb_ary_set(mrb, sandbox_watch_queues_, i, mrb_ary_entry(sandbox_watch_queues_, sandbox_watch_count_));
+  mrb_ary_set(mrb, sandbox_watch_queues_, sandbox_watch_count_, mrb_nil_value());
+}
+
+static void
+sandbox_unwatch(mrb_state *mrb, SandboxState *ss)
+{
+  for (int i = 0; i < sandbox_watch_count_; i++) {
+    if (sandbox_watches_[i].ss == ss) {
+      sandbox_watch_remove(mrb, i);
+      return;
+    }
+  }
+}
+
+static bool
+sandbox_watch_pending(mrb_state *mrb, void *ud)
+{
+  (void)mrb;
+  (void)ud;
+  return 0 < sandbox_watch_count_;
+}
+
+static void
+sandbox_watch_service(mrb_state *mrb, void *ud)
+{
+  bool signaled = (sigint_status == MACHINE_SIGINT_RECEIVED || sigint_status == MACHINE_SIGTSTP_RECEIVED);
+  int i = 0;
+
+  (void)ud;
+  while (i < sandbox_watch_count_) {
+    mrb_sym event;
+    if (sandbox_task_stopped(mrb, sandbox_watches_[i].ss)) {
+      event = MRB_SYM(done);
+    } else if (signaled && sandbox_watches_[i].signals) {
+      event = MRB_SYM(signal);
+    } else {
+      i++;
+      continue;
+    }
+    mrb_value queue = mrb_ary_entry(sandbox_watch_queues_, i);
+    /* Removed first: if the push raises, the waiter is left to its
+       timeout rather than the service failing at every entry */
+    sandbox_watch_remove(mrb, i);
+    mrb_task_queue_push(mrb, queue, mrb_symbol_value(event));
+  }
+}
+
+/*
+ * Sandbox#_watch(queue, signals) -> bool
+ * false if too many sandboxes are waited on
+ */
+static mrb_value
+mrb_sandbox__watch(mrb_state *mrb, mrb_value self)
+{
+  SS();
+  mrb_value queue;
+  mrb_bool signals;
+  mrb_get_args(mrb, "ob", &queue, &signals);
+  sandbox_unwatch(mrb, ss);
+  if (SANDBOX_WATCH_MAX <= sandbox_watch_count_) return mrb_false_value();
+  int i = sandbox_watch_count_++;
+  sandbox_watches_[i].ss = ss;
+  sandbox_watches_[i].signals = signals;
+  mrb_ary_set(mrb, sandbox_watch_queues_, i, queue);
+  return mrb_true_value();
+}
+
+/*
+ * Sandbox#_unwatch -> nil
+ */
+static mrb_value
+mrb_sandbox__unwatch(mrb_state *mrb, mrb_value self)
+{
+  SS();
+  sandbox_unwatch(mrb, ss);
+  return mrb_nil_value();
+}
+
+static void
+sandbox_watch_init(mrb_state *mrb, struct RClass *class_Sandbox)
+{
+  mrb_value queues = mrb_ary_new_capa(mrb, SANDBOX_WATCH_MAX);
+  for (int i = 0; i < SANDBOX_WATCH_MAX; i++) {
+    mrb_ary_push(mrb, queues, mrb_nil_value());
+  }
+  mrb_gc_register(mrb, queues);
+  sandbox_watch_queues_ = queues;
+  sandbox_watch_count_ = 0;
+
+  mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(_watch), mrb_sandbox__watch, MRB_ARGS_REQ(2));
+  mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(_unwatch), mrb_sandbox__unwatch, MRB_ARGS_NONE());
+
+  static const picorb_scheduler_service_opts_t opts = { "sandbox", 0, 0, sandbox_watch_pending };
+  picorb_scheduler_service_add_opts(mrb, sandbox_watch_service, NULL, &opts);
+}
+
+static void
+sandbox_watch_final(mrb_state *mrb)
+{
+  picorb_scheduler_service_remove(mrb, sandbox_watch_service, NULL);
+  sandbox_watch_count_ = 0;
+  mrb_gc_unregister(mrb, sandbox_watch_queues_);
+  sandbox_watch_queues_ = mrb_nil_value();
+}
+
+#endif /* SANDBOX_WAIT_BRIDGE */
 
 void
 mrb_picoruby_sandbox_gem_init(mrb_state *mrb)
@@ -338,13 +514,24 @@ mrb_picoruby_sandbox_gem_init(mrb_state *mrb)
   mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(stop), mrb_sandbox_stop, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(suspend), mrb_sandbox_suspend, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(free_parser), mrb_sandbox_free_parser, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(dump), mrb_sandbox_dump, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(exec_mrb), mrb_sandbox_exec_vm_code, MRB_ARGS_REQ(1));
   mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(exec_mrb_from_memory), mrb_sandbox_exec_vm_code_from_memory, MRB_ARGS_REQ(1));
   mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(terminate), mrb_sandbox_terminate, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, class_Sandbox, MRB_SYM(close), mrb_sandbox_close, MRB_ARGS_NONE());
+
+#if defined(SANDBOX_WAIT_BRIDGE)
+  mrb_define_const_id(mrb, class_Sandbox, MRB_SYM(WAIT_BRIDGE), mrb_true_value());
+  sandbox_watch_init(mrb, class_Sandbox);
+#else
+  mrb_define_const_id(mrb, class_Sandbox, MRB_SYM(WAIT_BRIDGE), mrb_false_value());
+#endif
 }
 
 void
 mrb_picoruby_sandbox_gem_final(mrb_state* mrb)
 {
+#if defined(SANDBOX_WAIT_BRIDGE)
+  sandbox_watch_final(mrb);
+#endif
 }
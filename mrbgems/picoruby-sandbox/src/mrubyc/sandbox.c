@@ -1,9 +1,17 @@
 #include <mrubyc.h>
 #include "picoruby/debug.h"
 
+#if defined(SANDBOX_WAIT_BRIDGE)
+#include "c_task_queue.h"
+#endif
+
 #define SS() \
   SandboxState *ss = (SandboxState *)v->instance->data
 
+#if defined(SANDBOX_WAIT_BRIDGE)
+static void sandbox_unwatch(SandboxState *ss);
+#endif
+
 static void
 sandbox_release_task(SandboxState *ss)
 {
@@ -22,6 +30,9 @@ static void
 mrbc_sandbox_free(mrbc_value *self)
 {
   SandboxState *ss = (SandboxState *)self->instance->data;
+#if defined(SANDBOX_WAIT_BRIDGE)
+  sandbox_unwatch(ss);
+#endif
   sandbox_release_task(ss);
   free_ccontext(ss);
 }
@@ -93,6 +104,7 @@ c_sandbox_free_parser(mrbc_vm *vm, mrbc_value *v, int argc)
        To preserve symbol table
     */
     if (ss->vm_code) ss->vm_code = NULL;
+    ss->vm_code_size = 0;
   }
   free_ccontext(ss);
   SET_NIL_RETURN();
@@ -131,6 +143,7 @@ sandbox_compile_sub(mrbc_vm *vm, mrbc_value *v, uint8_t *script, size_t size, co
       free_ccontext(ss);
       return;
     }
+    ss->vm_code_size = vm_code_size;
     SET_TRUE_RETURN();
   }
 }
@@ -205,6 +218,7 @@ c_sandbox_exec_mrb(mrbc_vm *vm, mrbc_value *v, int argc)
   }
   mrbc_vm *sandbox_vm = (mrbc_vm *)&ss->tcb->vm;
   ss->vm_code = GET_STRING_ARG(1);
+  ss->vm_code_size = 0;
   if (sandbox_exec_mrb_sub(sandbox_vm, ss)) {
     SET_TRUE_RETURN();
   } else {
@@ -223,6 +237,7 @@ c_sandbox_exec_mrb_from_memory(mrbc_vm *vm, mrbc_value *v, int argc)
   }
   mrbc_vm *sandbox_vm = (mrbc_vm *)&ss->tcb->vm;
   ss->vm_code = (uint8_t *)(intptr_t)GET_INT_ARG(1);
+  ss->vm_code_size = 0;
   if (sandbox_exec_mrb_sub(sandbox_vm, ss)) {
     SET_TRUE_RETURN();
   } else {
@@ -298,6 +313,21 @@ c_sandbox_new(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_RETURN(sandbox);
 }
 
+/*
+ * Sandbox#dump -> String | nil
+ * The RITE binary of the script compiled last
+ */
+static void
+c_sandbox_dump(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  SS();
+  if (!ss->vm_code || ss->vm_code_size == 0) {
+    SET_NIL_RETURN();
+    return;
+  }
+  SET_RETURN(mrbc_string_new(vm, ss->vm_code, ss->vm_code_size));
+}
+
 static void
 c_sandbox_terminate(mrbc_vm *vm, mrbc_value *v, int argc)
 {
@@ -314,6 +344,126 @@ c_sandbox_close(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_NIL_RETURN();
 }
 
+#if defined(SANDBOX_WAIT_BRIDGE)
+
+/*
+ * Waiting for a sandbox
+ *
+ * Mirror of src/mruby/sandbox.c. The queues are held as reference-
+ * counted values.
+ */
+
+static struct {
+  SandboxState *ss;
+  bool signals;
+  mrbc_value queue;
+} sandbox_watches_[SANDBOX_WATCH_MAX];
+static int sandbox_watch_count_;
+
+static bool
+sandbox_task_stopped(SandboxState *ss)
+{
+  if (!ss->tcb) return true;
+  return ss->tcb->state == TASKSTATE_DORMANT || ss->tcb->state == TASKSTATE_SUSPENDED;
+}
+
+/* The caller owns the queue reference from now on */
+static void
+sandbox_watch_remove(int i)
+{
+  sandbox_watch_count_--;
+  sandbox_watches_[i] = sandbox_watches_[sandbox_watch_count_];
+}
+
+static void
+sandbox_unwatch(SandboxState *ss)
+{
+  for (int i = 0; i < sandbox_watch_count_; i++) {
+    if (sandbox_watches_[i].ss == ss) {
+      mrbc_value queue = sandbox_watches_[i].queue;
+      sandbox_watch_remove(i);
+      mrbc_decref(&queue);
+      return;
+    }
+  }
+}
+
+static bool
+sandbox_watch_pending(void *ud)
+{
+  (void)ud;
+  return 0 < sandbox_watch_count_;
+}
+
+static void
+sandbox_watch_service(void *ud)
+{
+  bool signaled = (sigint_status == MACHINE_SIGINT_RECEIVED || sigint_status == MACHINE_SIGTSTP_RECEIVED);
+  int i = 0;
+
+  (void)ud;
+  while (i < sandbox_watch_count_) {
+    mrbc_value event;
+    if (sandbox_task_stopped(sandbox_watches_[i].ss)) {
+      event = mrbc_symbol_value(mrbc_str_to_symid("done"));
+    } else if (signaled && sandbox_watches_[i].signals) {
+      event = mrbc_symbol_value(mrbc_str_to_symid("signal"));
+    } else {
+      i++;
+      continue;
+    }
+    mrbc_value queue = sandbox_watches_[i].queue;
+    sandbox_watch_remove(i);
+    mrbc_task_queue_push(&queue, &event);
+    mrbc_decref(&queue);
+  }
+}
+
+/*
+ * Sandbox#_watch(queue, signals) -> bool
+ * false if too many sandboxes are waited on
+ */
+static void
+c_sandbox__watch(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  SS();
+  sandbox_unwatch(ss);
+  if (SANDBOX_WATCH_MAX <= sandbox_watch_count_) {
+    SET_FALSE_RETURN();
+    return;
+  }
+  int i = sandbox_watch_count_++;
+  sandbox_watches_[i].ss = ss;
+  sandbox_watches_[i].signals = mrbc_type(v[2]) != MRBC_TT_NIL && mrbc_type(v[2]) != MRBC_TT_FALSE;
+  sandbox_watches_[i].queue = v[1];
+  mrbc_incref(&v[1]);
+  SET_TRUE_RETURN();
+}
+
+/*
+ * Sandbox#_unwatch -> nil
+ */
+static void
+c_sandbox__unwatch(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  SS();
+  sandbox_unwatch(ss);
+  SET_NIL_RETURN();
+}
+
+static void
+sandbox_watch_init(mrbc_vm *vm, mrbc_class *class_Sandbox)
+{
+  sandbox_watch_count_ = 0;
+  mrbc_define_method(vm, class_Sandbox, "_watch", c_sandbox__watch);
+  mrbc_define_method(vm, class_Sandbox, "_unwatch", c_sandbox__unwatch);
+
+  static const picorb_scheduler_service_opts_t opts = { "sandbox", 0, 0, sandbox_watch_pending };
+  picorb_scheduler_service_add_opts(sandbox_watch_service, NULL, &opts);
+}
+
+#endif /* SANDBOX_WAIT_BRIDGE */
+
 void
 mrbc_sandbox_init(mrbc_vm *vm)
 {
@@ -330,9 +480,17 @@ mrbc_sandbox_init(mrbc_vm *vm)
   mrbc_define_method(vm, class_Sandbox, "stop",    c_sandbox_stop);
   mrbc_define_method(vm, class_Sandbox, "suspend", c_sandbox_suspend);
   mrbc_define_method(vm, class_Sandbox, "free_parser", c_sandbox_free_parser);
+  mrbc_define_method(vm, class_Sandbox, "dump", c_sandbox_dump);
   mrbc_define_method(vm, class_Sandbox, "exec_mrb", c_sandbox_exec_mrb);
   mrbc_define_method(vm, class_Sandbox, "exec_mrb_from_memory", c_sandbox_exec_mrb_from_memory);
   mrbc_define_method(vm, class_Sandbox, "new",     c_sandbox_new);
   mrbc_define_method(vm, class_Sandbox, "terminate", c_sandbox_terminate);
   mrbc_define_method(vm, class_Sandbox, "close", c_sandbox_close);
+
+#if defined(SANDBOX_WAIT_BRIDGE)
+  mrbc_set_class_const(class_Sandbox, mrbc_str_to_symid("WAIT_BRIDGE"), &mrbc_true_value());
+  sandbox_watch_init(vm, class_Sandbox);
+#else
+  mrbc_set_class_const(class_Sandbox, mrbc_str_to_symid("WAIT_BRIDGE"), &mrbc_false_value());
+#endif
 }
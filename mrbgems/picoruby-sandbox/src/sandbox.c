@@ -4,6 +4,25 @@
 #include "task.h"
 #endif
 
+/*
+ * Sandbox#wait blocks on a Task::Queue that a scheduler service fills
+ * once the sandboxed task stops or a signal arrives, when the VM has a
+ * scheduler hook. Otherwise it polls.
+ */
+#if (defined(PICORB_VM_MRUBY) && defined(MRB_USE_TASK_SCHEDULER)) || \
+    (defined(PICORB_VM_MRUBYC) && defined(MRBC_TASK_SCHEDULER_HOOK))
+#define SANDBOX_WAIT_BRIDGE 1
+/* Spelled out: picoruby-mruby/include/hal.h shadows this one on the
+   include path. */
+#include "../../picoruby-machine/include/hal.h"
+#include "../../picoruby-machine/include/machine.h"
+#endif
+
+/* Sandboxes that can be waited on at the same time */
+#ifndef SANDBOX_WATCH_MAX
+#define SANDBOX_WATCH_MAX 8
+#endif
+
 typedef struct sandbox_state {
   mrc_ccontext *cc;
   mrc_irep *irep;
@@ -13,6 +32,7 @@ typedef struct sandbox_state {
   mrbc_tcb *tcb;
 #endif
   uint8_t *vm_code;
+  size_t vm_code_size;      /* 0 unless vm_code is what compile dumped */
   pm_options_t *options;
 } SandboxState;
 
@@ -0,0 +1,139 @@
+# The test file is also `load`ed on CRuby to discover the test classes, where
+# "littlefs" does not exist; see picoruby-sqlite3/test/sqlite3_test.rb
+begin
+  require "littlefs"
+rescue LoadError
+end
+
+# Sandbox#load_file and its bytecode cache on the RAM backed littlefs volume
+# of ports/posix
+class SandboxBytecodeCacheTest < Picotest::Test
+  SOURCE = "/sandbox_cache_test.rb"
+
+  def setup
+    skip "no VFS on wasm" if wasm?
+    unless VFS::VOLUMES.any? { |v| v[:mountpoint] == "/" }
+      fs = Littlefs.new(:flash, label: "SBXTEST")
+      fs.mkfs
+      VFS.mount(fs, "/")
+    end
+    @enabled = Sandbox::BYTECODE_CACHE[:enabled]
+    Sandbox::BYTECODE_CACHE[:enabled] = true
+    sandbox = Sandbox.new
+    @cache = sandbox.bytecode_cache_path(SOURCE)
+    sandbox.close
+    File.unlink(@cache) if File.exist?(@cache)
+    write_file(SOURCE, ":from_source")
+  end
+
+  def teardown
+    return unless @cache
+    Sandbox::BYTECODE_CACHE[:enabled] = @enabled
+    File.unlink(SOURCE) if File.exist?(SOURCE)
+    File.unlink(@cache) if File.exist?(@cache)
+  end
+
+  def write_file(path, data)
+    f = File.open(path, "w")
+    f.write(data)
+    f.close
+  end
+
+  def read_file(path)
+    f = File.open(path, "r")
+    data = f.read
+    f.close
+    data
+  end
+
+  def run_file(path)
+    sandbox = Sandbox.new
+    sandbox.load_file(path)
+    assert_nil sandbox.error
+    result = sandbox.result
+    sandbox.close
+    result
+  end
+
+  # What follows the RITE binary in the cache file
+  def cache_key
+    data = read_file(@cache)
+    size = Sandbox.rite_binary_size(data)
+    data.byteslice(size, data.bytesize - size)
+  end
+
+  # Puts the bytecode of code in the cache under key, to tell a cache hit
+  # from a compile of SOURCE
+  def plant_cache(code, key)
+    sandbox = Sandbox.new
+    assert sandbox.compile(code)
+    bin = sandbox.dump
+    sandbox.close
+    write_file(@cache, bin + key)
+  end
+
+  def test_cache_is_written_then_run
+    assert_equal :from_source, run_file(SOURCE)
+    assert File.exist?(@cache)
+    assert read_file(@cache).start_with?(RITE_VERSION)
+    key = cache_key
+    assert key.start_with?("\0PRBC ")
+
+    plant_cache(":from_cache", key)
+    assert_equal :from_cache, run_file(SOURCE)
+  end
+
+  def test_source_of_another_size_is_compiled_again
+    run_file(SOURCE)
+    key = cache_key
+    plant_cache(":from_cache", key)
+    write_file(SOURCE, ":from_longer_source")
+    assert_equal :from_longer_source, run_file(SOURCE)
+    assert cache_key != key
+    assert_equal :from_longer_source, run_file(SOURCE)
+  end
+
+  def test_touched_source_is_compiled_again
+    run_file(SOURCE)
+    key = cache_key
+    plant_cache(":from_cache", key)
+    mtime = File::Stat.new(SOURCE).mtime + 10
+    File.utime(mtime, mtime, SOURCE)
+    assert_equal :from_source, run_file(SOURCE)
+    assert cache_key != key
+  end
+
+  def test_truncated_cache_is_compiled_again
+    run_file(SOURCE)
+    data = read_file(@cache)
+    key = cache_key
+    # The key is intact but the binary is not
+    write_file(@cache, data.byteslice(0, Sandbox::RITE_HEADER_SIZE + 4) + key)
+    assert_equal :from_source, run_file(SOURCE)
+    assert_equal data, read_file(@cache)
+  end
+
+  def test_corrupt_cache_is_compiled_again
+    run_file(SOURCE)
+    data = read_file(@cache)
+    key = cache_key
+    write_file(@cache, "RITE9999" + data.byteslice(8, data.bytesize - 8))
+    assert_equal :from_source, run_file(SOURCE)
+    assert_equal data, read_file(@cache)
+
+    write_file(@cache, "garbage" + key)
+    assert_equal :from_source, run_file(SOURCE)
+    assert_equal data, read_file(@cache)
+  end
+
+  def test_disabled_cache_is_neither_read_nor_written
+    run_file(SOURCE)
+    plant_cache(":from_cache", cache_key)
+    Sandbox::BYTECODE_CACHE[:enabled] = false
+    assert_equal :from_source, run_file(SOURCE)
+
+    File.unlink(@cache)
+    assert_equal :from_source, run_file(SOURCE)
+    assert !File.exist?(@cache)
+  end
+end
@@ -30,6 +30,19 @@ class SandboxTest < Picotest::Test
     assert_equal "/myscript.rb", sandbox.result
   end
 
+  def test_dump_runs_with_exec_mrb
+    sandbox = Sandbox.new
+    assert sandbox.compile("$sandbox_dumped = :dumped")
+    bin = sandbox.dump
+    assert bin.start_with?("RITE")
+
+    other = Sandbox.new
+    assert other.exec_mrb(bin)
+    other.wait(timeout: nil)
+    assert_nil other.error
+    assert_equal :dumped, $sandbox_dumped
+  end
+
   def test_stop_is_idempotent_after_task_finishes
     sandbox = Sandbox.new
     sandbox.compile(":done")
@@ -64,6 +77,36 @@ class SandboxTest < Picotest::Test
     assert_equal :new, sandbox.result
   end
 
+  # Both test builds have a scheduler hook: MRB_USE_TASK_SCHEDULER on
+  # picoruby and MRBC_TASK_SCHEDULER_HOOK in femtoruby-test
+  def test_wait_bridge
+    assert_true Sandbox::WAIT_BRIDGE
+  end
+
+  def test_wait_returns_when_task_finishes
+    sandbox = Sandbox.new
+    sandbox.compile("sleep_ms 50; :finished")
+    sandbox.execute
+    start = Machine.board_millis
+    assert_true sandbox.wait(timeout: 5_000)
+    assert Machine.board_millis - start < 1_000
+    assert_equal :finished, sandbox.result
+    sandbox.close
+  end
+
+  def test_wait_times_out
+    sandbox = Sandbox.new
+    sandbox.compile("while true; sleep_ms 10; end")
+    sandbox.execute
+    start = Machine.board_millis
+    assert_false sandbox.wait(timeout: 100)
+    elapsed = Machine.board_millis - start
+    assert 90 <= elapsed
+    assert elapsed < 2_000
+    sandbox.stop
+    sandbox.close
+  end
+
   def test_close_removes_task_from_scheduler
     dormant_count = Task.stat[:dormant][:count] if picoruby?
     sandbox = Sandbox.new
@@ -12,6 +12,24 @@
 
 #define SOCKET_ERROR_MSG_LEN 128
 
+/* Same as BasicSocket::CONNECTION_TIMEOUT_MS, for connects made in C */
+#ifndef PICORB_SOCKET_CONNECTION_TIMEOUT_MS
+#define PICORB_SOCKET_CONNECTION_TIMEOUT_MS 10000
+#endif
+
+/* Readiness is reported to Ruby through a Task::Queue in @event_queue.
+ * RP2040 poll mode notifies from lwIP callbacks; POSIX notifies from the
+ * I/O reactor of picoruby-machine (ports/posix/socket_poll.c). With an
+ * event queue, TCPSocket.new only starts connecting and Ruby waits for
+ * __connection_state to leave SOCKET_STATE_CONNECTING. */
+#if defined(PICO_CYW43_ARCH_POLL)
+  #define PICORB_SOCKET_EVENT_QUEUE 1
+#elif defined(PICORB_PLATFORM_POSIX) && !defined(__EMSCRIPTEN__) && \
+      ((defined(PICORB_VM_MRUBY) && defined(MRB_USE_TASK_SCHEDULER)) || \
+       (defined(PICORB_VM_MRUBYC) && defined(MRBC_TASK_SCHEDULER_HOOK)))
+  #define PICORB_SOCKET_EVENT_QUEUE 1
+#endif
+
 /* Connection states returned by the socket polling API. */
 #define SOCKET_STATE_NONE        0
 #define SOCKET_STATE_CONNECTING  1
@@ -22,6 +40,9 @@
 
 /* Socket structure for POSIX */
 #ifdef PICORB_PLATFORM_POSIX
+#define SOCKET_ADDRESS_LEN   46 /* INET6_ADDRSTRLEN */
+#define SOCKET_MAX_ADDRESSES 4  /* Resolved addresses tried by TCPSocket_connect */
+
 typedef struct {
   int fd;                    /* File descriptor (-1 = invalid) */
   int family;                /* AF_INET, AF_INET6 */
@@ -32,7 +53,29 @@ typedef struct {
   char remote_host[256];
   int remote_port;
   char errmsg[SOCKET_ERROR_MSG_LEN]; /* Last error message from C layer */
+  int state;                 /* SOCKET_STATE_* */
+  void *dns_request;         /* Net_dns_start request while resolving */
+  int race_fd;               /* Second connect attempt racing fd, or -1 */
+  char candidates[SOCKET_MAX_ADDRESSES][SOCKET_ADDRESS_LEN]; /* Numeric addresses in connect order */
+  int candidate_count;
+  int next_candidate;        /* First candidate not yet tried */
+  int last_error;            /* errno of the last failed attempt */
+  void *vm;                  /* Owning VM for readiness notification */
+  void *event_queue;         /* VM-specific Task::Queue value */
+  bool event_pending;        /* A readable notification is already queued */
 } picorb_socket_t;
+
+/* Address helpers shared by the POSIX ports (ports/posix/net_helpers.c).
+ * Net_resolve returns up to max numeric addresses of both families, IPv4
+ * and IPv6 interleaved as RFC 8305 orders connection attempts, or 0 with
+ * *error set to a getaddrinfo() error. Sockets of family AF_INET6 are
+ * dual-stack, so Net_sockaddr maps IPv4 addresses for them and
+ * Net_sockaddr_address unmaps them again. */
+struct sockaddr;
+int Net_resolve(const char *name, char (*addresses)[SOCKET_ADDRESS_LEN], int max, int *error);
+int Net_socket(int type, int protocol, int *family);
+size_t Net_sockaddr(const char *address, int port, int family, struct sockaddr *sa, size_t salen);
+int Net_sockaddr_address(const struct sockaddr *sa, char *host, size_t host_len, int *port);
 #endif
 
 /* Socket structure for LwIP (rp2040 and other microcontrollers) */
@@ -58,8 +101,9 @@ typedef struct {
   int last_sender_port;
   char errmsg[SOCKET_ERROR_MSG_LEN]; /* Last error message from C layer */
   void *vm;                   /* Owning VM for callback notification */
-  void *event_queue;          /* VM-specific Task::Queue value (RP2040 only) */
+  void *event_queue;          /* VM-specific Task::Queue value */
   bool event_pending;         /* A readable notification is already queued */
+  bool want_writable;         /* Notify when sent data is acknowledged */
 } picorb_socket_t;
 
 /* LwIP helper functions - implemented in ports/rp2040/ */
@@ -92,13 +136,70 @@ void Net_dns_abandon(void *request);
 #define picorb_state mrbc_vm
 #endif
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 void picorb_task_queue_notify(picorb_state *vm, void *queue, bool *pending);
 bool picorb_task_queue_attach(picorb_state *vm, void *self, void **queue);
 bool picorb_socket_attach_event_queue(picorb_state *vm, void *self, picorb_socket_t *sock);
 void picorb_socket_notify_readable(picorb_socket_t *sock);
 #endif
 
+#if defined(PICORB_PLATFORM_POSIX) && defined(PICORB_SOCKET_EVENT_QUEUE)
+/* Readiness watch on the I/O reactor of picoruby-machine
+ * (ports/posix/socket_poll.c). notify is called with target when fd
+ * becomes ready for events, unless *pending says that a notification is
+ * already queued. */
+#define SOCKET_WATCH_READABLE 0x01
+#define SOCKET_WATCH_WRITABLE 0x02
+typedef void (*picorb_socket_watch_func)(void *target, int events);
+bool Socket_watch(int fd, int events, picorb_socket_watch_func notify,
+                  void *target, bool *pending);
+void Socket_unwatch(int fd);
+bool TCPSocket_wait_connected(picorb_state *vm, picorb_socket_t *sock, int timeout_ms);
+
+/* Name resolution on a worker thread (ports/posix/net_helpers.c), with the
+ * same interface as the lwIP ports. notify is called on the VM thread.
+ * Status: 1 = in progress, 2 = resolved, 3 = failed */
+typedef void (*picorb_dns_notify_func)(void *arg);
+void* Net_dns_start(const char *name, picorb_dns_notify_func notify, void *arg);
+int Net_dns_status(void *request);
+int Net_dns_get_address(void *request, char *buf, size_t buflen);
+int Net_dns_get_address_at(void *request, int index, char *buf, size_t buflen);
+void Net_dns_release(void *request);
+void Net_dns_abandon(void *request);
+#endif
+
+/* Receive buffer behind BasicSocket#gets/read/ungetc.
+ * Unread bytes are ptr[head, tail). The buffer is filled with recv calls of
+ * at least PICORB_SOCKET_RBUF_SIZE bytes and grows only for long lines. */
+#ifndef PICORB_SOCKET_RBUF_SIZE
+#define PICORB_SOCKET_RBUF_SIZE 1024
+#endif
+
+typedef struct {
+  char *ptr;
+  size_t head;               /* Offset of the first unread byte */
+  size_t tail;               /* Offset just past the last unread byte */
+  size_t capa;               /* Allocated size of ptr */
+  size_t scanned;            /* Bytes after head already searched for a separator */
+} picorb_socket_rbuf_t;
+
+/* Receive function used to fill a picorb_socket_rbuf_t.
+ * Same return values as TCPSocket_recv(). */
+typedef ssize_t (*picorb_socket_recv_func)(picorb_state *vm, void *conn,
+                                           void *buf, size_t len, bool nonblock);
+
+void picorb_socket_rbuf_free(picorb_state *vm, picorb_socket_rbuf_t *rbuf);
+size_t picorb_socket_rbuf_length(const picorb_socket_rbuf_t *rbuf);
+char* picorb_socket_rbuf_reserve(picorb_state *vm, picorb_socket_rbuf_t *rbuf,
+                                 size_t len, size_t *avail);
+ssize_t picorb_socket_rbuf_fill(picorb_state *vm, picorb_socket_rbuf_t *rbuf,
+                                picorb_socket_recv_func recv, void *conn, bool nonblock);
+size_t picorb_socket_rbuf_find_line(picorb_socket_rbuf_t *rbuf, const char *sep,
+                                    size_t sep_len, size_t limit, bool resume);
+void picorb_socket_rbuf_consume(picorb_socket_rbuf_t *rbuf, size_t len);
+bool picorb_socket_rbuf_unget(picorb_state *vm, picorb_socket_rbuf_t *rbuf,
+                              const void *data, size_t len);
+
 /* Special return value from read functions: no data available in non-blocking mode */
 #define PICORB_RECV_WOULD_BLOCK (-2)
 /* Special return value from blocking read functions: timed out waiting for data */
@@ -107,17 +208,49 @@ void picorb_socket_notify_readable(picorb_socket_t *sock);
 /* Stack buffer threshold: use stack allocation for small reads to avoid heap overhead */
 #define PICORB_SOCKET_STACK_BUF_SIZE 101
 
+/* One piece of data for TCPSocket_sendv */
+typedef struct {
+  const void *base;
+  size_t len;
+} picorb_socket_iov_t;
+
+/* Most pieces that BasicSocket#write hands to one TCPSocket_sendv call */
+#ifndef PICORB_SOCKET_IOV_MAX
+#define PICORB_SOCKET_IOV_MAX 16
+#endif
+
 /* TCP Socket API */
 bool TCPSocket_create(picorb_state *vm, picorb_socket_t *sock);
 bool TCPSocket_connect(picorb_state *vm, picorb_socket_t *sock, const char *host, int port);
 int TCPSocket_connection_state(picorb_state *vm, picorb_socket_t *sock);
 ssize_t TCPSocket_send(picorb_state *vm, picorb_socket_t *sock, const void *data, size_t len);
+/* Send the pieces in order with one call. Returns the bytes sent, which
+ * may end in the middle of a piece, 0 while the send buffer is full, or
+ * -1 on error. */
+ssize_t TCPSocket_sendv(picorb_state *vm, picorb_socket_t *sock,
+                        const picorb_socket_iov_t *iov, int iovcnt);
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+/* Also notify the event queue when the socket can send again, or stop
+ * doing so. Returns false if the socket has no event queue. */
+bool TCPSocket_watch_writable(picorb_state *vm, picorb_socket_t *sock, bool writable);
+#endif
+#ifdef PICORB_PLATFORM_POSIX
+/* Send up to count bytes of in_fd from offset without copying them into
+ * the VM. Returns the bytes sent, fewer than count at the end of the file,
+ * or -1 on error. */
+ssize_t TCPSocket_sendfile(picorb_state *vm, picorb_socket_t *sock, int in_fd,
+                           off_t offset, size_t count);
+#endif
 ssize_t TCPSocket_recv(picorb_state *vm, picorb_socket_t *sock, void *buf, size_t len, bool nonblock);
 bool TCPSocket_close(picorb_state *vm, picorb_socket_t *sock);
 
 /* Get socket info */
 const char* TCPSocket_remote_host(picorb_state *vm, picorb_socket_t *sock);
 int TCPSocket_remote_port(picorb_state *vm, picorb_socket_t *sock);
+#ifdef PICORB_PLATFORM_POSIX
+/* Numeric address of the connected peer, unlike the host name given */
+const char* TCPSocket_peer_address(picorb_state *vm, picorb_socket_t *sock, char *buf, size_t len);
+#endif
 bool TCPSocket_closed(picorb_state *vm, picorb_socket_t *sock);
 bool Socket_ready(picorb_state *vm, picorb_socket_t *sock);
 
@@ -140,6 +273,9 @@ typedef struct picorb_tcp_server {
   int port;
   int backlog;
   bool listening;
+  void *vm;                  /* Owning VM for accept notification */
+  void *event_queue;         /* VM-specific Task::Queue value */
+  bool event_pending;        /* An accept notification is already queued */
 } picorb_tcp_server_t;
 #else
 typedef struct picorb_tcp_server picorb_tcp_server_t;
@@ -149,7 +285,7 @@ picorb_tcp_server_t* TCPServer_create(picorb_state *vm, int port, int backlog);
 picorb_socket_t* TCPServer_accept_nonblock(picorb_state *vm, picorb_tcp_server_t *server);
 bool TCPServer_close(picorb_state *vm, picorb_tcp_server_t *server);
 int TCPServer_port(picorb_state *vm, picorb_tcp_server_t *server);
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 void TCPServer_set_event_queue(picorb_tcp_server_t *server, picorb_state *vm, void *queue);
 void* TCPServer_event_queue(picorb_tcp_server_t *server);
 picorb_state* TCPServer_vm(picorb_tcp_server_t *server);
@@ -166,6 +302,10 @@ bool TCPServer_listening(picorb_state *vm, picorb_tcp_server_t *server);
 #ifdef PICORB_PLATFORM_POSIX
 /* Forward declaration for OpenSSL types */
 typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_session_st SSL_SESSION;
+
+/* Longest DNS name; hostnames beyond this are not cached for resumption */
+#define PICORB_SSL_HOSTNAME_MAX 253
 
 typedef struct picorb_ssl_context {
   SSL_CTX *ctx;
@@ -173,6 +313,10 @@ typedef struct picorb_ssl_context {
   char *cert_file;
   char *key_file;
   int verify_mode;
+  /* Last session issued to this context, offered again to the same peer */
+  SSL_SESSION *session;
+  char session_host[PICORB_SSL_HOSTNAME_MAX + 1];
+  int session_port;
 } picorb_ssl_context_t;
 #else
 typedef struct picorb_ssl_context picorb_ssl_context_t;
@@ -187,6 +331,7 @@ bool SSLContext_set_key_file(picorb_state *vm, picorb_ssl_context_t *ctx, const
 bool SSLContext_set_key(picorb_state *vm, picorb_ssl_context_t *ctx, const void *addr, size_t size);
 bool SSLContext_set_verify_mode(picorb_state *vm, picorb_ssl_context_t *ctx, int mode);
 int SSLContext_get_verify_mode(picorb_state *vm, picorb_ssl_context_t *ctx);
+void SSLContext_flush_sessions(picorb_state *vm, picorb_ssl_context_t *ctx);
 void SSLContext_free(picorb_state *vm, picorb_ssl_context_t *ctx);
 
 /* SSL Socket API */
@@ -198,6 +343,7 @@ typedef struct picorb_ssl_socket {
   picorb_socket_t *base_socket;
   picorb_ssl_context_t *ssl_ctx;
   SSL *ssl;
+  SSL_SESSION *session;   /* Set by SSLSocket_set_session, offered on connect */
   char *hostname;
   int port;
   bool connected;
@@ -221,6 +367,15 @@ bool SSLSocket_closed(picorb_state *vm, picorb_ssl_socket_t *ssl_sock);
 bool SSLSocket_ready(picorb_state *vm, picorb_ssl_socket_t *ssl_sock);
 const char* SSLSocket_remote_host(picorb_state *vm, picorb_ssl_socket_t *ssl_sock);
 int SSLSocket_remote_port(picorb_state *vm, picorb_ssl_socket_t *ssl_sock);
+/*
+ * TLS session resumption. A session is an opaque, port-specific byte string.
+ * SSLSocket_session copies it into buf and returns its length (the required
+ * length when buf is NULL or too small), 0 when there is none, -1 on error.
+ * SSLSocket_session_reused returns -1 when the port cannot tell.
+ */
+ssize_t SSLSocket_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, void *buf, size_t len);
+bool SSLSocket_set_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, const void *data, size_t len);
+int SSLSocket_session_reused(picorb_state *vm, picorb_ssl_socket_t *ssl_sock);
 
 /* Address resolution */
 bool resolve_address(const char *host, char *ip, size_t ip_len);
@@ -235,7 +390,11 @@ bool resolve_address(const char *host, char *ip, size_t ip_len);
   void udp_socket_init(mrbc_vm *vm, mrbc_class *class_BasicSocket);
   void ssl_socket_init(mrbc_vm *vm, mrbc_class *class_BasicSocket);
   void tcp_server_init(mrbc_vm *vm, mrbc_class *class_BasicSocket);
+  void read_buffer_init(mrbc_vm *vm);
   void mrbc_socket_free(mrbc_value *self);
+  picorb_socket_rbuf_t* mrbc_socket_rbuf(mrbc_value *self);
+  bool mrbc_socket_rbuf_take(mrbc_vm *vm, mrbc_value *self, int maxlen, mrbc_value *ret);
+  void mrbc_socket_rbuf_fill(mrbc_vm *vm, mrbc_value *v, picorb_socket_recv_func recv, void *conn);
   mrbc_value picorb_task_queue_new(mrbc_vm *vm);
 #elif defined(PICORB_VM_MRUBY)
   #include "mruby.h"
@@ -244,6 +403,10 @@ bool resolve_address(const char *host, char *ip, size_t ip_len);
   void udp_socket_init(mrb_state *mrb, struct RClass *class_BasicSocket);
   void ssl_socket_init(mrb_state *mrb, struct RClass *class_BasicSocket);
   void tcp_server_init(mrb_state *mrb, struct RClass *class_BasicSocket);
+  void read_buffer_init(mrb_state *mrb);
+  picorb_socket_rbuf_t* mrb_socket_rbuf(mrb_state *mrb, mrb_value self);
+  mrb_value mrb_socket_rbuf_take(mrb_state *mrb, picorb_socket_rbuf_t *rbuf, mrb_int maxlen);
+  mrb_value mrb_socket_rbuf_fill(mrb_state *mrb, mrb_value self, picorb_socket_recv_func recv, void *conn);
 
   /* Forward declaration for mruby data type */
   struct mrb_data_type;
@@ -10,9 +10,17 @@ class BasicSocket
     CONNECTION_TIMEOUT_MS
   end
 
+  # Machine.uptime_us at which a connect started now times out.
+  # Resolving, connecting and the TLS handshake all wait until the same
+  # deadline, so the whole connect takes at most CONNECTION_TIMEOUT_MS.
+  private def __connection_deadline
+    Machine.uptime_us + __connection_timeout_ms * 1000
+  end
+
   # A connection that timed out cannot be used, so release its resources here.
-  private def __wait_for_event(event_queue, timeout_message)
-    unless event_queue.pop(timeout_ms: __connection_timeout_ms)
+  private def __wait_for_event(event_queue, timeout_message, deadline)
+    timeout_ms = (deadline - Machine.uptime_us) / 1000
+    unless 0 < timeout_ms && event_queue.pop(timeout_ms: timeout_ms)
       close
       raise SocketError, timeout_message
     end
@@ -35,17 +43,38 @@ class BasicSocket
     data
   end
 
+  # Received bytes that gets/read/ungetc have not consumed yet.
+  # readpartial and read_nonblock return these before receiving more.
+  private def __rbuf
+    @rbuf ||= SocketReadBuffer.new
+  end
+
+  # Receive into the read buffer with one large recv.
+  # Returns the number of bytes added, or 0 at EOF.
+  private def __fill_rbuf_wait
+    event_queue = @event_queue
+    return __fill_rbuf(false) unless event_queue
+
+    size = __fill_rbuf(true)
+    while size.nil?
+      unless event_queue.pop(timeout_ms: READ_TIMEOUT_MS)
+        raise SocketError, "read timeout"
+      end
+      size = __fill_rbuf(true)
+    end
+    # @type var size: Integer
+    size
+  end
+
   # IO-compatible methods
 
   def read(maxlen = nil)
     raise TypeError, "no implicit conversion into Integer" unless maxlen.nil? || maxlen.is_a?(Integer)
+    rbuf = __rbuf
     if maxlen.nil?
-      res = ''
-      begin
-        while true
-          res << readpartial(100)
-        end
-      rescue EOFError
+      res = rbuf.read
+      while 0 < __fill_rbuf_wait
+        rbuf.read(nil, res)
       end
       return res
     elsif maxlen < 0
@@ -53,39 +82,107 @@ class BasicSocket
     elsif maxlen == 0
       return ''
     else
-      res = ''
-      remaining = maxlen
-      begin
-        while 0 < remaining
-          chunk = readpartial(remaining)
-          res << chunk
-          remaining -= chunk.bytesize
-        end
-      rescue EOFError
+      res = rbuf.read(maxlen)
+      while res.bytesize < maxlen
+        break if __fill_rbuf_wait == 0
+        rbuf.read(maxlen - res.bytesize, res)
       end
       return res.empty? ? nil : res
     end
   end
 
+  # All strings go out together where the socket can send a vector
+  # (TCPSocket), and a partial send resumes at an offset instead of
+  # slicing off the rest.
   def write(*str_ary)
-    write_len = 0
+    strings = [] #: Array[String]
+    total = 0
     i = 0
     str_ary_len = str_ary.length
     while i < str_ary_len
       str = str_ary[i].to_s
-      offset = 0
+      strings << str
+      total += str.bytesize
+      i += 1
+    end
+    offset = 0
+    stalled_at = nil
+    while offset < total
+      sent = __sendv(strings, offset)
+      raise RuntimeError, "write failed" if sent < 0
+      if sent == 0
+        # The send buffer is full until the peer acknowledges some data
+        stalled_at ||= Machine.uptime_us
+        stalled_ms = (Machine.uptime_us - stalled_at) / 1000
+        if READ_TIMEOUT_MS <= stalled_ms
+          raise SocketError, "write timeout"
+        end
+        __wait_writable(READ_TIMEOUT_MS - stalled_ms)
+        next
+      end
+      stalled_at = nil
+      offset += sent
+    end
+    total
+  end
+
+  # Block the task until the send buffer has room, or timeout_ms passes.
+  # Any other event on the queue wakes it as well, and write tries again.
+  private def __wait_writable(timeout_ms)
+    event_queue = @event_queue
+    unless event_queue && __watch_writable(true)
+      sleep_ms 1
+      return
+    end
+    begin
+      event_queue.pop(timeout_ms: timeout_ms)
+    ensure
+      __watch_writable(false)
+    end
+  end
+
+  # Sockets whose event queue cannot report room to send poll instead
+  private def __watch_writable(writable)
+    false
+  end
+
+  # Send the strings after their first offset bytes and return the number
+  # of bytes sent. TCPSocket does this in C; other sockets send the string
+  # that offset falls in.
+  private def __sendv(strings, offset)
+    i = 0
+    while str = strings[i]
       str_len = str.bytesize
-      while offset < str_len
-        rest = str.byteslice(offset, str_len - offset)
-        raise RuntimeError, "write failed" if rest.nil? || rest.empty?
-        sent = send(rest, 0)
-        raise RuntimeError, "write failed" if sent <= 0
-        offset += sent
-        write_len += sent
+      if offset < str_len
+        str = str.byteslice(offset, str_len - offset) || "" if 0 < offset
+        return send(str, 0)
       end
+      offset -= str_len
       i += 1
     end
-    write_len
+    0
+  end
+
+  # Send length bytes of file (to its end if nil) from offset, or from its
+  # current position which is then advanced. Returns the number of bytes
+  # sent. TCPSocket on POSIX hands an IO's descriptor to the kernel;
+  # otherwise the file is read in READ_BUFFER_SIZE pieces.
+  def sendfile(file, offset = nil, length = nil)
+    if offset
+      pos = file.tell
+      file.seek(offset)
+    end
+    sent = 0
+    while length.nil? || sent < length
+      size = READ_BUFFER_SIZE
+      size = length - sent if length && length - sent < size
+      chunk = file.read(size)
+      break if chunk.nil? || chunk.empty?
+      write(chunk)
+      sent += chunk.bytesize
+    end
+    file.seek(pos) if pos
+    sent
   end
 
   def puts(*args)
@@ -104,17 +201,44 @@ class BasicSocket
     nil
   end
 
-  def gets(sep = "\n")
-    buffer = ""
-    begin
-      while true
-        buffer << readpartial(1)
-        break if buffer.end_with?(sep)
+  def gets(sep = "\n", limit = nil, chomp: false)
+    if sep.is_a?(Integer)
+      limit = sep
+      sep = "\n"
+    end
+    return "" if limit == 0
+    limit = nil if limit && limit < 0
+    sep = "\n\n" if sep == ""
+    rbuf = __rbuf
+    line = rbuf.gets(sep, limit, false)
+    while line.nil?
+      if __fill_rbuf_wait == 0
+        line = rbuf.read(limit)
+        return nil if line.empty?
+        break
       end
-    rescue EOFError
-      return nil if buffer.empty?
+      line = rbuf.gets(sep, limit, true)
+    end
+    (chomp && sep) ? line.chomp(sep) : line
+  end
+
+  def readline(sep = "\n", limit = nil, chomp: false)
+    line = gets(sep, limit, chomp: chomp)
+    raise EOFError, "end of file reached" if line.nil?
+    line
+  end
+
+  def each_line(sep = "\n", limit = nil, chomp: false)
+    while line = gets(sep, limit, chomp: chomp)
+      yield line
     end
-    buffer
+    self
+  end
+
+  def ungetc(str)
+    str = str.chr if str.is_a?(Integer)
+    __rbuf.unget(str)
+    nil
   end
 
   def print(*args)
@@ -128,12 +252,15 @@ class BasicSocket
   end
 
   def eof?
+    rbuf = @rbuf
+    return false if rbuf && 0 < rbuf.size
     closed?
   end
 
   def peeraddr
     # Returns [address_family, port, hostname, numeric_address]
-    ["AF_INET", remote_port, remote_host, remote_host]
+    host = remote_host
+    [host&.include?(":") ? "AF_INET6" : "AF_INET", remote_port, host, host]
   end
 
   def remote_address
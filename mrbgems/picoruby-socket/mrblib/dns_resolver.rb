@@ -1,13 +1,17 @@
 if Object.const_defined?(:SocketDNSResolver)
   class SocketDNSResolver
-    def self.resolve_host(host)
-      new(host).resolve(host)
+    # deadline is a Machine.uptime_us value; a connect passes its own so
+    # that resolving counts against the connection timeout
+    def self.resolve_host(host, deadline = nil)
+      new(host).resolve(host, deadline)
     end
 
-    def resolve(host)
+    def resolve(host, deadline = nil)
+      deadline ||= Machine.uptime_us + BasicSocket::CONNECTION_TIMEOUT_MS * 1000
       status = __status
       if status == 1
-        unless @event_queue.pop(timeout_ms: BasicSocket::CONNECTION_TIMEOUT_MS)
+        timeout_ms = (deadline - Machine.uptime_us) / 1000
+        unless 0 < timeout_ms && @event_queue.pop(timeout_ms: timeout_ms)
           __abandon
           raise SocketError, "DNS resolution timed out for #{host}"
         end
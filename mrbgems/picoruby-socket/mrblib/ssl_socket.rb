@@ -38,14 +38,15 @@ class SSLSocket < BasicSocket
 
     def connect
       host = remote_host
-      resolved_host = SocketDNSResolver.resolve_host(host)
+      deadline = __connection_deadline
+      resolved_host = SocketDNSResolver.resolve_host(host, deadline)
       __set_connect_hostname(resolved_host)
       __connect_poll
       event_queue = @event_queue
       return self unless event_queue
 
       while __connection_state == 1
-        __wait_for_event(event_queue, "SSL handshake timed out")
+        __wait_for_event(event_queue, "SSL handshake timed out", deadline)
       end
 
       if __connection_state == 2
@@ -4,19 +4,14 @@ class TCPSocket < BasicSocket
 
   if Object.const_defined?(:SocketDNSResolver)
     def initialize(host, port)
-      host = SocketDNSResolver.resolve_host(host)
-      __initialize_poll(host, port)
-      event_queue = @event_queue
-      return unless event_queue
-
-      while __connection_state == 1
-        __wait_for_event(event_queue, "connection timed out")
-      end
-      return if __connection_state == 2
-
-      message = __error_message
-      close
-      raise SocketError, message || "failed to connect"
+      deadline = __connection_deadline
+      __connect_event_queue(SocketDNSResolver.resolve_host(host, deadline), port, deadline)
+    end
+  elsif BasicSocket::EVENT_QUEUE
+    # POSIX resolves the host on a worker thread and connects without
+    # blocking, so only the calling task waits
+    def initialize(host, port)
+      __connect_event_queue(host, port, __connection_deadline)
     end
   end
 
@@ -40,13 +35,48 @@ class TCPSocket < BasicSocket
     ["AF_INET", 0, "0.0.0.0", "0.0.0.0"]
   end
 
+  def peeraddr
+    # Returns [address_family, port, hostname, numeric_address].
+    # The host name may have resolved to either family.
+    address = __peer_address || remote_host
+    [address&.include?(":") ? "AF_INET6" : "AF_INET", remote_port, remote_host, address]
+  end
+
+  def sendfile(file, offset = nil, length = nil)
+    if Object.const_defined?(:IO) && file.is_a?(IO)
+      pos = offset || file.tell
+      sent = __sendfile(file.fileno, pos, length || -1)
+      if sent
+        file.seek(pos + sent) unless offset
+        return sent
+      end
+    end
+    super
+  end
+
   def connected?
     !closed?
   end
 
-  if Object.const_defined?(:SocketDNSResolver)
+  # With an event queue, readpartial waits on it so that other tasks run
+  if BasicSocket::EVENT_QUEUE
     def readpartial(maxlen)
       __readpartial_event_queue(maxlen, "read timeout")
     end
+
+    private def __connect_event_queue(host, port, deadline)
+      __initialize_poll(host, port)
+      event_queue = @event_queue
+      return unless event_queue
+
+      while __connection_state == 1
+        __wait_for_event(event_queue, "connection timed out", deadline)
+      end
+      return if __connection_state == 2
+
+      message = __error_message
+      close
+      raise SocketError, message || "failed to connect"
+    end
   end
 end
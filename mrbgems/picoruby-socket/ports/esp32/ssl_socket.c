@@ -31,6 +31,11 @@ struct picorb_ssl_context {
   bool client_cert_loaded;
   bool client_key_loaded;
   int verify_mode;
+  /* Last session (mbedtls_ssl_session_save format) and the peer it is for */
+  unsigned char *session_data;
+  size_t session_len;
+  char *session_host;
+  int session_port;
 };
 
 /* SSL socket structure */
@@ -42,8 +47,87 @@ struct picorb_ssl_socket {
   int state;
   char *hostname;
   int port;
+  unsigned char *session_data;    /* Offered on connect, then the new one */
+  size_t session_len;
 };
 
+/* ========================================================================
+ * Session resumption
+ * ======================================================================== */
+
+static void
+ssl_offer_session(picorb_ssl_socket_t *ssl_sock)
+{
+  picorb_ssl_context_t *ctx = ssl_sock->ssl_ctx;
+  const unsigned char *data = ssl_sock->session_data;
+  size_t len = ssl_sock->session_len;
+
+  if (!data && ctx->session_data && ctx->session_port == ssl_sock->port &&
+      strcmp(ctx->session_host, ssl_sock->hostname) == 0) {
+    data = ctx->session_data;
+    len = ctx->session_len;
+  }
+  if (!data) return;
+
+  /* A session the server no longer knows just means a full handshake */
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  if (mbedtls_ssl_session_load(&session, data, len) == 0) {
+    mbedtls_ssl_set_session(&ssl_sock->ssl, &session);
+  }
+  mbedtls_ssl_session_free(&session);
+}
+
+static unsigned char *
+ssl_dup_bytes(picorb_state *vm, const unsigned char *data, size_t len)
+{
+  unsigned char *copy = (unsigned char *)picorb_alloc(vm, len);
+  if (copy) memcpy(copy, data, len);
+  return copy;
+}
+
+static void
+ssl_save_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
+{
+  mbedtls_ssl_session session;
+  unsigned char *data = NULL;
+  size_t len = 0;
+
+  mbedtls_ssl_session_init(&session);
+  if (mbedtls_ssl_get_session(&ssl_sock->ssl, &session) != 0) goto done;
+  mbedtls_ssl_session_save(&session, NULL, 0, &len);
+  if (len == 0) goto done;
+  data = (unsigned char *)picorb_alloc(vm, len);
+  if (!data) goto done;
+  if (mbedtls_ssl_session_save(&session, data, len, &len) != 0) {
+    picorb_free(vm, data);
+    goto done;
+  }
+
+  if (ssl_sock->session_data) picorb_free(vm, ssl_sock->session_data);
+  ssl_sock->session_data = data;
+  ssl_sock->session_len = len;
+
+  /* Cache a copy on the context for the next connection to this peer */
+  picorb_ssl_context_t *ctx = ssl_sock->ssl_ctx;
+  unsigned char *cached = ssl_dup_bytes(vm, data, len);
+  char *host = (char *)ssl_dup_bytes(vm, (const unsigned char *)ssl_sock->hostname,
+                                     strlen(ssl_sock->hostname) + 1);
+  if (!cached || !host) {
+    if (cached) picorb_free(vm, cached);
+    if (host) picorb_free(vm, host);
+    goto done;
+  }
+  SSLContext_flush_sessions(vm, ctx);
+  ctx->session_data = cached;
+  ctx->session_len = len;
+  ctx->session_host = host;
+  ctx->session_port = ssl_sock->port;
+
+done:
+  mbedtls_ssl_session_free(&session);
+}
+
 /* ========================================================================
  * SSLContext Functions
  * ======================================================================== */
@@ -63,6 +147,10 @@ SSLContext_create(picorb_state *vm)
   ctx->client_cert_loaded = false;
   ctx->client_key_loaded = false;
   ctx->verify_mode = SSL_VERIFY_PEER;
+  ctx->session_data = NULL;
+  ctx->session_len = 0;
+  ctx->session_host = NULL;
+  ctx->session_port = 0;
 
   /* Seed the random number generator */
   if (mbedtls_ctr_drbg_seed(&ctx->ctr_drbg, mbedtls_entropy_func, &ctx->entropy, NULL, 0) != 0) {
@@ -87,10 +175,23 @@ SSLContext_create(picorb_state *vm)
   return ctx;
 }
 
+void
+SSLContext_flush_sessions(picorb_state *vm, picorb_ssl_context_t *ctx)
+{
+  if (!ctx) return;
+  if (ctx->session_data) picorb_free(vm, ctx->session_data);
+  if (ctx->session_host) picorb_free(vm, ctx->session_host);
+  ctx->session_data = NULL;
+  ctx->session_len = 0;
+  ctx->session_host = NULL;
+  ctx->session_port = 0;
+}
+
 void
 SSLContext_free(picorb_state *vm, picorb_ssl_context_t *ctx)
 {
   if (!ctx) return;
+  SSLContext_flush_sessions(vm, ctx);
   mbedtls_x509_crt_free(&ctx->cacert);
   mbedtls_x509_crt_free(&ctx->cert);
   mbedtls_pk_free(&ctx->key);
@@ -103,8 +204,9 @@ SSLContext_free(picorb_state *vm, picorb_ssl_context_t *ctx)
 bool
 SSLContext_set_ca_file(picorb_state *vm, picorb_ssl_context_t *ctx, const char *ca_file)
 {
-  (void)ctx;
   (void)ca_file;
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   return false;  /* Not supported on ESP32 */
 }
 
@@ -113,6 +215,8 @@ SSLContext_set_ca(picorb_state *vm, picorb_ssl_context_t *ctx, const void *addr,
 {
   if (!ctx || !addr || size == 0) return false;
 
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   int ret = mbedtls_x509_crt_parse(&ctx->cacert, (const unsigned char *)addr, size + 1);
   if (ret != 0) {
     return false;
@@ -190,6 +294,8 @@ SSLContext_set_verify_mode(picorb_state *vm, picorb_ssl_context_t *ctx, int mode
     default:
       return false;
   }
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   mbedtls_ssl_conf_authmode(&ctx->ssl_config, mbedtls_mode);
   ctx->verify_mode = mode;
   return true;
@@ -278,6 +384,7 @@ SSLSocket_connect(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
   }
 
   mbedtls_ssl_set_bio(&ssl_sock->ssl, &ssl_sock->net_ctx, mbedtls_net_send, mbedtls_net_recv, NULL);
+  ssl_offer_session(ssl_sock);
 
   /* 3. Handshake */
   while ((ret = mbedtls_ssl_handshake(&ssl_sock->ssl)) != 0) {
@@ -288,6 +395,7 @@ SSLSocket_connect(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     }
   }
 
+  ssl_save_session(vm, ssl_sock);
   ssl_sock->state = SSL_STATE_CONNECTED;
   return true;
 }
@@ -399,6 +507,10 @@ SSLSocket_close(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     picorb_free(vm, ssl_sock->hostname);
     ssl_sock->hostname = NULL;
   }
+  if (ssl_sock->session_data) {
+    picorb_free(vm, ssl_sock->session_data);
+    ssl_sock->session_data = NULL;
+  }
 
   picorb_free(vm, ssl_sock);
   return true;
@@ -432,3 +544,43 @@ SSLSocket_remote_port(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
   if (!ssl_sock) return -1;
   return ssl_sock->port;
 }
+
+ssize_t
+SSLSocket_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, void *buf, size_t len)
+{
+  (void)vm;
+  if (!ssl_sock) return -1;
+  if (!ssl_sock->session_data) return 0;
+  if (buf && ssl_sock->session_len <= len) {
+    memcpy(buf, ssl_sock->session_data, ssl_sock->session_len);
+  }
+  return (ssize_t)ssl_sock->session_len;
+}
+
+bool
+SSLSocket_set_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, const void *data, size_t len)
+{
+  if (!ssl_sock || ssl_sock->state != SSL_STATE_NONE || !data || len == 0) return false;
+
+  /* Reject bytes mbedTLS cannot load now rather than at connect */
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  int ret = mbedtls_ssl_session_load(&session, (const unsigned char *)data, len);
+  mbedtls_ssl_session_free(&session);
+  if (ret != 0) return false;
+
+  unsigned char *copy = ssl_dup_bytes(vm, (const unsigned char *)data, len);
+  if (!copy) return false;
+  if (ssl_sock->session_data) picorb_free(vm, ssl_sock->session_data);
+  ssl_sock->session_data = copy;
+  ssl_sock->session_len = len;
+  return true;
+}
+
+int
+SSLSocket_session_reused(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
+{
+  (void)vm;
+  (void)ssl_sock;
+  return -1;  /* mbedTLS does not report whether the handshake resumed */
+}
@@ -107,6 +107,34 @@ TCPSocket_send(picorb_state *vm, picorb_socket_t *sock, const void *data, size_t
   return sent;
 }
 
+ssize_t
+TCPSocket_sendv(picorb_state *vm, picorb_socket_t *sock,
+                const picorb_socket_iov_t *iov, int iovcnt)
+{
+  struct iovec vec[PICORB_SOCKET_IOV_MAX];
+  struct msghdr msg;
+
+  if (!sock || !iov || iovcnt <= 0 || sock->fd < 0 || sock->closed) {
+    return -1;
+  }
+  if (PICORB_SOCKET_IOV_MAX < iovcnt) iovcnt = PICORB_SOCKET_IOV_MAX;
+
+  for (int i = 0; i < iovcnt; i++) {
+    vec[i].iov_base = (void *)iov[i].base;
+    vec[i].iov_len = iov[i].len;
+  }
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = vec;
+  msg.msg_iovlen = iovcnt;
+
+  ssize_t sent = sendmsg(sock->fd, &msg, 0);
+  if (sent < 0) {
+    return -1;
+  }
+
+  return sent;
+}
+
 ssize_t
 TCPSocket_recv(picorb_state *vm, picorb_socket_t *sock, void *buf, size_t len, bool nonblock)
 {
@@ -0,0 +1,516 @@
+/*
+ * Network helper functions for POSIX
+ *
+ * Names resolve to addresses of both families. IPv4 and IPv6 addresses are
+ * interleaved, starting with the family getaddrinfo() preferred, so that
+ * TCPSocket_connect can race one address of each family.
+ *
+ * getaddrinfo() blocks, so with an event queue lookups run on up to
+ * PICORB_DNS_WORKER_COUNT detached worker threads, and further lookups
+ * wait for a worker in the order they were started. A worker writes to a
+ * pipe that the I/O reactor watches, and the request's notify is called
+ * from the reactor on the VM thread. Resolved addresses are cached for PICORB_DNS_CACHE_TTL_MS because
+ * getaddrinfo() does not report the record TTL.
+ */
+
+#include "../../include/socket.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/* Prevent name collision with embedded Ruby bytecode */
+#ifdef socket
+#undef socket
+#endif
+
+static bool
+net_literal(const char *name)
+{
+  struct in6_addr addr;
+  return inet_pton(AF_INET, name, &addr) == 1 || inet_pton(AF_INET6, name, &addr) == 1;
+}
+
+static void
+net_append(char (*list)[SOCKET_ADDRESS_LEN], int *count, int max, const char *address)
+{
+  if (max <= *count) return;
+  for (int i = 0; i < *count; i++) {
+    if (strcmp(list[i], address) == 0) return;
+  }
+  strcpy(list[*count], address);
+  (*count)++;
+}
+
+int
+Net_resolve(const char *name, char (*addresses)[SOCKET_ADDRESS_LEN], int max, int *error)
+{
+  char first[SOCKET_MAX_ADDRESSES][SOCKET_ADDRESS_LEN];
+  char other[SOCKET_MAX_ADDRESSES][SOCKET_ADDRESS_LEN];
+  int first_count = 0, other_count = 0, count = 0;
+  int first_family = AF_UNSPEC;
+  struct addrinfo hints;
+  struct addrinfo *res = NULL;
+
+  if (SOCKET_MAX_ADDRESSES < max) max = SOCKET_MAX_ADDRESSES;
+  if (net_literal(name)) {
+    strcpy(addresses[0], name);
+    return 1;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM; /* One entry per address */
+  hints.ai_flags = AI_ADDRCONFIG;
+  int err = getaddrinfo(name, NULL, &hints, &res);
+  if (err != 0 || !res) {
+    if (error) *error = err ? err : EAI_NONAME;
+    return 0;
+  }
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    char address[SOCKET_ADDRESS_LEN];
+    const void *src;
+    if (ai->ai_family == AF_INET) {
+      src = &((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+    } else if (ai->ai_family == AF_INET6) {
+      src = &((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr;
+    } else {
+      continue;
+    }
+    if (!inet_ntop(ai->ai_family, src, address, sizeof(address))) continue;
+    if (first_family == AF_UNSPEC) first_family = ai->ai_family;
+    if (ai->ai_family == first_family) {
+      net_append(first, &first_count, max, address);
+    } else {
+      net_append(other, &other_count, max, address);
+    }
+  }
+  freeaddrinfo(res);
+
+  for (int i = 0; count < max && (i < first_count || i < other_count); i++) {
+    if (i < first_count) strcpy(addresses[count++], first[i]);
+    if (i < other_count && count < max) strcpy(addresses[count++], other[i]);
+  }
+  if (count == 0 && error) *error = EAI_NONAME;
+  return count;
+}
+
+/* Open a socket of the preferred family: IPv6 accepting IPv4 as well,
+ * or IPv4 where IPv6 is unavailable */
+int
+Net_socket(int type, int protocol, int *family)
+{
+  int fd = socket(AF_INET6, type, protocol);
+  if (0 <= fd) {
+    int off = 0;
+    if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)) == 0) {
+      *family = AF_INET6;
+      return fd;
+    }
+    close(fd);
+  }
+  *family = AF_INET;
+  return socket(AF_INET, type, protocol);
+}
+
+/* Fill sa for a socket of family. Returns the address length, or 0 if
+ * address cannot be reached from such a socket. */
+size_t
+Net_sockaddr(const char *address, int port, int family, struct sockaddr *sa, size_t salen)
+{
+  if (family == AF_INET) {
+    struct sockaddr_in *sin = (struct sockaddr_in *)sa;
+    if (salen < sizeof(*sin)) return 0;
+    memset(sin, 0, sizeof(*sin));
+    sin->sin_family = AF_INET;
+    sin->sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &sin->sin_addr) != 1) return 0;
+    return sizeof(*sin);
+  }
+
+  struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)sa;
+  struct in_addr v4;
+  if (salen < sizeof(*sin6)) return 0;
+  memset(sin6, 0, sizeof(*sin6));
+  sin6->sin6_family = AF_INET6;
+  sin6->sin6_port = htons(port);
+  if (inet_pton(AF_INET6, address, &sin6->sin6_addr) == 1) return sizeof(*sin6);
+  if (inet_pton(AF_INET, address, &v4) != 1) return 0;
+  /* ::ffff:a.b.c.d */
+  sin6->sin6_addr.s6_addr[10] = 0xff;
+  sin6->sin6_addr.s6_addr[11] = 0xff;
+  memcpy(&sin6->sin6_addr.s6_addr[12], &v4, sizeof(v4));
+  return sizeof(*sin6);
+}
+
+/* Numeric address and port of sa. Returns the family of the address,
+ * which is AF_INET for an IPv4-mapped IPv6 address. */
+int
+Net_sockaddr_address(const struct sockaddr *sa, char *host, size_t host_len, int *port)
+{
+  int family = sa->sa_family;
+  const void *src;
+  int p;
+
+  if (family == AF_INET6) {
+    const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)sa;
+    p = ntohs(sin6->sin6_port);
+    if (IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
+      family = AF_INET;
+      src = &sin6->sin6_addr.s6_addr[12];
+    } else {
+      src = &sin6->sin6_addr;
+    }
+  } else if (family == AF_INET) {
+    const struct sockaddr_in *sin = (const struct sockaddr_in *)sa;
+    p = ntohs(sin->sin_port);
+    src = &sin->sin_addr;
+  } else {
+    if (host && 0 < host_len) host[0] = '\0';
+    return AF_UNSPEC;
+  }
+  if (host && 0 < host_len && !inet_ntop(family, src, host, host_len)) host[0] = '\0';
+  if (port) *port = p;
+  return family;
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../../../picoruby-machine/include/hal.h"
+
+#ifndef PICORB_DNS_WORKER_COUNT
+#define PICORB_DNS_WORKER_COUNT 4
+#endif
+
+#ifndef PICORB_DNS_CACHE_SIZE
+#define PICORB_DNS_CACHE_SIZE 8
+#endif
+
+#ifndef PICORB_DNS_CACHE_TTL_MS
+#define PICORB_DNS_CACHE_TTL_MS 60000
+#endif
+
+#define DNS_NAME_LEN    256
+
+typedef struct picorb_dns_request {
+  struct picorb_dns_request *next;
+  char name[DNS_NAME_LEN];
+  char addresses[SOCKET_MAX_ADDRESSES][SOCKET_ADDRESS_LEN];
+  int count;
+  picorb_dns_notify_func notify;
+  void *arg;
+  uint8_t state;     /* 1 = in progress, 2 = resolved, 3 = failed, 4 = queued */
+  bool notified;
+  bool abandoned;
+} picorb_dns_request;
+
+typedef struct {
+  char name[DNS_NAME_LEN];
+  char addresses[SOCKET_MAX_ADDRESSES][SOCKET_ADDRESS_LEN];
+  int count;
+  uint64_t expires_ms;
+} picorb_dns_cache_entry;
+
+/* Live requests, oldest first. The list and dns_workers are guarded by
+   dns_mutex. */
+static picorb_dns_request *dns_requests;
+static int dns_workers;
+static picorb_dns_cache_entry dns_cache[PICORB_DNS_CACHE_SIZE];
+static pthread_mutex_t dns_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int dns_pipe[2] = {-1, -1};
+static bool dns_pipe_pending;
+
+static uint64_t
+dns_now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+static bool
+dns_cache_lookup(const char *name, picorb_dns_request *request)
+{
+  uint64_t now = dns_now_ms();
+  for (int i = 0; i < PICORB_DNS_CACHE_SIZE; i++) {
+    picorb_dns_cache_entry *entry = &dns_cache[i];
+    if (entry->name[0] && now < entry->expires_ms &&
+        strcmp(entry->name, name) == 0) {
+      memcpy(request->addresses, entry->addresses, sizeof(entry->addresses));
+      request->count = entry->count;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void
+dns_cache_store(const picorb_dns_request *request)
+{
+  const char *name = request->name;
+  picorb_dns_cache_entry *victim = &dns_cache[0];
+  for (int i = 0; i < PICORB_DNS_CACHE_SIZE; i++) {
+    picorb_dns_cache_entry *entry = &dns_cache[i];
+    if (strcmp(entry->name, name) == 0) {
+      victim = entry;
+      break;
+    }
+    if (entry->expires_ms < victim->expires_ms) victim = entry;
+  }
+  memcpy(victim->name, name, DNS_NAME_LEN);
+  memcpy(victim->addresses, request->addresses, sizeof(request->addresses));
+  victim->count = request->count;
+  victim->expires_ms = dns_now_ms() + PICORB_DNS_CACHE_TTL_MS;
+}
+
+/* Unlink request from dns_requests; dns_mutex must be held */
+static void
+dns_unlink(picorb_dns_request *request)
+{
+  for (picorb_dns_request **p = &dns_requests; *p; p = &(*p)->next) {
+    if (*p == request) {
+      *p = request->next;
+      return;
+    }
+  }
+}
+
+/* Reactor callback on the VM thread: notify finished requests */
+static void
+dns_dispatch(void *ud, int events)
+{
+  char buf[16];
+
+  (void)ud;
+  (void)events;
+  while (0 < read(dns_pipe[0], buf, sizeof(buf))) ;
+
+  pthread_mutex_lock(&dns_mutex);
+  dns_pipe_pending = false;
+  while (true) {
+    picorb_dns_request *request = dns_requests;
+    while (request && (request->state == 1 || request->state == 4 || request->notified)) {
+      request = request->next;
+    }
+    if (!request) break;
+    request->notified = true;
+    if (request->state == 2) dns_cache_store(request);
+    picorb_dns_notify_func notify = request->notify;
+    void *arg = request->arg;
+    /* Called without the lock, and the scan starts over afterwards */
+    pthread_mutex_unlock(&dns_mutex);
+    if (notify) notify(arg);
+    pthread_mutex_lock(&dns_mutex);
+  }
+  pthread_mutex_unlock(&dns_mutex);
+}
+
+static bool
+dns_open(void)
+{
+  if (0 <= dns_pipe[0]) return true;
+  if (pipe(dns_pipe) < 0) return false;
+  for (int i = 0; i < 2; i++) {
+    fcntl(dns_pipe[i], F_SETFL, fcntl(dns_pipe[i], F_GETFL) | O_NONBLOCK);
+    fcntl(dns_pipe[i], F_SETFD, FD_CLOEXEC);
+  }
+  if (!picorb_reactor_add(dns_pipe[0], PICORB_REACTOR_READABLE, dns_dispatch, NULL, NULL)) {
+    close(dns_pipe[0]);
+    close(dns_pipe[1]);
+    dns_pipe[0] = dns_pipe[1] = -1;
+    return false;
+  }
+  return true;
+}
+
+/* Resolve request, then the oldest queued requests until none is left */
+static void *
+dns_worker(void *ptr)
+{
+  picorb_dns_request *request = (picorb_dns_request *)ptr;
+
+  while (request) {
+    char addresses[SOCKET_MAX_ADDRESSES][SOCKET_ADDRESS_LEN];
+    int error;
+
+    /* request->name is not touched by the VM thread while state is 1 */
+    int count = Net_resolve(request->name, addresses, SOCKET_MAX_ADDRESSES, &error);
+
+    pthread_mutex_lock(&dns_mutex);
+    if (request->abandoned) {
+      dns_unlink(request);
+      free(request);
+    } else {
+      if (0 < count) memcpy(request->addresses, addresses, sizeof(addresses));
+      request->count = count;
+      request->state = (0 < count) ? 2 : 3;
+      if (!dns_pipe_pending) {
+        dns_pipe_pending = true;
+        (void)!write(dns_pipe[1], "", 1);
+      }
+    }
+    for (request = dns_requests; request; request = request->next) {
+      if (request->state == 4) break;
+    }
+    if (request) {
+      request->state = 1;
+    } else {
+      dns_workers--;
+    }
+    pthread_mutex_unlock(&dns_mutex);
+  }
+  return NULL;
+}
+
+/* Start a worker thread. The scheduler tick and the terminal signals are
+ * blocked while it is created, so that the thread inherits a mask that
+ * leaves them to the VM thread, as machine.c does for the stdin reader. */
+static bool
+dns_spawn(picorb_dns_request *request)
+{
+  sigset_t mask, saved;
+  pthread_t tid;
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGALRM);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTSTP);
+  pthread_sigmask(SIG_BLOCK, &mask, &saved);
+  int err = pthread_create(&tid, NULL, dns_worker, request);
+  pthread_sigmask(SIG_SETMASK, &saved, NULL);
+  if (err != 0) return false;
+  pthread_detach(tid);
+  return true;
+}
+
+void*
+Net_dns_start(const char *name, picorb_dns_notify_func notify, void *arg)
+{
+  picorb_dns_request *request;
+  bool spawn = false;
+
+  if (!name || !notify || DNS_NAME_LEN <= strlen(name) || !dns_open()) {
+    return NULL;
+  }
+  request = (picorb_dns_request *)calloc(1, sizeof(picorb_dns_request));
+  if (!request) return NULL;
+  strcpy(request->name, name);
+  request->notify = notify;
+  request->arg = arg;
+
+  /* Numeric addresses and cache hits finish without a notification,
+     like an lwIP lookup that returns ERR_OK */
+  if (net_literal(name)) {
+    strcpy(request->addresses[0], name);
+    request->count = 1;
+    request->state = 2;
+    request->notified = true;
+  } else if (dns_cache_lookup(name, request)) {
+    request->state = 2;
+    request->notified = true;
+  }
+
+  pthread_mutex_lock(&dns_mutex);
+  picorb_dns_request **tail = &dns_requests;
+  while (*tail) tail = &(*tail)->next;
+  *tail = request;
+  if (request->state == 0) {
+    /* With every worker busy, the lookup waits for the first to finish */
+    if (dns_workers < PICORB_DNS_WORKER_COUNT) {
+      dns_workers++;
+      request->state = 1;
+      spawn = true;
+    } else {
+      request->state = 4;
+    }
+  }
+  pthread_mutex_unlock(&dns_mutex);
+
+  if (spawn && !dns_spawn(request)) {
+    pthread_mutex_lock(&dns_mutex);
+    dns_workers--;
+    request->state = 3;
+    request->notified = true;
+    pthread_mutex_unlock(&dns_mutex);
+  }
+  return request;
+}
+
+int
+Net_dns_status(void *ptr)
+{
+  picorb_dns_request *request = (picorb_dns_request *)ptr;
+  int state;
+
+  if (!request) return 3;
+  pthread_mutex_lock(&dns_mutex);
+  /* A result is reported only once it has been dispatched, so a caller
+     woken by notify and a caller polling see the same order */
+  state = (request->state == 1 || request->state == 4 || !request->notified) ? 1 : request->state;
+  pthread_mutex_unlock(&dns_mutex);
+  return state;
+}
+
+int
+Net_dns_get_address(void *ptr, char *buf, size_t buflen)
+{
+  return Net_dns_get_address_at(ptr, 0, buf, buflen);
+}
+
+/* index-th resolved address in connect order, or -1 past the last one */
+int
+Net_dns_get_address_at(void *ptr, int index, char *buf, size_t buflen)
+{
+  picorb_dns_request *request = (picorb_dns_request *)ptr;
+
+  if (!request || !buf || buflen == 0 || Net_dns_status(request) != 2) {
+    return -1;
+  }
+  if (index < 0 || request->count <= index) {
+    buf[0] = '\0';
+    return -1;
+  }
+  if (buflen <= strlen(request->addresses[index])) {
+    buf[0] = '\0';
+    return -1;
+  }
+  strcpy(buf, request->addresses[index]);
+  return 0;
+}
+
+/* A request released while still running is left for the worker to free */
+void
+Net_dns_release(void *ptr)
+{
+  Net_dns_abandon(ptr);
+}
+
+void
+Net_dns_abandon(void *ptr)
+{
+  picorb_dns_request *request = (picorb_dns_request *)ptr;
+
+  if (!request) return;
+  pthread_mutex_lock(&dns_mutex);
+  if (request->state == 1) {
+    /* The worker frees the request when getaddrinfo() returns */
+    request->abandoned = true;
+    request->notify = NULL;
+    request->arg = NULL;
+  } else {
+    dns_unlink(request);
+    free(request);
+  }
+  pthread_mutex_unlock(&dns_mutex);
+}
+
+#endif /* PICORB_SOCKET_EVENT_QUEUE */
@@ -0,0 +1,35 @@
+/*
+ * Readiness notification for POSIX sockets
+ *
+ * Sockets and servers that have an event queue register their fd with the
+ * I/O reactor of picoruby-machine, which pushes to the Task::Queue of each
+ * fd that became ready, so TCPSocket.new, TCPServer#accept and
+ * TCPSocket#readpartial block only the calling task instead of the VM. The
+ * pending flag keeps an fd quiet until its reader has drained it.
+ */
+
+#include "../../include/socket.h"
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+
+#include "../../../picoruby-machine/include/hal.h"
+
+bool
+Socket_watch(int fd, int events, picorb_socket_watch_func notify, void *target,
+             bool *pending)
+{
+  int reactor_events = 0;
+
+  if (fd < 0 || !notify || !pending) return false;
+  if (events & SOCKET_WATCH_READABLE) reactor_events |= PICORB_REACTOR_READABLE;
+  if (events & SOCKET_WATCH_WRITABLE) reactor_events |= PICORB_REACTOR_WRITABLE;
+  return picorb_reactor_add(fd, reactor_events, notify, target, pending);
+}
+
+void
+Socket_unwatch(int fd)
+{
+  picorb_reactor_remove(fd);
+}
+
+#endif /* PICORB_SOCKET_EVENT_QUEUE */
@@ -34,6 +34,31 @@ ssl_init_once(void)
   }
 }
 
+/*
+ * Keep the newest session OpenSSL hands out on a client connection.
+ * With TLS 1.3 the tickets arrive after the handshake, so they are only
+ * seen once the application reads from the socket.
+ */
+static int
+ssl_new_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+  picorb_ssl_socket_t *ssl_sock = (picorb_ssl_socket_t *)SSL_get_app_data(ssl);
+  if (!ssl_sock || !ssl_sock->hostname ||
+      PICORB_SSL_HOSTNAME_MAX < strlen(ssl_sock->hostname)) {
+    return 0;
+  }
+
+  picorb_ssl_context_t *ctx = ssl_sock->ssl_ctx;
+  if (ctx->session) {
+    SSL_SESSION_free(ctx->session);
+  }
+  ctx->session = session;
+  strcpy(ctx->session_host, ssl_sock->hostname);
+  ctx->session_port = ssl_sock->port;
+
+  return 1;  /* The context now owns the reference */
+}
+
 /*
  * Create SSL context
  */
@@ -62,6 +87,11 @@ SSLContext_create(picorb_state *vm)
   ctx->verify_mode = SSL_VERIFY_PEER;
   SSL_CTX_set_verify(ctx->ctx, SSL_VERIFY_PEER, NULL);
 
+  // Cache client sessions ourselves, keyed by peer; OpenSSL's internal
+  // store is for servers
+  SSL_CTX_set_session_cache_mode(ctx->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx->ctx, ssl_new_session_cb);
+
   // Load default CA certificates from system
   if (SSL_CTX_set_default_verify_paths(ctx->ctx) != 1) {
     fprintf(stderr, "SSL: Warning - failed to load default CA certificates\n");
@@ -79,6 +109,8 @@ SSLContext_set_ca_file(picorb_state *vm, picorb_ssl_context_t *ctx, const char *
   if (!ctx || !ca_file) {
     return false;
   }
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
 
   // Free previous ca_file if set
   if (ctx->ca_file) {
@@ -114,9 +146,10 @@ SSLContext_set_ca_file(picorb_state *vm, picorb_ssl_context_t *ctx, const char *
 bool
 SSLContext_set_ca(picorb_state *vm, picorb_ssl_context_t *ctx, const void *addr, size_t size)
 {
-  (void)ctx;
   (void)addr;
   (void)size;
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   fprintf(stderr, "Warning: SSLContext#set_ca is not supported on POSIX platforms. Use ca_file= instead.\n");
   return true;  /* Return true to avoid errors, but do nothing */
 }
@@ -233,6 +266,8 @@ SSLContext_set_verify_mode(picorb_state *vm, picorb_ssl_context_t *ctx, int mode
     return false;
   }
 
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   ctx->verify_mode = mode;
 
   if (mode == SSL_VERIFY_NONE) {
@@ -256,6 +291,22 @@ SSLContext_get_verify_mode(picorb_state *vm, picorb_ssl_context_t *ctx)
   return ctx->verify_mode;
 }
 
+/*
+ * Forget the cached session
+ */
+void
+SSLContext_flush_sessions(picorb_state *vm, picorb_ssl_context_t *ctx)
+{
+  (void)vm;
+  if (!ctx || !ctx->session) {
+    return;
+  }
+  SSL_SESSION_free(ctx->session);
+  ctx->session = NULL;
+  ctx->session_host[0] = '\0';
+  ctx->session_port = 0;
+}
+
 /*
  * Free SSL context
  */
@@ -266,6 +317,8 @@ SSLContext_free(picorb_state *vm, picorb_ssl_context_t *ctx)
     return;
   }
 
+  SSLContext_flush_sessions(vm, ctx);
+
   if (ctx->ctx) {
     SSL_CTX_free(ctx->ctx);
   }
@@ -305,6 +358,7 @@ SSLSocket_create(picorb_state *vm, picorb_ssl_context_t *ssl_ctx)
   ssl_sock->base_socket = NULL;
   ssl_sock->ssl_ctx = ssl_ctx;
   ssl_sock->ssl = NULL;
+  ssl_sock->session = NULL;
   ssl_sock->hostname = NULL;
   ssl_sock->port = 0;
   ssl_sock->connected = false;
@@ -383,8 +437,14 @@ SSLSocket_connect(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     return false;
   }
 
-  /* Connect TCP socket */
-  if (!TCPSocket_connect(vm, ssl_sock->base_socket, ssl_sock->hostname, ssl_sock->port)) {
+  /* Connect TCP socket. With an event queue TCPSocket_connect only starts
+   * connecting, and the handshake below needs the connection. */
+  if (!TCPSocket_connect(vm, ssl_sock->base_socket, ssl_sock->hostname, ssl_sock->port)
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+      || !TCPSocket_wait_connected(vm, ssl_sock->base_socket,
+                                   PICORB_SOCKET_CONNECTION_TIMEOUT_MS)
+#endif
+      ) {
     fprintf(stderr, "SSL: Failed to connect TCP socket to %s:%d\n",
             ssl_sock->hostname, ssl_sock->port);
     TCPSocket_close(vm, ssl_sock->base_socket);
@@ -440,6 +500,20 @@ SSLSocket_connect(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     return false;
   }
 
+  /* Offer a session to resume: the one given by SSLSocket_set_session,
+   * otherwise the context's last one if it came from the same peer.
+   * A session the server no longer knows just means a full handshake. */
+  SSL_set_app_data(ssl_sock->ssl, ssl_sock);
+  SSL_SESSION *session = ssl_sock->session;
+  picorb_ssl_context_t *ctx = ssl_sock->ssl_ctx;
+  if (!session && ctx->session && ctx->session_port == ssl_sock->port &&
+      strcmp(ctx->session_host, ssl_sock->hostname) == 0) {
+    session = ctx->session;
+  }
+  if (session && SSL_set_session(ssl_sock->ssl, session) != 1) {
+    ERR_clear_error();
+  }
+
   /* Perform SSL handshake */
   int ret = SSL_connect(ssl_sock->ssl);
   if (ret != 1) {
@@ -615,6 +689,11 @@ SSLSocket_close(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     ssl_sock->ssl = NULL;
   }
 
+  if (ssl_sock->session) {
+    SSL_SESSION_free(ssl_sock->session);
+    ssl_sock->session = NULL;
+  }
+
   /* Free hostname */
   if (ssl_sock->hostname) {
     picorb_free(vm, ssl_sock->hostname);
@@ -679,3 +758,68 @@ SSLSocket_remote_port(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
   }
   return ssl_sock->port;
 }
+
+/*
+ * Serialize the session of the connection, or the one set to be offered
+ */
+ssize_t
+SSLSocket_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, void *buf, size_t len)
+{
+  (void)vm;
+  if (!ssl_sock) {
+    return -1;
+  }
+
+  SSL_SESSION *session = ssl_sock->ssl ? SSL_get_session(ssl_sock->ssl) : ssl_sock->session;
+  if (!session || !SSL_SESSION_is_resumable(session)) {
+    return 0;
+  }
+
+  int size = i2d_SSL_SESSION(session, NULL);
+  if (size <= 0) {
+    return -1;
+  }
+  if (buf && (size_t)size <= len) {
+    unsigned char *p = (unsigned char *)buf;
+    i2d_SSL_SESSION(session, &p);
+  }
+  return (ssize_t)size;
+}
+
+/*
+ * Set the session to offer on connect
+ */
+bool
+SSLSocket_set_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, const void *data, size_t len)
+{
+  (void)vm;
+  if (!ssl_sock || ssl_sock->ssl || !data) {
+    return false;
+  }
+
+  const unsigned char *p = (const unsigned char *)data;
+  SSL_SESSION *session = d2i_SSL_SESSION(NULL, &p, (long)len);
+  if (!session) {
+    ERR_clear_error();
+    return false;
+  }
+
+  if (ssl_sock->session) {
+    SSL_SESSION_free(ssl_sock->session);
+  }
+  ssl_sock->session = session;
+  return true;
+}
+
+/*
+ * Whether the handshake resumed a session
+ */
+int
+SSLSocket_session_reused(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
+{
+  (void)vm;
+  if (!ssl_sock || !ssl_sock->ssl) {
+    return 0;
+  }
+  return SSL_session_reused(ssl_sock->ssl) ? 1 : 0;
+}
@@ -24,9 +24,11 @@ TCPServer_create(picorb_state *vm, int port, int backlog)
 {
   picorb_tcp_server_t *server = picorb_alloc(vm, sizeof(picorb_tcp_server_t));
   if (!server) return NULL;
+  memset(server, 0, sizeof(picorb_tcp_server_t));
 
-  /* Create socket */
-  server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  /* Create socket, dual-stack where IPv6 is available */
+  int family;
+  server->listen_fd = Net_socket(SOCK_STREAM, 0, &family);
   if (server->listen_fd < 0) {
     picorb_free(vm, server);
     return NULL;
@@ -48,13 +50,12 @@ TCPServer_create(picorb_state *vm, int port, int backlog)
   }
 #endif
 
-  /* Bind to address */
-  struct sockaddr_in addr = {0};
-  addr.sin_family = AF_INET;
-  addr.sin_addr.s_addr = INADDR_ANY;
-  addr.sin_port = htons(port);
+  /* Bind to the wildcard address */
+  struct sockaddr_storage addr;
+  size_t addr_len = Net_sockaddr(family == AF_INET6 ? "::" : "0.0.0.0", port, family,
+                                 (struct sockaddr*)&addr, sizeof(addr));
 
-  if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+  if (bind(server->listen_fd, (struct sockaddr*)&addr, (socklen_t)addr_len) < 0) {
     perror("bind failed");
     close(server->listen_fd);
     picorb_free(vm, server);
@@ -87,6 +88,11 @@ TCPServer_accept_nonblock(picorb_state *vm, picorb_tcp_server_t *server)
   if (!srv->listening) {
     return NULL;
   }
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  /* The listening fd is level-triggered: if more connections are still
+   * queued, the next scheduler pass notifies again. */
+  srv->event_pending = false;
+#endif
 
   /* Set socket to non-blocking mode */
   int flags = fcntl(srv->listen_fd, F_GETFL, 0);
@@ -99,7 +105,7 @@ TCPServer_accept_nonblock(picorb_state *vm, picorb_tcp_server_t *server)
     return NULL;
   }
 
-  struct sockaddr_in client_addr;
+  struct sockaddr_storage client_addr;
   socklen_t addr_len = sizeof(client_addr);
 
   /* Accept incoming connection (non-blocking) */
@@ -135,17 +141,20 @@ TCPServer_accept_nonblock(picorb_state *vm, picorb_tcp_server_t *server)
     return NULL;
   }
 
+  memset(client, 0, sizeof(picorb_socket_t));
   client->fd = client_fd;
-  client->family = AF_INET;
+  client->race_fd = -1;
   client->socktype = SOCK_STREAM;
   client->protocol = IPPROTO_TCP;
   client->connected = true;
+  client->state = SOCKET_STATE_CONNECTED;
   client->closed = false;
 
-  /* Save client information */
-  inet_ntop(AF_INET, &client_addr.sin_addr,
-            client->remote_host, sizeof(client->remote_host));
-  client->remote_port = ntohs(client_addr.sin_port);
+  /* Save client information; IPv4 clients of a dual-stack server are
+   * reported with their IPv4 address */
+  client->family = Net_sockaddr_address((struct sockaddr*)&client_addr,
+                                        client->remote_host, sizeof(client->remote_host),
+                                        &client->remote_port);
 
   /* Suppress Nagle algorithm on accepted socket to prevent ACK-Nagle deadlock
    * when receiving large firmware payloads in DFU transfers. */
@@ -167,6 +176,14 @@ TCPServer_close(picorb_state *vm, picorb_tcp_server_t *server)
 
   if (!srv) return false;
 
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  if (srv->event_queue) {
+    Socket_unwatch(srv->listen_fd);
+    picorb_free(vm, srv->event_queue);
+    srv->event_queue = NULL;
+  }
+#endif
+
   if (srv->listen_fd >= 0) {
     close(srv->listen_fd);
     srv->listen_fd = -1;
@@ -192,3 +209,48 @@ TCPServer_listening(picorb_state *vm, picorb_tcp_server_t *server)
   picorb_tcp_server_t *srv = (picorb_tcp_server_t*)server;
   return srv ? srv->listening : false;
 }
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+static void
+tcp_server_watch_notify(void *target, int events)
+{
+  (void)events;
+  TCPServer_notify_accepted((picorb_tcp_server_t *)target);
+}
+
+/* Takes ownership of queue and starts watching the listening fd */
+void
+TCPServer_set_event_queue(picorb_tcp_server_t *server, picorb_state *vm, void *queue)
+{
+  if (!server) return;
+  server->vm = vm;
+  server->event_queue = queue;
+  server->event_pending = false;
+  Socket_watch(server->listen_fd, SOCKET_WATCH_READABLE,
+               tcp_server_watch_notify, server, &server->event_pending);
+}
+
+void*
+TCPServer_event_queue(picorb_tcp_server_t *server)
+{
+  return server ? server->event_queue : NULL;
+}
+
+picorb_state*
+TCPServer_vm(picorb_tcp_server_t *server)
+{
+  return server ? (picorb_state *)server->vm : NULL;
+}
+
+bool
+TCPServer_event_pending(picorb_tcp_server_t *server)
+{
+  return server && server->event_pending;
+}
+
+void
+TCPServer_set_event_pending(picorb_tcp_server_t *server, bool pending)
+{
+  if (server) server->event_pending = pending;
+}
+#endif
@@ -1,4 +1,5 @@
 #include "../../include/socket.h"
+#include "picoruby.h"
 #include <stdio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -8,13 +9,23 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/uio.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+#include "../../../picoruby-machine/include/hal.h"
 
 /* Prevent name collision with embedded Ruby bytecode */
 #ifdef socket
 #undef socket
 #endif
 
-/* Create a new TCP socket */
+/* Create a new TCP socket.
+ * The fd is a placeholder until TCPSocket_connect opens one of the family
+ * of the address it connects to. */
 bool
 TCPSocket_create(picorb_state *vm, picorb_socket_t *sock)
 {
@@ -32,11 +43,264 @@ TCPSocket_create(picorb_state *vm, picorb_socket_t *sock)
   sock->protocol = IPPROTO_TCP;
   sock->connected = false;
   sock->closed = false;
+  sock->race_fd = -1;
 
   return true;
 }
 
-/* Connect to remote host */
+static void
+tcp_socket_fail(picorb_socket_t *sock, int err)
+{
+  snprintf(sock->errmsg, sizeof(sock->errmsg),
+           "connect(\"%s\":%d): %s", sock->remote_host, sock->remote_port,
+           strerror(err));
+  sock->state = SOCKET_STATE_ERROR;
+  sock->connected = false;
+}
+
+static void
+tcp_socket_set_nonblock(int fd, bool nonblock)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0) return;
+  fcntl(fd, F_SETFL, nonblock ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+static void
+tcp_socket_watch_notify(void *target, int events)
+{
+  (void)events;
+  picorb_socket_notify_readable((picorb_socket_t *)target);
+}
+#endif
+
+static void
+tcp_socket_close_attempt(int fd)
+{
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  Socket_unwatch(fd);
+#endif
+  close(fd);
+}
+
+/* Start a non-blocking connect to the next candidate address that accepts
+ * one. Returns its fd, or -1 with sock->last_error set when none is left. */
+static int
+tcp_socket_next_attempt(picorb_socket_t *sock)
+{
+  while (sock->next_candidate < sock->candidate_count) {
+    const char *address = sock->candidates[sock->next_candidate++];
+    struct sockaddr_storage ss;
+    int family = strchr(address, ':') ? AF_INET6 : AF_INET;
+    size_t len = Net_sockaddr(address, sock->remote_port, family,
+                              (struct sockaddr *)&ss, sizeof(ss));
+    if (len == 0) {
+      sock->last_error = EINVAL;
+      continue;
+    }
+    int fd = socket(family, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+      sock->last_error = errno;
+      continue;
+    }
+    tcp_socket_set_nonblock(fd, true);
+    if (connect(fd, (struct sockaddr *)&ss, (socklen_t)len) < 0 &&
+        errno != EINPROGRESS && errno != EINTR) {
+      sock->last_error = errno;
+      close(fd);
+      continue;
+    }
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+    if (!Socket_watch(fd, SOCKET_WATCH_WRITABLE, tcp_socket_watch_notify,
+                      sock, &sock->event_pending)) {
+      sock->last_error = ENOMEM;
+      close(fd);
+      continue;
+    }
+#endif
+    return fd;
+  }
+  return -1;
+}
+
+/* Race the first two candidates, which Net_resolve has put in different
+ * families when there are both. The placeholder fd is kept if no attempt
+ * can be started, so that close still has something to close. */
+static bool
+tcp_socket_start_attempts(picorb_socket_t *sock)
+{
+  sock->next_candidate = 0;
+  sock->last_error = EHOSTUNREACH;
+  int fd = tcp_socket_next_attempt(sock);
+  if (fd < 0) {
+    tcp_socket_fail(sock, sock->last_error);
+    return false;
+  }
+  close(sock->fd);
+  sock->fd = fd;
+  sock->race_fd = tcp_socket_next_attempt(sock);
+  sock->state = SOCKET_STATE_CONNECTING;
+  return true;
+}
+
+/* An attempt failed: replace it with the next candidate, or let the other
+ * attempt carry on alone. Returns false when no attempt is left, in which
+ * case the failed sock->fd stays open. */
+static bool
+tcp_socket_drop_attempt(picorb_socket_t *sock, int fd)
+{
+  int next = tcp_socket_next_attempt(sock);
+
+  if (fd == sock->race_fd) {
+    tcp_socket_close_attempt(fd);
+    sock->race_fd = next;
+    return true;
+  }
+  if (0 <= next) {
+    tcp_socket_close_attempt(fd);
+    sock->fd = next;
+    return true;
+  }
+  if (0 <= sock->race_fd) {
+    tcp_socket_close_attempt(fd);
+    sock->fd = sock->race_fd;
+    sock->race_fd = -1;
+    return true;
+  }
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  Socket_unwatch(fd);
+#endif
+  return false;
+}
+
+/* The first attempt to connect wins and the other is abandoned */
+static void
+tcp_socket_keep_attempt(picorb_socket_t *sock, int fd)
+{
+  struct sockaddr_storage ss;
+  socklen_t len = sizeof(ss);
+
+  if (fd == sock->race_fd) {
+    tcp_socket_close_attempt(sock->fd);
+    sock->fd = fd;
+  } else if (0 <= sock->race_fd) {
+    tcp_socket_close_attempt(sock->race_fd);
+  }
+  sock->race_fd = -1;
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  Socket_unwatch(fd);
+#endif
+  if (getsockname(fd, (struct sockaddr *)&ss, &len) == 0) {
+    sock->family = ss.ss_family;
+  }
+}
+
+/* Wait up to timeout_ms for an attempt to finish.
+ * Returns 0 once connected, EINPROGRESS while pending, or the errno of the
+ * last attempt once all have failed. */
+static int
+tcp_socket_check_attempts(picorb_socket_t *sock, int timeout_ms)
+{
+  struct pollfd pfd[2];
+  nfds_t n = 0;
+
+  pfd[n].fd = sock->fd;
+  pfd[n].events = POLLOUT;
+  pfd[n++].revents = 0;
+  if (0 <= sock->race_fd) {
+    pfd[n].fd = sock->race_fd;
+    pfd[n].events = POLLOUT;
+    pfd[n++].revents = 0;
+  }
+  int ready = poll(pfd, n, timeout_ms);
+  if (ready < 0) return (errno == EINTR) ? EINPROGRESS : errno;
+  if (ready == 0) return EINPROGRESS;
+
+  /* pfd[0] is sock->fd, preferred when both connected at once */
+  for (nfds_t i = 0; i < n; i++) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (pfd[i].revents == 0) continue;
+    if (getsockopt(pfd[i].fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+    if (err == 0) {
+      tcp_socket_keep_attempt(sock, pfd[i].fd);
+      return 0;
+    }
+    sock->last_error = err;
+    if (!tcp_socket_drop_attempt(sock, pfd[i].fd)) return err;
+  }
+  return EINPROGRESS;
+}
+
+/* Reads and writes after connect keep their blocking semantics */
+static void
+tcp_socket_established(picorb_socket_t *sock)
+{
+  tcp_socket_set_nonblock(sock->fd, false);
+  sock->state = SOCKET_STATE_CONNECTED;
+  sock->connected = true;
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+static void
+tcp_socket_dns_notify(void *arg)
+{
+  picorb_socket_notify_readable((picorb_socket_t *)arg);
+}
+
+/* Advance resolve -> connect -> connected. Every step that has to wait
+ * leaves a watch or a DNS request that pushes to the event queue. */
+static void
+tcp_socket_progress(picorb_socket_t *sock)
+{
+  if (sock->dns_request) {
+    int status = Net_dns_status(sock->dns_request);
+    if (status == 1) return;
+    int count = 0;
+    while (status == 2 && count < SOCKET_MAX_ADDRESSES &&
+           Net_dns_get_address_at(sock->dns_request, count, sock->candidates[count],
+                                  SOCKET_ADDRESS_LEN) == 0) {
+      count++;
+    }
+    Net_dns_release(sock->dns_request);
+    sock->dns_request = NULL;
+    if (count == 0) {
+      snprintf(sock->errmsg, sizeof(sock->errmsg),
+               "getaddrinfo(\"%s\"): name resolution failed", sock->remote_host);
+      sock->state = SOCKET_STATE_ERROR;
+      return;
+    }
+    sock->candidate_count = count;
+    tcp_socket_start_attempts(sock);
+    return;
+  }
+
+  int err = tcp_socket_check_attempts(sock, 0);
+  if (err == EINPROGRESS) return;
+  if (err != 0) {
+    tcp_socket_fail(sock, err);
+    return;
+  }
+
+  tcp_socket_established(sock);
+  /* A socket without a queue (under SSLSocket) is read from C */
+  if (sock->event_queue &&
+      !Socket_watch(sock->fd, SOCKET_WATCH_READABLE, tcp_socket_watch_notify,
+                    sock, &sock->event_pending)) {
+    tcp_socket_fail(sock, ENOMEM);
+  }
+}
+#endif
+
+/* Connect to remote host.
+ * The host may resolve to IPv4 and IPv6 addresses. Two of them are tried
+ * at once and the first to connect is kept, the rest being tried in turn
+ * as attempts fail.
+ * With an event queue this only starts resolving and connecting, and
+ * TCPSocket_connection_state reports the progress. Otherwise it resolves
+ * and connects before returning, giving up after
+ * PICORB_SOCKET_CONNECTION_TIMEOUT_MS. */
 bool
 TCPSocket_connect(picorb_state *vm, picorb_socket_t *sock, const char *host, int port)
 {
@@ -51,59 +315,101 @@ TCPSocket_connect(picorb_state *vm, picorb_socket_t *sock, const char *host, int
     }
   }
 
-  /* Resolve hostname */
-  struct sockaddr_in addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(port);
-
-  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
-    /* Not an IP address, try DNS resolution */
-    struct addrinfo hints;
-    struct addrinfo *res = NULL;
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-
-    int err = getaddrinfo(host, NULL, &hints, &res);
-    if (err != 0 || !res) {
-      snprintf(sock->errmsg, sizeof(sock->errmsg),
-               "getaddrinfo(\"%s\"): %s", host, gai_strerror(err));
-      close(sock->fd);
-      sock->fd = -1;
-      return false;
-    }
+  strncpy(sock->remote_host, host, sizeof(sock->remote_host) - 1);
+  sock->remote_host[sizeof(sock->remote_host) - 1] = '\0';
+  sock->remote_port = port;
+  sock->state = SOCKET_STATE_CONNECTING;
 
-    struct sockaddr_in *ai_addr = (struct sockaddr_in *)res->ai_addr;
-    addr.sin_addr = ai_addr->sin_addr;
-    freeaddrinfo(res);
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  sock->dns_request = Net_dns_start(host, tcp_socket_dns_notify, sock);
+  if (!sock->dns_request) {
+    snprintf(sock->errmsg, sizeof(sock->errmsg),
+             "getaddrinfo(\"%s\"): could not start the lookup", host);
+    sock->state = SOCKET_STATE_ERROR;
+    return false;
   }
-
-  /* Connect */
-  if (connect(sock->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+  tcp_socket_progress(sock);
+  return sock->state != SOCKET_STATE_ERROR;
+#else
+  int error = 0;
+  sock->candidate_count = Net_resolve(host, sock->candidates, SOCKET_MAX_ADDRESSES, &error);
+  if (sock->candidate_count == 0) {
     snprintf(sock->errmsg, sizeof(sock->errmsg),
-             "connect(\"%s\":%d): %s", host, port, strerror(errno));
+             "getaddrinfo(\"%s\"): %s", host, gai_strerror(error));
     close(sock->fd);
     sock->fd = -1;
     return false;
   }
 
-  /* Save connection info */
-  strncpy(sock->remote_host, host, sizeof(sock->remote_host) - 1);
-  sock->remote_host[sizeof(sock->remote_host) - 1] = '\0';
-  sock->remote_port = port;
-  sock->connected = true;
-
+  if (tcp_socket_start_attempts(sock)) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t deadline = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000 +
+                       PICORB_SOCKET_CONNECTION_TIMEOUT_MS;
+    int err = EINPROGRESS;
+    while (err == EINPROGRESS) {
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      int64_t remaining = deadline - ((int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+      if (remaining <= 0) break;
+      err = tcp_socket_check_attempts(sock, (int)remaining);
+    }
+    if (err == 0) {
+      sock->state = SOCKET_STATE_CONNECTED;
+    } else {
+      tcp_socket_fail(sock, err == EINPROGRESS ? ETIMEDOUT : err);
+    }
+  }
+  if (sock->state != SOCKET_STATE_CONNECTED) {
+    if (0 <= sock->race_fd) {
+      close(sock->race_fd);
+      sock->race_fd = -1;
+    }
+    close(sock->fd);
+    sock->fd = -1;
+    return false;
+  }
+  tcp_socket_established(sock);
   return true;
+#endif
 }
 
 int
 TCPSocket_connection_state(picorb_state *vm, picorb_socket_t *sock)
 {
   (void)vm;
-  return sock && sock->connected ? SOCKET_STATE_CONNECTED : SOCKET_STATE_ERROR;
+  if (!sock) return SOCKET_STATE_ERROR;
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  if (sock->state == SOCKET_STATE_CONNECTING) {
+    /* The caller has taken the notification that woke it */
+    sock->event_pending = false;
+    tcp_socket_progress(sock);
+  }
+#endif
+  return sock->state;
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+/* Block the VM until TCPSocket_connect has finished, for C callers that
+ * cannot wait on the event queue */
+bool
+TCPSocket_wait_connected(picorb_state *vm, picorb_socket_t *sock, int timeout_ms)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  int64_t deadline = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000 + timeout_ms;
+
+  while (TCPSocket_connection_state(vm, sock) == SOCKET_STATE_CONNECTING) {
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t remaining = deadline - ((int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    if (remaining <= 0) {
+      tcp_socket_fail(sock, ETIMEDOUT);
+      return false;
+    }
+    picorb_reactor_wait((int)remaining);
+  }
+  return sock->state == SOCKET_STATE_CONNECTED;
 }
+#endif
 
 /* Send data */
 ssize_t
@@ -121,6 +427,110 @@ TCPSocket_send(picorb_state *vm, picorb_socket_t *sock, const void *data, size_t
   return sent;
 }
 
+/* Send pieces with one sendmsg() */
+ssize_t
+TCPSocket_sendv(picorb_state *vm, picorb_socket_t *sock,
+                const picorb_socket_iov_t *iov, int iovcnt)
+{
+  struct iovec vec[PICORB_SOCKET_IOV_MAX];
+  struct msghdr msg;
+
+  if (!sock || !iov || iovcnt <= 0 || sock->fd < 0 || sock->closed) {
+    return -1;
+  }
+  if (PICORB_SOCKET_IOV_MAX < iovcnt) iovcnt = PICORB_SOCKET_IOV_MAX;
+
+  for (int i = 0; i < iovcnt; i++) {
+    vec[i].iov_base = (void *)iov[i].base;
+    vec[i].iov_len = iov[i].len;
+  }
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = vec;
+  msg.msg_iovlen = iovcnt;
+
+  int flags = 0;
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  /* BasicSocket#write waits on the event queue for a full send buffer */
+  if (sock->event_queue) flags = MSG_DONTWAIT;
+#endif
+  ssize_t sent = sendmsg(sock->fd, &msg, flags);
+  if (sent < 0) {
+    if (flags && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return -1;
+  }
+
+  return sent;
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+/* The watch is replaced rather than left writable, which would wake the
+ * queue for as long as the send buffer has room */
+bool
+TCPSocket_watch_writable(picorb_state *vm, picorb_socket_t *sock, bool writable)
+{
+  (void)vm;
+  if (!sock || sock->fd < 0 || sock->closed || !sock->event_queue) return false;
+  int events = SOCKET_WATCH_READABLE;
+  if (writable) events |= SOCKET_WATCH_WRITABLE;
+  Socket_unwatch(sock->fd);
+  sock->event_pending = false;
+  return Socket_watch(sock->fd, events, tcp_socket_watch_notify, sock,
+                      &sock->event_pending);
+}
+#endif
+
+#define TCP_SENDFILE_CHUNK (1024 * 1024)
+
+/* Send a file. Linux copies it in the kernel with sendfile(); elsewhere it
+ * goes through a stack buffer, still without a Ruby String. */
+ssize_t
+TCPSocket_sendfile(picorb_state *vm, picorb_socket_t *sock, int in_fd,
+                   off_t offset, size_t count)
+{
+  size_t total = 0;
+
+  if (!sock || sock->fd < 0 || sock->closed || in_fd < 0) {
+    return -1;
+  }
+
+  while (total < count) {
+#if defined(__linux__)
+    /* Whole-file requests pass SIZE_MAX, which sendfile() rejects as
+       overflowing the offset, so hand it a bounded chunk at a time */
+    size_t want = count - total < TCP_SENDFILE_CHUNK ? count - total : TCP_SENDFILE_CHUNK;
+    ssize_t n = sendfile(sock->fd, in_fd, &offset, want);
+#else
+    char buf[4096];
+    size_t want = count - total < sizeof(buf) ? count - total : sizeof(buf);
+    ssize_t n = pread(in_fd, buf, want, offset);
+    if (0 < n) {
+      ssize_t done = 0;
+      while (done < n) {
+        ssize_t sent = send(sock->fd, buf + done, n - done, 0);
+        if (sent < 0) {
+          if (errno == EINTR) continue;
+          break;
+        }
+        done += sent;
+      }
+      if (done < n) n = -1;
+      offset += done;
+      total += done;
+      if (n < 0) return (0 < total) ? (ssize_t)total : -1;
+      continue;
+    }
+#endif
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return (0 < total) ? (ssize_t)total : -1;
+    }
+    if (n == 0) break; /* End of file */
+    total += n;
+  }
+
+  return total;
+}
+
 /* Receive data.
  * If nonblock is true, uses MSG_DONTWAIT and returns
  * PICORB_RECV_WOULD_BLOCK when no data is available.
@@ -183,6 +593,25 @@ TCPSocket_close(picorb_state *vm, picorb_socket_t *sock)
     return false;
   }
 
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  if (sock->dns_request) {
+    Net_dns_abandon(sock->dns_request);
+    sock->dns_request = NULL;
+  }
+  Socket_unwatch(sock->fd);
+  if (0 <= sock->race_fd) {
+    Socket_unwatch(sock->race_fd);
+  }
+  if (sock->event_queue) {
+    picorb_free(vm, sock->event_queue);
+    sock->event_queue = NULL;
+  }
+#endif
+
+  if (0 <= sock->race_fd) {
+    close(sock->race_fd);
+    sock->race_fd = -1;
+  }
   close(sock->fd);
   sock->fd = -1;
   sock->connected = false;
@@ -199,6 +628,21 @@ TCPSocket_remote_host(picorb_state *vm, picorb_socket_t *sock)
   return sock->remote_host;
 }
 
+/* Get the numeric peer address */
+const char*
+TCPSocket_peer_address(picorb_state *vm, picorb_socket_t *sock, char *buf, size_t len)
+{
+  struct sockaddr_storage ss;
+  socklen_t sslen = sizeof(ss);
+
+  if (!sock || sock->fd < 0 || !sock->connected ||
+      getpeername(sock->fd, (struct sockaddr *)&ss, &sslen) < 0 ||
+      Net_sockaddr_address((struct sockaddr *)&ss, buf, len, NULL) == AF_UNSPEC) {
+    return NULL;
+  }
+  return buf;
+}
+
 /* Get remote port */
 int
 TCPSocket_remote_port(picorb_state *vm, picorb_socket_t *sock)
@@ -23,7 +23,7 @@
 #endif
 
 /*
- * Create a new UDP socket
+ * Create a new UDP socket, dual-stack where IPv6 is available
  */
 bool
 UDPSocket_create(picorb_state *vm, picorb_socket_t *sock)
@@ -33,7 +33,7 @@ UDPSocket_create(picorb_state *vm, picorb_socket_t *sock)
   /* Initialize socket structure */
   memset(sock, 0, sizeof(picorb_socket_t));
   sock->fd = -1;
-  sock->family = AF_INET;
+  sock->race_fd = -1;
   sock->socktype = SOCK_DGRAM;
   sock->protocol = IPPROTO_UDP;
   sock->connected = false;
@@ -41,7 +41,7 @@ UDPSocket_create(picorb_state *vm, picorb_socket_t *sock)
   sock->remote_port = 0;
 
   /* Create UDP socket */
-  sock->fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sock->fd = Net_socket(SOCK_DGRAM, IPPROTO_UDP, &sock->family);
   if (sock->fd < 0) {
     return false;
   }
@@ -55,6 +55,32 @@ UDPSocket_create(picorb_state *vm, picorb_socket_t *sock)
   return true;
 }
 
+/*
+ * Resolve host to the first of its addresses that the socket can reach
+ */
+static size_t
+udp_socket_sockaddr(picorb_socket_t *sock, const char *host, int port,
+                    struct sockaddr_storage *addr)
+{
+  char addresses[SOCKET_MAX_ADDRESSES][SOCKET_ADDRESS_LEN];
+  int error = 0;
+  int count = Net_resolve(host, addresses, SOCKET_MAX_ADDRESSES, &error);
+
+  if (count == 0) {
+    snprintf(sock->errmsg, sizeof(sock->errmsg),
+             "getaddrinfo(\"%s\"): %s", host, gai_strerror(error));
+    return 0;
+  }
+  for (int i = 0; i < count; i++) {
+    size_t len = Net_sockaddr(addresses[i], port, sock->family,
+                              (struct sockaddr *)addr, sizeof(*addr));
+    if (0 < len) return len;
+  }
+  snprintf(sock->errmsg, sizeof(sock->errmsg),
+           "\"%s\": no address reachable from this socket", host);
+  return 0;
+}
+
 /*
  * Bind socket to local address and port
  */
@@ -63,41 +89,21 @@ UDPSocket_bind(picorb_state *vm, picorb_socket_t *sock, const char *host, int po
 {
   if (!sock || sock->fd < 0) return false;
 
-  struct sockaddr_in addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(port);
+  struct sockaddr_storage addr;
+  size_t addr_len;
 
   if (!host || strcmp(host, "") == 0 || strcmp(host, "0.0.0.0") == 0) {
-    addr.sin_addr.s_addr = INADDR_ANY;
+    /* The wildcard of a dual-stack socket takes IPv4 datagrams as well */
+    addr_len = Net_sockaddr(sock->family == AF_INET6 ? "::" : "0.0.0.0", port,
+                            sock->family, (struct sockaddr *)&addr, sizeof(addr));
   } else {
-    /* Try numeric IP first */
-    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
-
-      /* Not numeric → use getaddrinfo() */
-      struct addrinfo hints;
-      struct addrinfo *res = NULL;
-
-      memset(&hints, 0, sizeof(hints));
-      hints.ai_family = AF_UNSPEC;      // IPv4/IPv6
-      hints.ai_socktype = SOCK_DGRAM;   // UDP
-      hints.ai_flags = AI_PASSIVE;      // For wildcard IP address
-
-      int err = getaddrinfo(host, NULL, &hints, &res);
-      if (err != 0 || !res) {
-        snprintf(sock->errmsg, sizeof(sock->errmsg),
-                 "getaddrinfo(\"%s\"): %s", host, gai_strerror(err));
-        return false;
-      }
-
-      struct sockaddr_in *ai_addr = (struct sockaddr_in *)res->ai_addr;
-      addr.sin_addr = ai_addr->sin_addr;
-
-      freeaddrinfo(res);
-    }
+    addr_len = udp_socket_sockaddr(sock, host, port, &addr);
+  }
+  if (addr_len == 0) {
+    return false;
   }
 
-  if (bind(sock->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+  if (bind(sock->fd, (struct sockaddr *)&addr, (socklen_t)addr_len) < 0) {
     return false;
   }
 
@@ -112,35 +118,14 @@ UDPSocket_connect(picorb_state *vm, picorb_socket_t *sock, const char *host, int
 {
   if (!sock || sock->fd < 0 || !host) return false;
 
-  struct sockaddr_in addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(port);
-
-  /* Try to parse as IP address */
-  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
-    /* Not an IP address, try DNS resolution */
-    struct addrinfo hints;
-    struct addrinfo *res = NULL;
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_DGRAM;
-
-    int err = getaddrinfo(host, NULL, &hints, &res);
-    if (err != 0 || !res) {
-      snprintf(sock->errmsg, sizeof(sock->errmsg),
-               "getaddrinfo(\"%s\"): %s", host, gai_strerror(err));
-      return false;
-    }
-
-    struct sockaddr_in *ai_addr = (struct sockaddr_in *)res->ai_addr;
-    addr.sin_addr = ai_addr->sin_addr;
-    freeaddrinfo(res);
+  struct sockaddr_storage addr;
+  size_t addr_len = udp_socket_sockaddr(sock, host, port, &addr);
+  if (addr_len == 0) {
+    return false;
   }
 
   /* Connect socket (sets default destination) */
-  if (connect(sock->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+  if (connect(sock->fd, (struct sockaddr *)&addr, (socklen_t)addr_len) < 0) {
     snprintf(sock->errmsg, sizeof(sock->errmsg),
              "connect(\"%s\":%d): %s", host, port, strerror(errno));
     return false;
@@ -184,35 +169,14 @@ UDPSocket_sendto(picorb_state *vm, picorb_socket_t *sock, const void *data, size
     return -1;
   }
 
-  struct sockaddr_in addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(port);
-
-  /* Try to parse as IP address */
-  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
-    /* Not an IP address, try DNS resolution */
-    struct addrinfo hints;
-    struct addrinfo *res = NULL;
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_DGRAM;
-
-    int err = getaddrinfo(host, NULL, &hints, &res);
-    if (err != 0 || !res) {
-      snprintf(sock->errmsg, sizeof(sock->errmsg),
-               "getaddrinfo(\"%s\"): %s", host, gai_strerror(err));
-      return -1;
-    }
-
-    struct sockaddr_in *ai_addr = (struct sockaddr_in *)res->ai_addr;
-    addr.sin_addr = ai_addr->sin_addr;
-    freeaddrinfo(res);
+  struct sockaddr_storage addr;
+  size_t addr_len = udp_socket_sockaddr(sock, host, port, &addr);
+  if (addr_len == 0) {
+    return -1;
   }
 
   ssize_t sent = sendto(sock->fd, data, len, 0,
-                        (struct sockaddr *)&addr, sizeof(addr));
+                        (struct sockaddr *)&addr, (socklen_t)addr_len);
   if (sent < 0) {
     return -1;
   }
@@ -231,7 +195,7 @@ UDPSocket_recvfrom(picorb_state *vm, picorb_socket_t *sock, void *buf, size_t le
     return -1;
   }
 
-  struct sockaddr_in addr;
+  struct sockaddr_storage addr;
   socklen_t addr_len = sizeof(addr);
   memset(&addr, 0, sizeof(addr));
 
@@ -247,13 +211,9 @@ UDPSocket_recvfrom(picorb_state *vm, picorb_socket_t *sock, void *buf, size_t le
     return -1;
   }
 
-  /* Extract sender information if requested */
-  if (host && host_len > 0) {
-    inet_ntop(AF_INET, &addr.sin_addr, host, host_len);
-  }
-  if (port) {
-    *port = ntohs(addr.sin_port);
-  }
+  /* Extract sender information if requested. IPv4 senders to a
+   * dual-stack socket are reported with their IPv4 address. */
+  Net_sockaddr_address((struct sockaddr *)&addr, host, host_len, port);
 
   return received;
 }
@@ -212,13 +212,11 @@ Net_dns_get_address(void *ptr, char *buf, size_t buflen)
   return 0;
 }
 
+/* A request released while still running is left for the callback to clear */
 void
 Net_dns_release(void *ptr)
 {
-  picorb_dns_request *request = (picorb_dns_request *)ptr;
-  if (request && request->state != 1) {
-    memset(request, 0, sizeof(*request));
-  }
+  Net_dns_abandon(ptr);
 }
 
 void
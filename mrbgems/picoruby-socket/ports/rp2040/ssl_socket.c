@@ -39,6 +39,11 @@ struct picorb_ssl_context {
   size_t cert_len;
   const unsigned char *key_data;
   size_t key_len;
+  /* Last session (mbedtls_ssl_session_save format) and the peer it is for */
+  unsigned char *session_data;
+  size_t session_len;
+  char *session_host;
+  int session_port;
 };
 
 /* SSL socket structure */
@@ -51,6 +56,8 @@ struct picorb_ssl_socket {
   char *hostname;
   char *connect_hostname;
   int port;
+  unsigned char *session_data;    /* Offered on connect, then the new one */
+  size_t session_len;
 };
 
 #ifdef PICORB_DEBUG
@@ -216,6 +223,98 @@ ssl_poll_callback(void *arg, struct altcp_pcb *pcb)
   return ERR_OK;
 }
 
+/* ========================================================================
+ * Session resumption
+ *
+ * Sessions are kept serialized: a few hundred bytes of heap instead of a
+ * live mbedtls_ssl_session, and the same bytes are what Ruby sees.
+ * ======================================================================== */
+
+static void
+ssl_offer_session(picorb_ssl_socket_t *ssl_sock, mbedtls_ssl_context *ssl)
+{
+  picorb_ssl_context_t *ctx = ssl_sock->ssl_ctx;
+  const unsigned char *data = ssl_sock->session_data;
+  size_t len = ssl_sock->session_len;
+
+  if (!data && ctx->session_data && ctx->session_port == ssl_sock->port &&
+      strcmp(ctx->session_host, ssl_sock->hostname) == 0) {
+    data = ctx->session_data;
+    len = ctx->session_len;
+  }
+  if (!data) {
+    return;
+  }
+
+  /* A session the server no longer knows just means a full handshake */
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  if (mbedtls_ssl_session_load(&session, data, len) == 0) {
+    mbedtls_ssl_set_session(ssl, &session);
+  }
+  mbedtls_ssl_session_free(&session);
+}
+
+static unsigned char *
+ssl_dup_bytes(picorb_state *vm, const unsigned char *data, size_t len)
+{
+  unsigned char *copy = (unsigned char *)picorb_alloc(vm, len);
+  if (copy) {
+    memcpy(copy, data, len);
+  }
+  return copy;
+}
+
+static void
+ssl_save_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, mbedtls_ssl_context *ssl)
+{
+  mbedtls_ssl_session session;
+  unsigned char *data = NULL;
+  size_t len = 0;
+
+  mbedtls_ssl_session_init(&session);
+  if (mbedtls_ssl_get_session(ssl, &session) != 0) {
+    goto done;
+  }
+  mbedtls_ssl_session_save(&session, NULL, 0, &len);
+  if (len == 0) {
+    goto done;
+  }
+  data = (unsigned char *)picorb_alloc(vm, len);
+  if (!data) {
+    goto done;
+  }
+  if (mbedtls_ssl_session_save(&session, data, len, &len) != 0) {
+    picorb_free(vm, data);
+    goto done;
+  }
+
+  if (ssl_sock->session_data) {
+    picorb_free(vm, ssl_sock->session_data);
+  }
+  ssl_sock->session_data = data;
+  ssl_sock->session_len = len;
+
+  /* Cache a copy on the context for the next connection to this peer */
+  picorb_ssl_context_t *ctx = ssl_sock->ssl_ctx;
+  unsigned char *cached = ssl_dup_bytes(vm, data, len);
+  char *host = (char *)ssl_dup_bytes(vm, (const unsigned char *)ssl_sock->hostname,
+                                     strlen(ssl_sock->hostname) + 1);
+  if (!cached || !host) {
+    if (cached) picorb_free(vm, cached);
+    if (host) picorb_free(vm, host);
+    goto done;
+  }
+  SSLContext_flush_sessions(vm, ctx);
+  ctx->session_data = cached;
+  ctx->session_len = len;
+  ctx->session_host = host;
+  ctx->session_port = ssl_sock->port;
+
+done:
+  mbedtls_ssl_session_free(&session);
+}
+
 /* ========================================================================
  * SSLContext Functions
  * ======================================================================== */
@@ -244,8 +343,9 @@ SSLContext_create(picorb_state *vm)
 bool
 SSLContext_set_ca_file(picorb_state *vm, picorb_ssl_context_t *ctx, const char *ca_file)
 {
-  (void)ctx;
   (void)ca_file;
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   return false;  /* Not supported on rp2040 */
 }
 
@@ -256,6 +356,8 @@ SSLContext_set_ca(picorb_state *vm, picorb_ssl_context_t *ctx, const void *addr,
     return false;
   }
 
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   ctx->ca_data = (const unsigned char *)addr;
   ctx->ca_len = size;
 
@@ -311,6 +413,8 @@ SSLContext_set_verify_mode(picorb_state *vm, picorb_ssl_context_t *ctx, int mode
     return false;
   }
 
+  /* A cached session would resume without the checks set here */
+  SSLContext_flush_sessions(vm, ctx);
   ctx->verify_mode = mode;
   return true;
 }
@@ -324,6 +428,25 @@ SSLContext_get_verify_mode(picorb_state *vm, picorb_ssl_context_t *ctx)
   return ctx->verify_mode;
 }
 
+void
+SSLContext_flush_sessions(picorb_state *vm, picorb_ssl_context_t *ctx)
+{
+  if (!ctx) {
+    return;
+  }
+
+  if (ctx->session_data) {
+    picorb_free(vm, ctx->session_data);
+    ctx->session_data = NULL;
+  }
+  if (ctx->session_host) {
+    picorb_free(vm, ctx->session_host);
+    ctx->session_host = NULL;
+  }
+  ctx->session_len = 0;
+  ctx->session_port = 0;
+}
+
 void
 SSLContext_free(picorb_state *vm, picorb_ssl_context_t *ctx)
 {
@@ -331,6 +454,8 @@ SSLContext_free(picorb_state *vm, picorb_ssl_context_t *ctx)
     return;
   }
 
+  SSLContext_flush_sessions(vm, ctx);
+
   if (ctx->tls_config) {
     altcp_tls_free_config(ctx->tls_config);
     ctx->tls_config = NULL;
@@ -562,6 +687,7 @@ SSLSocket_connect(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     return false;
   }
   mbedtls_ssl_set_hostname(ssl_ctx, ssl_sock->hostname);
+  ssl_offer_session(ssl_sock, ssl_ctx);
 
   /* Setup callbacks */
   D("SSL: setting callbacks");
@@ -649,6 +775,10 @@ SSLSocket_finish_connect(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     return true;
   }
 
+  if (ssl_sock->tls_pcb) {
+    ssl_save_session(vm, ssl_sock, (mbedtls_ssl_context *)altcp_tls_context(ssl_sock->tls_pcb));
+  }
+
   ssl_sock->base_socket->recv_buf = (char *)picorb_alloc(vm, SSL_RECV_BUF_SIZE + 1);
   if (!ssl_sock->base_socket->recv_buf) {
     Net_set_last_error("SSL recv buffer allocation failed");
@@ -780,6 +910,10 @@ SSLSocket_close(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
     picorb_free(vm, ssl_sock->connect_hostname);
     ssl_sock->connect_hostname = NULL;
   }
+  if (ssl_sock->session_data) {
+    picorb_free(vm, ssl_sock->session_data);
+    ssl_sock->session_data = NULL;
+  }
 
   if (ssl_sock->base_socket) {
   picorb_socket_notify_readable(SSLSocket_event_socket(ssl_sock));
@@ -833,3 +967,55 @@ SSLSocket_remote_port(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
   }
   return ssl_sock->port;
 }
+
+ssize_t
+SSLSocket_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, void *buf, size_t len)
+{
+  (void)vm;
+  if (!ssl_sock) {
+    return -1;
+  }
+  if (!ssl_sock->session_data) {
+    return 0;
+  }
+  if (buf && ssl_sock->session_len <= len) {
+    memcpy(buf, ssl_sock->session_data, ssl_sock->session_len);
+  }
+  return (ssize_t)ssl_sock->session_len;
+}
+
+bool
+SSLSocket_set_session(picorb_state *vm, picorb_ssl_socket_t *ssl_sock, const void *data, size_t len)
+{
+  if (!ssl_sock || ssl_sock->tls_pcb || !data || len == 0) {
+    return false;
+  }
+
+  /* Reject bytes mbedTLS cannot load now rather than at connect */
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  int ret = mbedtls_ssl_session_load(&session, (const unsigned char *)data, len);
+  mbedtls_ssl_session_free(&session);
+  if (ret != 0) {
+    return false;
+  }
+
+  unsigned char *copy = ssl_dup_bytes(vm, (const unsigned char *)data, len);
+  if (!copy) {
+    return false;
+  }
+  if (ssl_sock->session_data) {
+    picorb_free(vm, ssl_sock->session_data);
+  }
+  ssl_sock->session_data = copy;
+  ssl_sock->session_len = len;
+  return true;
+}
+
+int
+SSLSocket_session_reused(picorb_state *vm, picorb_ssl_socket_t *ssl_sock)
+{
+  (void)vm;
+  (void)ssl_sock;
+  return -1;  /* mbedTLS does not report whether the handshake resumed */
+}
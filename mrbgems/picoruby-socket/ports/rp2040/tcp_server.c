@@ -108,7 +108,12 @@ tcp_recv_callback(void *arg, struct altcp_pcb *pcb, struct pbuf *pbuf, err_t err
 static err_t
 tcp_sent_callback(void *arg, struct altcp_pcb *pcb, u16_t len)
 {
-  /* Nothing special to do */
+  picorb_socket_t *sock = (picorb_socket_t *)arg;
+  /* Acknowledged data frees room in the send buffer */
+  if (sock && sock->want_writable) {
+    sock->want_writable = false;
+    picorb_socket_notify_readable(sock);
+  }
   return ERR_OK;
 }
 
@@ -155,7 +155,12 @@ tcp_recv_callback(void *arg, struct altcp_pcb *pcb, struct pbuf *pbuf, err_t err
 static err_t
 tcp_sent_callback(void *arg, struct altcp_pcb *pcb, u16_t len)
 {
-  /* Nothing special to do */
+  picorb_socket_t *sock = (picorb_socket_t *)arg;
+  /* Acknowledged data frees room in the send buffer */
+  if (sock && sock->want_writable) {
+    sock->want_writable = false;
+    picorb_socket_notify_readable(sock);
+  }
   return ERR_OK;
 }
 
@@ -309,6 +314,70 @@ TCPSocket_send(picorb_state *vm, picorb_socket_t *sock, const void *data, size_t
   return (ssize_t)len;
 }
 
+/* Send pieces with one output: every piece is queued with
+ * TCP_WRITE_FLAG_MORE but the last, so they leave in as few segments as
+ * possible. A piece is cut at the free send buffer, which makes the send
+ * partial, and the caller sends the rest. Returns 0 while the send buffer
+ * is full, so that the caller waits for it to drain and tries again. */
+ssize_t
+TCPSocket_sendv(picorb_state *vm, picorb_socket_t *sock,
+                const picorb_socket_iov_t *iov, int iovcnt)
+{
+  size_t total = 0;
+  err_t werr = ERR_OK;
+
+  if (!sock || !iov || iovcnt <= 0 || !sock->pcb || sock->state != SOCKET_STATE_CONNECTED) {
+    return -1;
+  }
+
+  lwip_begin();
+  for (int i = 0; i < iovcnt; i++) {
+    size_t len = iov[i].len;
+    size_t room = altcp_sndbuf(sock->pcb);
+    if (len == 0) continue;
+    if (room < len) len = room;
+    if (len == 0) break;
+    u8_t flags = TCP_WRITE_FLAG_COPY;
+    if (i + 1 < iovcnt && len == iov[i].len) flags |= TCP_WRITE_FLAG_MORE;
+    werr = altcp_write(sock->pcb, iov[i].base, (u16_t)len, flags);
+    if (werr != ERR_OK) break;
+    total += len;
+    if (len < iov[i].len) break;
+  }
+  if (total == 0) {
+    lwip_end();
+    /* ERR_MEM: out of queue entries until sent segments are acknowledged */
+    return (werr == ERR_OK || werr == ERR_MEM) ? 0 : -1;
+  }
+
+  err_t err = altcp_output(sock->pcb);
+  lwip_end();
+
+#ifdef PICO_CYW43_ARCH_POLL
+  cyw43_arch_poll();
+#endif
+
+  if (err != ERR_OK) {
+    return -1;
+  }
+
+  return (ssize_t)total;
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+/* tcp_sent_callback runs from cyw43_arch_poll() on this thread, so no
+ * acknowledgement can slip in between a full send and this call */
+bool
+TCPSocket_watch_writable(picorb_state *vm, picorb_socket_t *sock, bool writable)
+{
+  (void)vm;
+  if (!sock || !sock->event_queue) return false;
+  sock->event_pending = false;
+  sock->want_writable = writable;
+  return true;
+}
+#endif
+
 /* Receive data */
 ssize_t
 TCPSocket_recv(picorb_state *vm, picorb_socket_t *sock, void *buf, size_t len, bool nonblock)
@@ -0,0 +1,170 @@
+#include "mruby/presym.h"
+#include "mruby/class.h"
+#include "mruby/data.h"
+#include "mruby/string.h"
+#include "mruby/variable.h"
+
+#define E_SOCKET_ERROR (mrb_class_get_id(mrb, MRB_SYM(SocketError)))
+
+static void
+mrb_socket_rbuf_free(mrb_state *mrb, void *ptr)
+{
+  if (ptr) {
+    picorb_socket_rbuf_free(mrb, (picorb_socket_rbuf_t *)ptr);
+    mrb_free(mrb, ptr);
+  }
+}
+
+static const struct mrb_data_type mrb_socket_rbuf_type = {
+  "SocketReadBuffer", mrb_socket_rbuf_free,
+};
+
+/* Buffer attached to a socket as @rbuf, or NULL if it has none yet */
+picorb_socket_rbuf_t*
+mrb_socket_rbuf(mrb_state *mrb, mrb_value self)
+{
+  mrb_value rbuf = mrb_iv_get(mrb, self, MRB_IVSYM(rbuf));
+  if (mrb_nil_p(rbuf)) return NULL;
+  return (picorb_socket_rbuf_t *)mrb_data_get_ptr(mrb, rbuf, &mrb_socket_rbuf_type);
+}
+
+/* Take up to maxlen buffered bytes (all of them if maxlen < 0) */
+mrb_value
+mrb_socket_rbuf_take(mrb_state *mrb, picorb_socket_rbuf_t *rbuf, mrb_int maxlen)
+{
+  size_t len = picorb_socket_rbuf_length(rbuf);
+  if (0 <= maxlen && (size_t)maxlen < len) len = (size_t)maxlen;
+  mrb_value str = mrb_str_new(mrb, rbuf->ptr + rbuf->head, len);
+  picorb_socket_rbuf_consume(rbuf, len);
+  return str;
+}
+
+/*
+ * Shared body of TCPSocket#__fill_rbuf and SSLSocket#__fill_rbuf.
+ * Returns the number of bytes added, 0 at EOF, or nil if nonblock
+ * is true and nothing is available yet.
+ */
+mrb_value
+mrb_socket_rbuf_fill(mrb_state *mrb, mrb_value self,
+                     picorb_socket_recv_func recv, void *conn)
+{
+  mrb_bool nonblock;
+  mrb_get_args(mrb, "b", &nonblock);
+
+  picorb_socket_rbuf_t *rbuf = mrb_socket_rbuf(mrb, self);
+  if (!rbuf) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "read buffer is not initialized");
+  }
+
+  ssize_t received = picorb_socket_rbuf_fill(mrb, rbuf, recv, conn, nonblock);
+
+  if (received == PICORB_RECV_WOULD_BLOCK) {
+    return mrb_nil_value();
+  }
+  if (received == PICORB_RECV_TIMEOUT) {
+    mrb_raise(mrb, E_SOCKET_ERROR, "read timeout");
+  }
+  if (received < 0) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "read failed");
+  }
+  return mrb_fixnum_value(received);
+}
+
+/* SocketReadBuffer.new */
+static mrb_value
+mrb_rbuf_initialize(mrb_state *mrb, mrb_value self)
+{
+  picorb_socket_rbuf_t *rbuf = (picorb_socket_rbuf_t *)mrb_malloc(mrb, sizeof(picorb_socket_rbuf_t));
+  memset(rbuf, 0, sizeof(picorb_socket_rbuf_t));
+  mrb_data_init(self, rbuf, &mrb_socket_rbuf_type);
+  return self;
+}
+
+/* rbuf.size -> Integer */
+static mrb_value
+mrb_rbuf_size(mrb_state *mrb, mrb_value self)
+{
+  picorb_socket_rbuf_t *rbuf = (picorb_socket_rbuf_t *)
+    mrb_data_get_ptr(mrb, self, &mrb_socket_rbuf_type);
+  return mrb_fixnum_value(picorb_socket_rbuf_length(rbuf));
+}
+
+/*
+ * rbuf.gets(sep, limit, resume) -> String or nil
+ * Returns nil when no complete line is buffered yet.
+ * sep = nil means that only limit ends a line.
+ */
+static mrb_value
+mrb_rbuf_gets(mrb_state *mrb, mrb_value self)
+{
+  mrb_value sep;
+  mrb_value limit;
+  mrb_bool resume;
+  mrb_get_args(mrb, "S!ob", &sep, &limit, &resume);
+
+  picorb_socket_rbuf_t *rbuf = (picorb_socket_rbuf_t *)
+    mrb_data_get_ptr(mrb, self, &mrb_socket_rbuf_type);
+  size_t max = mrb_nil_p(limit) ? 0 : (size_t)mrb_as_int(mrb, limit);
+  size_t len = picorb_socket_rbuf_find_line(
+    rbuf,
+    mrb_nil_p(sep) ? NULL : RSTRING_PTR(sep),
+    mrb_nil_p(sep) ? 0 : (size_t)RSTRING_LEN(sep),
+    max, resume);
+  if (len == 0) return mrb_nil_value();
+  return mrb_socket_rbuf_take(mrb, rbuf, (mrb_int)len);
+}
+
+/*
+ * rbuf.read(maxlen = nil, outbuf = nil) -> String
+ * Takes buffered bytes only; appends them to outbuf when given.
+ */
+static mrb_value
+mrb_rbuf_read(mrb_state *mrb, mrb_value self)
+{
+  mrb_value maxlen = mrb_nil_value();
+  mrb_value outbuf = mrb_nil_value();
+  mrb_get_args(mrb, "|oS!", &maxlen, &outbuf);
+
+  picorb_socket_rbuf_t *rbuf = (picorb_socket_rbuf_t *)
+    mrb_data_get_ptr(mrb, self, &mrb_socket_rbuf_type);
+  size_t len = picorb_socket_rbuf_length(rbuf);
+  if (!mrb_nil_p(maxlen)) {
+    mrb_int n = mrb_as_int(mrb, maxlen);
+    if (0 <= n && (size_t)n < len) len = (size_t)n;
+  }
+  if (mrb_nil_p(outbuf)) {
+    outbuf = mrb_str_new(mrb, rbuf->ptr + rbuf->head, len);
+  } else {
+    mrb_str_cat(mrb, outbuf, rbuf->ptr + rbuf->head, len);
+  }
+  picorb_socket_rbuf_consume(rbuf, len);
+  return outbuf;
+}
+
+/* rbuf.unget(str) -> nil */
+static mrb_value
+mrb_rbuf_unget(mrb_state *mrb, mrb_value self)
+{
+  mrb_value str;
+  mrb_get_args(mrb, "S", &str);
+
+  picorb_socket_rbuf_t *rbuf = (picorb_socket_rbuf_t *)
+    mrb_data_get_ptr(mrb, self, &mrb_socket_rbuf_type);
+  if (!picorb_socket_rbuf_unget(mrb, rbuf, RSTRING_PTR(str), RSTRING_LEN(str))) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "failed to allocate read buffer");
+  }
+  return mrb_nil_value();
+}
+
+void
+read_buffer_init(mrb_state *mrb)
+{
+  struct RClass *rbuf_class = mrb_define_class_id(mrb, MRB_SYM(SocketReadBuffer), mrb->object_class);
+  MRB_SET_INSTANCE_TT(rbuf_class, MRB_TT_DATA);
+
+  mrb_define_method_id(mrb, rbuf_class, MRB_SYM(initialize), mrb_rbuf_initialize, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, rbuf_class, MRB_SYM(size), mrb_rbuf_size, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, rbuf_class, MRB_SYM(gets), mrb_rbuf_gets, MRB_ARGS_REQ(3));
+  mrb_define_method_id(mrb, rbuf_class, MRB_SYM(read), mrb_rbuf_read, MRB_ARGS_OPT(2));
+  mrb_define_method_id(mrb, rbuf_class, MRB_SYM(unget), mrb_rbuf_unget, MRB_ARGS_REQ(1));
+}
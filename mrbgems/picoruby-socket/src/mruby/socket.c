@@ -3,7 +3,7 @@
 #include "mruby/class.h"
 #include "mruby/data.h"
 #include "mruby/variable.h"
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 #include "task.h"
 #endif
 
@@ -19,7 +19,7 @@ const struct mrb_data_type mrb_socket_type = {
   "Socket", mrb_socket_free,
 };
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 void
 picorb_task_queue_notify(mrb_state *mrb, void *queue_ptr, bool *pending)
 {
@@ -45,13 +45,29 @@ picorb_task_queue_attach(mrb_state *mrb, void *self_ptr, void **queue_ptr)
   return true;
 }
 
+#ifdef PICORB_PLATFORM_POSIX
+static void
+socket_watch_notify(void *target, int events)
+{
+  (void)events;
+  picorb_socket_notify_readable((picorb_socket_t *)target);
+}
+#endif
+
 bool
 picorb_socket_attach_event_queue(mrb_state *mrb, void *self_ptr,
                                  picorb_socket_t *sock)
 {
   if (!picorb_task_queue_attach(mrb, self_ptr, &sock->event_queue)) return false;
   sock->vm = mrb;
+#ifdef PICORB_PLATFORM_POSIX
+  /* A connecting socket is watched by TCPSocket_connect until connected */
+  if (!sock->connected) return true;
+  return Socket_watch(sock->fd, SOCKET_WATCH_READABLE, socket_watch_notify,
+                      sock, &sock->event_pending);
+#else
   return true;
+#endif
 }
 
 void
@@ -205,6 +221,12 @@ mrb_picoruby_socket_gem_init(mrb_state *mrb)
 
   /* BasicSocket class */
   basic_socket_class = mrb_define_class_id(mrb, MRB_SYM(BasicSocket), mrb->object_class);
+  mrb_define_const_id(mrb, basic_socket_class, MRB_SYM(READ_BUFFER_SIZE), mrb_fixnum_value(PICORB_SOCKET_RBUF_SIZE));
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  mrb_define_const_id(mrb, basic_socket_class, MRB_SYM(EVENT_QUEUE), mrb_true_value());
+#else
+  mrb_define_const_id(mrb, basic_socket_class, MRB_SYM(EVENT_QUEUE), mrb_false_value());
+#endif
 
 #ifdef PICO_CYW43_ARCH_POLL
   mrb_init_dns_resolver(mrb);
@@ -215,6 +237,7 @@ mrb_picoruby_socket_gem_init(mrb_state *mrb)
   udp_socket_init(mrb, basic_socket_class);
   tcp_server_init(mrb, basic_socket_class);
   ssl_socket_init(mrb, basic_socket_class);
+  read_buffer_init(mrb);
 }
 
 void
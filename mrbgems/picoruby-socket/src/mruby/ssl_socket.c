@@ -271,6 +271,22 @@ mrb_ssl_context_get_verify_mode(mrb_state *mrb, mrb_value self)
   return mrb_fixnum_value(mode);
 }
 
+/* ssl_context.flush_sessions */
+static mrb_value
+mrb_ssl_context_flush_sessions(mrb_state *mrb, mrb_value self)
+{
+  picorb_ssl_context_t *ctx;
+
+  ctx = (picorb_ssl_context_t *)mrb_data_get_ptr(mrb, self, &mrb_ssl_context_type);
+  if (!ctx) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "SSL context is not initialized");
+  }
+
+  SSLContext_flush_sessions(mrb, ctx);
+
+  return self;
+}
+
 /* Data type for SSLSocket */
 static void
 mrb_ssl_socket_free(mrb_state *mrb, void *ptr)
@@ -530,6 +546,12 @@ mrb_ssl_socket_readpartial(mrb_state *mrb, mrb_value self)
     mrb_raise(mrb, E_ARGUMENT_ERROR, "maxlen must be positive");
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  picorb_socket_rbuf_t *rbuf = mrb_socket_rbuf(mrb, self);
+  if (rbuf && 0 < picorb_socket_rbuf_length(rbuf)) {
+    return mrb_socket_rbuf_take(mrb, rbuf, maxlen);
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *read_buf = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -580,6 +602,12 @@ mrb_ssl_socket_read_nonblock(mrb_state *mrb, mrb_value self)
     mrb_raise(mrb, E_ARGUMENT_ERROR, "maxlen must be positive");
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  picorb_socket_rbuf_t *rbuf = mrb_socket_rbuf(mrb, self);
+  if (rbuf && 0 < picorb_socket_rbuf_length(rbuf)) {
+    return mrb_socket_rbuf_take(mrb, rbuf, maxlen);
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *read_buf = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -615,6 +643,34 @@ mrb_ssl_socket_read_nonblock(mrb_state *mrb, mrb_value self)
   return buf;
 }
 
+static ssize_t
+ssl_socket_recv_func(mrb_state *mrb, void *conn, void *buf, size_t len, bool nonblock)
+{
+  picorb_ssl_socket_t *ssl_sock = (picorb_ssl_socket_t *)conn;
+  ssize_t received = SSLSocket_recv(mrb, ssl_sock, buf, len, nonblock);
+#ifdef PICO_CYW43_ARCH_POLL
+  if (received == PICORB_RECV_WOULD_BLOCK) {
+    picorb_socket_t *sock = SSLSocket_event_socket(ssl_sock);
+    if (sock) sock->event_pending = false;
+  }
+#endif
+  return received;
+}
+
+/* ssl_socket.__fill_rbuf(nonblock) -> Integer or nil */
+static mrb_value
+mrb_ssl_socket_fill_rbuf(mrb_state *mrb, mrb_value self)
+{
+  picorb_ssl_socket_t *ssl_sock;
+
+  ssl_sock = (picorb_ssl_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_ssl_socket_type);
+  if (!ssl_sock) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "SSL socket is not initialized");
+  }
+
+  return mrb_socket_rbuf_fill(mrb, self, ssl_socket_recv_func, ssl_sock);
+}
+
 /* ssl_socket.close */
 static mrb_value
 mrb_ssl_socket_close(mrb_state *mrb, mrb_value self)
@@ -688,6 +744,73 @@ mrb_ssl_socket_remote_port(mrb_state *mrb, mrb_value self)
   return mrb_fixnum_value(port);
 }
 
+/* ssl_socket.session -> String or nil */
+static mrb_value
+mrb_ssl_socket_session(mrb_state *mrb, mrb_value self)
+{
+  picorb_ssl_socket_t *ssl_sock;
+
+  ssl_sock = (picorb_ssl_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_ssl_socket_type);
+  if (!ssl_sock) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "SSL socket is not initialized");
+  }
+
+  ssize_t size = SSLSocket_session(mrb, ssl_sock, NULL, 0);
+  if (size < 0) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "failed to get SSL session");
+  }
+  if (size == 0) {
+    return mrb_nil_value();
+  }
+
+  mrb_value session = mrb_str_new(mrb, NULL, size);
+  if (SSLSocket_session(mrb, ssl_sock, RSTRING_PTR(session), (size_t)size) != size) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "failed to get SSL session");
+  }
+
+  return session;
+}
+
+/* ssl_socket.session = session */
+static mrb_value
+mrb_ssl_socket_set_session(mrb_state *mrb, mrb_value self)
+{
+  picorb_ssl_socket_t *ssl_sock;
+  mrb_value session;
+
+  ssl_sock = (picorb_ssl_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_ssl_socket_type);
+  if (!ssl_sock) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "SSL socket is not initialized");
+  }
+
+  mrb_get_args(mrb, "S", &session);
+
+  if (!SSLSocket_set_session(mrb, ssl_sock, RSTRING_PTR(session), (size_t)RSTRING_LEN(session))) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "invalid SSL session or already connected");
+  }
+
+  return session;
+}
+
+/* ssl_socket.session_reused? */
+static mrb_value
+mrb_ssl_socket_session_reused_p(mrb_state *mrb, mrb_value self)
+{
+  picorb_ssl_socket_t *ssl_sock;
+
+  ssl_sock = (picorb_ssl_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_ssl_socket_type);
+  if (!ssl_sock) {
+    return mrb_false_value();
+  }
+
+  int reused = SSLSocket_session_reused(mrb, ssl_sock);
+  if (reused < 0) {
+    mrb_raise(mrb, E_NOTIMP_ERROR, "session_reused? is not supported on this platform");
+  }
+
+  return mrb_bool_value(reused);
+}
+
 /* ssl_socket.ready? */
 static mrb_value
 mrb_ssl_socket_ready_p(mrb_state *mrb, mrb_value self)
@@ -724,6 +847,7 @@ ssl_socket_init(mrb_state *mrb, struct RClass *basic_socket_class)
   mrb_define_method_id(mrb, ssl_context_class, MRB_SYM(set_key_pem), mrb_ssl_context_set_key_pem, MRB_ARGS_REQ(1));
   mrb_define_method_id(mrb, ssl_context_class, MRB_SYM_E(verify_mode), mrb_ssl_context_set_verify_mode, MRB_ARGS_REQ(1));
   mrb_define_method_id(mrb, ssl_context_class, MRB_SYM(verify_mode), mrb_ssl_context_get_verify_mode, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, ssl_context_class, MRB_SYM(flush_sessions), mrb_ssl_context_flush_sessions, MRB_ARGS_NONE());
 
   /* SSLContext constants */
   mrb_define_const_id(mrb, ssl_context_class, MRB_SYM(VERIFY_NONE), mrb_fixnum_value(SSL_VERIFY_NONE));
@@ -755,9 +879,13 @@ ssl_socket_init(mrb_state *mrb, struct RClass *basic_socket_class)
 #endif
   mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM(send), mrb_ssl_socket_send, MRB_ARGS_REQ(2));
   mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM(read_nonblock), mrb_ssl_socket_read_nonblock, MRB_ARGS_REQ(1));
+  mrb_define_private_method_id(mrb, ssl_socket_class, MRB_SYM(__fill_rbuf), mrb_ssl_socket_fill_rbuf, MRB_ARGS_REQ(1));
   mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM(close), mrb_ssl_socket_close, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM_Q(closed), mrb_ssl_socket_closed_p, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM_Q(ready), mrb_ssl_socket_ready_p, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM(remote_host), mrb_ssl_socket_remote_host, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM(remote_port), mrb_ssl_socket_remote_port, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM(session), mrb_ssl_socket_session, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM_E(session), mrb_ssl_socket_set_session, MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, ssl_socket_class, MRB_SYM_Q(session_reused), mrb_ssl_socket_session_reused_p, MRB_ARGS_NONE());
 }
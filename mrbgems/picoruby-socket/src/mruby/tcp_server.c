@@ -6,11 +6,11 @@
 #include "mruby/data.h"
 #include "mruby/string.h"
 #include "mruby/variable.h"
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 #include "task.h"
 #endif
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 void
 TCPServer_notify_accepted(picorb_tcp_server_t *server)
 {
@@ -87,7 +87,7 @@ mrb_tcp_server_initialize(mrb_state *mrb, mrb_value self)
 
   mrb_data_init(self, server, &mrb_tcp_server_type);
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   void *queue_ptr = NULL;
   if (!picorb_task_queue_attach(mrb, &self, &queue_ptr)) {
     TCPServer_close(mrb, server);
@@ -124,7 +124,7 @@ mrb_tcp_server_accept_nonblock(mrb_state *mrb, mrb_value self)
   tcp_socket_class = mrb_class_get_id(mrb, MRB_SYM(TCPSocket));
   client_obj = mrb_obj_value(mrb_data_object_alloc(mrb, tcp_socket_class, client, &mrb_socket_type));
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   if (!picorb_socket_attach_event_queue(mrb, &client_obj, client)) {
     mrb_raise(mrb, E_RUNTIME_ERROR, "failed to allocate event queue");
   }
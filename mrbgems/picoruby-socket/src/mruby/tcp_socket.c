@@ -1,11 +1,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include "mruby/presym.h"
+#include "mruby/array.h"
 #include "mruby/string.h"
 #include "mruby/class.h"
 #include "mruby/data.h"
 #include "mruby/variable.h"
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 #include "task.h"
 #endif
 
@@ -39,12 +40,15 @@ mrb_tcp_socket_initialize(mrb_state *mrb, mrb_value self)
 
   mrb_data_init(self, sock, &mrb_socket_type);
 
-#ifdef PICO_CYW43_ARCH_POLL
-  picorb_socket_attach_event_queue(mrb, &self, sock);
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  if (!picorb_socket_attach_event_queue(mrb, &self, sock)) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "failed to allocate event queue");
+  }
 #endif
 
-  /* Connect to remote host. RP2040 poll mode returns after starting the
-   * connection; Ruby waits on event_queue and checks __connection_state. */
+  /* Connect to remote host. With an event queue this returns after
+   * starting the connection; Ruby waits on event_queue and checks
+   * __connection_state. */
   if (!TCPSocket_connect(mrb, sock, host, (int)port)) {
     mrb_raisef(mrb, E_SOCKET_ERROR, "%s",
       sock->errmsg[0] ? sock->errmsg : "failed to connect");
@@ -99,6 +103,100 @@ mrb_tcp_socket_send(mrb_state *mrb, mrb_value self)
   return mrb_fixnum_value(sent);
 }
 
+/* socket.__sendv(strings, offset)
+ * Send the strings after skipping their first offset bytes, with one
+ * TCPSocket_sendv and no String for the rest of a partly sent one */
+static mrb_value
+mrb_tcp_socket_sendv(mrb_state *mrb, mrb_value self)
+{
+  picorb_socket_t *sock;
+  mrb_value ary;
+  mrb_int offset;
+  picorb_socket_iov_t iov[PICORB_SOCKET_IOV_MAX];
+  int iovcnt = 0;
+
+  sock = (picorb_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_socket_type);
+  if (!sock) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "socket is not initialized");
+  }
+
+  mrb_get_args(mrb, "Ai", &ary, &offset);
+
+  for (mrb_int i = 0; i < RARRAY_LEN(ary) && iovcnt < PICORB_SOCKET_IOV_MAX; i++) {
+    mrb_value str = RARRAY_PTR(ary)[i];
+    if (!mrb_string_p(str)) {
+      mrb_raise(mrb, E_TYPE_ERROR, "data must be a String");
+    }
+    if (RSTRING_LEN(str) <= offset) {
+      offset -= RSTRING_LEN(str);
+      continue;
+    }
+    iov[iovcnt].base = RSTRING_PTR(str) + offset;
+    iov[iovcnt].len = RSTRING_LEN(str) - offset;
+    iovcnt++;
+    offset = 0;
+  }
+  if (iovcnt == 0) {
+    return mrb_fixnum_value(0);
+  }
+
+  ssize_t sent = TCPSocket_sendv(mrb, sock, iov, iovcnt);
+  if (sent < 0) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "send failed");
+  }
+
+  return mrb_fixnum_value(sent);
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+/* socket.__watch_writable(writable) -> bool
+ * Let @event_queue also report room in the send buffer */
+static mrb_value
+mrb_tcp_socket_watch_writable(mrb_state *mrb, mrb_value self)
+{
+  picorb_socket_t *sock;
+  mrb_bool writable;
+
+  sock = (picorb_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_socket_type);
+  mrb_get_args(mrb, "b", &writable);
+  if (!sock) {
+    return mrb_false_value();
+  }
+
+  return mrb_bool_value(TCPSocket_watch_writable(mrb, sock, writable));
+}
+#endif
+
+/* socket.__sendfile(fd, offset, count)
+ * Returns the bytes sent, or nil where files cannot be sent from C */
+static mrb_value
+mrb_tcp_socket_sendfile(mrb_state *mrb, mrb_value self)
+{
+  picorb_socket_t *sock;
+  mrb_int fd, offset, count;
+
+  sock = (picorb_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_socket_type);
+  if (!sock) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "socket is not initialized");
+  }
+
+  mrb_get_args(mrb, "iii", &fd, &offset, &count);
+
+#ifdef PICORB_PLATFORM_POSIX
+  ssize_t sent = TCPSocket_sendfile(mrb, sock, (int)fd, (off_t)offset,
+                                    count < 0 ? SIZE_MAX : (size_t)count);
+  if (sent < 0) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "sendfile failed");
+  }
+  return mrb_fixnum_value(sent);
+#else
+  (void)fd;
+  (void)offset;
+  (void)count;
+  return mrb_nil_value();
+#endif
+}
+
 /* socket.readpartial(maxlen) */
 static mrb_value
 mrb_tcp_socket_readpartial(mrb_state *mrb, mrb_value self)
@@ -118,6 +216,12 @@ mrb_tcp_socket_readpartial(mrb_state *mrb, mrb_value self)
     mrb_raise(mrb, E_ARGUMENT_ERROR, "maxlen must be positive");
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  picorb_socket_rbuf_t *rbuf = mrb_socket_rbuf(mrb, self);
+  if (rbuf && 0 < picorb_socket_rbuf_length(rbuf)) {
+    return mrb_socket_rbuf_take(mrb, rbuf, maxlen);
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *read_buf = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -168,6 +272,12 @@ mrb_tcp_socket_read_nonblock(mrb_state *mrb, mrb_value self)
     mrb_raise(mrb, E_ARGUMENT_ERROR, "maxlen must be positive");
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  picorb_socket_rbuf_t *rbuf = mrb_socket_rbuf(mrb, self);
+  if (rbuf && 0 < picorb_socket_rbuf_length(rbuf)) {
+    return mrb_socket_rbuf_take(mrb, rbuf, maxlen);
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *read_buf = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -179,7 +289,7 @@ mrb_tcp_socket_read_nonblock(mrb_state *mrb, mrb_value self)
   ssize_t received = TCPSocket_recv(mrb, sock, read_buf, maxlen, true);
 
   if (received == PICORB_RECV_WOULD_BLOCK) {
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
     sock->event_pending = false;
 #endif
     if (read_buf != stack_buf) mrb_free(mrb, read_buf);
@@ -202,6 +312,30 @@ mrb_tcp_socket_read_nonblock(mrb_state *mrb, mrb_value self)
   return buf;
 }
 
+static ssize_t
+tcp_socket_recv_func(mrb_state *mrb, void *conn, void *buf, size_t len, bool nonblock)
+{
+  ssize_t received = TCPSocket_recv(mrb, (picorb_socket_t *)conn, buf, len, nonblock);
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  if (received == PICORB_RECV_WOULD_BLOCK) ((picorb_socket_t *)conn)->event_pending = false;
+#endif
+  return received;
+}
+
+/* socket.__fill_rbuf(nonblock) -> Integer or nil */
+static mrb_value
+mrb_tcp_socket_fill_rbuf(mrb_state *mrb, mrb_value self)
+{
+  picorb_socket_t *sock;
+
+  sock = (picorb_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_socket_type);
+  if (!sock) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "socket is not initialized");
+  }
+
+  return mrb_socket_rbuf_fill(mrb, self, tcp_socket_recv_func, sock);
+}
+
 /* socket.close */
 static mrb_value
 mrb_tcp_socket_close(mrb_state *mrb, mrb_value self)
@@ -253,6 +387,30 @@ mrb_tcp_socket_remote_host(mrb_state *mrb, mrb_value self)
   return mrb_str_new_cstr(mrb, host);
 }
 
+/* socket.__peer_address */
+static mrb_value
+mrb_tcp_socket_peer_address(mrb_state *mrb, mrb_value self)
+{
+  picorb_socket_t *sock;
+
+  sock = (picorb_socket_t *)mrb_data_get_ptr(mrb, self, &mrb_socket_type);
+  if (!sock) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "socket is not initialized");
+  }
+
+#ifdef PICORB_PLATFORM_POSIX
+  char buf[SOCKET_ADDRESS_LEN];
+  const char *address = TCPSocket_peer_address(mrb, sock, buf, sizeof(buf));
+#else
+  const char *address = TCPSocket_remote_host(mrb, sock);
+#endif
+  if (!address) {
+    return mrb_nil_value();
+  }
+
+  return mrb_str_new_cstr(mrb, address);
+}
+
 /* socket.remote_port */
 static mrb_value
 mrb_tcp_socket_remote_port(mrb_state *mrb, mrb_value self)
@@ -294,20 +452,30 @@ tcp_socket_init(mrb_state *mrb, struct RClass *basic_socket_class)
   tcp_socket_class = mrb_define_class_id(mrb, MRB_SYM(TCPSocket), basic_socket_class);
   MRB_SET_INSTANCE_TT(tcp_socket_class, MRB_TT_DATA);
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__initialize_poll), mrb_tcp_socket_initialize, MRB_ARGS_REQ(2));
   mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__connection_state), mrb_tcp_socket_connection_state, MRB_ARGS_NONE());
   mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__error_message), mrb_tcp_socket_error_message, MRB_ARGS_NONE());
-  mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__readpartial_poll), mrb_tcp_socket_readpartial, MRB_ARGS_REQ(1));
 #else
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM(initialize), mrb_tcp_socket_initialize, MRB_ARGS_REQ(2));
+#endif
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__readpartial_poll), mrb_tcp_socket_readpartial, MRB_ARGS_REQ(1));
+#else
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM(readpartial), mrb_tcp_socket_readpartial, MRB_ARGS_REQ(1));
 #endif
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM(send), mrb_tcp_socket_send, MRB_ARGS_REQ(2));
+  mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__sendv), mrb_tcp_socket_sendv, MRB_ARGS_REQ(2));
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__watch_writable), mrb_tcp_socket_watch_writable, MRB_ARGS_REQ(1));
+#endif
+  mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__sendfile), mrb_tcp_socket_sendfile, MRB_ARGS_REQ(3));
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM(read_nonblock), mrb_tcp_socket_read_nonblock, MRB_ARGS_REQ(1));
+  mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__fill_rbuf), mrb_tcp_socket_fill_rbuf, MRB_ARGS_REQ(1));
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM(close), mrb_tcp_socket_close, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM_Q(closed), mrb_tcp_socket_closed_p, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM_Q(ready), mrb_tcp_socket_ready_p, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM(remote_host), mrb_tcp_socket_remote_host, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, tcp_socket_class, MRB_SYM(remote_port), mrb_tcp_socket_remote_port, MRB_ARGS_NONE());
+  mrb_define_private_method_id(mrb, tcp_socket_class, MRB_SYM(__peer_address), mrb_tcp_socket_peer_address, MRB_ARGS_NONE());
 }
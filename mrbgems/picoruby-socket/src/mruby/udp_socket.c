@@ -180,7 +180,7 @@ mrb_udp_socket_recvfrom_nonblock(mrb_state *mrb, mrb_value self)
 
   /* Create address info array [family, port, host, host] */
   addr_info = mrb_ary_new(mrb);
-  mrb_ary_push(mrb, addr_info, mrb_str_new_cstr(mrb, "AF_INET"));
+  mrb_ary_push(mrb, addr_info, mrb_str_new_cstr(mrb, strchr(host, ':') ? "AF_INET6" : "AF_INET"));
   mrb_ary_push(mrb, addr_info, mrb_fixnum_value(port));
   mrb_ary_push(mrb, addr_info, mrb_str_new_cstr(mrb, host));
   mrb_ary_push(mrb, addr_info, mrb_str_new_cstr(mrb, host));
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+  picorb_socket_rbuf_t rbuf;
+  picorb_state *vm;
+} rbuf_wrapper_t;
+
+static void
+mrbc_socket_rbuf_free(mrbc_value *self)
+{
+  rbuf_wrapper_t *wrapper = (rbuf_wrapper_t *)self->instance->data;
+  if (wrapper->vm) {
+    picorb_socket_rbuf_free(wrapper->vm, &wrapper->rbuf);
+  }
+}
+
+/*
+ * Buffer attached to a socket as @rbuf, or NULL if it has none yet
+ */
+picorb_socket_rbuf_t*
+mrbc_socket_rbuf(mrbc_value *self)
+{
+  mrbc_value rbuf = mrbc_instance_getiv(self, mrbc_str_to_symid("rbuf"));
+  if (rbuf.tt != MRBC_TT_OBJECT) {
+    mrbc_decref(&rbuf);
+    return NULL;
+  }
+  rbuf_wrapper_t *wrapper = (rbuf_wrapper_t *)rbuf.instance->data;
+  mrbc_decref(&rbuf);
+  return &wrapper->rbuf;
+}
+
+/*
+ * If the socket has buffered bytes, take up to maxlen of them into *ret.
+ * readpartial and read_nonblock call this before receiving.
+ */
+bool
+mrbc_socket_rbuf_take(mrbc_vm *vm, mrbc_value *self, int maxlen, mrbc_value *ret)
+{
+  picorb_socket_rbuf_t *rbuf = mrbc_socket_rbuf(self);
+  if (!rbuf) return false;
+  size_t len = picorb_socket_rbuf_length(rbuf);
+  if (len == 0) return false;
+  if ((size_t)maxlen < len) len = (size_t)maxlen;
+  *ret = mrbc_string_new(vm, rbuf->ptr + rbuf->head, (int)len);
+  picorb_socket_rbuf_consume(rbuf, len);
+  return true;
+}
+
+/*
+ * Shared body of TCPSocket#__fill_rbuf and SSLSocket#__fill_rbuf.
+ * Returns the number of bytes added, 0 at EOF, or nil if nonblock
+ * is true and nothing is available yet.
+ */
+void
+mrbc_socket_rbuf_fill(mrbc_vm *vm, mrbc_value *v, picorb_socket_recv_func recv, void *conn)
+{
+  picorb_socket_rbuf_t *rbuf = mrbc_socket_rbuf(&v[0]);
+  if (!rbuf) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "read buffer is not initialized");
+    return;
+  }
+  bool nonblock = (GET_ARG(1).tt == MRBC_TT_TRUE);
+
+  ssize_t received = picorb_socket_rbuf_fill(vm, rbuf, recv, conn, nonblock);
+
+  if (received == PICORB_RECV_WOULD_BLOCK) {
+    SET_NIL_RETURN();
+    return;
+  }
+  if (received == PICORB_RECV_TIMEOUT) {
+    mrbc_raise(vm, mrbc_get_class_by_name("SocketError"), "read timeout");
+    return;
+  }
+  if (received < 0) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "read failed");
+    return;
+  }
+  SET_INT_RETURN(received);
+}
+
+static inline picorb_socket_rbuf_t*
+get_rbuf_ptr(mrbc_value *v)
+{
+  return &((rbuf_wrapper_t *)v[0].instance->data)->rbuf;
+}
+
+/*
+ * SocketReadBuffer.new
+ */
+static void
+c_rbuf_new(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  mrbc_value instance = mrbc_instance_new(vm, v->cls, sizeof(rbuf_wrapper_t));
+  rbuf_wrapper_t *wrapper = (rbuf_wrapper_t *)instance.instance->data;
+  memset(wrapper, 0, sizeof(rbuf_wrapper_t));
+  wrapper->vm = vm;
+  SET_RETURN(instance);
+}
+
+/*
+ * rbuf.size -> Integer
+ */
+static void
+c_rbuf_size(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  SET_INT_RETURN(picorb_socket_rbuf_length(get_rbuf_ptr(v)));
+}
+
+/*
+ * rbuf.gets(sep, limit, resume) -> String or nil
+ * Returns nil when no complete line is buffered yet.
+ * sep = nil means that only limit ends a line.
+ */
+static void
+c_rbuf_gets(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 3) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+  mrbc_value sep = GET_ARG(1);
+  mrbc_value limit = GET_ARG(2);
+  if (sep.tt != MRBC_TT_STRING && sep.tt != MRBC_TT_NIL) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "separator must be a String");
+    return;
+  }
+  if (limit.tt != MRBC_TT_INTEGER && limit.tt != MRBC_TT_NIL) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "limit must be an Integer");
+    return;
+  }
+
+  picorb_socket_rbuf_t *rbuf = get_rbuf_ptr(v);
+  size_t len = picorb_socket_rbuf_find_line(
+    rbuf,
+    sep.tt == MRBC_TT_STRING ? (const char *)sep.string->data : NULL,
+    sep.tt == MRBC_TT_STRING ? (size_t)sep.string->size : 0,
+    limit.tt == MRBC_TT_INTEGER ? (size_t)limit.i : 0,
+    GET_ARG(3).tt == MRBC_TT_TRUE);
+  if (len == 0) {
+    SET_NIL_RETURN();
+    return;
+  }
+  mrbc_value ret = mrbc_string_new(vm, rbuf->ptr + rbuf->head, (int)len);
+  picorb_socket_rbuf_consume(rbuf, len);
+  SET_RETURN(ret);
+}
+
+/*
+ * rbuf.read(maxlen = nil, outbuf = nil) -> String
+ * Takes buffered bytes only; appends them to outbuf when given.
+ */
+static void
+c_rbuf_read(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  picorb_socket_rbuf_t *rbuf = get_rbuf_ptr(v);
+  size_t len = picorb_socket_rbuf_length(rbuf);
+
+  if (1 <= argc && GET_ARG(1).tt == MRBC_TT_INTEGER) {
+    mrbc_int_t n = GET_ARG(1).i;
+    if (0 <= n && (size_t)n < len) len = (size_t)n;
+  }
+  if (2 <= argc && GET_ARG(2).tt == MRBC_TT_STRING) {
+    mrbc_value outbuf = GET_ARG(2);
+    mrbc_string_append_cbuf(&outbuf, rbuf->ptr + rbuf->head, (int)len);
+    picorb_socket_rbuf_consume(rbuf, len);
+    mrbc_incref(&outbuf);
+    SET_RETURN(outbuf);
+    return;
+  }
+  mrbc_value ret = mrbc_string_new(vm, rbuf->ptr + rbuf->head, (int)len);
+  picorb_socket_rbuf_consume(rbuf, len);
+  SET_RETURN(ret);
+}
+
+/*
+ * rbuf.unget(str) -> nil
+ */
+static void
+c_rbuf_unget(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 1 || GET_ARG(1).tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "argument must be a String");
+    return;
+  }
+  mrbc_value str = GET_ARG(1);
+  if (!picorb_socket_rbuf_unget(vm, get_rbuf_ptr(v), str.string->data, str.string->size)) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "failed to allocate read buffer");
+    return;
+  }
+  SET_NIL_RETURN();
+}
+
+void
+read_buffer_init(mrbc_vm *vm)
+{
+  mrbc_class *class_SocketReadBuffer = mrbc_define_class(vm, "SocketReadBuffer", mrbc_class_object);
+  mrbc_define_destructor(class_SocketReadBuffer, mrbc_socket_rbuf_free);
+
+  mrbc_define_method(vm, class_SocketReadBuffer, "new", c_rbuf_new);
+  mrbc_define_method(vm, class_SocketReadBuffer, "size", c_rbuf_size);
+  mrbc_define_method(vm, class_SocketReadBuffer, "gets", c_rbuf_gets);
+  mrbc_define_method(vm, class_SocketReadBuffer, "read", c_rbuf_read);
+  mrbc_define_method(vm, class_SocketReadBuffer, "unget", c_rbuf_unget);
+}
@@ -2,7 +2,7 @@
 #include <string.h>
 #include <stdint.h>
 #include "picoruby.h"
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 #include "c_task_queue.h"
 
 mrbc_value
@@ -48,13 +48,29 @@ picorb_task_queue_attach(mrbc_vm *vm, void *self_ptr, void **queue_ptr)
   return true;
 }
 
+#ifdef PICORB_PLATFORM_POSIX
+static void
+socket_watch_notify(void *target, int events)
+{
+  (void)events;
+  picorb_socket_notify_readable((picorb_socket_t *)target);
+}
+#endif
+
 bool
 picorb_socket_attach_event_queue(mrbc_vm *vm, void *self_ptr,
                                   picorb_socket_t *sock)
 {
   if (!picorb_task_queue_attach(vm, self_ptr, &sock->event_queue)) return false;
   sock->vm = vm;
+#ifdef PICORB_PLATFORM_POSIX
+  /* A connecting socket is watched by TCPSocket_connect until connected */
+  if (!sock->connected) return true;
+  return Socket_watch(sock->fd, SOCKET_WATCH_READABLE, socket_watch_notify,
+                      sock, &sock->event_pending);
+#else
   return true;
+#endif
 }
 
 void
@@ -64,7 +80,9 @@ picorb_socket_notify_readable(picorb_socket_t *sock)
   picorb_task_queue_notify((mrbc_vm *)sock->vm, sock->event_queue,
                            &sock->event_pending);
 }
+#endif
 
+#ifdef PICO_CYW43_ARCH_POLL
 typedef struct {
   mrbc_value queue;
   void *request;
@@ -213,6 +231,12 @@ void
 mrbc_socket_init(mrbc_vm *vm)
 {
   mrbc_class *class_BasicSocket = mrbc_define_class(vm, "BasicSocket", mrbc_class_object);
+  mrbc_set_class_const(class_BasicSocket, mrbc_str_to_symid("READ_BUFFER_SIZE"), &mrbc_integer_value(PICORB_SOCKET_RBUF_SIZE));
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  mrbc_set_class_const(class_BasicSocket, mrbc_str_to_symid("EVENT_QUEUE"), &mrbc_true_value());
+#else
+  mrbc_set_class_const(class_BasicSocket, mrbc_str_to_symid("EVENT_QUEUE"), &mrbc_false_value());
+#endif
 
 #ifdef PICO_CYW43_ARCH_POLL
   mrbc_dns_resolver_init(vm);
@@ -222,4 +246,5 @@ mrbc_socket_init(mrbc_vm *vm)
   udp_socket_init(vm, class_BasicSocket);
   ssl_socket_init(vm, class_BasicSocket);
   tcp_server_init(vm, class_BasicSocket);
+  read_buffer_init(vm);
 }
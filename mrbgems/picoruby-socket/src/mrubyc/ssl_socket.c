@@ -380,6 +380,14 @@ c_ssl_socket_readpartial(mrbc_vm *vm, mrbc_value *v, int argc)
     return;
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  mrbc_value buffered;
+  if (mrbc_socket_rbuf_take(vm, &v[0], maxlen, &buffered)) {
+    mrbc_incref(&v[0]);
+    SET_RETURN(buffered);
+    return;
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *buffer = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -444,6 +452,14 @@ c_ssl_socket_read_nonblock(mrbc_vm *vm, mrbc_value *v, int argc)
     return;
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  mrbc_value buffered;
+  if (mrbc_socket_rbuf_take(vm, &v[0], maxlen, &buffered)) {
+    mrbc_incref(&v[0]);
+    SET_RETURN(buffered);
+    return;
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *buffer = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -479,6 +495,40 @@ c_ssl_socket_read_nonblock(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_RETURN(ret);
 }
 
+static ssize_t
+ssl_socket_recv_func(mrbc_vm *vm, void *conn, void *buf, size_t len, bool nonblock)
+{
+  picorb_ssl_socket_t *ssl_sock = (picorb_ssl_socket_t *)conn;
+  ssize_t received = SSLSocket_recv(vm, ssl_sock, buf, len, nonblock);
+#ifdef PICO_CYW43_ARCH_POLL
+  if (received == PICORB_RECV_WOULD_BLOCK) {
+    picorb_socket_t *sock = SSLSocket_event_socket(ssl_sock);
+    if (sock) sock->event_pending = false;
+  }
+#endif
+  return received;
+}
+
+/*
+ * ssl_socket.__fill_rbuf(nonblock) -> Integer or nil
+ */
+static void
+c_ssl_socket_fill_rbuf(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 1) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  ssl_socket_wrapper_t *wrapper = (ssl_socket_wrapper_t *)v[0].instance->data;
+  if (!wrapper->ptr) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "SSL socket is not initialized");
+    return;
+  }
+
+  mrbc_socket_rbuf_fill(vm, v, ssl_socket_recv_func, wrapper->ptr);
+}
+
 /*
  * ssl_socket.close -> nil
  */
@@ -617,6 +667,111 @@ c_ssl_socket_ready_q(mrbc_vm *vm, mrbc_value *v, int argc)
   }
 }
 
+/*
+ * ssl_socket.session -> String or nil
+ */
+static void
+c_ssl_socket_session(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 0) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  ssl_socket_wrapper_t *wrapper = (ssl_socket_wrapper_t *)v[0].instance->data;
+  if (!wrapper->ptr) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "SSL socket is not initialized");
+    return;
+  }
+
+  ssize_t size = SSLSocket_session(vm, wrapper->ptr, NULL, 0);
+  if (size < 0) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "failed to get SSL session");
+    return;
+  }
+  if (size == 0) {
+    SET_NIL_RETURN();
+    return;
+  }
+
+  char *buffer = (char *)picorb_alloc(vm, size);
+  if (!buffer) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "failed to allocate buffer");
+    return;
+  }
+  if (SSLSocket_session(vm, wrapper->ptr, buffer, (size_t)size) != size) {
+    picorb_free(vm, buffer);
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "failed to get SSL session");
+    return;
+  }
+
+  mrbc_value ret = mrbc_string_new(vm, buffer, size);
+  picorb_free(vm, buffer);
+  SET_RETURN(ret);
+}
+
+/*
+ * ssl_socket.session = session -> String
+ */
+static void
+c_ssl_socket_set_session(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 1) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  ssl_socket_wrapper_t *wrapper = (ssl_socket_wrapper_t *)v[0].instance->data;
+  if (!wrapper->ptr) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "SSL socket is not initialized");
+    return;
+  }
+
+  mrbc_value session = GET_ARG(1);
+  if (session.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "session must be a String");
+    return;
+  }
+
+  if (!SSLSocket_set_session(vm, wrapper->ptr, session.string->data, session.string->size)) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "invalid SSL session or already connected");
+    return;
+  }
+
+  mrbc_incref(&session);
+  SET_RETURN(session);
+}
+
+/*
+ * ssl_socket.session_reused? -> true or false
+ */
+static void
+c_ssl_socket_session_reused_q(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 0) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  ssl_socket_wrapper_t *wrapper = (ssl_socket_wrapper_t *)v[0].instance->data;
+  if (!wrapper->ptr) {
+    SET_FALSE_RETURN();
+    return;
+  }
+
+  int reused = SSLSocket_session_reused(vm, wrapper->ptr);
+  if (reused < 0) {
+    mrbc_raise(vm, MRBC_CLASS(NotImplementedError), "session_reused? is not supported on this platform");
+    return;
+  }
+
+  if (reused) {
+    SET_TRUE_RETURN();
+  } else {
+    SET_FALSE_RETURN();
+  }
+}
+
 /*
  * SSLContext.new() -> SSLContext
  */
@@ -1014,6 +1169,26 @@ c_ssl_context_get_verify_mode(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_INT_RETURN(mode);
 }
 
+/*
+ * ssl_context.flush_sessions -> self
+ */
+static void
+c_ssl_context_flush_sessions(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 0) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  ssl_context_wrapper_t *wrapper = (ssl_context_wrapper_t *)v[0].instance->data;
+  if (!wrapper->ptr) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "SSL context is not initialized");
+    return;
+  }
+
+  SSLContext_flush_sessions(vm, wrapper->ptr);
+}
+
 
 void
 ssl_socket_init(mrbc_vm *vm, mrbc_class *class_BasicSocket)
@@ -1038,11 +1213,15 @@ ssl_socket_init(mrbc_vm *vm, mrbc_class *class_BasicSocket)
 #endif
   mrbc_define_method(vm, class_SSLSocket, "send", c_ssl_socket_send);
   mrbc_define_method(vm, class_SSLSocket, "read_nonblock", c_ssl_socket_read_nonblock);
+  mrbc_define_method(vm, class_SSLSocket, "__fill_rbuf", c_ssl_socket_fill_rbuf);
   mrbc_define_method(vm, class_SSLSocket, "close", c_ssl_socket_close);
   mrbc_define_method(vm, class_SSLSocket, "closed?", c_ssl_socket_closed_q);
   mrbc_define_method(vm, class_SSLSocket, "ready?", c_ssl_socket_ready_q);
   mrbc_define_method(vm, class_SSLSocket, "remote_host", c_ssl_socket_remote_host);
   mrbc_define_method(vm, class_SSLSocket, "remote_port", c_ssl_socket_remote_port);
+  mrbc_define_method(vm, class_SSLSocket, "session", c_ssl_socket_session);
+  mrbc_define_method(vm, class_SSLSocket, "session=", c_ssl_socket_set_session);
+  mrbc_define_method(vm, class_SSLSocket, "session_reused?", c_ssl_socket_session_reused_q);
 
 
   /* SSLContext */
@@ -1061,6 +1240,7 @@ ssl_socket_init(mrbc_vm *vm, mrbc_class *class_BasicSocket)
   mrbc_define_method(vm, class_SSLContext, "set_key_pem", c_ssl_context_set_key_pem);
   mrbc_define_method(vm, class_SSLContext, "verify_mode=", c_ssl_context_set_verify_mode);
   mrbc_define_method(vm, class_SSLContext, "verify_mode", c_ssl_context_get_verify_mode);
+  mrbc_define_method(vm, class_SSLContext, "flush_sessions", c_ssl_context_flush_sessions);
 
   mrbc_value verify_none = mrbc_integer_value(SSL_VERIFY_NONE);
   mrbc_set_class_const(class_SSLContext, mrbc_str_to_symid("VERIFY_NONE"), &verify_none);
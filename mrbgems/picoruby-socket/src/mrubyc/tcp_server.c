@@ -2,7 +2,7 @@
 #include <string.h>
 #include <stdint.h>
 #include "picoruby.h"
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 #include "c_task_queue.h"
 
 void
@@ -100,7 +100,7 @@ c_tcp_server_new(mrbc_vm *vm, mrbc_value *v, int argc)
     return;
   }
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   void *queue_ptr = NULL;
   if (!picorb_task_queue_attach(vm, &instance, &queue_ptr)) {
     TCPServer_close(vm, wrapper->ptr);
@@ -149,7 +149,7 @@ c_tcp_server_accept_nonblock(mrbc_vm *vm, mrbc_value *v, int argc)
   client_wrapper->ptr = client;
   client_wrapper->vm = vm;
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   if (!picorb_socket_attach_event_queue(vm, &client_obj, client)) {
     mrbc_decref(&client_obj);
     mrbc_raise(vm, MRBC_CLASS(RuntimeError), "failed to allocate event queue");
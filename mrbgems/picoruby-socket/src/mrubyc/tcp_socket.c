@@ -2,7 +2,7 @@
 #include <string.h>
 #include <stdint.h>
 #include "picoruby.h"
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 #include "c_task_queue.h"
 #endif
 
@@ -22,7 +22,7 @@ get_socket_ptr(mrbc_value *v)
 static void
 c_tcp_socket_new(mrbc_vm *vm, mrbc_value *v, int argc)
 {
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   mrbc_value instance = mrbc_instance_new(vm, v->cls, sizeof(socket_wrapper_t));
   /* mrbc_instance_new does not clear instance data. Ruby initialize may
    * raise before __initialize_poll assigns the wrapper fields, so initialize
@@ -98,7 +98,7 @@ c_tcp_socket_new(mrbc_vm *vm, mrbc_value *v, int argc)
 #endif
 }
 
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
 static void
 c_tcp_socket_initialize_poll(mrbc_vm *vm, mrbc_value *v, int argc)
 {
@@ -204,6 +204,131 @@ c_tcp_socket_send(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_INT_RETURN(sent);
 }
 
+/*
+ * socket.__sendv(strings, offset) -> Integer
+ *
+ * Send the strings after skipping their first offset bytes, with one
+ * TCPSocket_sendv and no String for the rest of a partly sent one
+ */
+static void
+c_tcp_socket_sendv(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 2) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  picorb_socket_t *sock = get_socket_ptr(v);
+  if (!sock) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "socket is not initialized");
+    return;
+  }
+
+  mrbc_value ary = GET_ARG(1);
+  if (ary.tt != MRBC_TT_ARRAY || GET_ARG(2).tt != MRBC_TT_INTEGER) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "wrong argument type");
+    return;
+  }
+  mrbc_int_t offset = GET_ARG(2).i;
+
+  picorb_socket_iov_t iov[PICORB_SOCKET_IOV_MAX];
+  int iovcnt = 0;
+  int ary_len = mrbc_array_size(&ary);
+  for (int i = 0; i < ary_len && iovcnt < PICORB_SOCKET_IOV_MAX; i++) {
+    mrbc_value str = mrbc_array_get(&ary, i);
+    if (str.tt != MRBC_TT_STRING) {
+      mrbc_raise(vm, MRBC_CLASS(TypeError), "data must be a String");
+      return;
+    }
+    if (str.string->size <= offset) {
+      offset -= str.string->size;
+      continue;
+    }
+    iov[iovcnt].base = str.string->data + offset;
+    iov[iovcnt].len = str.string->size - offset;
+    iovcnt++;
+    offset = 0;
+  }
+  if (iovcnt == 0) {
+    mrbc_incref(&v[0]);
+    SET_INT_RETURN(0);
+    return;
+  }
+
+  ssize_t sent = TCPSocket_sendv(vm, sock, iov, iovcnt);
+  if (sent < 0) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "send failed");
+    return;
+  }
+
+  mrbc_incref(&v[0]);
+  SET_INT_RETURN(sent);
+}
+
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+/*
+ * socket.__watch_writable(writable) -> true or false
+ *
+ * Let @event_queue also report room in the send buffer
+ */
+static void
+c_tcp_socket_watch_writable(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 1) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  picorb_socket_t *sock = get_socket_ptr(v);
+  bool writable = (GET_ARG(1).tt != MRBC_TT_FALSE && GET_ARG(1).tt != MRBC_TT_NIL);
+  if (sock && TCPSocket_watch_writable(vm, sock, writable)) {
+    SET_TRUE_RETURN();
+  } else {
+    SET_FALSE_RETURN();
+  }
+}
+#endif
+
+/*
+ * socket.__sendfile(fd, offset, count) -> Integer or nil
+ *
+ * nil where files cannot be sent from C
+ */
+static void
+c_tcp_socket_sendfile(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 3) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  picorb_socket_t *sock = get_socket_ptr(v);
+  if (!sock) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "socket is not initialized");
+    return;
+  }
+  if (GET_ARG(1).tt != MRBC_TT_INTEGER || GET_ARG(2).tt != MRBC_TT_INTEGER ||
+      GET_ARG(3).tt != MRBC_TT_INTEGER) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "wrong argument type");
+    return;
+  }
+
+#ifdef PICORB_PLATFORM_POSIX
+  mrbc_int_t count = GET_ARG(3).i;
+  ssize_t sent = TCPSocket_sendfile(vm, sock, (int)GET_ARG(1).i, (off_t)GET_ARG(2).i,
+                                    count < 0 ? SIZE_MAX : (size_t)count);
+  if (sent < 0) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "sendfile failed");
+    return;
+  }
+
+  mrbc_incref(&v[0]);
+  SET_INT_RETURN(sent);
+#else
+  SET_NIL_RETURN();
+#endif
+}
+
 /*
  * socket.readpartial(maxlen) -> String
  * Raises EOFError on EOF.
@@ -233,6 +358,14 @@ c_tcp_socket_readpartial(mrbc_vm *vm, mrbc_value *v, int argc)
     return;
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  mrbc_value buffered;
+  if (mrbc_socket_rbuf_take(vm, &v[0], maxlen, &buffered)) {
+    mrbc_incref(&v[0]);
+    SET_RETURN(buffered);
+    return;
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *buffer = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -297,6 +430,14 @@ c_tcp_socket_read_nonblock(mrbc_vm *vm, mrbc_value *v, int argc)
     return;
   }
 
+  /* Bytes left over by gets/ungetc come first */
+  mrbc_value buffered;
+  if (mrbc_socket_rbuf_take(vm, &v[0], maxlen, &buffered)) {
+    mrbc_incref(&v[0]);
+    SET_RETURN(buffered);
+    return;
+  }
+
   char stack_buf[PICORB_SOCKET_STACK_BUF_SIZE];
   char *buffer = (maxlen < PICORB_SOCKET_STACK_BUF_SIZE)
     ? stack_buf
@@ -309,7 +450,7 @@ c_tcp_socket_read_nonblock(mrbc_vm *vm, mrbc_value *v, int argc)
   ssize_t received = TCPSocket_recv(vm, sock, buffer, maxlen, true);
 
   if (received == PICORB_RECV_WOULD_BLOCK) {
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
     sock->event_pending = false;
 #endif
     if (buffer != stack_buf) picorb_free(vm, buffer);
@@ -335,6 +476,36 @@ c_tcp_socket_read_nonblock(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_RETURN(ret);
 }
 
+static ssize_t
+tcp_socket_recv_func(mrbc_vm *vm, void *conn, void *buf, size_t len, bool nonblock)
+{
+  ssize_t received = TCPSocket_recv(vm, (picorb_socket_t *)conn, buf, len, nonblock);
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  if (received == PICORB_RECV_WOULD_BLOCK) ((picorb_socket_t *)conn)->event_pending = false;
+#endif
+  return received;
+}
+
+/*
+ * socket.__fill_rbuf(nonblock) -> Integer or nil
+ */
+static void
+c_tcp_socket_fill_rbuf(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  if (argc != 1) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+
+  picorb_socket_t *sock = get_socket_ptr(v);
+  if (!sock) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "socket is not initialized");
+    return;
+  }
+
+  mrbc_socket_rbuf_fill(vm, v, tcp_socket_recv_func, sock);
+}
+
 /*
  * socket.close -> nil
  */
@@ -418,6 +589,33 @@ c_tcp_socket_remote_host(mrbc_vm *vm, mrbc_value *v, int argc)
   SET_RETURN(mrbc_string_new_cstr(vm, host));
 }
 
+/*
+ * socket.__peer_address -> String
+ */
+static void
+c_tcp_socket_peer_address(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  picorb_socket_t *sock = get_socket_ptr(v);
+  if (!sock) {
+    SET_NIL_RETURN();
+    return;
+  }
+
+#ifdef PICORB_PLATFORM_POSIX
+  char buf[SOCKET_ADDRESS_LEN];
+  const char *address = TCPSocket_peer_address(vm, sock, buf, sizeof(buf));
+#else
+  const char *address = TCPSocket_remote_host(vm, sock);
+#endif
+  if (!address || address[0] == '\0') {
+    SET_NIL_RETURN();
+    return;
+  }
+
+  mrbc_incref(&v[0]);
+  SET_RETURN(mrbc_string_new_cstr(vm, address));
+}
+
 /*
  * socket.remote_port -> Integer
  */
@@ -481,20 +679,29 @@ tcp_socket_init(mrbc_vm *vm, mrbc_class *class_BasicSocket)
   mrbc_define_destructor(class_TCPSocket, mrbc_socket_free);
 
   mrbc_define_method(vm, class_TCPSocket, "new", c_tcp_socket_new);
-#ifdef PICO_CYW43_ARCH_POLL
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   mrbc_define_method(vm, class_TCPSocket, "__initialize_poll", c_tcp_socket_initialize_poll);
   mrbc_define_method(vm, class_TCPSocket, "__connection_state", c_tcp_socket_connection_state);
   mrbc_define_method(vm, class_TCPSocket, "__error_message", c_tcp_socket_error_message);
+#endif
+#ifdef PICORB_SOCKET_EVENT_QUEUE
   mrbc_define_method(vm, class_TCPSocket, "__readpartial_poll", c_tcp_socket_readpartial);
 #else
   mrbc_define_method(vm, class_TCPSocket, "readpartial", c_tcp_socket_readpartial);
 #endif
   mrbc_define_method(vm, class_TCPSocket, "send", c_tcp_socket_send);
+  mrbc_define_method(vm, class_TCPSocket, "__sendv", c_tcp_socket_sendv);
+#ifdef PICORB_SOCKET_EVENT_QUEUE
+  mrbc_define_method(vm, class_TCPSocket, "__watch_writable", c_tcp_socket_watch_writable);
+#endif
+  mrbc_define_method(vm, class_TCPSocket, "__sendfile", c_tcp_socket_sendfile);
   mrbc_define_method(vm, class_TCPSocket, "read_nonblock", c_tcp_socket_read_nonblock);
+  mrbc_define_method(vm, class_TCPSocket, "__fill_rbuf", c_tcp_socket_fill_rbuf);
   mrbc_define_method(vm, class_TCPSocket, "close", c_tcp_socket_close);
   mrbc_define_method(vm, class_TCPSocket, "closed?", c_tcp_socket_closed_q);
   mrbc_define_method(vm, class_TCPSocket, "ready?", c_tcp_socket_ready_q);
   mrbc_define_method(vm, class_TCPSocket, "remote_host", c_tcp_socket_remote_host);
   mrbc_define_method(vm, class_TCPSocket, "remote_port", c_tcp_socket_remote_port);
+  mrbc_define_method(vm, class_TCPSocket, "__peer_address", c_tcp_socket_peer_address);
 
 }
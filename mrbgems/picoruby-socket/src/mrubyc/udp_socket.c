@@ -296,7 +296,7 @@ c_udp_socket_recvfrom_nonblock(mrbc_vm *vm, mrbc_value *v, int argc)
   /* Create address info array [family, port, host, host] */
   mrbc_value addr_info = mrbc_array_new(vm, 4);
   mrbc_incref(&addr_info);
-  mrbc_value family_val = mrbc_string_new_cstr(vm, "AF_INET");
+  mrbc_value family_val = mrbc_string_new_cstr(vm, strchr(host, ':') ? "AF_INET6" : "AF_INET");
   mrbc_incref(&family_val);
   mrbc_array_set(&addr_info, 0, &family_val);
   mrbc_value port_val = mrbc_integer_value(port);
@@ -0,0 +1,157 @@
+/*
+ * Receive buffer for BasicSocket
+ *
+ * gets/read/ungetc consume bytes from this buffer, and the buffer is
+ * refilled with large recv calls, so a line-oriented reader costs one
+ * recv per buffer fill instead of one VM call per byte.
+ */
+
+#include "picoruby.h"
+#include "../include/socket.h"
+#include <string.h>
+
+void
+picorb_socket_rbuf_free(picorb_state *vm, picorb_socket_rbuf_t *rbuf)
+{
+  if (rbuf->ptr) picorb_free(vm, rbuf->ptr);
+  rbuf->ptr = NULL;
+  rbuf->head = 0;
+  rbuf->tail = 0;
+  rbuf->capa = 0;
+  rbuf->scanned = 0;
+}
+
+size_t
+picorb_socket_rbuf_length(const picorb_socket_rbuf_t *rbuf)
+{
+  return rbuf->tail - rbuf->head;
+}
+
+/*
+ * Make room for at least `len` bytes after tail.
+ * Unread bytes are moved to the front before the buffer is grown.
+ * Returns the write position and stores the free size in *avail.
+ */
+char*
+picorb_socket_rbuf_reserve(picorb_state *vm, picorb_socket_rbuf_t *rbuf,
+                           size_t len, size_t *avail)
+{
+  size_t used = rbuf->tail - rbuf->head;
+
+  if (rbuf->capa - rbuf->tail < len && 0 < rbuf->head) {
+    memmove(rbuf->ptr, rbuf->ptr + rbuf->head, used);
+    rbuf->head = 0;
+    rbuf->tail = used;
+  }
+  if (rbuf->capa - rbuf->tail < len) {
+    size_t capa = rbuf->capa ? rbuf->capa : PICORB_SOCKET_RBUF_SIZE;
+    while (capa - used < len) capa *= 2;
+    char *ptr = (char *)picorb_realloc(vm, rbuf->ptr, capa);
+    if (!ptr) return NULL;
+    rbuf->ptr = ptr;
+    rbuf->capa = capa;
+  }
+  if (avail) *avail = rbuf->capa - rbuf->tail;
+  return rbuf->ptr + rbuf->tail;
+}
+
+/*
+ * Receive as much as fits into the free part of the buffer.
+ * Returns the value of recv() so that callers can tell EOF (0),
+ * PICORB_RECV_WOULD_BLOCK and errors apart.
+ */
+ssize_t
+picorb_socket_rbuf_fill(picorb_state *vm, picorb_socket_rbuf_t *rbuf,
+                        picorb_socket_recv_func recv, void *conn, bool nonblock)
+{
+  size_t avail;
+  char *dst = picorb_socket_rbuf_reserve(vm, rbuf, PICORB_SOCKET_RBUF_SIZE, &avail);
+  if (!dst) return -1;
+
+  ssize_t received = recv(vm, conn, dst, avail, nonblock);
+  if (0 < received) rbuf->tail += (size_t)received;
+  return received;
+}
+
+/*
+ * Length of the next line including `sep`, or 0 if more data is needed.
+ * A line is also complete when it reaches `limit` bytes (0 = no limit).
+ * With `resume`, bytes searched by the previous call are not searched
+ * again, which keeps a long line at O(n) across several fills.
+ */
+size_t
+picorb_socket_rbuf_find_line(picorb_socket_rbuf_t *rbuf, const char *sep,
+                             size_t sep_len, size_t limit, bool resume)
+{
+  const char *top = rbuf->ptr + rbuf->head;
+  size_t len = rbuf->tail - rbuf->head;
+  size_t from = resume ? rbuf->scanned : 0;
+
+  if (0 < sep_len && sep_len <= len) {
+    const char *s = top + from;
+    const char *last = top + len - sep_len;
+    while (s <= last) {
+      s = (const char *)memchr(s, sep[0], (size_t)(last - s) + 1);
+      if (!s) break;
+      if (memcmp(s, sep, sep_len) == 0) {
+        size_t line_len = (size_t)(s - top) + sep_len;
+        rbuf->scanned = 0;
+        return (0 < limit && limit < line_len) ? limit : line_len;
+      }
+      s++;
+    }
+    rbuf->scanned = len - sep_len + 1;
+  }
+  if (0 < limit && limit <= len) {
+    rbuf->scanned = 0;
+    return limit;
+  }
+  return 0;
+}
+
+void
+picorb_socket_rbuf_consume(picorb_socket_rbuf_t *rbuf, size_t len)
+{
+  rbuf->head += len;
+  if (rbuf->tail <= rbuf->head) {
+    rbuf->head = 0;
+    rbuf->tail = 0;
+  }
+  rbuf->scanned = 0;
+}
+
+/* Push `data` back so that it is read before the buffered bytes */
+bool
+picorb_socket_rbuf_unget(picorb_state *vm, picorb_socket_rbuf_t *rbuf,
+                         const void *data, size_t len)
+{
+  if (len == 0) return true;
+  if (rbuf->head < len) {
+    size_t used = rbuf->tail - rbuf->head;
+    if (rbuf->capa < used + len) {
+      size_t capa = rbuf->capa ? rbuf->capa : PICORB_SOCKET_RBUF_SIZE;
+      while (capa < used + len) capa *= 2;
+      char *ptr = (char *)picorb_realloc(vm, rbuf->ptr, capa);
+      if (!ptr) return false;
+      rbuf->ptr = ptr;
+      rbuf->capa = capa;
+    }
+    memmove(rbuf->ptr + len, rbuf->ptr + rbuf->head, used);
+    rbuf->head = len;
+    rbuf->tail = len + used;
+  }
+  rbuf->head -= len;
+  memcpy(rbuf->ptr + rbuf->head, data, len);
+  rbuf->scanned = 0;
+  return true;
+}
+
+#if defined(PICORB_VM_MRUBY)
+
+#include "mruby/read_buffer.c"
+
+#elif defined(PICORB_VM_MRUBYC)
+
+#include "mrubyc/read_buffer.c"
+
+#endif
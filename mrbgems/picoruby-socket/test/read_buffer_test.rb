@@ -0,0 +1,89 @@
+require 'socket'
+
+class ReadBufferTest < Picotest::Test
+  def connect_pair(port)
+    server = TCPServer.new("127.0.0.1", port)
+    socket = TCPSocket.new("127.0.0.1", port)
+    peer = server.accept
+    [server, socket, peer]
+  end
+
+  def test_unget_is_read_before_buffered_bytes
+    rbuf = SocketReadBuffer.new
+    rbuf.unget("world")
+    rbuf.unget("hello ")
+    assert_equal(11, rbuf.size)
+    assert_equal("hello", rbuf.read(5))
+    rbuf.unget("HELLO")
+    assert_equal("HELLO world", rbuf.read)
+    assert_equal(0, rbuf.size)
+  end
+
+  def test_gets_returns_nil_until_separator_is_buffered
+    rbuf = SocketReadBuffer.new
+    rbuf.unget("abc")
+    assert_nil(rbuf.gets("\r\n", nil, false))
+    assert_equal("ab", rbuf.gets("\r\n", 2, false))
+    assert_equal("c", rbuf.read)
+  end
+
+  def test_socket_gets_with_separator_limit_and_chomp
+    server, socket, peer = connect_pair(18100)
+    peer.write("one,two,three\r\nfour\nfive")
+    assert_equal("one,", socket.gets(","))
+    assert_equal("tw", socket.gets(2))
+    assert_equal("o,three", socket.gets("\r\n", chomp: true))
+    assert_equal("four", socket.gets(chomp: true))
+    peer.close
+    assert_equal("five", socket.gets(chomp: true))
+    assert_nil(socket.gets)
+    socket.close
+    server.close
+  end
+
+  def test_socket_ungetc_then_gets
+    server, socket, peer = connect_pair(18101)
+    peer.write("bc\n")
+    assert_equal("b", socket.read(1))
+    socket.ungetc("a")
+    socket.ungetc("b")
+    assert_equal("bac\n", socket.gets)
+    peer.close
+    socket.close
+    server.close
+  end
+
+  def test_socket_read_across_buffer_refills
+    server, socket, peer = connect_pair(18102)
+    size = BasicSocket::READ_BUFFER_SIZE * 3 + 17
+    data = ""
+    i = 0
+    while i < size
+      data << (97 + i % 26).chr
+      i += 1
+    end
+    peer.write(data)
+    assert_equal(data.byteslice(0, 10), socket.read(10))
+    assert_equal(data.byteslice(10, size - 20), socket.read(size - 20))
+    peer.close
+    assert_equal(data.byteslice(size - 10, 10), socket.read)
+    socket.close
+    server.close
+  end
+
+  def test_socket_eof
+    server, socket, peer = connect_pair(18103)
+    peer.write("last")
+    peer.close
+    assert_equal("la", socket.read(2))
+    assert_equal("st", socket.read(10))
+    assert_nil(socket.read(1))
+    assert_equal("", socket.read)
+    assert_nil(socket.gets)
+    assert_raise(EOFError) do
+      socket.readline
+    end
+    socket.close
+    server.close
+  end
+end
@@ -32,6 +32,100 @@ class SSLSocketTest < Picotest::Test
     assert_true(methods.include?(:ssl_context))
   end
 
+  def test_ssl_session_methods_exist
+    assert_true(SSLContext.instance_methods.include?(:flush_sessions))
+    methods = SSLSocket.instance_methods
+    assert_true(methods.include?(:session))
+    assert_true(methods.include?(:session=))
+    assert_true(methods.include?(:session_reused?))
+  end
+
+  def test_ssl_context_flush_sessions_without_session
+    ctx = SSLContext.new
+    assert_equal(ctx, ctx.flush_sessions)
+  end
+
+  # A TLS 1.2 session in DER as OpenSSL serializes it, with just the
+  # required fields: version, protocol, cipher, session ID, master key
+  SESSION_ID = "\x11" * 32
+  SESSION_DER = "\x30\x5f\x02\x01\x01\x02\x02\x03\x03\x04\x02\xc0\x30\x04\x20" +
+                SESSION_ID + "\x04\x30" + "\x22" * 48
+
+  # An SSLSocket over a local TCP connection, not connected yet.
+  # This suite listens on 18120-18129; picoruby-net-http's on 18110-18119.
+  def unconnected_ssl_socket(port)
+    server = TCPServer.new("127.0.0.1", port)
+    tcp = TCPSocket.new("127.0.0.1", port)
+    peer = server.accept
+    [server, tcp, peer, SSLSocket.new(tcp, SSLContext.new)]
+  end
+
+  def close_all(sockets)
+    sockets.reverse.each { |s| s.close }
+  end
+
+  def test_session_is_nil_before_connect
+    sockets = unconnected_ssl_socket(18120)
+    assert_nil(sockets.last.session)
+    close_all(sockets)
+  end
+
+  def test_session_setter_rejects_garbage
+    sockets = unconnected_ssl_socket(18121)
+    assert_raise(ArgumentError) do
+      sockets.last.session = "not a session"
+    end
+    assert_nil(sockets.last.session)
+    close_all(sockets)
+  end
+
+  # OpenSSL re-encodes a parsed session with its creation time added, so
+  # the bytes match from the second round on
+  def test_session_round_trips_through_the_setter
+    sockets = unconnected_ssl_socket(18122)
+    ssl = sockets.last
+    ssl.session = SESSION_DER
+    session = ssl.session
+    assert_not_nil(session)
+    assert_true(session.include?(SESSION_ID))
+
+    others = unconnected_ssl_socket(18123)
+    others.last.session = session
+    assert_equal(session, others.last.session)
+    close_all(others)
+    close_all(sockets)
+  end
+
+  # Set SSL_TEST_HOST to a TLS server on port 443 that resumes sessions
+  def test_session_of_a_connection
+    host = ENV["SSL_TEST_HOST"]
+    skip "SSL_TEST_HOST is not set" unless host
+    ctx = SSLContext.new
+    ctx.verify_mode = SSLContext::VERIFY_NONE
+    tcp = TCPSocket.new(host, 443)
+    ssl = SSLSocket.new(tcp, ctx)
+    ssl.connect
+    # TLS 1.3 tickets come after the handshake
+    ssl.write("HEAD / HTTP/1.1\r\nHost: #{host}\r\n\r\n")
+    ssl.readpartial(16)
+    session = ssl.session
+    assert_not_nil(session)
+    assert_raise(ArgumentError) do
+      ssl.session = session
+    end
+    ssl.close
+    tcp.close
+
+    ctx.flush_sessions
+    tcp = TCPSocket.new(host, 443)
+    ssl = SSLSocket.new(tcp, ctx)
+    ssl.session = session
+    ssl.connect
+    assert_true(ssl.session_reused?)
+    ssl.close
+    tcp.close
+  end
+
   def test_ssl_socket_inherits_from_basic_socket
     # SSLSocket should inherit from BasicSocket
     assert_true(SSLSocket.ancestors.include?(BasicSocket))
@@ -56,4 +56,36 @@ class TCPServerTest < Picotest::Test
     assert_true server.respond_to?(:accept_loop)
     server.close
   end
+
+  # Test 8: accept returns nil without a pending client
+  def test_tcp_server_accept_nonblock_without_client
+    server = TCPServer.new(nil, 18087)
+    assert_nil server.accept_nonblock
+    server.close
+  end
+
+  # Test 9: a connection wakes a task blocked in accept on the event queue
+  def test_tcp_server_accept_wakes_blocked_task
+    skip "no socket event queue" unless BasicSocket::EVENT_QUEUE
+    skip "FemtoRuby cannot spawn a task from a block" if femtoruby?
+    server = TCPServer.new("127.0.0.1", 18088)
+    client = nil
+    Task.new do
+      client = server.accept
+    end
+    # Let the task reach accept and block there
+    sleep_ms 20
+    assert_nil client
+    socket = TCPSocket.new("127.0.0.1", 18088)
+    i = 0
+    while i < 50
+      break unless client.nil?
+      sleep_ms 2
+      i += 1
+    end
+    assert_true client.is_a?(TCPSocket)
+    client&.close
+    socket.close
+    server.close
+  end
 end
@@ -8,6 +8,9 @@ class TCPSocketTest < Picotest::Test
     assert_true(methods.include?(:addr))
     assert_true(methods.include?(:puts))
     assert_true(methods.include?(:gets))
+    assert_true(methods.include?(:readline))
+    assert_true(methods.include?(:each_line))
+    assert_true(methods.include?(:ungetc))
     assert_true(methods.include?(:print))
     assert_true(methods.include?(:send))
     assert_true(methods.include?(:read))
@@ -20,6 +23,86 @@ class TCPSocketTest < Picotest::Test
     assert_true(SocketError.ancestors.include?(StandardError))
   end
 
+  def test_tcp_socket_connects_to_local_server
+    server = TCPServer.new("127.0.0.1", 18090)
+    socket = TCPSocket.new("127.0.0.1", 18090)
+    assert_equal("127.0.0.1", socket.remote_host)
+    assert_equal(18090, socket.remote_port)
+    socket.close
+    server.close
+  end
+
+  def test_tcp_socket_peeraddr_reports_ipv4_family
+    server = TCPServer.new("127.0.0.1", 18092)
+    socket = TCPSocket.new("127.0.0.1", 18092)
+    assert_equal(["AF_INET", 18092, "127.0.0.1", "127.0.0.1"], socket.peeraddr)
+    socket.close
+    server.close
+  end
+
+  def test_tcp_socket_connects_over_ipv6_loopback
+    server = TCPServer.new("::1", 18095)
+    begin
+      socket = TCPSocket.new("::1", 18095)
+    rescue SocketError
+      server.close
+      skip "IPv6 is unavailable"
+    end
+    peer = server.accept
+    assert_equal(["AF_INET6", 18095, "::1", "::1"], socket.peeraddr)
+    assert_equal("::1", peer.remote_host)
+    socket.write("ping")
+    assert_equal("ping", peer.read(4))
+    peer.write("pong")
+    assert_equal("pong", socket.read(4))
+    peer.close
+    socket.close
+    server.close
+  end
+
+  def test_tcp_socket_write_sends_all_strings
+    server = TCPServer.new("127.0.0.1", 18093)
+    socket = TCPSocket.new("127.0.0.1", 18093)
+    peer = server.accept
+    assert_equal(11, socket.write("hello", " ", "world"))
+    assert_equal("hello world", peer.read(11))
+    peer.close
+    socket.close
+    server.close
+  end
+
+  def test_tcp_socket_readpartial_wakes_blocked_task
+    skip "no socket event queue" unless BasicSocket::EVENT_QUEUE
+    skip "FemtoRuby cannot spawn a task from a block" if femtoruby?
+    server = TCPServer.new("127.0.0.1", 18094)
+    socket = TCPSocket.new("127.0.0.1", 18094)
+    peer = server.accept
+    received = nil
+    Task.new do
+      received = socket.readpartial(16)
+    end
+    # Let the task reach readpartial and block on the event queue
+    sleep_ms 20
+    assert_nil(received)
+    peer.write("wake")
+    i = 0
+    while i < 50
+      break unless received.nil?
+      sleep_ms 2
+      i += 1
+    end
+    assert_equal("wake", received)
+    peer.close
+    socket.close
+    server.close
+  end
+
+  def test_tcp_socket_refused_connection_raises
+    assert_raise(SocketError) do
+      TCPSocket.new("127.0.0.1", 18091)
+    end
+  end
+
   # DNS-dependent tests (invalid host) are not run here because they
   # require network access.  The C layer is tested on microcontroller
   # builds where hardfault prevention matters most.
@@ -11,6 +11,10 @@
 
 #include "../lib/sqlite-amalgamation-3530300/sqlite3.h"
 
+#if defined(PICORB_SQLITE3_LITTLEFS)
+  #include "../../picoruby-littlefs/include/littlefs.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -22,6 +26,9 @@ extern "C" {
  * it is plain C memory that the GC does not scan. The File object it holds is
  * therefore kept alive explicitly with mrb_gc_register() between
  * prb_file_new() and prb_file_close().
+ *
+ * A file opened on the native littlefs path uses lfs_file instead and holds no
+ * Ruby object at all.
  */
 typedef struct PRBFile
 {
@@ -29,6 +36,12 @@ typedef struct PRBFile
 #if defined(PICORB_VM_MRUBY)
   mrb_state *mrb;
   mrb_value file;
+#endif
+#if defined(PICORB_SQLITE3_LITTLEFS)
+  lfs_file_t lfs_file;
+  const char *name;             /* SQLite keeps it valid until xClose */
+  bool writable;
+  bool delete_on_close;
 #endif
   int sector_size;
 } PRBFile;
@@ -37,7 +50,7 @@ typedef struct PRBFile
  * Bridge from SQLite's OS layer to the VFS driver object that picoruby-vfs
  * mounted (a Littlefs instance, a FAT instance, ...). The driver is reached by
  * calling its Ruby methods, so any filesystem implementing the picoruby-vfs
- * driver protocol works and no filesystem specific header is needed here.
+ * driver protocol works. Littlefs has a native path as well; see below.
  *
  * Implemented per VM under src/<vm>/sqlite3_prb_methods.c. None of these lets
  * a Ruby exception escape: SQLite's C frames sit between the VM and us, and
@@ -78,6 +91,25 @@ sqlite3_int64 prb_file_size(PRBFile *prbfile);
 int prb_file_unlink(const char *zName);
 bool prb_file_exist_q(const char *zName);
 
+#if defined(PICORB_SQLITE3_LITTLEFS)
+/*
+ * Native path for a Littlefs driver. SQLite's file I/O goes straight to the
+ * littlefs C API instead of through the driver's Ruby methods, so a page read
+ * or write neither allocates a String nor enters the VM. The bridge attaches
+ * it when the driver set by prb_vfs_set_driver() is a plain Littlefs instance;
+ * any other driver keeps the Ruby path above.
+ *
+ * Implemented in src/sqlite3_lfs_methods.c.
+ */
+bool prb_lfs_attach(const char *prefix, size_t len);
+void prb_lfs_detach(void);
+bool prb_lfs_attached_p(void);
+
+int prb_lfs_file_open(PRBFile *prbfile, const char *zName, int flags);
+int prb_lfs_file_unlink(const char *zName);
+bool prb_lfs_file_exist_q(const char *zName);
+#endif
+
 /* sqlite3_mem_methods backed by the PicoRuby heap */
 void *prb_mem_alloc(int nByte);
 void prb_mem_free(void *pPrior);
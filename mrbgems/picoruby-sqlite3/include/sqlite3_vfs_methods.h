@@ -30,6 +30,15 @@ int prbIOFileControl(sqlite3_file *pFile, int op, void *pArg);
 int prbIOSectorSize(sqlite3_file *pFile);
 int prbIODeviceCharacteristics(sqlite3_file *pFile);
 
+#if defined(PICORB_SQLITE3_LITTLEFS)
+int prbLfsIOClose(sqlite3_file *pFile);
+int prbLfsIORead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst);
+int prbLfsIOWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64 iOfst);
+int prbLfsIOTruncate(sqlite3_file *pFile, sqlite3_int64 size);
+int prbLfsIOSync(sqlite3_file *pFile, int flags);
+int prbLfsIOFileSize(sqlite3_file *pFile, sqlite3_int64 *pSize);
+#endif
+
 extern sqlite3_vfs prb_vfs;
 
 #ifdef __cplusplus
@@ -48,8 +48,21 @@ class SQLite3
 
     attr_accessor :results_as_hash
 
+    # Statements #execute keeps prepared, by SQL text
+    STATEMENT_CACHE_SIZE = 8
+
+    def statement_cache_size
+      @statement_cache_size || STATEMENT_CACHE_SIZE
+    end
+
+    # 0 turns the cache off
+    def statement_cache_size=(size)
+      @statement_cache_size = size
+      trim_statement_cache
+    end
+
     def execute(sql, bind_vars = [])
-      prepare(sql) do |stmt|
+      with_cached_statement(sql) do |stmt|
         stmt.bind_params(*bind_vars)
         resultset = SQLite3::ResultSet.new(self, stmt)
         if block_given?
@@ -64,6 +77,64 @@ class SQLite3
       end
     end
 
+    # Like #execute, but returns the result by column: an Array per column,
+    # or a Hash of them by column name if results_as_hash is set.
+    def execute_columns(sql, bind_vars = [])
+      with_cached_statement(sql) do |stmt|
+        stmt.bind_params(*bind_vars)
+        columns = stmt.fetch_columns
+        if results_as_hash
+          result = {} #: Hash[String, Array[untyped]]
+          names = stmt.columns
+          ci = 0
+          while ci < names.size
+            result[names[ci]] = columns[ci]
+            ci += 1
+          end
+          result
+        else
+          columns
+        end
+      end
+    end
+
+    # Runs sql once per element of rows, binding it as #execute binds
+    # bind_vars (a single value is bound to the first parameter). Binding
+    # and stepping happen in C, inside one transaction unless one is
+    # already open. Returns the number of rows run.
+    #
+    #   db.insert_many("INSERT INTO log (t, v) VALUES (?, ?)", samples)
+    def insert_many(sql, rows)
+      with_cached_statement(sql) do |stmt|
+        if transaction_active?
+          stmt.execute_many(rows)
+        else
+          count = 0
+          transaction { count = stmt.execute_many(rows) }
+          count
+        end
+      end
+    end
+
+    # Finalizes every statement #execute has kept prepared
+    def clear_statement_cache
+      cache = @statement_cache
+      return unless cache
+      cache.each_value { |stmt| stmt.close }
+      cache.clear
+      nil
+    end
+
+    alias __close_without_statement_cache close
+    def close
+      clear_statement_cache
+      __close_without_statement_cache
+    ensure
+      # SQLite creates and removes journals without telling VFS, so
+      # forget the paths VFS.exist? found missing
+      VFS.clear_cache if defined?(VFS)
+    end
+
     def prepare(sql)
       stmt = SQLite3::Statement.new(self, sql)
       return stmt unless block_given?
@@ -186,5 +257,38 @@ class SQLite3
         end
       end
     end
+
+    private
+
+    # Yields a prepared statement for sql, taken out of the cache for the
+    # duration so that a nested #execute of the same SQL prepares its own,
+    # and put back as the most recently used one afterwards.
+    def with_cached_statement(sql)
+      cache = (@statement_cache ||= {})
+      stmt = cache.delete(sql)
+      stmt = prepare(sql) if stmt.nil? || stmt.closed?
+      begin
+        yield stmt
+      ensure
+        if statement_cache_size <= 0 || closed? || cache[sql]
+          stmt.close
+        else
+          stmt.recycle
+          cache[sql] = stmt
+          trim_statement_cache
+        end
+      end
+    end
+
+    def trim_statement_cache
+      cache = @statement_cache
+      return unless cache
+      limit = statement_cache_size
+      limit = 0 if limit < 0
+      while limit < cache.size
+        _sql, stmt = cache.shift
+        stmt&.close
+      end
+    end
   end
 end
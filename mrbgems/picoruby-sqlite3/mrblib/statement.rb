@@ -28,6 +28,17 @@ class SQLite3
       @results
     end
 
+    # Readies the statement to run again with fresh bindings. Used by the
+    # statement cache of Database#execute.
+    def recycle
+      reset!
+      clear_bindings!
+      # The schema may change before the next run
+      @columns = nil
+      @types = nil
+      self
+    end
+
     def active?
       !done?
     end
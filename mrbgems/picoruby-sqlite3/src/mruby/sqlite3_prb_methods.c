@@ -1,4 +1,6 @@
 #include <string.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include <mruby/class.h>
 #include <mruby/error.h>
@@ -32,6 +34,8 @@ prb_vfs_driver_set_p(void)
   return vfs_mrb != NULL;
 }
 
+static void prb_vfs_attach_native(mrb_state *mrb, mrb_value driver);
+
 void
 prb_vfs_set_driver(mrb_state *mrb, mrb_value driver)
 {
@@ -42,12 +46,16 @@ prb_vfs_set_driver(mrb_state *mrb, mrb_value driver)
   vfs_mrb = mrb;
   vfs_driver = driver;
   mrb_gc_register(mrb, driver);
+  prb_vfs_attach_native(mrb, driver);
 }
 
 void
 prb_vfs_forget_driver(mrb_state *mrb)
 {
   if (vfs_mrb == NULL) return;
+#if defined(PICORB_SQLITE3_LITTLEFS)
+  prb_lfs_detach();
+#endif
   mrb_gc_unregister(vfs_mrb, vfs_driver);
   vfs_driver = mrb_nil_value();
   vfs_mrb = NULL;
@@ -98,25 +106,43 @@ prb_call_int(mrb_value recv, mrb_sym mid, mrb_int argc, const mrb_value *argv)
   return mrb_integer_p(ret) ? mrb_integer(ret) : -1;
 }
 
-int64_t
-prb_time_gettime_us(void)
+/*
+ * A Littlefs driver is served by the native path in sqlite3_lfs_methods.c.
+ * Only a plain Littlefs qualifies: a subclass may override open_file and
+ * friends, and then its Ruby methods have to be called.
+ */
+static void
+prb_vfs_attach_native(mrb_state *mrb, mrb_value driver)
 {
-  mrb_state *mrb = vfs_mrb;
-  if (mrb == NULL) return 0;
+#if defined(PICORB_SQLITE3_LITTLEFS)
+  prb_lfs_detach();
+  if (!mrb_class_defined_id(mrb, MRB_SYM(Littlefs))) return;
+  if (mrb_obj_class(mrb, driver) != mrb_class_get_id(mrb, MRB_SYM(Littlefs))) return;
 
   int ai = mrb_gc_arena_save(mrb);
-  int64_t usec = 0;
-  mrb_value time_class = mrb_obj_value(mrb_class_get_id(mrb, MRB_SYM(Time)));
-  mrb_value now = prb_call(time_class, MRB_SYM(now), 0, NULL);
-  if (!mrb_undef_p(now)) {
-    mrb_value sec = prb_call(now, MRB_SYM(to_i), 0, NULL);
-    mrb_value frac = prb_call(now, MRB_SYM(usec), 0, NULL);
-    if (mrb_integer_p(sec) && mrb_integer_p(frac)) {
-      usec = (int64_t)mrb_integer(sec) * 1000000 + (int64_t)mrb_integer(frac);
-    }
+  mrb_value prefix = prb_call(driver, MRB_SYM(prefix), 0, NULL);
+  if (mrb_string_p(prefix)) {
+    prb_lfs_attach(RSTRING_PTR(prefix), (size_t)RSTRING_LEN(prefix));
   }
   mrb_gc_arena_restore(mrb, ai);
-  return usec;
+#else
+  (void)mrb; (void)driver;
+#endif
+}
+
+/* Same clock as Time.now, read without going through the VM */
+int64_t
+prb_time_gettime_us(void)
+{
+#if defined(NO_CLOCK_GETTIME)
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
 }
 
 static int
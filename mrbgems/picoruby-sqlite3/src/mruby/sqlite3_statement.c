@@ -1,6 +1,7 @@
 #include <mruby/array.h>
 #include <mruby/class.h>
 #include <mruby/data.h>
+#include <mruby/hash.h>
 #include <mruby/presym.h>
 #include <mruby/string.h>
 #include <mruby/variable.h>
@@ -105,62 +106,98 @@ mrb_Statement_closed_p(mrb_state *mrb, mrb_value self)
   return mrb_bool_value(statement(mrb, self)->st == NULL);
 }
 
-static mrb_value
-mrb_step(mrb_state *mrb, mrb_value self)
+/* Steps once, raising on an error. Returns false when the statement is done */
+static bool
+step_row(mrb_state *mrb, DbStatement *cxt)
 {
-  DbStatement *cxt = open_statement(mrb, self);
-  if (cxt->done_p) return mrb_nil_value();
-
   int rc = sqlite3_step(cxt->st);
   if (rc == SQLITE_DONE) {
     cxt->done_p = true;
-    return mrb_nil_value();
+    return false;
   }
   if (rc != SQLITE_ROW) {
     sqlite3_reset(cxt->st);
     cxt->done_p = false;
     prb_sqlite3_raise(mrb, sqlite3_db_handle(cxt->st), rc);
-    return mrb_nil_value();
   }
+  return true;
+}
+
+static mrb_value
+column_value(mrb_state *mrb, sqlite3_stmt *st, int i)
+{
+  switch (sqlite3_column_type(st, i)) {
+    case SQLITE_INTEGER:
+      return mrb_int_value(mrb, (mrb_int)sqlite3_column_int64(st, i));
+    case SQLITE_FLOAT:
+      return mrb_float_value(mrb, sqlite3_column_double(st, i));
+    case SQLITE_TEXT:
+      return mrb_str_new(
+        mrb,
+        (const char *)sqlite3_column_text(st, i),
+        sqlite3_column_bytes(st, i)
+      );
+    case SQLITE_BLOB:
+      return mrb_str_new(
+        mrb,
+        (const char *)sqlite3_column_blob(st, i),
+        sqlite3_column_bytes(st, i)
+      );
+    default:
+      return mrb_nil_value();
+  }
+}
+
+static mrb_value
+mrb_step(mrb_state *mrb, mrb_value self)
+{
+  DbStatement *cxt = open_statement(mrb, self);
+  if (cxt->done_p) return mrb_nil_value();
+  if (!step_row(mrb, cxt)) return mrb_nil_value();
 
   int length = sqlite3_column_count(cxt->st);
   mrb_value row = mrb_ary_new_capa(mrb, length);
   int ai = mrb_gc_arena_save(mrb);
   int i = 0;
   while (i < length) {
-    mrb_value value;
-    switch (sqlite3_column_type(cxt->st, i)) {
-      case SQLITE_INTEGER:
-        value = mrb_int_value(mrb, (mrb_int)sqlite3_column_int64(cxt->st, i));
-        break;
-      case SQLITE_FLOAT:
-        value = mrb_float_value(mrb, sqlite3_column_double(cxt->st, i));
-        break;
-      case SQLITE_TEXT:
-        value = mrb_str_new(
-          mrb,
-          (const char *)sqlite3_column_text(cxt->st, i),
-          sqlite3_column_bytes(cxt->st, i)
-        );
-        break;
-      case SQLITE_BLOB:
-        value = mrb_str_new(
-          mrb,
-          (const char *)sqlite3_column_blob(cxt->st, i),
-          sqlite3_column_bytes(cxt->st, i)
-        );
-        break;
-      default:
-        value = mrb_nil_value();
-        break;
-    }
-    mrb_ary_push(mrb, row, value);
+    mrb_ary_push(mrb, row, column_value(mrb, cxt->st, i));
     mrb_gc_arena_restore(mrb, ai);
     i++;
   }
   return row;
 }
 
+/*
+ * fetch_columns -> Array
+ *
+ * Steps through the remaining rows and returns one Array per column instead
+ * of one per row, which saves an allocation per row on long results.
+ */
+static mrb_value
+mrb_fetch_columns(mrb_state *mrb, mrb_value self)
+{
+  DbStatement *cxt = open_statement(mrb, self);
+  int length = sqlite3_column_count(cxt->st);
+  mrb_value columns = mrb_ary_new_capa(mrb, length);
+  int i = 0;
+  while (i < length) {
+    mrb_ary_push(mrb, columns, mrb_ary_new(mrb));
+    i++;
+  }
+  if (cxt->done_p) return columns;
+
+  int ai = mrb_gc_arena_save(mrb);
+  while (step_row(mrb, cxt)) {
+    i = 0;
+    while (i < length) {
+      mrb_ary_push(mrb, RARRAY_PTR(columns)[i], column_value(mrb, cxt->st, i));
+      mrb_gc_arena_restore(mrb, ai);
+      i++;
+    }
+  }
+  return columns;
+}
+
 static mrb_value
 mrb_reset_bang(mrb_state *mrb, mrb_value self)
 {
@@ -203,14 +240,9 @@ mrb_column_count(mrb_state *mrb, mrb_value self)
  * `key` is either a 1-based parameter index or the parameter's name; a Symbol
  * or String name is looked up the way the sqlite3 gem does.
  */
-static mrb_value
-mrb_bind_param(mrb_state *mrb, mrb_value self)
+static void
+bind_value(mrb_state *mrb, DbStatement *cxt, mrb_value key, mrb_value value)
 {
-  mrb_value key;
-  mrb_value value;
-  mrb_get_args(mrb, "oo", &key, &value);
-  DbStatement *cxt = open_statement(mrb, self);
-
   int index;
   if (mrb_integer_p(key)) {
     index = (int)mrb_integer(key);
@@ -258,9 +290,93 @@ mrb_bind_param(mrb_state *mrb, mrb_value self)
       break;
     default:
       mrb_raise(mrb, E_TYPE_ERROR, "cannot bind this type to a statement");
-      return self;
+      return;
   }
   prb_sqlite3_raise(mrb, sqlite3_db_handle(cxt->st), status);
+}
+
+static mrb_value
+mrb_bind_param(mrb_state *mrb, mrb_value self)
+{
+  mrb_value key;
+  mrb_value value;
+  mrb_get_args(mrb, "oo", &key, &value);
+  bind_value(mrb, open_statement(mrb, self), key, value);
+  return self;
+}
+
+static void
+bind_hash(mrb_state *mrb, DbStatement *cxt, mrb_value hash)
+{
+  mrb_value keys = mrb_hash_keys(mrb, hash);
+  mrb_int i = 0;
+  while (i < RARRAY_LEN(keys)) {
+    mrb_value key = RARRAY_PTR(keys)[i];
+    bind_value(mrb, cxt, key, mrb_hash_get(mrb, hash, key));
+    i++;
+  }
+}
+
+/* Binds one row the way Statement#bind_params binds its arguments */
+static void
+bind_row(mrb_state *mrb, DbStatement *cxt, mrb_value row)
+{
+  if (mrb_hash_p(row)) {
+    bind_hash(mrb, cxt, row);
+    return;
+  }
+  if (!mrb_array_p(row)) {
+    bind_value(mrb, cxt, mrb_fixnum_value(1), row);
+    return;
+  }
+  mrb_int index = 1;
+  mrb_int i = 0;
+  while (i < RARRAY_LEN(row)) {
+    mrb_value var = RARRAY_PTR(row)[i];
+    if (mrb_hash_p(var)) {
+      bind_hash(mrb, cxt, var);
+    } else {
+      bind_value(mrb, cxt, mrb_fixnum_value(index), var);
+      index++;
+    }
+    i++;
+  }
+}
+
+/*
+ * execute_many(rows) -> Integer
+ *
+ * Binds each row in turn (an Array of values, a Hash of named values, or a
+ * single value) and steps the statement to completion, all without leaving
+ * C. Any rows the statement returns are discarded. Returns the number of
+ * rows of `rows` that were run. Does not open a transaction; see
+ * Database#insert_many.
+ */
+static mrb_value
+mrb_execute_many(mrb_state *mrb, mrb_value self)
+{
+  mrb_value rows;
+  mrb_get_args(mrb, "A", &rows);
+  DbStatement *cxt = open_statement(mrb, self);
+
+  int ai = mrb_gc_arena_save(mrb);
+  mrb_int n = 0;
+  while (n < RARRAY_LEN(rows)) {
+    sqlite3_reset(cxt->st);
+    sqlite3_clear_bindings(cxt->st);
+    cxt->done_p = false;
+    bind_row(mrb, cxt, RARRAY_PTR(rows)[n]);
+    while (step_row(mrb, cxt));
+    mrb_gc_arena_restore(mrb, ai);
+    n++;
+  }
+  return mrb_int_value(mrb, n);
+}
+
+static mrb_value
+mrb_clear_bindings_bang(mrb_state *mrb, mrb_value self)
+{
+  sqlite3_clear_bindings(open_statement(mrb, self)->st);
   return self;
 }
 
@@ -298,6 +414,9 @@ mrb_init_class_SQLite3_Statement(mrb_state *mrb, struct RClass *class_SQLite3)
   mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM_Q(readonly), mrb_Statement_readonly_p, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM(column_count), mrb_column_count, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM(bind_param), mrb_bind_param, MRB_ARGS_REQ(2));
+  mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM_B(clear_bindings), mrb_clear_bindings_bang, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM(execute_many), mrb_execute_many, MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM(fetch_columns), mrb_fetch_columns, MRB_ARGS_NONE());
   mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM(column_name), mrb_column_name, MRB_ARGS_REQ(1));
   mrb_define_method_id(mrb, class_SQLite3_Statement, MRB_SYM(column_decltype), mrb_column_decltype, MRB_ARGS_REQ(1));
 }
@@ -0,0 +1,202 @@
+#include "../include/sqlite3_vfs_methods.h"
+
+#if defined(PICORB_SQLITE3_LITTLEFS)
+
+#include <string.h>
+
+/*
+ * Native storage for a Littlefs driver. Everything here is VM independent and
+ * never enters the VM, so it keeps working while the bridge is suspended for
+ * a GC free function.
+ *
+ * Paths are joined with the driver's prefix exactly as Littlefs#open_file
+ * does, so a database opened here and one opened through the Ruby bridge see
+ * the same files.
+ */
+
+#define PRB_LFS_PREFIX_MAX 64
+
+static bool lfs_attached = false;
+static char lfs_prefix[PRB_LFS_PREFIX_MAX];
+static size_t lfs_prefix_len = 0;
+
+bool
+prb_lfs_attach(const char *prefix, size_t len)
+{
+  if (sizeof(lfs_prefix) <= len) {
+    lfs_attached = false;
+    return false;
+  }
+  memcpy(lfs_prefix, prefix, len);
+  lfs_prefix[len] = '\0';
+  lfs_prefix_len = len;
+  lfs_attached = true;
+  return true;
+}
+
+void
+prb_lfs_detach(void)
+{
+  lfs_attached = false;
+}
+
+bool
+prb_lfs_attached_p(void)
+{
+  return lfs_attached;
+}
+
+/* zName on the volume, or NULL if it does not fit in buf */
+static const char *
+prb_lfs_path(const char *zName, char *buf, size_t size)
+{
+  if (lfs_prefix_len == 0) return zName;
+  size_t len = strlen(zName);
+  if (size <= lfs_prefix_len + len) return NULL;
+  memcpy(buf, lfs_prefix, lfs_prefix_len);
+  memcpy(buf + lfs_prefix_len, zName, len + 1);
+  return buf;
+}
+
+int
+prb_lfs_file_open(PRBFile *prbfile, const char *zName, int flags)
+{
+  /* An anonymous temporary file has no name to open; see prb_file_new() */
+  if (zName == NULL) return -1;
+  if (littlefs_ensure_mounted() != LFS_ERR_OK) return -1;
+
+  char buf[PATHNAME_MAX_LEN + 1];
+  const char *path = prb_lfs_path(zName, buf, sizeof(buf));
+  if (path == NULL) return -1;
+
+  int lfs_flags;
+  if (flags & SQLITE_OPEN_READONLY) {
+    lfs_flags = LFS_O_RDONLY;
+  } else {
+    lfs_flags = LFS_O_RDWR;
+    if (flags & SQLITE_OPEN_CREATE) lfs_flags |= LFS_O_CREAT;
+    if (flags & SQLITE_OPEN_EXCLUSIVE) lfs_flags |= LFS_O_EXCL;
+  }
+  if (lfs_file_open(littlefs_get_lfs(), &prbfile->lfs_file, path, lfs_flags) != LFS_ERR_OK) {
+    return -1;
+  }
+  prbfile->name = zName;
+  prbfile->writable = (lfs_flags != LFS_O_RDONLY);
+  prbfile->delete_on_close = (flags & SQLITE_OPEN_DELETEONCLOSE) != 0;
+  prbfile->sector_size = (int)littlefs_get_config()->block_size;
+  return 0;
+}
+
+int
+prb_lfs_file_unlink(const char *zName)
+{
+  if (littlefs_ensure_mounted() != LFS_ERR_OK) return -1;
+  char buf[PATHNAME_MAX_LEN + 1];
+  const char *path = prb_lfs_path(zName, buf, sizeof(buf));
+  if (path == NULL) return -1;
+  return (lfs_remove(littlefs_get_lfs(), path) == LFS_ERR_OK) ? 0 : -1;
+}
+
+bool
+prb_lfs_file_exist_q(const char *zName)
+{
+  if (littlefs_ensure_mounted() != LFS_ERR_OK) return false;
+  char buf[PATHNAME_MAX_LEN + 1];
+  const char *path = prb_lfs_path(zName, buf, sizeof(buf));
+  if (path == NULL) return false;
+  struct lfs_info info;
+  return lfs_stat(littlefs_get_lfs(), path, &info) == LFS_ERR_OK;
+}
+
+int
+prbLfsIOClose(sqlite3_file *pFile)
+{
+  PRBFile *prbfile = (PRBFile *)pFile;
+  lfs_t *lfs = littlefs_get_lfs();
+  int err = lfs_file_close(lfs, &prbfile->lfs_file);
+
+  char buf[PATHNAME_MAX_LEN + 1];
+  const char *path = prb_lfs_path(prbfile->name, buf, sizeof(buf));
+  if (path != NULL) {
+    if (prbfile->delete_on_close) {
+      lfs_remove(lfs, path);
+    } else if (prbfile->writable) {
+      /* Stamp the mtime as Littlefs::File#close does */
+      uint32_t ts = littlefs_get_unixtime();
+      lfs_setattr(lfs, path, LFS_ATTR_MTIME, &ts, sizeof(ts));
+    }
+  }
+  return (err == LFS_ERR_OK) ? SQLITE_OK : SQLITE_IOERR_CLOSE;
+}
+
+int
+prbLfsIORead(sqlite3_file *pFile, void *zBuf, int iAmt, sqlite3_int64 iOfst)
+{
+  PRBFile *prbfile = (PRBFile *)pFile;
+  lfs_t *lfs = littlefs_get_lfs();
+  if (LFS_FILE_MAX < iOfst ||
+      lfs_file_seek(lfs, &prbfile->lfs_file, (lfs_soff_t)iOfst, LFS_SEEK_SET) < 0) {
+    return SQLITE_IOERR_READ;
+  }
+  lfs_ssize_t nRead = lfs_file_read(lfs, &prbfile->lfs_file, zBuf, (lfs_size_t)iAmt);
+  if (nRead < 0) {
+    return SQLITE_IOERR_READ;
+  }
+  if (nRead < iAmt) {
+    /* SQLite requires the unread tail to be zeroed on a short read */
+    memset((char *)zBuf + nRead, 0, (size_t)(iAmt - nRead));
+    return SQLITE_IOERR_SHORT_READ;
+  }
+  return SQLITE_OK;
+}
+
+int
+prbLfsIOWrite(sqlite3_file *pFile, const void *zBuf, int iAmt, sqlite3_int64 iOfst)
+{
+  PRBFile *prbfile = (PRBFile *)pFile;
+  lfs_t *lfs = littlefs_get_lfs();
+  if (LFS_FILE_MAX < iOfst + iAmt ||
+      lfs_file_seek(lfs, &prbfile->lfs_file, (lfs_soff_t)iOfst, LFS_SEEK_SET) < 0) {
+    return SQLITE_IOERR_WRITE;
+  }
+  /* Not synced here, unlike Littlefs::File#write: SQLite calls xSync at the
+     points where the data has to be on flash */
+  lfs_ssize_t nWritten = lfs_file_write(lfs, &prbfile->lfs_file, zBuf, (lfs_size_t)iAmt);
+  if (nWritten == LFS_ERR_NOSPC) {
+    return SQLITE_FULL;
+  }
+  return (nWritten == iAmt) ? SQLITE_OK : SQLITE_IOERR_WRITE;
+}
+
+int
+prbLfsIOTruncate(sqlite3_file *pFile, sqlite3_int64 size)
+{
+  PRBFile *prbfile = (PRBFile *)pFile;
+  if (size < 0 || LFS_FILE_MAX < size) {
+    return SQLITE_IOERR_TRUNCATE;
+  }
+  int err = lfs_file_truncate(littlefs_get_lfs(), &prbfile->lfs_file, (lfs_off_t)size);
+  return (err == LFS_ERR_OK) ? SQLITE_OK : SQLITE_IOERR_TRUNCATE;
+}
+
+int
+prbLfsIOSync(sqlite3_file *pFile, int flags)
+{
+  PRBFile *prbfile = (PRBFile *)pFile;
+  int err = lfs_file_sync(littlefs_get_lfs(), &prbfile->lfs_file);
+  return (err == LFS_ERR_OK) ? SQLITE_OK : SQLITE_IOERR_FSYNC;
+}
+
+int
+prbLfsIOFileSize(sqlite3_file *pFile, sqlite3_int64 *pSize)
+{
+  PRBFile *prbfile = (PRBFile *)pFile;
+  lfs_soff_t size = lfs_file_size(littlefs_get_lfs(), &prbfile->lfs_file);
+  if (size < 0) {
+    return SQLITE_IOERR_FSTAT;
+  }
+  *pSize = (sqlite3_int64)size;
+  return SQLITE_OK;
+}
+
+#endif /* PICORB_SQLITE3_LITTLEFS */
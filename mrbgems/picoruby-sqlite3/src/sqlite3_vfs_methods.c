@@ -63,6 +63,31 @@ static sqlite3_io_methods prb_io_methods = {
   0                             /* xUnfetch */
 };
 
+#if defined(PICORB_SQLITE3_LITTLEFS)
+/* Files on the native littlefs path; see sqlite3_lfs_methods.c */
+static sqlite3_io_methods prb_lfs_io_methods = {
+  3,                            /* iVersion */
+  prbLfsIOClose,                /* xClose */
+  prbLfsIORead,                 /* xRead */
+  prbLfsIOWrite,                /* xWrite */
+  prbLfsIOTruncate,             /* xTruncate */
+  prbLfsIOSync,                 /* xSync */
+  prbLfsIOFileSize,             /* xFileSize */
+  prbIOLock,                    /* xLock */
+  prbIOUnlock,                  /* xUnlock */
+  prbIOCheckReservedLock,       /* xCheckReservedLock */
+  prbIOFileControl,             /* xFileControl */
+  prbIOSectorSize,              /* xSectorSize */
+  prbIODeviceCharacteristics,   /* xDeviceCharacteristics */
+  0,                            /* xShmMap */
+  0,                            /* xShmLock */
+  0,                            /* xShmBarrier */
+  0,                            /* xShmUnmap */
+  0,                            /* xFetch */
+  0                             /* xUnfetch */
+};
+#endif
+
 int
 sqlite3_os_init(void)
 {
@@ -92,8 +117,18 @@ prbVFSOpen(sqlite3_vfs *pVfs, const char *zName, sqlite3_file *pFile, int flags,
 {
   PRBFile *prbfile = (PRBFile *)pFile;
   memset(prbfile, 0, sizeof(PRBFile));
-  pFile->pMethods = &prb_io_methods;
-  if (prb_file_new(prbfile, zName, flags) != 0) {
+  int ret;
+#if defined(PICORB_SQLITE3_LITTLEFS)
+  if (prb_lfs_attached_p()) {
+    pFile->pMethods = &prb_lfs_io_methods;
+    ret = prb_lfs_file_open(prbfile, zName, flags);
+  } else
+#endif
+  {
+    pFile->pMethods = &prb_io_methods;
+    ret = prb_file_new(prbfile, zName, flags);
+  }
+  if (ret != 0) {
     /* SQLite only calls xClose when pMethods is set, so clear it again */
     pFile->pMethods = NULL;
     return SQLITE_CANTOPEN;
@@ -107,7 +142,16 @@ prbVFSOpen(sqlite3_vfs *pVfs, const char *zName, sqlite3_file *pFile, int flags,
 int
 prbVFSDelete(sqlite3_vfs *pVfs, const char *zName, int syncDir)
 {
-  if (prb_file_unlink(zName) != 0) {
+  int ret;
+#if defined(PICORB_SQLITE3_LITTLEFS)
+  if (prb_lfs_attached_p()) {
+    ret = prb_lfs_file_unlink(zName);
+  } else
+#endif
+  {
+    ret = prb_file_unlink(zName);
+  }
+  if (ret != 0) {
     return SQLITE_IOERR_DELETE;
   }
   return SQLITE_OK;
@@ -120,7 +164,16 @@ prbVFSAccess(sqlite3_vfs *pVfs, const char *zName, int flags, int *pResOut)
    * There is a single user and no permission bits on the filesystems
    * PicoRuby mounts, so an existing file is always readable and writable.
    */
-  *pResOut = prb_file_exist_q(zName) ? 1 : 0;
+  bool exist;
+#if defined(PICORB_SQLITE3_LITTLEFS)
+  if (prb_lfs_attached_p()) {
+    exist = prb_lfs_file_exist_q(zName);
+  } else
+#endif
+  {
+    exist = prb_file_exist_q(zName);
+  }
+  *pResOut = exist ? 1 : 0;
   return SQLITE_OK;
 }
 
@@ -0,0 +1,101 @@
+# See sqlite3_test.rb for why the require is guarded
+begin
+  require "littlefs"
+rescue LoadError
+end
+
+# SQLite talks to a plain Littlefs through its C API (src/sqlite3_lfs_methods.c)
+# but to any other driver through the driver's Ruby methods. A subclass of
+# Littlefs takes the Ruby path, so these tests cover the bridge that FAT and
+# other drivers depend on, on the same RAM backed volume.
+#
+# Littlefs is missing where the file is loaded on CRuby, hence the guard.
+if Object.const_defined?(:Littlefs)
+  class Sqlite3BridgedLittlefs < Littlefs
+  end
+end
+
+class Sqlite3DriverBridgeTest < Picotest::Test
+  MOUNTPOINT = "/bridge"
+
+  def setup
+    skip "Not supported on FemtoRuby" if femtoruby?
+    skip "no VFS on wasm" if wasm?
+    return if VFS.volume_index(MOUNTPOINT)
+    fs = Sqlite3BridgedLittlefs.new(:flash, label: "SQLITE3")
+    # Every Littlefs shares the one device; format it only if no other test
+    # has mounted it yet
+    fs.mkfs unless VFS::VOLUMES.any? { |v| v[:driver].is_a?(Littlefs) }
+    VFS.mount(fs, MOUNTPOINT)
+  end
+
+  # The prefix of a Littlefs is "", so the files here share the device's
+  # namespace with the ones of sqlite3_test.rb
+  def fresh_db(name)
+    db = SQLite3::Database.new("#{MOUNTPOINT}/bridge_#{name}.db")
+    db.execute("DROP TABLE IF EXISTS users;")
+    db.execute("CREATE TABLE users (id INTEGER PRIMARY KEY, name TEXT, age INTEGER);")
+    db
+  end
+
+  def test_driver_is_not_a_plain_littlefs
+    volume, _path = VFS.sanitize_and_split("#{MOUNTPOINT}/bridge_crud.db")
+    assert_equal(Sqlite3BridgedLittlefs, volume[:driver].class)
+  end
+
+  def test_create_insert_select_update_and_delete
+    db = fresh_db("crud")
+    db.execute("INSERT INTO users (name, age) VALUES (?, ?)", ["Alice", 30])
+    db.execute("INSERT INTO users (name, age) VALUES (?, ?)", ["Bob", 25])
+    assert_equal([[1, "Alice", 30], [2, "Bob", 25]],
+                 db.execute("SELECT id, name, age FROM users ORDER BY id;"))
+    db.execute("UPDATE users SET age = ? WHERE name = ?", [31, "Alice"])
+    assert_equal(31, db.get_first_value("SELECT age FROM users WHERE name = 'Alice'"))
+    db.execute("DELETE FROM users WHERE name = ?", ["Bob"])
+    assert_equal(1, db.get_first_value("SELECT COUNT(*) FROM users"))
+    db.close
+  end
+
+  def test_persistence_across_reopen
+    db = fresh_db("reopen")
+    db.execute("INSERT INTO users (name, age) VALUES (?, ?)", ["Carol", 40])
+    db.close
+    db = SQLite3::Database.new("#{MOUNTPOINT}/bridge_reopen.db")
+    assert_equal([["Carol", 40]], db.execute("SELECT name, age FROM users;"))
+    db.close
+  end
+
+  def test_transaction_block_commits
+    db = fresh_db("txn_commit")
+    db.transaction do |t|
+      t.execute("INSERT INTO users (name) VALUES (?)", ["Alice"])
+      t.execute("INSERT INTO users (name) VALUES (?)", ["Bob"])
+    end
+    assert_false(db.transaction_active?)
+    assert_equal(2, db.get_first_value("SELECT COUNT(*) FROM users"))
+    db.close
+  end
+
+  def test_transaction_block_rolls_back_on_error
+    db = fresh_db("txn_rollback")
+    db.execute("INSERT INTO users (name) VALUES (?)", ["Seed"])
+    assert_raise(RuntimeError) do
+      db.transaction do |t|
+        t.execute("INSERT INTO users (name) VALUES (?)", ["Alice"])
+        raise "boom"
+      end
+    end
+    assert_false(db.transaction_active?)
+    assert_equal(1, db.get_first_value("SELECT COUNT(*) FROM users"))
+    db.close
+  end
+
+  def test_manual_rollback
+    db = fresh_db("manual_rollback")
+    db.transaction
+    db.execute("INSERT INTO users (name) VALUES (?)", ["Alice"])
+    db.rollback
+    assert_equal(0, db.get_first_value("SELECT COUNT(*) FROM users"))
+    db.close
+  end
+end
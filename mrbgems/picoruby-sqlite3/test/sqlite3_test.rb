@@ -179,6 +179,23 @@ class Sqlite3Test < Picotest::Test
     end
   end
 
+  def test_vacuum_shrinks_file_on_littlefs
+    skip "no file on wasm" if wasm?
+    # The test volume is a plain Littlefs, so SQLite goes through the native
+    # path, which can truncate
+    db = fresh_db("/vacuum.db")
+    db.transaction do |t|
+      100.times { t.execute("INSERT INTO users (name) VALUES (?);", ["x" * 200]) }
+    end
+    db.close
+    grown = File.open("/vacuum.db") { |f| f.size }
+    SQLite3::Database.new("/vacuum.db") do |reopened|
+      reopened.execute("DELETE FROM users;")
+      reopened.execute("VACUUM;")
+    end
+    assert_true(File.open("/vacuum.db") { |f| f.size } < grown)
+  end
+
   def test_invalid_sql_raises
     SQLite3::Database.new("/error.db") do |db|
       assert_raise(SQLite3::Exception) do
@@ -239,6 +256,56 @@ class Sqlite3Test < Picotest::Test
     db.close
   end
 
+  def test_cached_statement_does_not_keep_old_bindings
+    db = fresh_db("/stmt_cache.db")
+    db.execute("INSERT INTO users (name, age) VALUES (?, ?)", ["Alice", 30])
+    db.execute("INSERT INTO users (name, age) VALUES (?, ?)", ["Bob"])
+    assert_equal([["Bob", nil]], db.execute("SELECT name, age FROM users WHERE id = 2"))
+    db.close
+  end
+
+  def test_nested_execute_of_the_same_sql
+    db = fresh_db("/stmt_nested.db")
+    db.execute("INSERT INTO users (name) VALUES ('a'), ('b')")
+    pairs = []
+    sql = "SELECT name FROM users ORDER BY id"
+    db.execute(sql) do |outer|
+      db.execute(sql) { |inner| pairs << outer[0] + inner[0] }
+    end
+    assert_equal(["aa", "ab", "ba", "bb"], pairs)
+    db.close
+  end
+
+  def test_insert_many
+    db = fresh_db("/insert_many.db")
+    rows = [["Alice", 30], ["Bob", 25], [{ name: "Carol", age: 41 }]]
+    assert_equal(2, db.insert_many("INSERT INTO users (name, age) VALUES (?, ?)", rows[0, 2]))
+    db.insert_many("INSERT INTO users (name, age) VALUES (:name, :age)", rows[2, 1])
+    assert_false(db.transaction_active?)
+    assert_equal(3, db.get_first_value("SELECT count(*) FROM users"))
+    db.close
+  end
+
+  def test_insert_many_rolls_back_on_error
+    db = fresh_db("/insert_many_err.db")
+    assert_raise(SQLite3::ConstraintException) do
+      db.insert_many("INSERT INTO users (id, name) VALUES (?, ?)", [[1, "a"], [1, "b"]])
+    end
+    assert_false(db.transaction_active?)
+    assert_equal(0, db.get_first_value("SELECT count(*) FROM users"))
+    db.close
+  end
+
+  def test_execute_columns
+    db = fresh_db("/columns.db")
+    db.insert_many("INSERT INTO users (name, age) VALUES (?, ?)", [["Alice", 30], ["Bob", 25]])
+    sql = "SELECT name, age FROM users ORDER BY id"
+    assert_equal([["Alice", "Bob"], [30, 25]], db.execute_columns(sql))
+    db.results_as_hash = true
+    assert_equal({ "name" => ["Alice", "Bob"], "age" => [30, 25] }, db.execute_columns(sql))
+    db.close
+  end
+
   def test_get_first_row
     db = fresh_db("/first_row.db")
     db.execute("INSERT INTO users (name, age) VALUES (?, ?)", ["Alice", 30])
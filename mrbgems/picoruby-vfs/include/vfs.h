@@ -0,0 +1,82 @@
+#ifndef VFS_DEFINED_H_
+#define VFS_DEFINED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Mount table */
+#ifndef VFS_VOLUME_MAX
+#define VFS_VOLUME_MAX 8
+#endif
+#ifndef VFS_MOUNTPOINT_MAX
+#define VFS_MOUNTPOINT_MAX 32
+#endif
+
+/*
+ * Entries of the resolved path cache and of the cache of paths known
+ * not to exist. 0 disables either. Paths longer than
+ * VFS_CACHE_PATH_MAX are resolved every time and never cached.
+ */
+#ifndef VFS_RESOLVE_CACHE_SIZE
+#define VFS_RESOLVE_CACHE_SIZE 4
+#endif
+#ifndef VFS_MISSING_CACHE_SIZE
+#define VFS_MISSING_CACHE_SIZE 8
+#endif
+#ifndef VFS_CACHE_PATH_MAX
+#define VFS_CACHE_PATH_MAX 64
+#endif
+
+typedef struct {
+  int volume;               /* index in the mount table, -1 if none */
+  const char *path;         /* path on the volume's driver */
+  size_t path_len;
+  bool missing;             /* known not to exist */
+} vfs_resolution_t;
+
+/* Returns the index of the new volume, or -1 if the table is full or
+   the mountpoint too long */
+int VFS_mount(const char *mountpoint, size_t len);
+void VFS_unmount(int index);
+int VFS_volume_index(const char *mountpoint, size_t len);
+
+/*
+ * Makes path absolute against pwd and removes ".", ".." and empty
+ * components. An empty path stands for home, which is returned as it
+ * is. out needs VFS_SANITIZE_SIZE bytes. Returns the length.
+ */
+#define VFS_SANITIZE_SIZE(len, pwd_len, home_len) \
+  ((len) + (pwd_len) + (home_len) + 2)
+size_t VFS_sanitize(const char *path, size_t len,
+                    const char *pwd, size_t pwd_len,
+                    const char *home, size_t home_len, char *out);
+
+/* The volume whose mountpoint is the longest match of a sanitized path,
+   or the first volume if none matches */
+int VFS_split(const char *sanitized, size_t len, const char **path, size_t *path_len);
+
+/*
+ * VFS_sanitize and VFS_split through the caches. buf is as out of
+ * VFS_sanitize; res->path may point into it or into the cache.
+ */
+void VFS_resolve(const char *path, size_t len,
+                 const char *pwd, size_t pwd_len,
+                 const char *home, size_t home_len,
+                 char *buf, vfs_resolution_t *res);
+
+/* Remembers that path does not exist on the volume */
+void VFS_set_missing(int volume, const char *path, size_t path_len);
+/* Forgets the paths known to be missing */
+void VFS_clear_missing(void);
+void VFS_clear_cache(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VFS_DEFINED_H_ */
@@ -4,7 +4,7 @@ class File
 
   class Stat
     def initialize(path)
-      volume, _path = VFS.sanitize_and_split(path)
+      volume, _path = VFS.lookup(path)
       @stat = volume[:driver].class::Stat.new(volume[:driver].prefix, _path) # steep:ignore
     end
     def directory? = @stat.directory?
@@ -15,7 +15,8 @@ class File
     def size = @stat.size
   end
 
-  CHUNK_SIZE = 127
+  # Buffer size for a driver that does not tell its sector size
+  DEFAULT_BUFFER_SIZE = 512
 
   class << self
     def expand_path(path, default_path = '.')
@@ -145,6 +146,16 @@ class File
     # @type var mode: String
     @path = path
     @file = VFS::File.open(path, mode)
+    # Read-ahead: the bytes of @rbuf from @roff on have been read from the
+    # driver but not consumed yet
+    @rbuf = ""
+    @roff = 0
+    # Writes not yet handed to the driver
+    @wbuf = ""
+    # One sector of the driver, so that each driver call covers whole
+    # sectors
+    size = @file.sector_size
+    @buffer_size = 0 < size ? size : DEFAULT_BUFFER_SIZE
   end
 
   attr_reader :path
@@ -154,7 +165,8 @@ class File
   end
 
   def tell
-    @file.tell
+    flush
+    @file.tell - (@rbuf.bytesize - @roff)
   end
   alias pos tell
 
@@ -162,12 +174,16 @@ class File
   SEEK_CUR = 1
   SEEK_END = 2
   def seek(pos, whence = SEEK_SET)
+    flush
+    # The driver is ahead of the reader by what is left in the buffer
+    pos -= @rbuf.bytesize - @roff if whence == SEEK_CUR
+    clear_read_buffer
     @file.seek(pos, whence)
   end
   alias pos= seek
 
   def rewind
-    @file.seek(0)
+    seek(0)
   end
 
   def each_line(&block) # steep:ignore MethodArityMismatch
@@ -179,14 +195,14 @@ class File
   end
 
   def gets(*args, chomp: false) # steep:ignore MethodArityMismatch
-    # @type var rs: String
+    # @type var rs: String | nil
     # @type var limit: Integer | nil
     case args.size
     when 0
       rs = "\n"
       limit = nil
     when 1
-      # @type var arg0: String | Integer
+      # @type var arg0: String | Integer | nil
       arg0 = args[0]
       if arg0.is_a?(Integer)
         rs = "\n"
@@ -196,52 +212,50 @@ class File
         limit = nil
       end
     when 2
-      # @type var args: [_ToS, _ToI]
-      rs = args[0].to_s
+      # @type var args: [String | nil, _ToI]
+      rs = args[0]
       limit = args[1].to_i
     else
       raise ArgumentError.new("wrong number of arguments (expected 0..2)")
     end
-    result = ""
-    chunk_size = CHUNK_SIZE
-    initial_pos = self.tell
-    rs = "" unless rs
-    rs_adjust = rs.length - 1
-    if limit
-      count = limit / chunk_size
-      i = 0
-      while i < count
-        if chunk = @file.read(limit)
-          result << chunk
-        end
-        i += 1
-      end
-      if (chunk = @file.read(limit % chunk_size))
-        result << chunk
+    # Paragraph mode
+    rs = "\n\n" if rs == ""
+    return "" if limit == 0
+    flush
+
+    # Search the buffer, and top it up only when the line runs past it.
+    # Offsets and limit are in bytes.
+    from = @roff
+    while true
+      avail = @rbuf.bytesize - @roff
+      if rs && (found = rbuf_index(rs, from))
+        len = found + rs.bytesize - @roff
+        len = limit if limit && limit < len
+        break
       end
-      if pos = result.index(rs)
-        result = result[0, pos + 1 + rs_adjust]
+      if limit && limit <= avail
+        len = limit
+        break
       end
-    else
-      index_at = 0
-      while chunk = @file.read(chunk_size) do
-        result << chunk
-        if pos = result.index(rs, [index_at - rs_adjust, 0].max || 0)
-          result = result[0, pos + 1 + rs_adjust] || ""
-          break
-        end
-        index_at += chunk_size
+      unless fill_read_buffer
+        len = avail
+        break
       end
+      # The unread bytes now start the buffer, and a separator may
+      # straddle their old end
+      from = rs ? avail - rs.bytesize + 1 : 0
+      from = 0 if from < 0
     end
-    if result&.length == 0 || result.nil?
-      return nil
-    else
-      self.seek(initial_pos + (result&.length || 0))
-      return chomp ? result.chomp(rs) : result
-    end
+    return nil if len == 0
+
+    line = @rbuf.byteslice(@roff, len) || ""
+    @roff += line.bytesize
+    (chomp && rs) ? line.chomp(rs) : line
   end
 
   def eof?
+    return false if @roff < @rbuf.bytesize
+    flush
     @file.eof?
   end
 
@@ -251,10 +265,30 @@ class File
     if length && length < 0
       raise ArgumentError.new("negative length #{length} given")
     end
+    flush
     if length.is_a?(Integer)
-      outbuf << @file.read(length).to_s
+      remaining = length
+      while 0 < remaining
+        if @roff < @rbuf.bytesize
+          chunk = @rbuf.byteslice(@roff, remaining) || ""
+          @roff += chunk.bytesize
+          outbuf << chunk
+          remaining -= chunk.bytesize
+        elsif @buffer_size <= remaining
+          # Too big to be worth buffering
+          break unless chunk = @file.read(remaining)
+          outbuf << chunk
+          remaining -= chunk.bytesize
+        else
+          break unless fill_read_buffer
+        end
+      end
     elsif length.nil?
-      while buff = @file.read(1024)
+      if @roff < @rbuf.bytesize
+        outbuf << (@rbuf.byteslice(@roff, @rbuf.bytesize - @roff) || "")
+      end
+      clear_read_buffer
+      while buff = @file.read(@buffer_size)
         outbuf << buff
       end
     else
@@ -268,24 +302,48 @@ class File
   end
 
   def getbyte
-    @file.getbyte
+    if @rbuf.bytesize <= @roff
+      flush
+      return nil unless fill_read_buffer
+    end
+    byte = @rbuf.getbyte(@roff)
+    @roff += 1
+    byte
   end
 
+  # Writes are held until a buffer's worth has built up, and handed to
+  # the driver by flush, or by any call that reads, seeks or closes.
   def write(*args)
+    unread = @rbuf.bytesize - @roff
+    # Put the driver back where the reader is
+    @file.seek(-unread, SEEK_CUR) if 0 < unread
+    clear_read_buffer
     len = 0
     i = 0
     while i < args.size
-      len += @file.write(args[i].to_s)
+      str = args[i].to_s
+      @wbuf << str
+      len += str.bytesize
       i += 1
     end
+    flush if @buffer_size <= @wbuf.bytesize
     return len
   end
 
+  # The buffer is kept if the write raises (a full volume, say), so that
+  # a later flush can try again
+  def flush
+    unless @wbuf.empty?
+      @file.write(@wbuf)
+      @wbuf = ""
+    end
+    self
+  end
+
   def puts(*lines)
     i = 0
     while i < lines.size
-      @file.write lines[i]
-      @file.write "\n"
+      write lines[i], "\n"
       i += 1
     end
     return nil
@@ -295,9 +353,9 @@ class File
     # @type var ch: String | Integer
     case ch.class
     when Integer
-      @file.write ch.chr
+      write ch.chr
     when String
-      @file.write ch[0].to_s
+      write ch[0].to_s
     else
       raise ArgumentError
     end
@@ -310,10 +368,15 @@ class File
   end
 
   def close
-    @file.close
+    begin
+      flush
+    ensure
+      @file.close
+    end
   end
 
   def size
+    flush
     @file.size
   end
 
@@ -323,7 +386,51 @@ class File
   end
 
   def fsync
+    flush
     @file.fsync
   end
 
+  private
+
+  # Reads the next buffer from the driver after what is left unread.
+  # Returns false at the end of file.
+  def fill_read_buffer
+    chunk = @file.read(@buffer_size)
+    return false unless chunk
+    if @roff < @rbuf.bytesize
+      rest = @rbuf.byteslice(@roff, @rbuf.bytesize - @roff) || ""
+      @rbuf = rest << chunk
+    else
+      @rbuf = chunk
+    end
+    @roff = 0
+    true
+  end
+
+  def clear_read_buffer
+    @rbuf = ""
+    @roff = 0
+  end
+
+  # The byte offset of rs in @rbuf at or after from. String#index counts
+  # characters where strings are UTF-8 aware.
+  if "".respond_to?(:byteindex)
+    def rbuf_index(rs, from)
+      @rbuf.byteindex(rs, from)
+    end
+  else
+    def rbuf_index(rs, from)
+      first = rs.getbyte(0)
+      size = rs.bytesize
+      last = @rbuf.bytesize - size
+      while from <= last
+        if @rbuf.getbyte(from) == first && @rbuf.byteslice(from, size) == rs
+          return from
+        end
+        from += 1
+      end
+      nil
+    end
+  end
+
 end
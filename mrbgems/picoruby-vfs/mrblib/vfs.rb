@@ -10,22 +10,30 @@ class VFS
       unless mountpoint[0] == '/'
         raise ArgumentError.new "Mountpoint must start with `/`"
       end
-      driver.mount(mountpoint) # It raises if error
+      index = _mount(mountpoint) # It raises if the table is full
+      begin
+        driver.mount(mountpoint) # It raises if error
+      rescue => e
+        _unmount(index)
+        raise e
+      end
       VOLUMES << { driver: driver, mountpoint: mountpoint }
       ENV["PWD"] = mountpoint if ENV["PWD"]&.empty?
     end
 
     def unmount(driver, force = false)
       mountpoint = driver.mountpoint
-      mountpoint << "/" unless mountpoint.end_with?("/")
+      # The mount table has the mountpoint as it was given to mount
       unless index = volume_index(mountpoint)
         raise "Mountpoint `#{mountpoint}` doesn't exist"
       end
-      if !force && ENV["PWD"]&.start_with?(mountpoint)
+      prefix = mountpoint.end_with?("/") ? mountpoint : "#{mountpoint}/"
+      if !force && ENV["PWD"]&.start_with?(prefix)
         raise "Can't unmount where you are"
       end
       driver.unmount
       VOLUMES.delete_at index
+      _unmount(index)
       if VOLUMES.empty?
         ENV["PWD"] = ""
       end
@@ -92,107 +100,69 @@ class VFS
     end
 
     def exist?(path)
-      volume, _path = VFS.sanitize_and_split(path)
+      index, _path, missing = VFS.resolve(path)
       # Nothing is mounted, so no path can exist. Returning false instead of
       # dereferencing a nil volume keeps File.exist?/File.file? usable (e.g. the
       # require/load path querying candidates) before any volume is mounted.
-      return false unless volume
-      volume[:driver].exist?(_path)
+      return false if index.nil? || missing
+      return true if VOLUMES[index][:driver].exist?(_path)
+      _set_missing(index, _path)
+      false
     end
 
     def directory?(path)
-      volume, _path = VFS.sanitize_and_split(path)
-      return false unless volume
-      volume[:driver].directory?(_path)
+      index, _path, missing = VFS.resolve(path)
+      return false if index.nil? || missing
+      VOLUMES[index][:driver].directory?(_path)
     end
 
     def contiguous?(path)
-      volume, _path = VFS.sanitize_and_split(path)
+      volume, _path = VFS.lookup(path)
       volume[:driver].contiguous?(_path)
     end
 
     # private
 
+    # The path on its volume's driver for a caller that may create, remove
+    # or rename it, so the paths known to be missing are forgotten
     def sanitize_and_split(path)
-      split(sanitize path)
+      _clear_missing
+      lookup(path)
     end
 
-    def sanitize(path)
-      dirs = case path
-      when "/"
-        [""]
-      when ""
-        return ENV["HOME"].to_s
-      else
-        path.split("/")
-      end
-      if dirs[0] != "" # path.start_with?("/")
-        # Relative path
-        dirs = (ENV["PWD"] || "").split("/") + dirs
-      end
-      sanitized_dirs = [] #: Array[String]
-      prefix_dirs = [] #: Array[String]
-      i = 0
-      while i < dirs.size
-        dir = dirs[i]
-        unless dir == "." || dir == ""
-          if dir == ".."
-            if sanitized_dirs.empty?
-              prefix_dirs << ".."
-            else
-              sanitized_dirs.pop
-            end
-          else
-            sanitized_dirs << dir
-          end
-        end
-        i += 1
-      end
-      "#{prefix_dirs.join("/")}/#{sanitized_dirs.join("/")}"
+    # The same for reading only
+    def lookup(path)
+      index, _path, _missing = resolve(path)
+      [index ? VOLUMES[index] : nil, _path]
     end
 
-    def split(sanitized_path)
-      volume = nil
-      best_len = -1
-      i = 0
-      while i < VOLUMES.size
-        v = VOLUMES[i]
-        if sanitized_path.start_with?(v[:mountpoint]) && best_len < v[:mountpoint].length
-          volume = v
-          best_len = v[:mountpoint].length
-        end
-        i += 1
-      end
-      if volume
-        # @type var volume: volume_t
-        cut = volume[:mountpoint] == "/" ? 0 : 1
-        [volume, "/#{sanitized_path[volume[:mountpoint].length + cut, 255]}"]
-      else
-        [VOLUMES[0], sanitized_path]
-      end
+    # [volume index, path on the driver, known to be missing] from the mount
+    # table and caches in C
+    def resolve(path)
+      _resolve(path, ENV["PWD"], ENV["HOME"])
     end
 
-    def volume_index(mountpoint)
-      i = 0
-      while i < VOLUMES.size
-        return i if VOLUMES[i][:mountpoint] == mountpoint
-        i += 1
-      end
-      nil
+    def sanitize(path)
+      _sanitize(path, ENV["PWD"], ENV["HOME"])
+    end
+
+    def split(sanitized_path)
+      index, path = _split(sanitized_path)
+      [index ? VOLUMES[index] : nil, path]
     end
 
   end
 
   class Dir
     def self.open(path)
-      volume, _path = VFS.sanitize_and_split(path)
+      volume, _path = VFS.lookup(path)
       volume[:driver].open_dir(_path)
     end
   end
 
   class File
     def self.open(path, mode)
-      volume, _path = VFS.sanitize_and_split(path)
+      volume, _path = (mode == "r") ? VFS.lookup(path) : VFS.sanitize_and_split(path)
       volume[:driver].open_file(_path, mode)
     end
 
@@ -0,0 +1,193 @@
+#include "mruby.h"
+#include "mruby/presym.h"
+#include "mruby/class.h"
+#include "mruby/string.h"
+#include "mruby/array.h"
+
+/* Paths up to this long are worked on in a buffer on the stack */
+#define VFS_STACK_BUFFER_SIZE 256
+
+static void
+vfs_get_optional_str(mrb_value str, const char **ptr, size_t *len)
+{
+  if (mrb_string_p(str)) {
+    *ptr = RSTRING_PTR(str);
+    *len = (size_t)RSTRING_LEN(str);
+  } else {
+    *ptr = "";
+    *len = 0;
+  }
+}
+
+static mrb_value
+vfs_index_value(int index)
+{
+  return index < 0 ? mrb_nil_value() : mrb_fixnum_value(index);
+}
+
+/*
+ * VFS._mount(mountpoint) -> Integer
+ */
+static mrb_value
+mrb_vfs_s__mount(mrb_state *mrb, mrb_value klass)
+{
+  const char *mountpoint;
+  mrb_int len;
+  mrb_get_args(mrb, "s", &mountpoint, &len);
+  int index = VFS_mount(mountpoint, (size_t)len);
+  if (index < 0) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "Too many volumes or too long mountpoint");
+  }
+  return mrb_fixnum_value(index);
+}
+
+/*
+ * VFS._unmount(index) -> nil
+ */
+static mrb_value
+mrb_vfs_s__unmount(mrb_state *mrb, mrb_value klass)
+{
+  mrb_int index;
+  mrb_get_args(mrb, "i", &index);
+  VFS_unmount((int)index);
+  return mrb_nil_value();
+}
+
+/*
+ * VFS.volume_index(mountpoint) -> Integer | nil
+ */
+static mrb_value
+mrb_vfs_s_volume_index(mrb_state *mrb, mrb_value klass)
+{
+  const char *mountpoint;
+  mrb_int len;
+  mrb_get_args(mrb, "s", &mountpoint, &len);
+  return vfs_index_value(VFS_volume_index(mountpoint, (size_t)len));
+}
+
+/*
+ * VFS._sanitize(path, pwd, home) -> String
+ */
+static mrb_value
+mrb_vfs_s__sanitize(mrb_state *mrb, mrb_value klass)
+{
+  const char *path;
+  mrb_int len;
+  mrb_value pwd_value, home_value;
+  mrb_get_args(mrb, "soo", &path, &len, &pwd_value, &home_value);
+  const char *pwd, *home;
+  size_t pwd_len, home_len;
+  vfs_get_optional_str(pwd_value, &pwd, &pwd_len);
+  vfs_get_optional_str(home_value, &home, &home_len);
+
+  mrb_value str = mrb_str_new(mrb, NULL, VFS_SANITIZE_SIZE((size_t)len, pwd_len, home_len));
+  size_t n = VFS_sanitize(path, (size_t)len, pwd, pwd_len, home, home_len, RSTRING_PTR(str));
+  return mrb_str_resize(mrb, str, n);
+}
+
+/*
+ * VFS._split(sanitized_path) -> [Integer | nil, String]
+ */
+static mrb_value
+mrb_vfs_s__split(mrb_state *mrb, mrb_value klass)
+{
+  const char *sanitized;
+  mrb_int len;
+  mrb_get_args(mrb, "s", &sanitized, &len);
+  const char *path;
+  size_t path_len;
+  int index = VFS_split(sanitized, (size_t)len, &path, &path_len);
+  mrb_value values[2] = {
+    vfs_index_value(index),
+    mrb_str_new(mrb, path, path_len)
+  };
+  return mrb_ary_new_from_values(mrb, 2, values);
+}
+
+/*
+ * VFS._resolve(path, pwd, home) -> [Integer | nil, String, bool]
+ * The last element is true if the path is known not to exist
+ */
+static mrb_value
+mrb_vfs_s__resolve(mrb_state *mrb, mrb_value klass)
+{
+  const char *path;
+  mrb_int len;
+  mrb_value pwd_value, home_value;
+  mrb_get_args(mrb, "soo", &path, &len, &pwd_value, &home_value);
+  const char *pwd, *home;
+  size_t pwd_len, home_len;
+  vfs_get_optional_str(pwd_value, &pwd, &pwd_len);
+  vfs_get_optional_str(home_value, &home, &home_len);
+
+  char stack_buf[VFS_STACK_BUFFER_SIZE];
+  char *buf = stack_buf;
+  size_t size = VFS_SANITIZE_SIZE((size_t)len, pwd_len, home_len);
+  if (sizeof(stack_buf) < size) {
+    /* A String, so that the GC takes it back if anything raises */
+    buf = RSTRING_PTR(mrb_str_new(mrb, NULL, size));
+  }
+  vfs_resolution_t res;
+  VFS_resolve(path, (size_t)len, pwd, pwd_len, home, home_len, buf, &res);
+  mrb_value values[3] = {
+    vfs_index_value(res.volume),
+    mrb_str_new(mrb, res.path, res.path_len),
+    mrb_bool_value(res.missing)
+  };
+  return mrb_ary_new_from_values(mrb, 3, values);
+}
+
+/*
+ * VFS._set_missing(index, path) -> nil
+ */
+static mrb_value
+mrb_vfs_s__set_missing(mrb_state *mrb, mrb_value klass)
+{
+  mrb_int index;
+  const char *path;
+  mrb_int len;
+  mrb_get_args(mrb, "is", &index, &path, &len);
+  VFS_set_missing((int)index, path, (size_t)len);
+  return mrb_nil_value();
+}
+
+/*
+ * VFS.clear_cache -> nil
+ */
+static mrb_value
+mrb_vfs_s_clear_cache(mrb_state *mrb, mrb_value klass)
+{
+  VFS_clear_cache();
+  return mrb_nil_value();
+}
+
+/*
+ * VFS._clear_missing -> nil
+ */
+static mrb_value
+mrb_vfs_s__clear_missing(mrb_state *mrb, mrb_value klass)
+{
+  VFS_clear_missing();
+  return mrb_nil_value();
+}
+
+void
+mrb_picoruby_vfs_gem_init(mrb_state* mrb)
+{
+  struct RClass *class_VFS = mrb_define_class_id(mrb, MRB_SYM(VFS), mrb->object_class);
+
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(_mount), mrb_vfs_s__mount, MRB_ARGS_REQ(1));
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(_unmount), mrb_vfs_s__unmount, MRB_ARGS_REQ(1));
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(volume_index), mrb_vfs_s_volume_index, MRB_ARGS_REQ(1));
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(_sanitize), mrb_vfs_s__sanitize, MRB_ARGS_REQ(3));
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(_split), mrb_vfs_s__split, MRB_ARGS_REQ(1));
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(_resolve), mrb_vfs_s__resolve, MRB_ARGS_REQ(3));
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(_set_missing), mrb_vfs_s__set_missing, MRB_ARGS_REQ(2));
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(_clear_missing), mrb_vfs_s__clear_missing, MRB_ARGS_NONE());
+  mrb_define_class_method_id(mrb, class_VFS, MRB_SYM(clear_cache), mrb_vfs_s_clear_cache, MRB_ARGS_NONE());
+}
+
+void
+mrb_picoruby_vfs_gem_final(mrb_state* mrb)
+{
+}
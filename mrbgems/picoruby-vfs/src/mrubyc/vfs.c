@@ -0,0 +1,194 @@
+#include "mrubyc.h"
+
+/* Paths up to this long are worked on in a buffer on the stack */
+#define VFS_STACK_BUFFER_SIZE 256
+
+static void
+vfs_get_optional_str(mrbc_value *str, const char **ptr, size_t *len)
+{
+  if (str->tt == MRBC_TT_STRING) {
+    *ptr = (const char *)str->string->data;
+    *len = (size_t)str->string->size;
+  } else {
+    *ptr = "";
+    *len = 0;
+  }
+}
+
+static mrbc_value
+vfs_index_value(int index)
+{
+  return index < 0 ? mrbc_nil_value() : mrbc_integer_value(index);
+}
+
+static bool
+vfs_check_string(mrbc_vm *vm, mrbc_value *v)
+{
+  if (v->tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "Expected a String");
+    return false;
+  }
+  return true;
+}
+
+/*
+ * VFS._mount(mountpoint) -> Integer
+ */
+static void
+c_vfs__mount(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if (!vfs_check_string(vm, &v[1])) return;
+  int index = VFS_mount((const char *)v[1].string->data, (size_t)v[1].string->size);
+  if (index < 0) {
+    mrbc_raise(vm, MRBC_CLASS(RuntimeError), "Too many volumes or too long mountpoint");
+    return;
+  }
+  SET_INT_RETURN(index);
+}
+
+/*
+ * VFS._unmount(index) -> nil
+ */
+static void
+c_vfs__unmount(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  VFS_unmount((int)GET_INT_ARG(1));
+  SET_NIL_RETURN();
+}
+
+/*
+ * VFS.volume_index(mountpoint) -> Integer | nil
+ */
+static void
+c_vfs_volume_index(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if (!vfs_check_string(vm, &v[1])) return;
+  int index = VFS_volume_index((const char *)v[1].string->data, (size_t)v[1].string->size);
+  SET_RETURN(vfs_index_value(index));
+}
+
+/*
+ * VFS._sanitize(path, pwd, home) -> String
+ */
+static void
+c_vfs__sanitize(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if (!vfs_check_string(vm, &v[1])) return;
+  const char *pwd, *home;
+  size_t pwd_len, home_len;
+  vfs_get_optional_str(&v[2], &pwd, &pwd_len);
+  vfs_get_optional_str(&v[3], &home, &home_len);
+  size_t len = (size_t)v[1].string->size;
+
+  mrbc_value str = mrbc_string_new(vm, NULL, VFS_SANITIZE_SIZE(len, pwd_len, home_len));
+  if (str.tt != MRBC_TT_STRING) {
+    mrbc_raise(vm, MRBC_CLASS(NoMemoryError), "out of memory");
+    return;
+  }
+  size_t n = VFS_sanitize((const char *)v[1].string->data, len, pwd, pwd_len, home, home_len,
+                          (char *)str.string->data);
+  str.string->size = n;
+  str.string->data[n] = '\0';
+  SET_RETURN(str);
+}
+
+/*
+ * VFS._split(sanitized_path) -> [Integer | nil, String]
+ */
+static void
+c_vfs__split(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if (!vfs_check_string(vm, &v[1])) return;
+  const char *path;
+  size_t path_len;
+  int index = VFS_split((const char *)v[1].string->data, (size_t)v[1].string->size, &path, &path_len);
+
+  mrbc_value ret = mrbc_array_new(vm, 2);
+  mrbc_value volume = vfs_index_value(index);
+  mrbc_value str = mrbc_string_new(vm, path, path_len);
+  mrbc_array_push(&ret, &volume);
+  mrbc_array_push(&ret, &str);
+  SET_RETURN(ret);
+}
+
+/*
+ * VFS._resolve(path, pwd, home) -> [Integer | nil, String, bool]
+ * The last element is true if the path is known not to exist
+ */
+static void
+c_vfs__resolve(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if (!vfs_check_string(vm, &v[1])) return;
+  const char *pwd, *home;
+  size_t pwd_len, home_len;
+  vfs_get_optional_str(&v[2], &pwd, &pwd_len);
+  vfs_get_optional_str(&v[3], &home, &home_len);
+  size_t len = (size_t)v[1].string->size;
+
+  char stack_buf[VFS_STACK_BUFFER_SIZE];
+  char *buf = stack_buf;
+  size_t size = VFS_SANITIZE_SIZE(len, pwd_len, home_len);
+  if (sizeof(stack_buf) < size) {
+    buf = (char *)mrbc_alloc(vm, size);
+    if (!buf) return;
+  }
+  vfs_resolution_t res;
+  VFS_resolve((const char *)v[1].string->data, len, pwd, pwd_len, home, home_len, buf, &res);
+
+  mrbc_value ret = mrbc_array_new(vm, 3);
+  mrbc_value volume = vfs_index_value(res.volume);
+  mrbc_value str = mrbc_string_new(vm, res.path, res.path_len);
+  mrbc_value missing = mrbc_bool_value(res.missing);
+  if (buf != stack_buf) mrbc_free(vm, buf);
+  mrbc_array_push(&ret, &volume);
+  mrbc_array_push(&ret, &str);
+  mrbc_array_push(&ret, &missing);
+  SET_RETURN(ret);
+}
+
+/*
+ * VFS._set_missing(index, path) -> nil
+ */
+static void
+c_vfs__set_missing(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  if (!vfs_check_string(vm, &v[2])) return;
+  VFS_set_missing((int)GET_INT_ARG(1), (const char *)v[2].string->data, (size_t)v[2].string->size);
+  SET_NIL_RETURN();
+}
+
+/*
+ * VFS._clear_missing -> nil
+ */
+static void
+c_vfs__clear_missing(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  VFS_clear_missing();
+  SET_NIL_RETURN();
+}
+
+/*
+ * VFS.clear_cache -> nil
+ */
+static void
+c_vfs_clear_cache(mrbc_vm *vm, mrbc_value v[], int argc)
+{
+  VFS_clear_cache();
+  SET_NIL_RETURN();
+}
+
+void
+mrbc_vfs_init(mrbc_vm *vm)
+{
+  mrbc_class *class_VFS = mrbc_define_class(vm, "VFS", mrbc_class_object);
+
+  mrbc_define_method(vm, class_VFS, "_mount", c_vfs__mount);
+  mrbc_define_method(vm, class_VFS, "_unmount", c_vfs__unmount);
+  mrbc_define_method(vm, class_VFS, "volume_index", c_vfs_volume_index);
+  mrbc_define_method(vm, class_VFS, "_sanitize", c_vfs__sanitize);
+  mrbc_define_method(vm, class_VFS, "_split", c_vfs__split);
+  mrbc_define_method(vm, class_VFS, "_resolve", c_vfs__resolve);
+  mrbc_define_method(vm, class_VFS, "_set_missing", c_vfs__set_missing);
+  mrbc_define_method(vm, class_VFS, "_clear_missing", c_vfs__clear_missing);
+  mrbc_define_method(vm, class_VFS, "clear_cache", c_vfs_clear_cache);
+}
@@ -0,0 +1,283 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../include/vfs.h"
+
+/*
+ * Mount table
+ *
+ * Mountpoints in the order of VFS::VOLUMES, which keeps the drivers.
+ */
+
+static struct {
+  uint8_t len;
+  char mountpoint[VFS_MOUNTPOINT_MAX];
+} vfs_volumes[VFS_VOLUME_MAX];
+static int vfs_volume_count = 0;
+
+static const char vfs_root[] = "/";
+
+int
+VFS_mount(const char *mountpoint, size_t len)
+{
+  if (VFS_VOLUME_MAX <= vfs_volume_count || VFS_MOUNTPOINT_MAX < len) return -1;
+  int index = vfs_volume_count++;
+  memcpy(vfs_volumes[index].mountpoint, mountpoint, len);
+  vfs_volumes[index].len = (uint8_t)len;
+  VFS_clear_cache();
+  return index;
+}
+
+void
+VFS_unmount(int index)
+{
+  if (index < 0 || vfs_volume_count <= index) return;
+  memmove(&vfs_volumes[index], &vfs_volumes[index + 1],
+          sizeof(vfs_volumes[0]) * (vfs_volume_count - index - 1));
+  vfs_volume_count--;
+  VFS_clear_cache();
+}
+
+int
+VFS_volume_index(const char *mountpoint, size_t len)
+{
+  for (int i = 0; i < vfs_volume_count; i++) {
+    if (vfs_volumes[i].len == len && memcmp(vfs_volumes[i].mountpoint, mountpoint, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Path normalization
+ */
+
+/* Appends the components of s to the "/a/b" at out[0, n) */
+static size_t
+vfs_push(char *out, size_t n, int *up, const char *s, size_t len)
+{
+  size_t i = 0;
+  while (i < len) {
+    size_t start = i;
+    while (i < len && s[i] != '/') i++;
+    size_t comp = i - start;
+    i++;
+    if (comp == 0 || (comp == 1 && s[start] == '.')) continue;
+    if (comp == 2 && s[start] == '.' && s[start + 1] == '.') {
+      if (0 < n) {
+        while (out[--n] != '/');
+      } else {
+        (*up)++;
+      }
+      continue;
+    }
+    out[n++] = '/';
+    memcpy(out + n, s + start, comp);
+    n += comp;
+  }
+  return n;
+}
+
+size_t
+VFS_sanitize(const char *path, size_t len,
+             const char *pwd, size_t pwd_len,
+             const char *home, size_t home_len, char *out)
+{
+  if (len == 0) {
+    memcpy(out, home, home_len);
+    return home_len;
+  }
+  size_t n = 0;
+  /* ".." above the root are kept in front, as in "../../a" */
+  int up = 0;
+  if (path[0] != '/') n = vfs_push(out, n, &up, pwd, pwd_len);
+  n = vfs_push(out, n, &up, path, len);
+  if (n == 0) out[n++] = '/';
+  if (0 < up) {
+    size_t prefix = (size_t)up * 3 - 1;
+    memmove(out + prefix, out, n);
+    for (size_t i = 0; i < prefix; i += 3) {
+      out[i] = '.';
+      out[i + 1] = '.';
+      if (i + 2 < prefix) out[i + 2] = '/';
+    }
+    n += prefix;
+  }
+  return n;
+}
+
+int
+VFS_split(const char *sanitized, size_t len, const char **path, size_t *path_len)
+{
+  int best = -1;
+  size_t best_len = 0;
+  for (int i = 0; i < vfs_volume_count; i++) {
+    size_t mp_len = vfs_volumes[i].len;
+    const char *mp = vfs_volumes[i].mountpoint;
+    if (len < mp_len || memcmp(sanitized, mp, mp_len) != 0) continue;
+    /* Whole components only: "/sd" is not a mountpoint of "/sdcard" */
+    if (mp_len < len && mp[mp_len - 1] != '/' && sanitized[mp_len] != '/') continue;
+    if (best < 0 || best_len < mp_len) {
+      best = i;
+      best_len = mp_len;
+    }
+  }
+  if (best < 0) {
+    *path = sanitized;
+    *path_len = len;
+    return 0 < vfs_volume_count ? 0 : -1;
+  }
+  if (best_len == len) {
+    *path = vfs_root;
+    *path_len = 1;
+  } else {
+    /* Keep the slash that follows the mountpoint, or ends it */
+    size_t start = (sanitized[best_len] == '/') ? best_len : best_len - 1;
+    *path = sanitized + start;
+    *path_len = len - start;
+  }
+  return best;
+}
+
+/*
+ * Caches
+ *
+ * require and the shell probe the same few paths over and over, and
+ * mostly for files that are not there.
+ */
+
+#if 0 < VFS_RESOLVE_CACHE_SIZE
+typedef struct {
+  bool used;
+  int8_t volume;
+  uint8_t len;
+  uint8_t pwd_len;          /* 0 for an absolute path */
+  uint8_t path_len;
+  char key[VFS_CACHE_PATH_MAX];
+  char pwd[VFS_CACHE_PATH_MAX];
+  char path[VFS_CACHE_PATH_MAX];
+} vfs_resolve_entry_t;
+
+static vfs_resolve_entry_t vfs_resolve_cache[VFS_RESOLVE_CACHE_SIZE];
+static int vfs_resolve_next = 0;
+#endif
+
+#if 0 < VFS_MISSING_CACHE_SIZE
+typedef struct {
+  bool used;
+  int8_t volume;
+  uint8_t len;
+  char path[VFS_CACHE_PATH_MAX];
+} vfs_missing_entry_t;
+
+static vfs_missing_entry_t vfs_missing_cache[VFS_MISSING_CACHE_SIZE];
+static int vfs_missing_next = 0;
+#endif
+
+static bool
+vfs_missing_p(int volume, const char *path, size_t path_len)
+{
+#if 0 < VFS_MISSING_CACHE_SIZE
+  for (int i = 0; i < VFS_MISSING_CACHE_SIZE; i++) {
+    vfs_missing_entry_t *e = &vfs_missing_cache[i];
+    if (e->used && e->volume == volume && e->len == path_len && memcmp(e->path, path, path_len) == 0) {
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+void
+VFS_resolve(const char *path, size_t len,
+            const char *pwd, size_t pwd_len,
+            const char *home, size_t home_len,
+            char *buf, vfs_resolution_t *res)
+{
+  /* An absolute path does not depend on pwd. An empty one depends on
+     home, and is not cached. */
+  if (0 < len && path[0] == '/') pwd_len = 0;
+#if 0 < VFS_RESOLVE_CACHE_SIZE
+  bool cacheable = (0 < len && len <= VFS_CACHE_PATH_MAX && pwd_len <= VFS_CACHE_PATH_MAX);
+  if (cacheable) {
+    for (int i = 0; i < VFS_RESOLVE_CACHE_SIZE; i++) {
+      vfs_resolve_entry_t *e = &vfs_resolve_cache[i];
+      if (e->used && e->len == len && e->pwd_len == pwd_len &&
+          memcmp(e->key, path, len) == 0 && memcmp(e->pwd, pwd, pwd_len) == 0) {
+        res->volume = e->volume;
+        res->path = e->path;
+        res->path_len = e->path_len;
+        res->missing = vfs_missing_p(res->volume, res->path, res->path_len);
+        return;
+      }
+    }
+  }
+#endif
+  size_t n = VFS_sanitize(path, len, pwd, pwd_len, home, home_len, buf);
+  res->volume = VFS_split(buf, n, &res->path, &res->path_len);
+  res->missing = vfs_missing_p(res->volume, res->path, res->path_len);
+#if 0 < VFS_RESOLVE_CACHE_SIZE
+  if (cacheable && res->path_len <= VFS_CACHE_PATH_MAX) {
+    vfs_resolve_entry_t *e = &vfs_resolve_cache[vfs_resolve_next];
+    vfs_resolve_next = (vfs_resolve_next + 1) % VFS_RESOLVE_CACHE_SIZE;
+    e->used = true;
+    e->volume = (int8_t)res->volume;
+    e->len = (uint8_t)len;
+    e->pwd_len = (uint8_t)pwd_len;
+    e->path_len = (uint8_t)res->path_len;
+    memcpy(e->key, path, len);
+    memcpy(e->pwd, pwd, pwd_len);
+    memcpy(e->path, res->path, res->path_len);
+  }
+#endif
+}
+
+void
+VFS_set_missing(int volume, const char *path, size_t path_len)
+{
+#if 0 < VFS_MISSING_CACHE_SIZE
+  if (volume < 0 || VFS_CACHE_PATH_MAX < path_len) return;
+  if (vfs_missing_p(volume, path, path_len)) return;
+  vfs_missing_entry_t *e = &vfs_missing_cache[vfs_missing_next];
+  vfs_missing_next = (vfs_missing_next + 1) % VFS_MISSING_CACHE_SIZE;
+  e->used = true;
+  e->volume = (int8_t)volume;
+  e->len = (uint8_t)path_len;
+  memcpy(e->path, path, path_len);
+#else
+  (void)volume; (void)path; (void)path_len;
+#endif
+}
+
+void
+VFS_clear_missing(void)
+{
+#if 0 < VFS_MISSING_CACHE_SIZE
+  for (int i = 0; i < VFS_MISSING_CACHE_SIZE; i++) {
+    vfs_missing_cache[i].used = false;
+  }
+#endif
+}
+
+void
+VFS_clear_cache(void)
+{
+#if 0 < VFS_RESOLVE_CACHE_SIZE
+  for (int i = 0; i < VFS_RESOLVE_CACHE_SIZE; i++) {
+    vfs_resolve_cache[i].used = false;
+  }
+#endif
+  VFS_clear_missing();
+}
+
+#if defined(PICORB_VM_MRUBY)
+
+#include "mruby/vfs.c"
+
+#elif defined(PICORB_VM_MRUBYC)
+
+#include "mrubyc/vfs.c"
+
+#endif
@@ -0,0 +1,146 @@
+# The test file is also `load`ed on CRuby to discover the test classes, where
+# "littlefs" does not exist; see picoruby-sqlite3/test/sqlite3_test.rb
+begin
+  require "littlefs"
+rescue LoadError
+end
+
+# File on the RAM backed littlefs volume (ports/posix) that sqlite3_test.rb
+# also mounts at "/". The read buffer is shrunk to a few bytes so that lines
+# and separators cross its boundary, as they cross sectors on a device.
+class VFSFileTest < Picotest::Test
+  def setup
+    skip "no VFS on wasm" if wasm?
+    unless VFS::VOLUMES.any? { |v| v[:mountpoint] == "/" }
+      fs = Littlefs.new(:flash, label: "VFSTEST")
+      fs.mkfs
+      VFS.mount(fs, "/")
+    end
+  end
+
+  def write_file(path, data)
+    File.open(path, "w") { |f| f.write(data) }
+  end
+
+  # Opens path with a read buffer of size bytes
+  def open_buffered(path, size, mode = "r")
+    f = File.open(path, mode)
+    f.instance_variable_set(:@buffer_size, size)
+    f
+  end
+
+  def gets_all(path, size, *args)
+    f = open_buffered(path, size)
+    lines = []
+    while line = f.gets(*args)
+      lines << line
+    end
+    f.close
+    lines
+  end
+
+  def test_gets_multibyte_separator_across_buffers
+    # 6, 4, 5 and 1 bytes
+    write_file("/gets_sep.txt", "aäwöbwöccwöd")
+    size = 1
+    while size <= 9
+      assert_equal(["aäwö", "bwö", "ccwö", "d"], gets_all("/gets_sep.txt", size, "wö"))
+      size += 1
+    end
+  end
+
+  def test_gets_limit_counts_bytes
+    write_file("/gets_limit.txt", "äöü\nab")
+    size = 1
+    while size <= 7
+      f = open_buffered("/gets_limit.txt", size)
+      assert_equal("ä", f.gets(2))
+      assert_equal("öü", f.gets(4))
+      assert_equal("\n", f.gets(4))
+      assert_equal("ab", f.gets(4))
+      assert_nil(f.gets(4))
+      f.close
+      size += 1
+    end
+  end
+
+  def test_gets_separator_and_limit
+    # The limit of 5 bytes cuts the first line only
+    write_file("/gets_both.txt", "äbcdefwöhwö")
+    size = 1
+    while size <= 7
+      assert_equal(["äbcd", "efwö", "hwö"], gets_all("/gets_both.txt", size, "wö", 5))
+      size += 1
+    end
+  end
+
+  def test_gets_chomp_and_paragraph
+    write_file("/gets_chomp.txt", "one\ntwo\n\n\nthree")
+    f = open_buffered("/gets_chomp.txt", 3)
+    assert_equal("one", f.gets(chomp: true))
+    assert_equal("two\n\n", f.gets(""))
+    assert_equal("\n", f.gets)
+    assert_equal("three", f.gets)
+    assert_nil(f.gets)
+    f.close
+  end
+
+  def test_gets_after_byte_reads
+    write_file("/gets_mixed.txt", "éa\nöb\n")
+    f = open_buffered("/gets_mixed.txt", 4)
+    assert_equal(0xC3, f.getbyte)
+    assert_equal("\xA9a\n", f.gets)
+    assert_equal("ö", f.read(2))
+    assert_equal("b\n", f.gets)
+    f.close
+  end
+
+  def test_read_write_seek_tell
+    File.open("/rwst.txt", "w+") do |f|
+      assert_equal(11, f.write("hello world"))
+      assert_equal(11, f.tell)
+      f.seek(6)
+      assert_equal(6, f.tell)
+      assert_equal("wor", f.read(3))
+      assert_equal(9, f.tell)
+      f.seek(-3, File::SEEK_CUR)
+      f.write("WOR")
+      assert_equal(9, f.tell)
+      f.rewind
+      assert_equal("hello WORld", f.read)
+      f.seek(-2, File::SEEK_END)
+      assert_equal("ld", f.read(2))
+      assert_nil(f.read(1))
+      assert_true(f.eof?)
+    end
+  end
+
+  def test_write_after_buffered_read_lands_at_reader
+    write_file("/rw_pos.txt", "0123456789")
+    f = open_buffered("/rw_pos.txt", 4, "r+")
+    assert_equal("01", f.read(2))
+    f.write("ab")
+    assert_equal(4, f.tell)
+    assert_equal("45", f.read(2))
+    f.close
+    assert_equal("01ab456789", File.open("/rw_pos.txt") { |g| g.read })
+  end
+
+  def test_close_flushes_buffered_writes
+    f = File.open("/flush_close.txt", "w")
+    f.write("abc")
+    f.puts("def")
+    f.close
+    assert_equal("abcdef\n", File.open("/flush_close.txt") { |g| g.read })
+    # The block form closes, and so flushes, too
+    File.open("/flush_close.txt", "a") { |g| g.write("ghi") }
+    assert_equal("abcdef\nghi", File.open("/flush_close.txt") { |g| g.read })
+  end
+
+  def test_size_flushes_buffered_writes
+    File.open("/flush_size.txt", "w") do |f|
+      f.write("12345")
+      assert_equal(5, f.size)
+    end
+  end
+end
@@ -0,0 +1,273 @@
+# A driver that keeps its files in a Hash and counts the exist? calls that
+# reach it, so the tests see what VFS answers from its caches
+class VFSTestDriver
+  attr_reader :mountpoint, :files, :exist_calls, :opened
+
+  def initialize
+    @files = {}
+    @exist_calls = 0
+    @opened = []
+  end
+
+  def prefix
+    ""
+  end
+
+  def mount(mountpoint)
+    @mountpoint = mountpoint
+  end
+
+  def unmount
+  end
+
+  def exist?(path)
+    @exist_calls += 1
+    @files.key?(path)
+  end
+
+  def directory?(path)
+    false
+  end
+
+  def open_file(path, mode)
+    @opened << path
+    @files[path] = VFSTestFile.new
+  end
+
+  def unlink(path)
+    @files.delete(path)
+  end
+end
+
+# A file of VFSTestDriver whose writes fail while full is set
+class VFSTestFile
+  attr_accessor :full
+  attr_reader :data
+
+  def initialize
+    @data = ""
+    @full = false
+  end
+
+  def sector_size
+    0
+  end
+
+  def write(str)
+    raise IOError, "no space left on device" if @full
+    @data << str
+    str.bytesize
+  end
+
+  def close
+  end
+end
+
+# The mount table, path resolution and lookup caches of src/vfs.c
+class VFSTest < Picotest::Test
+  def setup
+    skip "no VFS on wasm" if wasm?
+    @pwd = ENV["PWD"]
+    @root = VFSTestDriver.new
+    @sd = VFSTestDriver.new
+    VFS.mount(@root, "/vfs_test")
+    VFS.mount(@sd, "/vfs_test/sd")
+  end
+
+  def teardown
+    [@sd, @root].each do |driver|
+      VFS.unmount(driver, true) if VFS.volume_index(driver.mountpoint)
+    end
+    if @pwd
+      ENV["PWD"] = @pwd
+    else
+      ENV.delete("PWD")
+    end
+    VFS.clear_cache
+  end
+
+  # VFS.sanitize and VFS.split as they were written in Ruby, before the C
+  # implementation
+
+  def old_sanitize(path)
+    dirs = case path
+    when "/"
+      [""]
+    when ""
+      return ENV["HOME"].to_s
+    else
+      path.split("/")
+    end
+    if dirs[0] != ""
+      dirs = (ENV["PWD"] || "").split("/") + dirs
+    end
+    sanitized_dirs = []
+    prefix_dirs = []
+    i = 0
+    while i < dirs.size
+      dir = dirs[i]
+      unless dir == "." || dir == ""
+        if dir == ".."
+          if sanitized_dirs.empty?
+            prefix_dirs << ".."
+          else
+            sanitized_dirs.pop
+          end
+        else
+          sanitized_dirs << dir
+        end
+      end
+      i += 1
+    end
+    "#{prefix_dirs.join("/")}/#{sanitized_dirs.join("/")}"
+  end
+
+  def old_split(sanitized_path)
+    volume = nil
+    best_len = -1
+    i = 0
+    while i < VFS::VOLUMES.size
+      v = VFS::VOLUMES[i]
+      if sanitized_path.start_with?(v[:mountpoint]) && best_len < v[:mountpoint].length
+        volume = v
+        best_len = v[:mountpoint].length
+      end
+      i += 1
+    end
+    if volume
+      cut = volume[:mountpoint] == "/" ? 0 : 1
+      [volume, "/#{sanitized_path[volume[:mountpoint].length + cut, 255]}"]
+    else
+      [VFS::VOLUMES[0], sanitized_path]
+    end
+  end
+
+  PARITY_PATHS = [
+    "/", "/home", "home", "home/", ".", "./a/../b", "a/./b//c", "../x",
+    "../../x/y", "/a/b/../../..", "..", "", "/vfs_test", "/vfs_test/a",
+    "/vfs_test/sd", "/vfs_test/sd/home/", "sd/../sd/x"
+  ]
+
+  def test_sanitize_and_split_match_the_ruby_implementation
+    ["/", "/home", "/vfs_test", "/vfs_test/sd", ""].each do |pwd|
+      ENV["PWD"] = pwd
+      PARITY_PATHS.each do |path|
+        sanitized = VFS.sanitize(path)
+        assert_equal(old_sanitize(path), sanitized)
+        volume, _path = VFS.split(sanitized)
+        old_volume, old_path = old_split(sanitized)
+        assert_equal(old_volume[:mountpoint], volume[:mountpoint])
+        assert_equal(old_path, _path)
+        volume, _path = VFS.lookup(path)
+        assert_equal(old_volume[:mountpoint], volume[:mountpoint])
+        assert_equal(old_path, _path)
+      end
+    end
+  end
+
+  # The Ruby implementation made "//" relative to PWD
+  def test_double_slash_is_the_root
+    ENV["PWD"] = "/vfs_test/sd"
+    assert_equal("/vfs_test/sd", old_sanitize("//"))
+    assert_equal("/", VFS.sanitize("//"))
+  end
+
+  # The Ruby implementation matched mountpoints as string prefixes, so
+  # "/vfs_testx/a" landed on "/vfs_test" as "//a"
+  def test_mountpoints_match_whole_components
+    old_volume, old_path = old_split("/vfs_testx/a")
+    assert_equal("/vfs_test", old_volume[:mountpoint])
+    assert_equal("//a", old_path)
+    volume, path = VFS.split("/vfs_testx/a")
+    assert_equal(VFS::VOLUMES[0][:mountpoint], volume[:mountpoint])
+    assert_equal("/vfs_testx/a", path)
+    volume, path = VFS.split("/vfs_test/sdcard")
+    assert_equal("/vfs_test", volume[:mountpoint])
+    assert_equal("/sdcard", path)
+  end
+
+  def test_missing_path_is_cached
+    assert_false(VFS.exist?("/vfs_test/nothing"))
+    calls = @root.exist_calls
+    assert_false(VFS.exist?("/vfs_test/nothing"))
+    assert_equal(calls, @root.exist_calls)
+    # An existing file is asked for every time
+    @root.files["/here"] = ""
+    assert_true(VFS.exist?("/vfs_test/here"))
+    assert_true(VFS.exist?("/vfs_test/here"))
+    assert_equal(calls + 2, @root.exist_calls)
+  end
+
+  # A file created without VFS stays hidden while its miss is cached
+  def test_clear_cache_shows_a_file_created_by_the_driver
+    assert_false(VFS.exist?("/vfs_test/later"))
+    @root.files["/later"] = ""
+    assert_false(VFS.exist?("/vfs_test/later"))
+    VFS.clear_cache
+    assert_true(VFS.exist?("/vfs_test/later"))
+  end
+
+  def test_opening_to_write_clears_the_missing_paths
+    assert_false(VFS.exist?("/vfs_test/new"))
+    VFS::File.open("/vfs_test/new", "w")
+    assert_equal(["/new"], @root.opened)
+    assert_true(VFS.exist?("/vfs_test/new"))
+    # Opening to read keeps them
+    assert_false(VFS.exist?("/vfs_test/other"))
+    @root.files["/other"] = ""
+    VFS::File.open("/vfs_test/new", "r")
+    assert_false(VFS.exist?("/vfs_test/other"))
+  end
+
+  def test_flush_keeps_the_buffer_when_the_write_fails
+    f = File.open("/vfs_test/full", "w")
+    f.write("data")
+    file = @root.files["/full"]
+    file.full = true
+    assert_raise(IOError) { f.flush }
+    assert_equal("", file.data)
+    file.full = false
+    f.close
+    assert_equal("data", file.data)
+  end
+
+  def test_mount_clears_the_caches
+    assert_false(VFS.exist?("/vfs_test/cf/a"))
+    assert_equal("/vfs_test", VFS.lookup("/vfs_test/cf/a")[0][:mountpoint])
+    cf = VFSTestDriver.new
+    cf.files["/a"] = ""
+    VFS.mount(cf, "/vfs_test/cf")
+    begin
+      volume, path = VFS.lookup("/vfs_test/cf/a")
+      assert_equal("/vfs_test/cf", volume[:mountpoint])
+      assert_equal("/a", path)
+      assert_true(VFS.exist?("/vfs_test/cf/a"))
+    ensure
+      VFS.unmount(cf)
+    end
+  end
+
+  def test_unmount_clears_the_caches
+    @sd.files["/a"] = ""
+    assert_true(VFS.exist?("/vfs_test/sd/a"))
+    assert_equal("/vfs_test/sd", VFS.lookup("/vfs_test/sd/a")[0][:mountpoint])
+    # The mountpoint has no trailing slash in the mount table
+    VFS.unmount(@sd)
+    assert_nil(VFS.volume_index("/vfs_test/sd"))
+    volume, path = VFS.lookup("/vfs_test/sd/a")
+    assert_equal("/vfs_test", volume[:mountpoint])
+    assert_equal("/sd/a", path)
+    assert_false(VFS.exist?("/vfs_test/sd/a"))
+  end
+
+  def test_unmount_refuses_the_working_directory
+    ENV["PWD"] = "/vfs_test/sd/dir"
+    assert_raise(RuntimeError) do
+      VFS.unmount(@sd)
+    end
+    # A sibling that only shares the prefix is not inside
+    ENV["PWD"] = "/vfs_test/sdcard"
+    VFS.unmount(@sd)
+    assert_nil(VFS.volume_index("/vfs_test/sd"))
+  end
+end
@@ -0,0 +1,144 @@
+#ifndef YAML_DEFINED_H_
+#define YAML_DEFINED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Deepest nesting of collections. The parser recurses on the C stack,
+ * which is small on microcontrollers. */
+#ifndef YAML_MAX_DEPTH
+#define YAML_MAX_DEPTH 32
+#endif
+
+/* Bytes read from an IO at a time */
+#ifndef YAML_READ_BUFFER_SIZE
+#define YAML_READ_BUFFER_SIZE 256
+#endif
+
+/* Longest anchor name */
+#define YAML_ANCHOR_SIZE 32
+
+/*
+ * Event parser for the YAML subset used by configuration files:
+ *
+ * - block mappings and sequences, including "- key: value" items and
+ *   sequences at the indentation of their key
+ * - flow collections ([a, b], {a: 1}) over any number of lines
+ * - plain, 'single' and "double" quoted scalars, folded over lines
+ * - literal (|) and folded (>) block scalars with chomping and
+ *   indentation indicators
+ * - anchors (&a), aliases (*a) and comments; tags are skipped except
+ *   !!str, which keeps a plain scalar a String
+ *
+ * Only the first document is read. The source is a string or a fill
+ * callback; with the latter, bytes are pulled YAML_READ_BUFFER_SIZE at a
+ * time and the whole text is never held. Scalars are collected in a
+ * scratch buffer grown with the realloc callback and handed to the
+ * handler one event at a time, so the VM glue builds the values as the
+ * text is read.
+ */
+
+typedef enum {
+  YAML_EVENT_SCALAR,
+  YAML_EVENT_ALIAS,
+  YAML_EVENT_SEQ_START,
+  YAML_EVENT_SEQ_END,
+  YAML_EVENT_MAP_START,
+  YAML_EVENT_MAP_END,
+} yaml_event_type_t;
+
+typedef enum {
+  YAML_STYLE_PLAIN,
+  YAML_STYLE_SINGLE_QUOTED,
+  YAML_STYLE_DOUBLE_QUOTED,
+  YAML_STYLE_LITERAL,
+  YAML_STYLE_FOLDED,
+} yaml_style_t;
+
+typedef struct {
+  yaml_event_type_t type;
+  /* Scalar text or alias name; not NUL-terminated */
+  const char *value;
+  size_t len;
+  yaml_style_t style;
+  /* Tagged !!str */
+  bool tag_str;
+  /* Anchor of the node, if any */
+  const char *anchor;
+  size_t anchor_len;
+} yaml_event_t;
+
+/* Return false to stop parsing; the handler sets its own error */
+typedef bool (*yaml_handler_t)(void *ctx, const yaml_event_t *event);
+/* Read up to size bytes into buf; 0 at the end */
+typedef size_t (*yaml_fill_t)(void *ctx, uint8_t *buf, size_t size);
+/* realloc(3) with the VM's allocator; free when size is 0 */
+typedef void *(*yaml_realloc_t)(void *ctx, void *ptr, size_t size);
+
+typedef struct {
+  /* Input window */
+  const uint8_t *src;
+  size_t pos;
+  size_t len;
+  uint8_t *buf;
+  yaml_fill_t fill;
+  bool eof;
+  /* Position of src[pos] */
+  int line;
+  int column;
+  /* Only blanks so far on this line */
+  bool bol;
+  /* Scratch for the scalar being read */
+  char *scratch;
+  size_t slen;
+  size_t scapa;
+  /* Node properties waiting for their node */
+  char anchor[YAML_ANCHOR_SIZE];
+  size_t anchor_len;
+  bool tag_str;
+  int depth;
+  yaml_handler_t handler;
+  yaml_realloc_t realloc;
+  void *ctx;
+  /* Static message; line is 1-origin */
+  const char *error;
+  int error_line;
+  /* Set when the handler stopped the parser */
+  bool stopped;
+} yaml_parser_t;
+
+void YAML_parser_init(yaml_parser_t *p, const uint8_t *src, size_t len,
+                      yaml_handler_t handler, yaml_realloc_t realloc, void *ctx);
+/* buf must have YAML_READ_BUFFER_SIZE bytes */
+void YAML_parser_init_io(yaml_parser_t *p, uint8_t *buf, yaml_fill_t fill,
+                         yaml_handler_t handler, yaml_realloc_t realloc, void *ctx);
+/* Parse the first document. Returns false with error set, or with
+ * stopped set by the handler. An empty document yields no events. */
+bool YAML_parse(yaml_parser_t *p);
+/* Free the scratch buffer */
+void YAML_parser_free(yaml_parser_t *p);
+
+typedef enum {
+  YAML_SCALAR_STRING,
+  YAML_SCALAR_NULL,
+  YAML_SCALAR_TRUE,
+  YAML_SCALAR_FALSE,
+  YAML_SCALAR_INTEGER,
+  YAML_SCALAR_FLOAT,
+} yaml_scalar_t;
+
+/* Resolve a scalar event by the YAML 1.2 core schema. Only plain
+ * scalars resolve to anything but a String. An integer that does not
+ * fit in int64_t is a float. */
+yaml_scalar_t YAML_resolve(const yaml_event_t *event, int64_t *ival, double *fval);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* YAML_DEFINED_H_ */
@@ -1,20 +1,22 @@
 #
 # YAM library for PicoRuby
 # This is a simple YAML library for PicoRuby.
-# It is designed to be small and simple, not to be fast or complete.
+# It loads the subset of YAML that configuration files use; see
+# include/yaml.h for what is supported.
 #
 # Author: Hitoshi HASUMI
 # License: MIT
 #
 
 module YAML
-  def self.load(yaml_string)
-    parse(yaml_string)
-  end
+  class SyntaxError < StandardError; end
+
+  # YAML.load(source) is implemented in C (src/yaml.c). source is a
+  # String or an IO; an IO is read a chunk at a time.
 
   def self.load_file(file_path)
     File.open(file_path, "r") do |file|
-      parse(file.read)
+      load(file)
     end
   end
 
@@ -24,88 +26,10 @@ module YAML
 
 #  private
 
-  def self.parse(yaml_string)
-    lines = yaml_string.split("\n")
-    root = {} #: Hash[untyped, untyped]
-    stack = [root] #: Array[untyped]
-    indent_stack = [-1]
-    prev_indent = -1
-
-    li = 0
-    while li < lines.size
-      line = lines[li]
-      li += 1
-      line_strip = line.strip
-      next if line_strip.empty? || line_strip.start_with?('#')
-
-      indent = count_leading_spaces(line)
-      is_list_item = line_strip.start_with?('-')
-
-      if is_list_item
-        key, value = parse_list_item(line_strip)
-      else
-        key, value = split_key_value(line_strip)
-      end
-
-      while indent <= indent_stack.last && 1 < stack.size
-        indent_stack.pop
-        stack.pop
-      end
-
-      current_object = stack.last
-
-      if is_list_item
-        if !current_object.is_a?(Array)
-          new_array = [] #: Array[untyped]
-          if 1 < stack.size && stack[-2].is_a?(Hash)
-            last_key = stack[-2].keys.last
-            stack[-2][last_key] = new_array
-          end
-          stack[-1] = new_array
-          current_object = new_array
-        end
-        if value.nil? || value.empty?
-          new_item = {} #: Hash[untyped, untyped]
-          current_object << new_item
-          stack.push(new_item)
-          indent_stack.push(indent)
-        else
-          current_object << parse_value(value)
-        end
-      else
-        if value.nil? || value.empty?
-          new_item = {} #: Hash[untyped, untyped]
-          current_object[key] = new_item
-          stack.push(new_item)
-          indent_stack.push(indent)
-        else
-          current_object[key] = parse_value(value)
-        end
-      end
-
-      prev_indent = indent
-    end
-
-    root
-  end
-
-  def self.parse_value(value)
-    if is_integer?(value)
-      value.to_i
-    elsif is_float?(value)
-      value.to_f
-    elsif is_boolean?(value)
-      value.downcase == 'true'
-    elsif is_null?(value)
-      nil
-    else
-      value
-    end
-  end
-
   def self.serialize(object, indent = 0)
     case object
     when Hash
+      return "{}" if object.empty?
       yaml = ""
       keys = object.keys
       ki = 0
@@ -115,7 +39,7 @@ module YAML
         yaml << "#{' ' * indent}#{key}:"
         if value.nil?
           yaml << " null\n"
-        elsif value.is_a?(Hash) || value.is_a?(Array)
+        elsif (value.is_a?(Hash) || value.is_a?(Array)) && !value.empty?
           yaml << "\n" + serialize(value, indent + 2)
         else
           yaml << " #{serialize(value)}\n"
@@ -124,6 +48,7 @@ module YAML
       end
       yaml
     when Array
+      return "[]" if object.empty?
       yaml = ""
       # @type var object: Array
       ai = 0
@@ -133,7 +58,7 @@ module YAML
         yaml << "#{' ' * indent}- "
         if item.nil?
           yaml << "null\n"
-        elsif item.is_a?(Hash) || item.is_a?(Array)
+        elsif (item.is_a?(Hash) || item.is_a?(Array)) && !item.empty?
           yaml << "\n" + serialize(item, indent + 2)
         else
           yaml << "#{serialize(item)}\n"
@@ -142,22 +67,55 @@ module YAML
       end
       yaml
     else
-      object.to_s
+      scalar = object.to_s
+      object.is_a?(String) && quote?(scalar) ? quote(scalar) : scalar
     end
   end
 
-  def self.count_leading_spaces(string)
-    string.length - string.lstrip.length
-  end
-
-  def self.split_key_value(string)
-    parts = string.split(':', 2)
-    [parts[0].strip, parts[1]&.strip]
+  HEX_DIGITS = "0123456789abcdef"
+
+  # A double-quoted scalar with only the escapes YAML.load reads.
+  # String#inspect also writes "#{" as "\#{", and YAML has no "\#" escape.
+  def self.quote(string)
+    quoted = "\""
+    len = string.bytesize
+    start = 0
+    i = 0
+    while i < len
+      byte = string.getbyte(i) || 0
+      if byte < 0x20 || byte == 0x22 || byte == 0x5C || byte == 0x7F
+        quoted << string.byteslice(start, i - start).to_s if start < i
+        case byte
+        when 0x22 then quoted << "\\\""
+        when 0x5C then quoted << "\\\\"
+        when 0x0A then quoted << "\\n"
+        when 0x09 then quoted << "\\t"
+        when 0x0D then quoted << "\\r"
+        else
+          quoted << "\\x" << HEX_DIGITS[byte >> 4].to_s << HEX_DIGITS[byte & 0x0F].to_s
+        end
+        start = i + 1
+      end
+      i += 1
+    end
+    quoted << string.byteslice(start, len - start).to_s if start < len
+    quoted << "\""
   end
 
-  def self.parse_list_item(string)
-    parts = string.split(' ', 2)
-    [nil, parts[1]&.strip]
+  # Whether a String would not load back as itself when written plain
+  def self.quote?(string)
+    return true if string.empty? || string.strip != string
+    return true if is_integer?(string) || is_float?(string) || is_boolean?(string) || is_null?(string)
+    return true if string == "~" || string.include?(": ") || string.include?(" #") || string.include?("\n")
+    return true if string.end_with?(":")
+    len = string.bytesize
+    i = 0
+    while i < len
+      byte = string.getbyte(i) || 0
+      return true if byte < 0x20 || byte == 0x7F
+      i += 1
+    end
+    "-?:,[]{}#&*!|>'\"%@`".include?(string[0].to_s)
   end
 
   def self.is_integer?(string)
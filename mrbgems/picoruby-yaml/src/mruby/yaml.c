@@ -0,0 +1,250 @@
+#include "mruby.h"
+#include "mruby/presym.h"
+#include "mruby/string.h"
+#include "mruby/array.h"
+#include "mruby/hash.h"
+#include "mruby/class.h"
+#include "mruby/error.h"
+
+/*
+ * Builder
+ *
+ * Containers being filled and their pending keys live in the stack
+ * Array so that the GC sees them: the root at 0, then a container and a
+ * key for each open collection.
+ */
+
+typedef struct {
+  bool map;
+  bool has_key;
+  /* The pending key is a plain "<<" */
+  bool merge;
+} yaml_frame_t;
+
+typedef struct {
+  mrb_state *mrb;
+  yaml_parser_t parser;
+  mrb_value io;
+  mrb_value stack;
+  mrb_value anchors;
+  yaml_frame_t frames[YAML_MAX_DEPTH];
+  int depth;
+  bool done;
+  const char *error;
+} yaml_load_t;
+
+static void *
+yaml_realloc(void *ctx, void *ptr, size_t size)
+{
+  mrb_state *mrb = ((yaml_load_t *)ctx)->mrb;
+  if (size == 0) {
+    mrb_free(mrb, ptr);
+    return NULL;
+  }
+  return mrb_realloc_simple(mrb, ptr, size);
+}
+
+static size_t
+yaml_fill(void *ctx, uint8_t *buf, size_t size)
+{
+  yaml_load_t *l = (yaml_load_t *)ctx;
+  mrb_state *mrb = l->mrb;
+  int ai = mrb_gc_arena_save(mrb);
+
+  mrb_value chunk = mrb_funcall_id(mrb, l->io, MRB_SYM(read), 1, mrb_int_value(mrb, (mrb_int)size));
+  size_t len = 0;
+  if (mrb_string_p(chunk)) {
+    len = RSTRING_LEN(chunk);
+    if (size < len) len = size;
+    memcpy(buf, RSTRING_PTR(chunk), len);
+  }
+  mrb_gc_arena_restore(mrb, ai);
+  return len;
+}
+
+static mrb_value
+yaml_scalar_value(mrb_state *mrb, const yaml_event_t *e)
+{
+  int64_t ival;
+  double fval;
+
+  switch (YAML_resolve(e, &ival, &fval)) {
+    case YAML_SCALAR_NULL:
+      return mrb_nil_value();
+    case YAML_SCALAR_TRUE:
+      return mrb_true_value();
+    case YAML_SCALAR_FALSE:
+      return mrb_false_value();
+    case YAML_SCALAR_INTEGER:
+      if (MRB_INT_MIN <= ival && ival <= MRB_INT_MAX) {
+        return mrb_int_value(mrb, (mrb_int)ival);
+      }
+      fval = (double)ival;
+      /* fall through */
+    case YAML_SCALAR_FLOAT:
+#ifndef MRB_NO_FLOAT
+      return mrb_float_value(mrb, (mrb_float)fval);
+#endif
+    default:
+      return mrb_str_new(mrb, e->value, e->len);
+  }
+}
+
+/* <<: merges the entries of a Hash, or of each Hash in an Array, that
+ * the mapping does not have yet */
+static void
+yaml_merge(mrb_state *mrb, mrb_value hash, mrb_value src)
+{
+  if (mrb_array_p(src)) {
+    for (mrb_int i = 0; i < RARRAY_LEN(src); i++) {
+      yaml_merge(mrb, hash, RARRAY_PTR(src)[i]);
+    }
+    return;
+  }
+  if (!mrb_hash_p(src)) return;
+  mrb_value keys = mrb_hash_keys(mrb, src);
+  for (mrb_int i = 0; i < RARRAY_LEN(keys); i++) {
+    mrb_value key = RARRAY_PTR(keys)[i];
+    if (!mrb_hash_key_p(mrb, hash, key)) {
+      mrb_hash_set(mrb, hash, key, mrb_hash_get(mrb, src, key));
+    }
+  }
+}
+
+static void
+yaml_add(yaml_load_t *l, mrb_value value, bool merge_key)
+{
+  mrb_state *mrb = l->mrb;
+
+  if (l->depth == 0) {
+    mrb_ary_set(mrb, l->stack, 0, value);
+    l->done = true;
+    return;
+  }
+  yaml_frame_t *f = &l->frames[l->depth - 1];
+  mrb_int slot = 2 * l->depth - 1;
+  mrb_value container = mrb_ary_ref(mrb, l->stack, slot);
+  if (!f->map) {
+    mrb_ary_push(mrb, container, value);
+  } else if (!f->has_key) {
+    mrb_ary_set(mrb, l->stack, slot + 1, value);
+    f->has_key = true;
+    f->merge = merge_key;
+  } else {
+    if (f->merge) {
+      yaml_merge(mrb, container, value);
+    } else {
+      mrb_hash_set(mrb, container, mrb_ary_ref(mrb, l->stack, slot + 1), value);
+    }
+    f->has_key = false;
+  }
+}
+
+static bool
+yaml_handler(void *ctx, const yaml_event_t *e)
+{
+  yaml_load_t *l = (yaml_load_t *)ctx;
+  mrb_state *mrb = l->mrb;
+  int ai = mrb_gc_arena_save(mrb);
+  mrb_value value;
+
+  switch (e->type) {
+    case YAML_EVENT_SCALAR:
+    case YAML_EVENT_ALIAS:
+      if (e->type == YAML_EVENT_ALIAS) {
+        mrb_value name = mrb_str_new(mrb, e->value, e->len);
+        if (!mrb_hash_key_p(mrb, l->anchors, name)) {
+          l->error = "found undefined alias";
+          mrb_gc_arena_restore(mrb, ai);
+          return false;
+        }
+        value = mrb_hash_get(mrb, l->anchors, name);
+      } else {
+        value = yaml_scalar_value(mrb, e);
+      }
+      if (e->anchor) mrb_hash_set(mrb, l->anchors, mrb_str_new(mrb, e->anchor, e->anchor_len), value);
+      yaml_add(l, value, e->type == YAML_EVENT_SCALAR && e->style == YAML_STYLE_PLAIN &&
+                         e->len == 2 && memcmp(e->value, "<<", 2) == 0);
+      break;
+    case YAML_EVENT_SEQ_START:
+    case YAML_EVENT_MAP_START:
+      value = e->type == YAML_EVENT_MAP_START ? mrb_hash_new(mrb) : mrb_ary_new(mrb);
+      /* Anchored before its contents, so that they may refer to it */
+      if (e->anchor) mrb_hash_set(mrb, l->anchors, mrb_str_new(mrb, e->anchor, e->anchor_len), value);
+      yaml_add(l, value, false);
+      l->frames[l->depth].map = e->type == YAML_EVENT_MAP_START;
+      l->frames[l->depth].has_key = false;
+      l->depth++;
+      mrb_ary_set(mrb, l->stack, 2 * l->depth - 1, value);
+      mrb_ary_set(mrb, l->stack, 2 * l->depth, mrb_nil_value());
+      break;
+    case YAML_EVENT_SEQ_END:
+    case YAML_EVENT_MAP_END:
+      l->depth--;
+      mrb_ary_resize(mrb, l->stack, 2 * l->depth + 1);
+      break;
+  }
+  mrb_gc_arena_restore(mrb, ai);
+  return true;
+}
+
+static mrb_value
+yaml_load_body(mrb_state *mrb, void *ud)
+{
+  yaml_load_t *l = (yaml_load_t *)ud;
+  return mrb_bool_value(YAML_parse(&l->parser));
+}
+
+/*
+ * YAML.load(source)
+ *
+ * source is a String or an IO that answers read. An empty document
+ * loads as an empty Hash.
+ */
+static mrb_value
+mrb_yaml_s_load(mrb_state *mrb, mrb_value self)
+{
+  mrb_value source;
+  uint8_t buf[YAML_READ_BUFFER_SIZE];
+  yaml_load_t l;
+  mrb_bool raised = FALSE;
+
+  mrb_get_args(mrb, "o", &source);
+  memset(&l, 0, sizeof(l));
+  l.mrb = mrb;
+  l.stack = mrb_ary_new_capa(mrb, 1 + 2 * 4);
+  mrb_ary_push(mrb, l.stack, mrb_nil_value());
+  l.anchors = mrb_hash_new(mrb);
+  if (mrb_string_p(source)) {
+    YAML_parser_init(&l.parser, (const uint8_t *)RSTRING_PTR(source), RSTRING_LEN(source),
+                     yaml_handler, yaml_realloc, &l);
+  } else if (mrb_respond_to(mrb, source, MRB_SYM(read))) {
+    l.io = source;
+    YAML_parser_init_io(&l.parser, buf, yaml_fill, yaml_handler, yaml_realloc, &l);
+  } else {
+    mrb_raise(mrb, E_TYPE_ERROR, "no implicit conversion into String");
+  }
+  /* The scratch buffer must be freed even when read raises */
+  mrb_value ret = mrb_protect_error(mrb, yaml_load_body, &l, &raised);
+  YAML_parser_free(&l.parser);
+  if (raised) mrb_exc_raise(mrb, ret);
+  if (!mrb_test(ret)) {
+    struct RClass *module_YAML = mrb_module_get_id(mrb, MRB_SYM(YAML));
+    mrb_raisef(mrb, mrb_class_get_under_id(mrb, module_YAML, MRB_SYM(SyntaxError)), "%s at line %d",
+               l.error ? l.error : l.parser.error, l.parser.error_line ? l.parser.error_line : l.parser.line + 1);
+  }
+  return l.done ? mrb_ary_ref(mrb, l.stack, 0) : mrb_hash_new(mrb);
+}
+
+void
+mrb_picoruby_yaml_gem_init(mrb_state* mrb)
+{
+  struct RClass *module_YAML = mrb_define_module_id(mrb, MRB_SYM(YAML));
+
+  mrb_define_class_method_id(mrb, module_YAML, MRB_SYM(load), mrb_yaml_s_load, MRB_ARGS_REQ(1));
+}
+
+void
+mrb_picoruby_yaml_gem_final(mrb_state* mrb)
+{
+}
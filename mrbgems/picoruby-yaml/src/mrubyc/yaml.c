@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <mrubyc.h>
+
+/*
+ * Builder
+ *
+ * Each open collection holds a reference to its container and to its
+ * pending key; the parent holds another to the container. Everything
+ * still held is released if the parser stops halfway.
+ */
+
+typedef struct {
+  mrbc_value container;
+  mrbc_value key;
+  bool map;
+  bool has_key;
+  /* The pending key is a plain "<<" */
+  bool merge;
+} yaml_frame_t;
+
+typedef struct {
+  mrbc_vm *vm;
+  mrbc_value *v;
+  int argc;
+  yaml_parser_t parser;
+  mrbc_value *io;
+  mrbc_value root;
+  mrbc_value anchors;
+  yaml_frame_t frames[YAML_MAX_DEPTH];
+  int depth;
+  bool done;
+  const char *error;
+} yaml_load_t;
+
+static void *
+yaml_realloc(void *ctx, void *ptr, size_t size)
+{
+  mrbc_vm *vm = ((yaml_load_t *)ctx)->vm;
+  if (size == 0) {
+    mrbc_free(vm, ptr);
+    return NULL;
+  }
+  return ptr ? mrbc_realloc(vm, ptr, size) : mrbc_alloc(vm, size);
+}
+
+static size_t
+yaml_fill(void *ctx, uint8_t *buf, size_t size)
+{
+  yaml_load_t *l = (yaml_load_t *)ctx;
+  mrbc_value n = mrbc_integer_value((mrbc_int_t)size);
+  size_t len = 0;
+
+  mrbc_value chunk = mrbc_send(l->vm, l->v, l->argc, l->io, "read", 1, &n);
+  if (chunk.tt == MRBC_TT_STRING) {
+    len = chunk.string->size;
+    if (size < len) len = size;
+    memcpy(buf, chunk.string->data, len);
+  }
+  mrbc_decref(&chunk);
+  /* An exception ends the input; c_yaml_load leaves it pending */
+  if (l->vm->exception.tt == MRBC_TT_EXCEPTION) return 0;
+  return len;
+}
+
+static mrbc_value
+yaml_scalar_value(mrbc_vm *vm, const yaml_event_t *e)
+{
+  int64_t ival;
+  double fval;
+
+  switch (YAML_resolve(e, &ival, &fval)) {
+    case YAML_SCALAR_NULL:
+      return mrbc_nil_value();
+    case YAML_SCALAR_TRUE:
+      return mrbc_true_value();
+    case YAML_SCALAR_FALSE:
+      return mrbc_false_value();
+    case YAML_SCALAR_INTEGER:
+      if ((int64_t)(mrbc_int_t)ival == ival) {
+        return mrbc_integer_value((mrbc_int_t)ival);
+      }
+      fval = (double)ival;
+      /* fall through */
+    case YAML_SCALAR_FLOAT:
+#if MRBC_USE_FLOAT
+      return mrbc_float_value(vm, fval);
+#endif
+    default:
+      return mrbc_string_new(vm, e->value, e->len);
+  }
+}
+
+/* <<: merges the entries of a Hash, or of each Hash in an Array, that
+ * the mapping does not have yet */
+static void
+yaml_merge(mrbc_value *hash, mrbc_value *src)
+{
+  if (src->tt == MRBC_TT_ARRAY) {
+    for (int i = 0; i < mrbc_array_size(src); i++) {
+      mrbc_value item = mrbc_array_get(src, i);
+      yaml_merge(hash, &item);
+    }
+    return;
+  }
+  if (src->tt != MRBC_TT_HASH) return;
+  mrbc_hash_iterator ite = mrbc_hash_iterator_new(src);
+  while (mrbc_hash_i_has_next(&ite)) {
+    mrbc_value *kv = mrbc_hash_i_next(&ite);
+    if (mrbc_hash_search(hash, &kv[0])) continue;
+    mrbc_incref(&kv[0]);
+    mrbc_incref(&kv[1]);
+    mrbc_hash_set(hash, &kv[0], &kv[1]);
+  }
+}
+
+/* Takes over the reference to value */
+static void
+yaml_add(yaml_load_t *l, mrbc_value *value, bool merge_key)
+{
+  if (l->depth == 0) {
+    l->root = *value;
+    l->done = true;
+    return;
+  }
+  yaml_frame_t *f = &l->frames[l->depth - 1];
+  if (!f->map) {
+    mrbc_array_push(&f->container, value);
+  } else if (!f->has_key) {
+    f->key = *value;
+    f->has_key = true;
+    f->merge = merge_key;
+  } else {
+    if (f->merge) {
+      yaml_merge(&f->container, value);
+      mrbc_decref(value);
+      mrbc_decref(&f->key);
+    } else {
+      mrbc_hash_set(&f->container, &f->key, value);
+    }
+    f->key = mrbc_nil_value();
+    f->has_key = false;
+  }
+}
+
+static void
+yaml_anchor(yaml_load_t *l, const yaml_event_t *e, mrbc_value *value)
+{
+  mrbc_value name = mrbc_string_new(l->vm, e->anchor, e->anchor_len);
+  mrbc_incref(value);
+  mrbc_hash_set(&l->anchors, &name, value);
+}
+
+static bool
+yaml_handler(void *ctx, const yaml_event_t *e)
+{
+  yaml_load_t *l = (yaml_load_t *)ctx;
+  mrbc_value value;
+
+  switch (e->type) {
+    case YAML_EVENT_ALIAS: {
+      mrbc_value name = mrbc_string_new(l->vm, e->value, e->len);
+      mrbc_value *key = mrbc_hash_search(&l->anchors, &name);
+      mrbc_decref(&name);
+      if (!key) {
+        l->error = "found undefined alias";
+        return false;
+      }
+      /* The value follows its key */
+      value = key[1];
+      mrbc_incref(&value);
+      yaml_add(l, &value, false);
+      break;
+    }
+    case YAML_EVENT_SCALAR:
+      value = yaml_scalar_value(l->vm, e);
+      if (e->anchor) yaml_anchor(l, e, &value);
+      yaml_add(l, &value, e->style == YAML_STYLE_PLAIN && e->len == 2 && memcmp(e->value, "<<", 2) == 0);
+      break;
+    case YAML_EVENT_SEQ_START:
+    case YAML_EVENT_MAP_START: {
+      value = e->type == YAML_EVENT_MAP_START ? mrbc_hash_new(l->vm, 0) : mrbc_array_new(l->vm, 0);
+      /* Anchored before its contents, so that they may refer to it */
+      if (e->anchor) yaml_anchor(l, e, &value);
+      yaml_frame_t *f = &l->frames[l->depth];
+      f->container = value;
+      f->key = mrbc_nil_value();
+      f->map = e->type == YAML_EVENT_MAP_START;
+      f->has_key = false;
+      mrbc_incref(&value);
+      yaml_add(l, &value, false);
+      l->depth++;
+      break;
+    }
+    case YAML_EVENT_SEQ_END:
+    case YAML_EVENT_MAP_END:
+      l->depth--;
+      mrbc_decref(&l->frames[l->depth].container);
+      break;
+  }
+  return true;
+}
+
+/*
+ * YAML.load(source)
+ *
+ * source is a String or an IO that answers read. An empty document
+ * loads as an empty Hash.
+ */
+static void
+c_yaml_load(mrbc_vm *vm, mrbc_value *v, int argc)
+{
+  uint8_t buf[YAML_READ_BUFFER_SIZE];
+  yaml_load_t l;
+  mrbc_method method;
+
+  if (argc != 1) {
+    mrbc_raise(vm, MRBC_CLASS(ArgumentError), "wrong number of arguments");
+    return;
+  }
+  memset(&l, 0, sizeof(l));
+  l.vm = vm;
+  l.v = v;
+  l.argc = argc;
+  l.root = mrbc_nil_value();
+  if (GET_TT_ARG(1) == MRBC_TT_STRING) {
+    YAML_parser_init(&l.parser, GET_ARG(1).string->data, GET_ARG(1).string->size,
+                     yaml_handler, yaml_realloc, &l);
+  } else if (mrbc_find_method(&method, find_class_by_object(&v[1]), mrbc_str_to_symid("read"))) {
+    l.io = &v[1];
+    YAML_parser_init_io(&l.parser, buf, yaml_fill, yaml_handler, yaml_realloc, &l);
+  } else {
+    mrbc_raise(vm, MRBC_CLASS(TypeError), "no implicit conversion into String");
+    return;
+  }
+  l.anchors = mrbc_hash_new(vm, 0);
+  bool ok = YAML_parse(&l.parser);
+  YAML_parser_free(&l.parser);
+  mrbc_decref(&l.anchors);
+  if (ok && vm->exception.tt != MRBC_TT_EXCEPTION) {
+    if (!l.done) l.root = mrbc_hash_new(vm, 0);
+    SET_RETURN(l.root);
+    return;
+  }
+  while (0 < l.depth) {
+    l.depth--;
+    mrbc_decref(&l.frames[l.depth].container);
+    mrbc_decref(&l.frames[l.depth].key);
+  }
+  mrbc_decref(&l.root);
+  if (vm->exception.tt == MRBC_TT_EXCEPTION) return;
+
+  char message[96];
+  mrbc_class *cls = MRBC_CLASS(StandardError);
+  mrbc_class *module_YAML = mrbc_get_class_by_name("YAML");
+  if (module_YAML) {
+    mrbc_value *c = mrbc_get_class_const(module_YAML, mrbc_str_to_symid("SyntaxError"));
+    if (c && c->tt == MRBC_TT_CLASS) cls = c->cls;
+  }
+  snprintf(message, sizeof(message), "%s at line %d",
+           l.error ? l.error : l.parser.error,
+           l.parser.error_line ? l.parser.error_line : l.parser.line + 1);
+  mrbc_raise(vm, cls, message);
+}
+
+void
+mrbc_yaml_init(mrbc_vm *vm)
+{
+  mrbc_class *module_YAML = mrbc_define_module(vm, "YAML");
+
+  mrbc_define_method(vm, module_YAML, "load", c_yaml_load);
+}
@@ -0,0 +1,994 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../include/yaml.h"
+
+/*
+ * Input
+ *
+ * With an IO, src is buf and holds YAML_READ_BUFFER_SIZE bytes at most.
+ * The parser never looks more than four bytes ahead, so the unread rest
+ * is moved to the front and topped up when a peek runs past it.
+ */
+
+void
+YAML_parser_init(yaml_parser_t *p, const uint8_t *src, size_t len,
+                 yaml_handler_t handler, yaml_realloc_t realloc, void *ctx)
+{
+  memset(p, 0, sizeof(*p));
+  p->src = src;
+  p->len = len;
+  p->eof = true;
+  p->handler = handler;
+  p->realloc = realloc;
+  p->ctx = ctx;
+}
+
+void
+YAML_parser_init_io(yaml_parser_t *p, uint8_t *buf, yaml_fill_t fill,
+                    yaml_handler_t handler, yaml_realloc_t realloc, void *ctx)
+{
+  YAML_parser_init(p, buf, 0, handler, realloc, ctx);
+  p->buf = buf;
+  p->fill = fill;
+  p->eof = false;
+}
+
+void
+YAML_parser_free(yaml_parser_t *p)
+{
+  if (p->scratch) p->realloc(p->ctx, p->scratch, 0);
+  p->scratch = NULL;
+  p->slen = p->scapa = 0;
+}
+
+static inline bool
+yaml_break_p(int c)
+{
+  return c == '\n' || c == '\r';
+}
+
+static inline bool
+yaml_blank_p(int c)
+{
+  return c == ' ' || c == '\t';
+}
+
+static inline bool
+yaml_blankz_p(int c)
+{
+  return c < 0 || yaml_blank_p(c) || yaml_break_p(c);
+}
+
+static inline bool
+yaml_flow_indicator_p(int c)
+{
+  return c == ',' || c == '[' || c == ']' || c == '{' || c == '}';
+}
+
+static int
+yaml_peek_at(yaml_parser_t *p, size_t k)
+{
+  if (p->pos + k < p->len) return p->src[p->pos + k];
+  if (p->eof) return -1;
+  memmove(p->buf, p->buf + p->pos, p->len - p->pos);
+  p->len -= p->pos;
+  p->pos = 0;
+  while (p->len <= k && !p->eof) {
+    size_t n = p->fill(p->ctx, p->buf + p->len, YAML_READ_BUFFER_SIZE - p->len);
+    if (n == 0) {
+      p->eof = true;
+    } else {
+      p->len += n;
+    }
+  }
+  return k < p->len ? p->src[k] : -1;
+}
+
+#define yaml_peek(p) yaml_peek_at((p), 0)
+
+static void
+yaml_next(yaml_parser_t *p)
+{
+  int c = yaml_peek(p);
+  if (c < 0) return;
+  p->pos++;
+  if (c == '\n') {
+    p->line++;
+    p->column = 0;
+    p->bol = true;
+  } else {
+    p->column++;
+    if (!yaml_blank_p(c)) p->bol = false;
+  }
+}
+
+static bool
+yaml_fail(yaml_parser_t *p, const char *message)
+{
+  if (!p->error) {
+    p->error = message;
+    p->error_line = p->line + 1;
+  }
+  return false;
+}
+
+static void
+yaml_skip_break(yaml_parser_t *p)
+{
+  if (yaml_peek(p) == '\r') yaml_next(p);
+  if (yaml_peek(p) == '\n') yaml_next(p);
+}
+
+static void
+yaml_skip_space(yaml_parser_t *p)
+{
+  while (yaml_blank_p(yaml_peek(p))) yaml_next(p);
+}
+
+static void
+yaml_skip_comment(yaml_parser_t *p)
+{
+  if (yaml_peek(p) != '#') return;
+  int c;
+  while ((c = yaml_peek(p)) >= 0 && !yaml_break_p(c)) yaml_next(p);
+}
+
+/* Skip blanks, comments and line breaks up to the next content */
+static void
+yaml_skip_to_content(yaml_parser_t *p)
+{
+  for (;;) {
+    yaml_skip_space(p);
+    yaml_skip_comment(p);
+    if (!yaml_break_p(yaml_peek(p))) return;
+    yaml_skip_break(p);
+  }
+}
+
+static bool
+yaml_document_marker_p(yaml_parser_t *p)
+{
+  if (p->column != 0) return false;
+  int c = yaml_peek(p);
+  if (c != '-' && c != '.') return false;
+  return yaml_peek_at(p, 1) == c && yaml_peek_at(p, 2) == c && yaml_blankz_p(yaml_peek_at(p, 3));
+}
+
+/*
+ * Scratch and events
+ */
+
+static bool
+yaml_push(yaml_parser_t *p, char c)
+{
+  if (p->slen == p->scapa) {
+    size_t capa = p->scapa ? p->scapa * 2 : 32;
+    char *s = (char *)p->realloc(p->ctx, p->scratch, capa);
+    if (!s) return yaml_fail(p, "out of memory");
+    p->scratch = s;
+    p->scapa = capa;
+  }
+  p->scratch[p->slen++] = c;
+  return true;
+}
+
+static bool
+yaml_push_breaks(yaml_parser_t *p, int n)
+{
+  while (0 < n--) {
+    if (!yaml_push(p, '\n')) return false;
+  }
+  return true;
+}
+
+static bool
+yaml_push_utf8(yaml_parser_t *p, uint32_t cp)
+{
+  if (cp < 0x80) return yaml_push(p, (char)cp);
+  if (cp < 0x800) {
+    return yaml_push(p, (char)(0xC0 | (cp >> 6))) &&
+           yaml_push(p, (char)(0x80 | (cp & 0x3F)));
+  }
+  if (cp < 0x10000) {
+    return yaml_push(p, (char)(0xE0 | (cp >> 12))) &&
+           yaml_push(p, (char)(0x80 | ((cp >> 6) & 0x3F))) &&
+           yaml_push(p, (char)(0x80 | (cp & 0x3F)));
+  }
+  return yaml_push(p, (char)(0xF0 | (cp >> 18))) &&
+         yaml_push(p, (char)(0x80 | ((cp >> 12) & 0x3F))) &&
+         yaml_push(p, (char)(0x80 | ((cp >> 6) & 0x3F))) &&
+         yaml_push(p, (char)(0x80 | (cp & 0x3F)));
+}
+
+/* Hand an event to the handler with the pending anchor and tag */
+static bool
+yaml_emit(yaml_parser_t *p, yaml_event_type_t type, const char *value, size_t len, yaml_style_t style)
+{
+  yaml_event_t event;
+
+  event.type = type;
+  event.value = value;
+  event.len = len;
+  event.style = style;
+  event.tag_str = p->tag_str;
+  event.anchor = p->anchor_len ? p->anchor : NULL;
+  event.anchor_len = p->anchor_len;
+  p->anchor_len = 0;
+  p->tag_str = false;
+  if (!p->handler(p->ctx, &event)) {
+    p->stopped = true;
+    return false;
+  }
+  return true;
+}
+
+static bool
+yaml_emit_scalar(yaml_parser_t *p, yaml_style_t style)
+{
+  return yaml_emit(p, YAML_EVENT_SCALAR, p->scratch, p->slen, style);
+}
+
+static bool
+yaml_emit_null(yaml_parser_t *p)
+{
+  return yaml_emit(p, YAML_EVENT_SCALAR, "", 0, YAML_STYLE_PLAIN);
+}
+
+/*
+ * Node properties and aliases
+ */
+
+static size_t
+yaml_scan_name(yaml_parser_t *p, char *name, size_t size)
+{
+  size_t len = 0;
+  int c;
+
+  while (!yaml_blankz_p(c = yaml_peek(p)) && !yaml_flow_indicator_p(c)) {
+    if (len == size) {
+      yaml_fail(p, "anchor name too long");
+      return 0;
+    }
+    name[len++] = (char)c;
+    yaml_next(p);
+  }
+  if (len == 0) yaml_fail(p, "did not find expected anchor name");
+  return len;
+}
+
+/* Anchor and tag in front of a node, kept until its first event */
+static bool
+yaml_parse_properties(yaml_parser_t *p)
+{
+  for (;;) {
+    int c = yaml_peek(p);
+    if (c == '&') {
+      yaml_next(p);
+      p->anchor_len = yaml_scan_name(p, p->anchor, sizeof(p->anchor));
+      if (p->anchor_len == 0) return false;
+    } else if (c == '!') {
+      char tag[6];
+      size_t len = 0;
+      while (!yaml_blankz_p(c = yaml_peek(p)) && !yaml_flow_indicator_p(c)) {
+        if (len < sizeof(tag)) tag[len] = (char)c;
+        len++;
+        yaml_next(p);
+      }
+      p->tag_str = (len == 5 && memcmp(tag, "!!str", 5) == 0);
+    } else {
+      return true;
+    }
+    yaml_skip_space(p);
+  }
+}
+
+/* "*name"; name must have YAML_ANCHOR_SIZE bytes */
+static size_t
+yaml_scan_alias(yaml_parser_t *p, char *name)
+{
+  yaml_next(p);
+  return yaml_scan_name(p, name, YAML_ANCHOR_SIZE);
+}
+
+static bool
+yaml_emit_alias(yaml_parser_t *p, const char *name, size_t len)
+{
+  /* An alias has no properties of its own */
+  p->anchor_len = 0;
+  p->tag_str = false;
+  return yaml_emit(p, YAML_EVENT_ALIAS, name, len, YAML_STYLE_PLAIN);
+}
+
+static bool
+yaml_parse_alias(yaml_parser_t *p)
+{
+  char name[YAML_ANCHOR_SIZE];
+  size_t len = yaml_scan_alias(p, name);
+  return 0 < len && yaml_emit_alias(p, name, len);
+}
+
+/*
+ * Scalars
+ */
+
+/* The rest of a plain scalar on this line. Stops before ": ", " #" and
+ * line breaks, and in flow context before ",[]{}" too. Trailing blanks
+ * are dropped. */
+static bool
+yaml_scan_plain_line(yaml_parser_t *p, bool flow)
+{
+  size_t text_end = p->slen;
+  int c;
+
+  while ((c = yaml_peek(p)) >= 0 && !yaml_break_p(c)) {
+    if (c == ':') {
+      int n = yaml_peek_at(p, 1);
+      if (yaml_blankz_p(n) || (flow && yaml_flow_indicator_p(n))) break;
+    }
+    if (flow && yaml_flow_indicator_p(c)) break;
+    if (c == '#' && text_end < p->slen) break;
+    if (!yaml_push(p, (char)c)) return false;
+    if (!yaml_blank_p(c)) text_end = p->slen;
+    yaml_next(p);
+  }
+  p->slen = text_end;
+  return true;
+}
+
+/* Fold the following lines of a block plain scalar into it as long as
+ * they are indented deeper than parent_indent */
+static bool
+yaml_scan_plain_rest(yaml_parser_t *p, int parent_indent)
+{
+  while (yaml_break_p(yaml_peek(p))) {
+    int breaks = 0;
+    do {
+      yaml_skip_break(p);
+      breaks++;
+      yaml_skip_space(p);
+    } while (yaml_break_p(yaml_peek(p)));
+    int c = yaml_peek(p);
+    if (c < 0 || c == '#' || p->column <= parent_indent || yaml_document_marker_p(p)) break;
+    if (breaks == 1) {
+      if (!yaml_push(p, ' ')) return false;
+    } else if (!yaml_push_breaks(p, breaks - 1)) {
+      return false;
+    }
+    if (!yaml_scan_plain_line(p, false)) return false;
+  }
+  return true;
+}
+
+/* Plain scalar in a flow collection, which may also run over lines */
+static bool
+yaml_scan_plain_flow(yaml_parser_t *p)
+{
+  if (!yaml_scan_plain_line(p, true)) return false;
+  while (yaml_break_p(yaml_peek(p))) {
+    int breaks = 0;
+    do {
+      yaml_skip_break(p);
+      breaks++;
+      yaml_skip_space(p);
+    } while (yaml_break_p(yaml_peek(p)));
+    int c = yaml_peek(p);
+    if (c < 0 || c == '#' || c == ':' || yaml_flow_indicator_p(c)) break;
+    if (breaks == 1) {
+      if (!yaml_push(p, ' ')) return false;
+    } else if (!yaml_push_breaks(p, breaks - 1)) {
+      return false;
+    }
+    if (!yaml_scan_plain_line(p, true)) return false;
+  }
+  return true;
+}
+
+static int
+yaml_hex(int c)
+{
+  if ('0' <= c && c <= '9') return c - '0';
+  if ('a' <= c && c <= 'f') return c - 'a' + 10;
+  if ('A' <= c && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool
+yaml_scan_escape(yaml_parser_t *p)
+{
+  int c = yaml_peek(p);
+  int digits = 0;
+
+  yaml_next(p);
+  switch (c) {
+    case '0': return yaml_push(p, '\0');
+    case 'a': return yaml_push(p, '\a');
+    case 'b': return yaml_push(p, '\b');
+    case 't':
+    case '\t': return yaml_push(p, '\t');
+    case 'n': return yaml_push(p, '\n');
+    case 'v': return yaml_push(p, '\v');
+    case 'f': return yaml_push(p, '\f');
+    case 'r': return yaml_push(p, '\r');
+    case 'e': return yaml_push(p, 0x1B);
+    case ' ': return yaml_push(p, ' ');
+    case '"': return yaml_push(p, '"');
+    case '/': return yaml_push(p, '/');
+    case '\\': return yaml_push(p, '\\');
+    case 'N': return yaml_push_utf8(p, 0x85);
+    case '_': return yaml_push_utf8(p, 0xA0);
+    case 'L': return yaml_push_utf8(p, 0x2028);
+    case 'P': return yaml_push_utf8(p, 0x2029);
+    case 'x': digits = 2; break;
+    case 'u': digits = 4; break;
+    case 'U': digits = 8; break;
+    default: return yaml_fail(p, "found unknown escape character");
+  }
+  uint32_t cp = 0;
+  while (0 < digits--) {
+    int h = yaml_hex(yaml_peek(p));
+    if (h < 0) return yaml_fail(p, "did not find expected hexdecimal number");
+    cp = (cp << 4) | (uint32_t)h;
+    yaml_next(p);
+  }
+  if (0x10FFFF < cp) return yaml_fail(p, "found invalid Unicode character escape code");
+  return yaml_push_utf8(p, cp);
+}
+
+/* 'single' or "double" quoted scalar. A line break folds into a space,
+ * and each blank line after it into a newline. */
+static bool
+yaml_scan_quoted(yaml_parser_t *p)
+{
+  int quote = yaml_peek(p);
+
+  yaml_next(p);
+  for (;;) {
+    int c = yaml_peek(p);
+    if (c < 0) return yaml_fail(p, "found unexpected end of stream while scanning a quoted scalar");
+    if (c == quote) {
+      yaml_next(p);
+      if (quote == '"' || yaml_peek(p) != '\'') break;
+      /* '' in a single quoted scalar */
+      if (!yaml_push(p, '\'')) return false;
+      yaml_next(p);
+      continue;
+    }
+    if (c == '\\' && quote == '"') {
+      yaml_next(p);
+      if (yaml_break_p(yaml_peek(p))) {
+        /* Escaped line break: joined without a space */
+        yaml_skip_break(p);
+        yaml_skip_space(p);
+        continue;
+      }
+      if (!yaml_scan_escape(p)) return false;
+      continue;
+    }
+    if (yaml_blank_p(c) || yaml_break_p(c)) {
+      size_t text_end = p->slen;
+      while (yaml_blank_p(c = yaml_peek(p))) {
+        if (!yaml_push(p, (char)c)) return false;
+        yaml_next(p);
+      }
+      if (yaml_break_p(c)) {
+        int breaks = 0;
+        p->slen = text_end;
+        while (yaml_break_p(yaml_peek(p))) {
+          yaml_skip_break(p);
+          breaks++;
+          yaml_skip_space(p);
+        }
+        if (breaks == 1) {
+          if (!yaml_push(p, ' ')) return false;
+        } else if (!yaml_push_breaks(p, breaks - 1)) {
+          return false;
+        }
+      }
+      continue;
+    }
+    if (!yaml_push(p, (char)c)) return false;
+    yaml_next(p);
+  }
+  return true;
+}
+
+/* Literal (|) or folded (>) block scalar. Content lines are those
+ * indented deeper than parent_indent; the first one sets the
+ * indentation unless the header gives it. */
+static bool
+yaml_scan_block_scalar(yaml_parser_t *p, int parent_indent)
+{
+  bool literal = yaml_peek(p) == '|';
+  int chomp = 0; /* -1: strip, 0: clip, 1: keep */
+  int indent = 0;
+  int breaks = 0;
+  bool started = false;
+  bool prev_more = false;
+  int c;
+
+  yaml_next(p);
+  for (int i = 0; i < 2; i++) {
+    c = yaml_peek(p);
+    if (c == '-' || c == '+') {
+      chomp = c == '-' ? -1 : 1;
+      yaml_next(p);
+    } else if ('1' <= c && c <= '9') {
+      indent = (parent_indent < 0 ? 0 : parent_indent) + (c - '0');
+      yaml_next(p);
+    }
+  }
+  yaml_skip_space(p);
+  yaml_skip_comment(p);
+  c = yaml_peek(p);
+  if (0 <= c && !yaml_break_p(c)) {
+    return yaml_fail(p, "did not find expected comment or line break");
+  }
+  yaml_skip_break(p);
+
+  for (;;) {
+    while (yaml_peek(p) == ' ' && (indent == 0 || p->column < indent)) yaml_next(p);
+    c = yaml_peek(p);
+    if (c < 0) break;
+    if (yaml_break_p(c)) {
+      yaml_skip_break(p);
+      breaks++;
+      continue;
+    }
+    if (indent == 0) {
+      if (p->column <= parent_indent) break;
+      indent = p->column;
+    }
+    if (p->column < indent || yaml_document_marker_p(p)) break;
+    /* A line starting with a blank is "more indented" and keeps its
+       line breaks when folded */
+    bool more = yaml_blank_p(c);
+    if (started && !literal && !more && !prev_more) {
+      if (breaks == 1) {
+        if (!yaml_push(p, ' ')) return false;
+      } else if (!yaml_push_breaks(p, breaks - 1)) {
+        return false;
+      }
+    } else if (!yaml_push_breaks(p, breaks)) {
+      return false;
+    }
+    started = true;
+    prev_more = more;
+    breaks = 0;
+    while ((c = yaml_peek(p)) >= 0 && !yaml_break_p(c)) {
+      if (!yaml_push(p, (char)c)) return false;
+      yaml_next(p);
+    }
+    if (c < 0) break;
+    yaml_skip_break(p);
+    breaks = 1;
+  }
+  if (0 < chomp) {
+    if (!yaml_push_breaks(p, breaks)) return false;
+  } else if (chomp == 0 && started) {
+    if (!yaml_push(p, '\n')) return false;
+  }
+  return true;
+}
+
+/*
+ * Flow collections
+ */
+
+static void
+yaml_skip_flow_space(yaml_parser_t *p)
+{
+  for (;;) {
+    int c = yaml_peek(p);
+    if (yaml_blank_p(c)) {
+      yaml_next(p);
+    } else if (yaml_break_p(c)) {
+      yaml_skip_break(p);
+    } else if (c == '#') {
+      yaml_skip_comment(p);
+    } else {
+      return;
+    }
+  }
+}
+
+static bool
+yaml_parse_flow_node(yaml_parser_t *p)
+{
+  int c;
+
+  yaml_skip_flow_space(p);
+  if (!yaml_parse_properties(p)) return false;
+  yaml_skip_flow_space(p);
+  c = yaml_peek(p);
+  p->slen = 0;
+  if (c == '*') return yaml_parse_alias(p);
+  if (c == '"' || c == '\'') {
+    return yaml_scan_quoted(p) &&
+           yaml_emit_scalar(p, c == '"' ? YAML_STYLE_DOUBLE_QUOTED : YAML_STYLE_SINGLE_QUOTED);
+  }
+  if (c == ',' || c == ']' || c == '}') {
+    /* Only properties: "[&a , b]" */
+    if (p->anchor_len || p->tag_str) return yaml_emit_null(p);
+    return yaml_fail(p, "did not find expected node content");
+  }
+  if (c < 0) return yaml_fail(p, "found unexpected end of stream");
+  if (c != '[' && c != '{') {
+    if (c == '|' || c == '>' || c == '%' || c == '@' || c == '`') {
+      return yaml_fail(p, "found character that cannot start any token");
+    }
+    return yaml_scan_plain_flow(p) && yaml_emit_scalar(p, YAML_STYLE_PLAIN);
+  }
+
+  bool map = c == '{';
+  int close = map ? '}' : ']';
+  if (YAML_MAX_DEPTH <= p->depth) return yaml_fail(p, "nesting of collections too deep");
+  p->depth++;
+  if (!yaml_emit(p, map ? YAML_EVENT_MAP_START : YAML_EVENT_SEQ_START, NULL, 0, YAML_STYLE_PLAIN)) {
+    return false;
+  }
+  yaml_next(p);
+  for (;;) {
+    yaml_skip_flow_space(p);
+    if (yaml_peek(p) == close) break;
+    if (!yaml_parse_flow_node(p)) return false;
+    if (map) {
+      yaml_skip_flow_space(p);
+      if (yaml_peek(p) == ':') {
+        yaml_next(p);
+        yaml_skip_flow_space(p);
+        c = yaml_peek(p);
+        if (c == ',' || c == '}') {
+          if (!yaml_emit_null(p)) return false;
+        } else if (!yaml_parse_flow_node(p)) {
+          return false;
+        }
+      } else if (!yaml_emit_null(p)) {
+        /* {a, b}: keys without values */
+        return false;
+      }
+    }
+    yaml_skip_flow_space(p);
+    c = yaml_peek(p);
+    if (c == ',') {
+      yaml_next(p);
+    } else if (c != close) {
+      return yaml_fail(p, map ? "did not find expected ',' or '}'" : "did not find expected ',' or ']'");
+    }
+  }
+  yaml_next(p);
+  p->depth--;
+  return yaml_emit(p, map ? YAML_EVENT_MAP_END : YAML_EVENT_SEQ_END, NULL, 0, YAML_STYLE_PLAIN);
+}
+
+/*
+ * Block collections
+ */
+
+static bool yaml_parse_block_node(yaml_parser_t *p, int parent_indent, bool seq_at_parent,
+                                  bool compact);
+
+/* After a node: the rest of its line must be blank or a comment. Moves
+ * to the next content. */
+static bool
+yaml_end_of_node(yaml_parser_t *p)
+{
+  yaml_skip_space(p);
+  if (!p->bol) {
+    yaml_skip_comment(p);
+    int c = yaml_peek(p);
+    if (0 <= c && !yaml_break_p(c)) return yaml_fail(p, "did not find expected <block end>");
+  }
+  yaml_skip_to_content(p);
+  return true;
+}
+
+static bool
+yaml_mapping_value_p(yaml_parser_t *p)
+{
+  return yaml_peek(p) == ':' && yaml_blankz_p(yaml_peek_at(p, 1));
+}
+
+/* Block mapping at indent. The first key is the alias when one is
+ * given, otherwise in scratch. */
+static bool
+yaml_parse_block_mapping(yaml_parser_t *p, int indent, yaml_style_t key_style,
+                         const char *alias, size_t alias_len)
+{
+  if (YAML_MAX_DEPTH <= p->depth) return yaml_fail(p, "nesting of collections too deep");
+  p->depth++;
+  if (!yaml_emit(p, YAML_EVENT_MAP_START, NULL, 0, YAML_STYLE_PLAIN)) return false;
+  if (alias) {
+    if (!yaml_emit_alias(p, alias, alias_len)) return false;
+  } else if (!yaml_emit_scalar(p, key_style)) {
+    return false;
+  }
+  for (;;) {
+    bool alias_key = false;
+    /* On the ':' after a key */
+    yaml_next(p);
+    if (!yaml_parse_block_node(p, indent, true, false)) return false;
+    if (!yaml_end_of_node(p)) return false;
+    int c = yaml_peek(p);
+    if (c < 0 || p->column < indent || yaml_document_marker_p(p)) break;
+    if (indent < p->column) return yaml_fail(p, "bad indentation of a mapping entry");
+    if (!yaml_parse_properties(p)) return false;
+    c = yaml_peek(p);
+    p->slen = 0;
+    if (c == '*') {
+      if (!yaml_parse_alias(p)) return false;
+      alias_key = true;
+    } else if (c == '"' || c == '\'') {
+      if (!yaml_scan_quoted(p)) return false;
+      key_style = c == '"' ? YAML_STYLE_DOUBLE_QUOTED : YAML_STYLE_SINGLE_QUOTED;
+    } else if (c == '?') {
+      return yaml_fail(p, "complex mapping keys are not supported");
+    } else if ((c == '-' && yaml_blankz_p(yaml_peek_at(p, 1))) || c == '[' || c == '{' ||
+               c == '|' || c == '>' || c == '#') {
+      return yaml_fail(p, "did not find expected key");
+    } else {
+      if (!yaml_scan_plain_line(p, false)) return false;
+      key_style = YAML_STYLE_PLAIN;
+    }
+    yaml_skip_space(p);
+    if (!yaml_mapping_value_p(p)) return yaml_fail(p, "could not find expected ':'");
+    if (!alias_key && !yaml_emit_scalar(p, key_style)) return false;
+  }
+  p->depth--;
+  return yaml_emit(p, YAML_EVENT_MAP_END, NULL, 0, YAML_STYLE_PLAIN);
+}
+
+/* Block sequence whose first "-" is at the current position */
+static bool
+yaml_parse_block_sequence(yaml_parser_t *p, int indent)
+{
+  if (YAML_MAX_DEPTH <= p->depth) return yaml_fail(p, "nesting of collections too deep");
+  p->depth++;
+  if (!yaml_emit(p, YAML_EVENT_SEQ_START, NULL, 0, YAML_STYLE_PLAIN)) return false;
+  for (;;) {
+    yaml_next(p);
+    if (!yaml_parse_block_node(p, indent, false, true)) return false;
+    if (!yaml_end_of_node(p)) return false;
+    int c = yaml_peek(p);
+    if (c < 0 || p->column < indent || yaml_document_marker_p(p)) break;
+    if (indent < p->column) return yaml_fail(p, "bad indentation of a sequence entry");
+    /* The next key of a mapping the sequence is the value of */
+    if (c != '-' || !yaml_blankz_p(yaml_peek_at(p, 1))) break;
+  }
+  p->depth--;
+  return yaml_emit(p, YAML_EVENT_SEQ_END, NULL, 0, YAML_STYLE_PLAIN);
+}
+
+/*
+ * A node in block context, starting on the line of its "key:", "- " or
+ * "---" indicator or on a following one.
+ *
+ * seq_at_parent: a sequence may start at parent_indent ("key:\n- a")
+ * compact: a collection may start on the indicator's line ("- a: 1")
+ */
+static bool
+yaml_parse_block_node(yaml_parser_t *p, int parent_indent, bool seq_at_parent, bool compact)
+{
+  int c;
+
+  yaml_skip_space(p);
+  if (!yaml_parse_properties(p)) return false;
+  c = yaml_peek(p);
+  if (c < 0 || c == '#' || yaml_break_p(c)) {
+    yaml_skip_to_content(p);
+    compact = true;
+    c = yaml_peek(p);
+    bool seq = seq_at_parent && p->column == parent_indent && c == '-' &&
+               yaml_blankz_p(yaml_peek_at(p, 1));
+    if (c < 0 || yaml_document_marker_p(p) || (p->column <= parent_indent && !seq)) {
+      return yaml_emit_null(p);
+    }
+    if (!seq && !p->anchor_len && !p->tag_str) {
+      if (!yaml_parse_properties(p)) return false;
+      c = yaml_peek(p);
+    }
+  }
+
+  int column = p->column;
+  p->slen = 0;
+  switch (c) {
+    case '*': {
+      char name[YAML_ANCHOR_SIZE];
+      size_t len = yaml_scan_alias(p, name);
+      if (len == 0) return false;
+      yaml_skip_space(p);
+      if (!yaml_mapping_value_p(p)) return yaml_emit_alias(p, name, len);
+      return compact ? yaml_parse_block_mapping(p, column, YAML_STYLE_PLAIN, name, len)
+                     : yaml_fail(p, "mapping values are not allowed in this context");
+    }
+    case '-':
+      if (yaml_blankz_p(yaml_peek_at(p, 1))) {
+        if (!compact) return yaml_fail(p, "block sequence entries are not allowed in this context");
+        return yaml_parse_block_sequence(p, column);
+      }
+      break;
+    case '[':
+    case '{':
+      return yaml_parse_flow_node(p);
+    case '|':
+    case '>':
+      return yaml_scan_block_scalar(p, parent_indent) &&
+             yaml_emit_scalar(p, c == '|' ? YAML_STYLE_LITERAL : YAML_STYLE_FOLDED);
+    case '"':
+    case '\'': {
+      yaml_style_t style = c == '"' ? YAML_STYLE_DOUBLE_QUOTED : YAML_STYLE_SINGLE_QUOTED;
+      if (!yaml_scan_quoted(p)) return false;
+      yaml_skip_space(p);
+      if (!yaml_mapping_value_p(p)) return yaml_emit_scalar(p, style);
+      return compact ? yaml_parse_block_mapping(p, column, style, NULL, 0)
+                     : yaml_fail(p, "mapping values are not allowed in this context");
+    }
+    case '?':
+      return yaml_fail(p, "complex mapping keys are not supported");
+    case '%':
+    case '@':
+    case '`':
+    case ']':
+    case '}':
+    case ',':
+      return yaml_fail(p, "found character that cannot start any token");
+    default:
+      break;
+  }
+  if (!yaml_scan_plain_line(p, false)) return false;
+  if (yaml_mapping_value_p(p)) {
+    return compact ? yaml_parse_block_mapping(p, column, YAML_STYLE_PLAIN, NULL, 0)
+                   : yaml_fail(p, "mapping values are not allowed in this context");
+  }
+  return yaml_scan_plain_rest(p, parent_indent) && yaml_emit_scalar(p, YAML_STYLE_PLAIN);
+}
+
+bool
+YAML_parse(yaml_parser_t *p)
+{
+  int c;
+
+  p->bol = true;
+  for (;;) {
+    yaml_skip_to_content(p);
+    /* Directives */
+    if (yaml_peek(p) != '%' || p->column != 0) break;
+    while ((c = yaml_peek(p)) >= 0 && !yaml_break_p(c)) yaml_next(p);
+  }
+  c = yaml_peek(p);
+  if (c < 0 || (yaml_document_marker_p(p) && c == '.')) return true;
+  if (yaml_document_marker_p(p)) {
+    yaml_next(p);
+    yaml_next(p);
+    yaml_next(p);
+    if (!yaml_parse_block_node(p, -1, false, false)) return false;
+  } else {
+    if (!yaml_parse_block_node(p, -1, false, true)) return false;
+  }
+  if (!yaml_end_of_node(p)) return false;
+  if (0 <= yaml_peek(p) && !yaml_document_marker_p(p)) {
+    return yaml_fail(p, "did not find expected <document start>");
+  }
+  return true;
+}
+
+/*
+ * Scalar resolution
+ */
+
+static bool
+yaml_word_p(const yaml_event_t *e, const char *lower, const char *title, const char *upper)
+{
+  size_t len = strlen(lower);
+  return e->len == len &&
+         (memcmp(e->value, lower, len) == 0 || memcmp(e->value, title, len) == 0 ||
+          memcmp(e->value, upper, len) == 0);
+}
+
+static bool
+yaml_digits_p(const char *s, size_t len, int base)
+{
+  if (len == 0) return false;
+  for (size_t i = 0; i < len; i++) {
+    int h = yaml_hex(s[i]);
+    if (h < 0 || base <= h) return false;
+  }
+  return true;
+}
+
+/* [-+]? ( \. [0-9]+ | [0-9]+ ( \. [0-9]* )? ) ( [eE] [-+]? [0-9]+ )? */
+static bool
+yaml_float_p(const char *s, size_t len)
+{
+  size_t i = 0, int_digits = 0, frac_digits = 0;
+
+  if (i < len && (s[i] == '-' || s[i] == '+')) i++;
+  while (i < len && '0' <= s[i] && s[i] <= '9') { i++; int_digits++; }
+  if (i < len && s[i] == '.') {
+    i++;
+    while (i < len && '0' <= s[i] && s[i] <= '9') { i++; frac_digits++; }
+  }
+  if (int_digits + frac_digits == 0) return false;
+  if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+    i++;
+    if (i < len && (s[i] == '-' || s[i] == '+')) i++;
+    if (!yaml_digits_p(s + i, len - i, 10)) return false;
+    return true;
+  }
+  return i == len;
+}
+
+yaml_scalar_t
+YAML_resolve(const yaml_event_t *event, int64_t *ival, double *fval)
+{
+  const char *s = event->value;
+  size_t len = event->len;
+  char buf[64];
+
+  if (event->style != YAML_STYLE_PLAIN || event->tag_str) return YAML_SCALAR_STRING;
+  if (len == 0 || (len == 1 && s[0] == '~') || yaml_word_p(event, "null", "Null", "NULL")) {
+    return YAML_SCALAR_NULL;
+  }
+  if (yaml_word_p(event, "true", "True", "TRUE")) return YAML_SCALAR_TRUE;
+  if (yaml_word_p(event, "false", "False", "FALSE")) return YAML_SCALAR_FALSE;
+  if (sizeof(buf) <= len) return YAML_SCALAR_STRING;
+
+  size_t sign = (s[0] == '-' || s[0] == '+') ? 1 : 0;
+  int base = 0;
+  size_t digits = sign;
+  if (!sign && 2 < len && s[0] == '0' && (s[1] == 'x' || s[1] == 'o')) {
+    base = s[1] == 'x' ? 16 : 8;
+    digits = 2;
+  } else if (yaml_digits_p(s + sign, len - sign, 10)) {
+    base = 10;
+  }
+  if (base && yaml_digits_p(s + digits, len - digits, base)) {
+    uint64_t n = 0;
+    bool overflow = false;
+    for (size_t i = digits; i < len; i++) {
+      uint64_t d = (uint64_t)yaml_hex(s[i]);
+      if ((UINT64_MAX - d) / base < n) overflow = true;
+      n = n * base + d;
+    }
+    bool negative = s[0] == '-';
+    if (!overflow && n <= (uint64_t)INT64_MAX + negative) {
+      *ival = negative ? (int64_t)(0 - n) : (int64_t)n;
+      return YAML_SCALAR_INTEGER;
+    }
+    memcpy(buf, s + digits, len - digits);
+    buf[len - digits] = '\0';
+    *fval = base == 10 ? strtod(buf, NULL) : (double)n;
+    if (negative) *fval = -*fval;
+    return YAML_SCALAR_FLOAT;
+  }
+
+  const char *t = s + sign;
+  size_t tlen = len - sign;
+  if (tlen == 4 && t[0] == '.' &&
+      (memcmp(t, ".inf", 4) == 0 || memcmp(t, ".Inf", 4) == 0 || memcmp(t, ".INF", 4) == 0)) {
+    *fval = s[0] == '-' ? -INFINITY : INFINITY;
+    return YAML_SCALAR_FLOAT;
+  }
+  if (!sign && yaml_word_p(event, ".nan", ".NaN", ".NAN")) {
+    *fval = NAN;
+    return YAML_SCALAR_FLOAT;
+  }
+  if (yaml_float_p(s, len)) {
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    *fval = strtod(buf, NULL);
+    return YAML_SCALAR_FLOAT;
+  }
+  return YAML_SCALAR_STRING;
+}
+
+#if defined(PICORB_VM_MRUBY)
+
+#include "mruby/yaml.c"
+
+#elif defined(PICORB_VM_MRUBYC)
+
+#include "mrubyc/yaml.c"
+
+#endif
@@ -0,0 +1,127 @@
+class YAMLTestReader
+  def initialize(data)
+    @data = data
+    @pos = 0
+  end
+
+  def read(n)
+    s = @data.byteslice(@pos, n)
+    @pos += n
+    s
+  end
+end
+
+class YAMLTest < Picotest::Test
+  def test_load_block_collections
+    yaml = <<~YAML
+      name: PicoRuby
+      version: 3
+      ratio: 1.5
+      enabled: true
+      none: ~
+      features:
+        - small
+        - fast
+      list:
+      - a: 1
+        b: 2
+      - c
+    YAML
+    expected = {
+      "name" => "PicoRuby", "version" => 3, "ratio" => 1.5, "enabled" => true, "none" => nil,
+      "features" => ["small", "fast"], "list" => [{"a" => 1, "b" => 2}, "c"]
+    }
+    assert_equal expected, YAML.load(yaml)
+  end
+
+  def test_load_flow_collections
+    yaml = <<~YAML
+      pins: [1, 2, 3]
+      led: {pin: 25, name: "status led"}
+      multi: [
+        a,   # comment
+        b
+      ]
+    YAML
+    expected = {"pins" => [1, 2, 3], "led" => {"pin" => 25, "name" => "status led"}, "multi" => ["a", "b"]}
+    assert_equal expected, YAML.load(yaml)
+  end
+
+  def test_load_scalars
+    yaml = <<~YAML
+      literal: |
+        line 1
+        line 2
+      folded: >-
+        one
+        two
+      plain: a long
+        plain scalar
+      single: 'it''s'
+      double: "tab\\tand \\u00e9"
+      string: "123"
+      tagged: !!str 456
+    YAML
+    result = YAML.load(yaml)
+    assert_equal "line 1\nline 2\n", result["literal"]
+    assert_equal "one two", result["folded"]
+    assert_equal "a long plain scalar", result["plain"]
+    assert_equal "it's", result["single"]
+    assert_equal "tab\tand é", result["double"]
+    assert_equal "123", result["string"]
+    assert_equal "456", result["tagged"]
+  end
+
+  def test_load_anchors_and_merge_keys
+    yaml = <<~YAML
+      base: &base
+        host: localhost
+        port: 80
+      dev:
+        <<: *base
+        port: 8080
+      copy: *base
+    YAML
+    result = YAML.load(yaml)
+    assert_equal({"host" => "localhost", "port" => 8080}, result["dev"])
+    assert result["copy"].equal?(result["base"])
+  end
+
+  def test_load_from_io
+    yaml = "key: value\nlist:\n  - " + "x" * 300 + "\n  - y\n"
+    result = YAML.load(YAMLTestReader.new(yaml))
+    assert_equal "value", result["key"]
+    assert_equal ["x" * 300, "y"], result["list"]
+  end
+
+  def test_load_empty
+    assert_equal({}, YAML.load(""))
+    assert_equal({}, YAML.load("# comment only\n"))
+  end
+
+  def test_syntax_error
+    assert_raise(YAML::SyntaxError) do
+      YAML.load("a: [1, 2\n")
+    end
+    assert_raise(YAML::SyntaxError) do
+      YAML.load("a: 1\n b: 2\n")
+    end
+  end
+
+  def test_dump_roundtrip
+    data = {"s" => "", "n" => "123", "t" => "true", "colon" => "a: b", "e" => [], "h" => {}, "i" => 1}
+    assert_equal data, YAML.load(YAML.dump(data))
+  end
+
+  def test_dump_roundtrip_escapes
+    data = {
+      "interp" => "\#{x} \#$y \#@z",
+      "quote" => "say \"hi\" \\ bye",
+      "control" => "a\tb\nc\rd\x01\x1f\x7f",
+      "lead" => " # \\"
+    }
+    yaml = YAML.dump(data)
+    assert_false yaml.include?("\\#")
+    assert_equal data, YAML.load(yaml)
+  end
+end